@@ -0,0 +1,59 @@
+#pragma once
+#include "math/box.h"
+#include "math/ray.h"
+#include <chrono>
+#include <memory>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	class Model;
+	struct Mesh;
+}
+
+// Minimal benchmark registry like the one of Tests, BENCHMARK defines a function run by main for every benchmark selected.
+namespace Benchmarks
+{
+	struct BenchmarkModel
+	{
+		std::string name;
+		std::shared_ptr<Engine::Model> model;
+		std::span<const Engine::Mesh> meshes;
+	};
+
+	struct BenchmarkCase
+	{
+		const char* name;
+		void (*function)(std::span<const BenchmarkModel> models);
+	};
+
+	std::vector<BenchmarkCase>& getBenchmarkCases();
+
+	struct BenchmarkRegistrar
+	{
+		BenchmarkRegistrar(const char* name, void (*function)(std::span<const BenchmarkModel>))
+		{
+			getBenchmarkCases().push_back({ name, function });
+		}
+	};
+
+	// Rays from points on the sphere around the box towards points inside it, so most of them hit something.
+	// The seed is fixed, every benchmark traces the same rays for the same box.
+	std::vector<Engine::math::Ray> createRays(const Engine::math::Box& bounds, uint32_t count);
+
+	// wall time of func in milliseconds
+	template <typename Func>
+	float measure(Func&& func)
+	{
+		auto start = std::chrono::steady_clock::now();
+		func();
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+}
+
+#define BENCHMARK(name) \
+	static void name(std::span<const Benchmarks::BenchmarkModel> models); \
+	static Benchmarks::BenchmarkRegistrar name##Registrar(#name, name); \
+	static void name(std::span<const Benchmarks::BenchmarkModel> models)
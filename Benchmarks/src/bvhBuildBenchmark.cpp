@@ -0,0 +1,56 @@
+#include "benchmark.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "utils/parallelExecutor.h"
+#include <cstdio>
+
+using namespace Engine;
+using namespace Benchmarks;
+
+namespace
+{
+	const uint32_t THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+
+	// summed over the meshes of the model
+	template <typename Build>
+	float measureBuilds(const BenchmarkModel& model, Build&& build)
+	{
+		float time = 0.0f;
+		for (const Mesh& mesh : model.meshes)
+		{
+			if (mesh.triangles.empty())
+			{
+				continue;
+			}
+
+			TriangleBVH bvh;
+			time += measure([&] { build(bvh, mesh); });
+		}
+		return time;
+	}
+}
+
+// Build time of the BINARY BVHs of every model, serial and with the parallel build at each thread count.
+// Speedup is against the serial build, meshes of up to TriangleBVH::PARALLEL_CHUNK_TRIANGLES triangles are built serially at any count.
+BENCHMARK(bvhBuildScaling)
+{
+	std::printf("%-12s %10s", "model", "serial ms");
+	for (uint32_t threadCount : THREAD_COUNTS)
+	{
+		std::printf(" | %2u threads ms  speedup", threadCount);
+	}
+	std::printf("\n");
+
+	for (const BenchmarkModel& model : models)
+	{
+		const float serialTime = measureBuilds(model, [](TriangleBVH& bvh, const Mesh& mesh) { bvh.initialize(mesh, TriangleBVH::Layout::BINARY); });
+		std::printf("%-12s %10.2f", model.name.c_str(), serialTime);
+
+		for (uint32_t threadCount : THREAD_COUNTS)
+		{
+			ParallelExecutor executor(threadCount);
+			const float time = measureBuilds(model, [&](TriangleBVH& bvh, const Mesh& mesh) { bvh.initialize(mesh, executor, TriangleBVH::Layout::BINARY); });
+			std::printf(" | %13.2f %8.2f", time, serialTime / time);
+		}
+		std::printf("\n");
+	}
+}
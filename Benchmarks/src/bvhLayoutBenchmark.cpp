@@ -0,0 +1,122 @@
+#include "benchmark.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "math/intersection.h"
+#include "math/rayPacket.h"
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+using namespace Engine;
+using namespace Benchmarks;
+
+namespace
+{
+	const uint32_t RAY_COUNT = 100000; // per mesh
+
+	struct LayoutResult
+	{
+		size_t nodeBytes = 0;
+		size_t totalBytes = 0;
+		float nearestTime = 0.0f;
+		float packetTime = 0.0f;
+		float occludedTime = 0.0f;
+	};
+
+	// Traces the rays one by one, as full packets and as any-hit queries. Rays beyond the last full packet are only traced one by one.
+	void traceRays(const TriangleBVH& bvh, const std::vector<math::Ray>& rays, std::vector<math::MeshIntersection>& outHits, LayoutResult& result)
+	{
+		result.nearestTime += measure([&]
+		{
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				outHits[i].reset(0.0f);
+				bvh.intersect(rays[i], outHits[i]);
+			}
+		});
+
+		result.packetTime += measure([&]
+		{
+			for (size_t first = 0; first + math::RayPacket::SIZE <= rays.size(); first += math::RayPacket::SIZE)
+			{
+				math::RayPacket packet;
+				math::MeshIntersection hits[math::RayPacket::SIZE];
+				for (uint32_t lane = 0; lane < math::RayPacket::SIZE; ++lane)
+				{
+					packet.set(lane, rays[first + lane]);
+					hits[lane].reset(0.0f);
+				}
+				bvh.intersect(packet, math::RayPacket::FULL_MASK, hits);
+			}
+		});
+
+		result.occludedTime += measure([&]
+		{
+			for (const math::Ray& ray : rays)
+			{
+				bvh.occluded(ray, std::numeric_limits<float>::infinity());
+			}
+		});
+	}
+
+	void printLayout(const char* name, const LayoutResult& result, size_t triangleCount, size_t rayCount)
+	{
+		std::printf(" | %-6s %9.1f %9.1f %12.0f %12.0f %12.0f", name, double(result.nodeBytes) / triangleCount, double(result.totalBytes) / triangleCount,
+			rayCount * 1000.0f / result.nearestTime, rayCount * 1000.0f / result.packetTime, rayCount * 1000.0f / result.occludedTime);
+	}
+}
+
+// Bytes per triangle of the nodes and of the whole tree, and rays per second of nearest hit, packet and any-hit queries
+// of the BINARY and QUANTIZED_WIDE layouts. Mismatches count rays whose nearest hit differs between the two by more than rounding.
+BENCHMARK(bvhLayouts)
+{
+	std::printf("%-12s %9s | %-6s %9s %9s %12s %12s %12s | %-6s %9s %9s %12s %12s %12s | %s\n", "model", "triangles",
+		"layout", "node B/t", "total B/t", "nearest/s", "packet/s", "occluded/s",
+		"layout", "node B/t", "total B/t", "nearest/s", "packet/s", "occluded/s", "mismatches");
+
+	for (const BenchmarkModel& model : models)
+	{
+		size_t triangleCount = 0;
+		size_t rayCount = 0;
+		uint32_t mismatches = 0;
+		LayoutResult binary, wide;
+
+		for (const Mesh& mesh : model.meshes)
+		{
+			if (mesh.triangles.empty())
+			{
+				continue;
+			}
+			triangleCount += mesh.triangles.size();
+
+			TriangleBVH binaryBVH, wideBVH;
+			binaryBVH.initialize(mesh, TriangleBVH::Layout::BINARY);
+			wideBVH.initialize(mesh, TriangleBVH::Layout::QUANTIZED_WIDE);
+
+			binary.nodeBytes += binaryBVH.getNodes().size_bytes() + binaryBVH.getWideNodes().size_bytes();
+			binary.totalBytes += binaryBVH.getMemoryUsage();
+			wide.nodeBytes += wideBVH.getNodes().size_bytes() + wideBVH.getWideNodes().size_bytes();
+			wide.totalBytes += wideBVH.getMemoryUsage();
+
+			const std::vector<math::Ray> rays = createRays(mesh.boundingBox, RAY_COUNT);
+			rayCount += rays.size();
+
+			std::vector<math::MeshIntersection> binaryHits(rays.size()), wideHits(rays.size());
+			traceRays(binaryBVH, rays, binaryHits, binary);
+			traceRays(wideBVH, rays, wideHits, wide);
+
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				if (binaryHits[i].valid() != wideHits[i].valid() ||
+					(binaryHits[i].valid() && std::abs(binaryHits[i].t - wideHits[i].t) > binaryHits[i].t * 1e-4f))
+				{
+					++mismatches;
+				}
+			}
+		}
+
+		std::printf("%-12s %9zu", model.name.c_str(), triangleCount);
+		printLayout("binary", binary, triangleCount, rayCount);
+		printLayout("wide", wide, triangleCount, rayCount);
+		std::printf(" | %u\n", mismatches);
+	}
+}
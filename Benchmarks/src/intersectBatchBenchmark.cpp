@@ -0,0 +1,103 @@
+#include "benchmark.h"
+#include "render/meshSystem/meshSystem.h"
+#include "transformSystem/transformSystem.h"
+#include "utils/parallelExecutor.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+using namespace Engine;
+using namespace Benchmarks;
+
+namespace
+{
+	const uint32_t GRID_SIZE = 4; // instances of every model along each horizontal axis
+	const uint32_t RAY_COUNTS[] = { 1000, 10000, 100000, 1000000 };
+	const uint32_t THREAD_COUNTS[] = { 1, 2, 4, 8, 16 };
+
+	math::Box getModelBounds(const BenchmarkModel& model)
+	{
+		math::Box bounds = math::Box::empty();
+		for (const Mesh& mesh : model.meshes)
+		{
+			for (const math::Mat4f& meshToModel : mesh.instances)
+			{
+				bounds.expand(mesh.boundingBox.transformed(meshToModel));
+			}
+		}
+		return bounds;
+	}
+
+	// Places GRID_SIZE x GRID_SIZE instances of every model in a cell each, one row of cells per model. Returns the bounds of the scene.
+	math::Box createScene(std::span<const BenchmarkModel> models)
+	{
+		float cellSize = 0.0f;
+		for (const BenchmarkModel& model : models)
+		{
+			cellSize = (std::max)(cellSize, getModelBounds(model).size().maxCoeff());
+		}
+
+		math::Box sceneBounds = math::Box::empty();
+		for (size_t row = 0; row < models.size(); ++row)
+		{
+			const math::Box modelBounds = getModelBounds(models[row]);
+			for (uint32_t x = 0; x < GRID_SIZE; ++x)
+			{
+				for (uint32_t z = 0; z < GRID_SIZE; ++z)
+				{
+					const math::Vec3f cellCenter(cellSize * float(x), 0.0f, cellSize * float(z + row * GRID_SIZE));
+					const math::Vec3f translation = cellCenter - modelBounds.center();
+
+					const TransformSystem::ID id = TransformSystem::getInstance()->createMatrix();
+					math::Mat4f& modelToWorld = TransformSystem::getInstance()->getMatrix(id);
+					modelToWorld = math::Mat4f::Identity();
+					math::setTranslation(modelToWorld, translation);
+
+					MeshSystem::getInstancePtr()->addNormalVisInstance(models[row].model, std::make_shared<ShadingGroupsDetails::NormalVisMaterial>(), { id, 0 });
+
+					sceneBounds.expand(modelBounds.min + translation);
+					sceneBounds.expand(modelBounds.max + translation);
+				}
+			}
+		}
+		return sceneBounds;
+	}
+}
+
+// MeshSystem::intersectBatch over the instances of all models, for growing batches and thread counts.
+// Speedup is against one thread for the same batch. The scene stays in the MeshSystem until exit.
+BENCHMARK(intersectBatchScaling)
+{
+	const math::Box bounds = createScene(models);
+	MeshSystem* meshSystem = MeshSystem::getInstancePtr();
+
+	std::printf("%10s %8s | %10s %13s %8s | %s\n", "rays", "threads", "ms", "rays/s", "speedup", "hits");
+	for (uint32_t rayCount : RAY_COUNTS)
+	{
+		const std::vector<math::Ray> rays = createRays(bounds, rayCount);
+		std::vector<MeshSystem::RayHit> hits(rays.size());
+
+		float singleThreadTime = 0.0f;
+		for (uint32_t threadCount : THREAD_COUNTS)
+		{
+			ParallelExecutor executor(threadCount);
+
+			// the first call builds the instance BVH, which isn't part of the timing
+			auto trace = [&]
+			{
+				for (MeshSystem::RayHit& hit : hits)
+				{
+					hit.nearest.reset();
+				}
+				meshSystem->intersectBatch(rays, hits, executor);
+			};
+			trace();
+
+			const float time = measure(trace);
+			singleThreadTime = threadCount == 1 ? time : singleThreadTime;
+
+			const size_t hitCount = std::count_if(hits.begin(), hits.end(), [](const MeshSystem::RayHit& hit) { return std::isfinite(hit.nearest.t); });
+			std::printf("%10u %8u | %10.2f %13.0f %8.2f | %zu\n", rayCount, threadCount, time, rayCount * 1000.0f / time, singleThreadTime / time, hitCount);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+#include "benchmark.h"
+#include "engine/engine.h"
+#include "resourcesManagers/modelManager.h"
+#include "math/simd.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace Benchmarks
+{
+	std::vector<BenchmarkCase>& getBenchmarkCases()
+	{
+		static std::vector<BenchmarkCase> benchmarkCases;
+		return benchmarkCases;
+	}
+
+	std::vector<Engine::math::Ray> createRays(const Engine::math::Box& bounds, uint32_t count)
+	{
+		using namespace Engine::math;
+
+		std::mt19937 random(7);
+		std::normal_distribution<float> normal;
+		std::uniform_real_distribution<float> inside(-0.5f, 0.5f);
+
+		const Vec3f center = bounds.center();
+		const Vec3f size = bounds.size();
+		const float radius = (std::max)(bounds.radius() * 1.5f, 1e-3f);
+
+		std::vector<Ray> rays(count);
+		for (Ray& ray : rays)
+		{
+			Vec3f onSphere(normal(random), normal(random), normal(random));
+			ray.origin = center + onSphere.normalized() * radius;
+
+			Vec3f target = center + size.cwiseProduct(Vec3f(inside(random), inside(random), inside(random)));
+			ray.direction = (target - ray.origin).normalized();
+		}
+		return rays;
+	}
+}
+
+// Loads the shipped models and runs every benchmark, or the ones whose name contains the first argument.
+// Asset and shader paths are relative to the Project directory, which has to be the working directory.
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	std::printf("simd width %u\n", Engine::math::simd::WIDTH);
+
+	Engine::Engine::init();
+	{
+		std::vector<Benchmarks::BenchmarkModel> models;
+		for (const char* name : { "Cube/cube", "EastTower/EastTower", "Knight/Knight", "KnightHorse/KnightHorse", "Samurai/Samurai" })
+		{
+			std::shared_ptr<Engine::Model> model = Engine::ModelManager::getInstancePtr()->getModel(std::string("Assets/Models/") + name + ".fbx");
+			models.push_back({ std::strchr(name, '/') + 1, model, model->getMeshes() });
+		}
+
+		for (const Benchmarks::BenchmarkCase& benchmarkCase : Benchmarks::getBenchmarkCases())
+		{
+			if (filter && !std::strstr(benchmarkCase.name, filter))
+			{
+				continue;
+			}
+
+			std::printf("\n%s\n", benchmarkCase.name);
+			benchmarkCase.function(models);
+		}
+	}
+	Engine::Engine::deinit();
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include "benchmark.h"
+#include "triangleOctree.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "math/intersection.h"
+#include <cmath>
+#include <cstdio>
+
+using namespace Engine;
+using namespace Benchmarks;
+
+namespace
+{
+	const uint32_t RAY_COUNT = 100000; // per mesh
+}
+
+// Build time, heap memory and nearest hit rays per second of the octree the BVH replaced and of the BINARY BVH, both built on one thread.
+// Mismatches count rays whose hit differs between the two by more than rounding.
+BENCHMARK(octreeVsBVH)
+{
+	std::printf("%-12s %9s | %10s %10s | %10s %10s | %13s %13s | %s\n", "model", "triangles", "octree ms", "bvh ms", "octree KB", "bvh KB", "octree rays/s", "bvh rays/s", "mismatches");
+
+	for (const BenchmarkModel& model : models)
+	{
+		size_t triangleCount = 0;
+		size_t rayCount = 0;
+		uint32_t mismatches = 0;
+		float octreeBuild = 0.0f, bvhBuild = 0.0f;
+		float octreeTrace = 0.0f, bvhTrace = 0.0f;
+		size_t octreeMemory = 0, bvhMemory = 0;
+
+		for (const Mesh& mesh : model.meshes)
+		{
+			if (mesh.triangles.empty())
+			{
+				continue;
+			}
+			triangleCount += mesh.triangles.size();
+
+			TriangleOctree octree;
+			octreeBuild += measure([&] { octree.initialize(mesh); });
+			octreeMemory += octree.getMemoryUsage();
+
+			TriangleBVH bvh;
+			bvhBuild += measure([&] { bvh.initialize(mesh, TriangleBVH::Layout::BINARY); });
+			bvhMemory += bvh.getMemoryUsage();
+
+			const std::vector<math::Ray> rays = createRays(mesh.boundingBox, RAY_COUNT);
+			rayCount += rays.size();
+
+			std::vector<math::MeshIntersection> octreeHits(rays.size());
+			octreeTrace += measure([&]
+			{
+				for (size_t i = 0; i < rays.size(); ++i)
+				{
+					octreeHits[i].reset(0.0f);
+					octree.intersect(rays[i], octreeHits[i]);
+				}
+			});
+
+			std::vector<math::MeshIntersection> bvhHits(rays.size());
+			bvhTrace += measure([&]
+			{
+				for (size_t i = 0; i < rays.size(); ++i)
+				{
+					bvhHits[i].reset(0.0f);
+					bvh.intersect(rays[i], bvhHits[i]);
+				}
+			});
+
+			for (size_t i = 0; i < rays.size(); ++i)
+			{
+				if (octreeHits[i].valid() != bvhHits[i].valid() ||
+					(bvhHits[i].valid() && std::abs(octreeHits[i].t - bvhHits[i].t) > bvhHits[i].t * 1e-4f))
+				{
+					++mismatches;
+				}
+			}
+		}
+
+		std::printf("%-12s %9zu | %10.2f %10.2f | %10zu %10zu | %13.0f %13.0f | %u\n", model.name.c_str(), triangleCount,
+			octreeBuild, bvhBuild, octreeMemory / 1024, bvhMemory / 1024,
+			rayCount * 1000.0f / octreeTrace, rayCount * 1000.0f / bvhTrace, mismatches);
+	}
+}
@@ -1,9 +1,7 @@
 #include "triangleOctree.h"
-#include "mesh.h"
-#include "../../../math/ray.h"
-#include "../../../math/intersection.h"
+#include "render/meshSystem/mesh/mesh.h"
 #include <algorithm>
-#include "../../../utils/assert.h"
+#include "utils/assert.h"
 
 namespace Engine
 {
@@ -60,6 +58,20 @@ namespace Engine
 		return intersectInternal(ray, nearest);
 	}
 
+	size_t TriangleOctree::getMemoryUsage() const
+	{
+		size_t usage = m_triangles.capacity() * sizeof(uint32_t);
+		if (m_children)
+		{
+			usage += sizeof(std::array<TriangleOctree, 8>);
+			for (const TriangleOctree& child : *m_children)
+			{
+				usage += child.getMemoryUsage();
+			}
+		}
+		return usage;
+	}
+
 	void TriangleOctree::initialize(const Mesh& mesh, const math::Box& parentBoundingBox, const math::Vec3f& parentCenter, int octetIndex)
 	{
 		m_mesh = &mesh;
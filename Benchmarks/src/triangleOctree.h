@@ -1,5 +1,7 @@
 #pragma once
-#include "../../math/box.h"
+#include "math/box.h"
+#include "math/intersection.h"
+#include "math/ray.h"
 #include <limits>
 #include <vector>
 #include <memory>
@@ -9,6 +11,7 @@ namespace Engine
 {
 	struct Mesh;
 
+	// The octree meshes were traced with before TriangleBVH, kept only as the baseline of the benchmarks.
 	class TriangleOctree
 	{
 	public:
@@ -34,6 +37,9 @@ namespace Engine
 		void initialize(const Mesh& mesh);
 		bool intersect(const math::Ray& ray, math::MeshIntersection& nearest) const;
 
+		// heap memory of the triangle lists and the children, comparable to TriangleBVH::getMemoryUsage
+		size_t getMemoryUsage() const;
+
 	protected:
 		const Mesh* m_mesh = nullptr;
 		std::vector<uint32_t> m_triangles;
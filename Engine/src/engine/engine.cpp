@@ -3,6 +3,7 @@
 #include "../render/meshSystem/meshSystem.h"
 #include "../render/lightSystem/lightSystem.h"
 #include "../resourcesManagers/modelManager.h"
+#include "../render/meshSystem/mesh/geometryPool.h"
 #include "../resourcesManagers/textureManager.h"
 #include "../transformSystem/transformSystem.h"
 #include "renderer.h"
@@ -16,6 +17,7 @@ namespace Engine
 	{
 		D3D::createInstance()->init();
 		Random::createInstance()->init();
+		GeometryPool::createInstance();
 		ModelManager::createInstance();
 		TextureManager::createInstance()->init();
 		MeshSystem::createInstance();
@@ -37,6 +39,7 @@ namespace Engine
 		MeshSystem::deleteInstance();
 		TextureManager::deleteInstance();
 		ModelManager::deleteInstance();
+		GeometryPool::deleteInstance();
 		D3D::deleteInstance();
 	}
 }
\ No newline at end of file
@@ -5,6 +5,7 @@
 #include "../render/lightSystem/lightSystem.h"
 #include "../render/particleSystem/particleSystem.h"
 #include "../render/decalSystem/decalSystem.h"
+#include "../resourcesManagers/modelManager.h"
 
 namespace Engine
 {
@@ -78,6 +79,8 @@ namespace Engine
 	{
 		clearViews();
 
+		// models loaded in the background since the last frame get their GPU buffers here, before their instances are gathered
+		ModelManager::getInstancePtr()->update();
 		MeshSystem::getInstancePtr()->updateShadingGroupsInstanceBuffers(camera);
 
 		renderDepth(camera);
@@ -39,6 +39,12 @@ namespace Engine::math
 			return size().norm() / 2.0f;
 		}
 
+		float surfaceArea() const
+		{
+			Vec3f s = size();
+			return 2.0f * (s.x() * s.y() + s.y() * s.z() + s.z() * s.x());
+		}
+
 		void reset()
 		{
 			constexpr float maxf = (std::numeric_limits<float>::max)();
@@ -66,6 +72,30 @@ namespace Engine::math
 				min[2] <= point[2] && point[2] <= max[2];
 		}
 
+		bool overlaps(const Box& box) const
+		{
+			return
+				min[0] <= box.max[0] && box.min[0] <= max[0] &&
+				min[1] <= box.max[1] && box.min[1] <= max[1] &&
+				min[2] <= box.max[2] && box.min[2] <= max[2];
+		}
+
+		float squaredDistance(const Vec3f& point) const
+		{
+			Vec3f outside = (min - point).cwiseMax(point - max).cwiseMax(0.0f);
+			return outside.squaredNorm();
+		}
+
+		// bounds of the box transformed by an affine (row-vector) matrix
+		Box transformed(const Mat4f& matrix) const
+		{
+			Vec3f halfSize = size() / 2.0f;
+			Vec3f transformedCenter = (Vec4f(center().x(), center().y(), center().z(), 1.0f) * matrix).head<3>();
+			Vec3f transformedHalfSize = halfSize * matrix.topLeftCorner<3, 3>().cwiseAbs();
+
+			return { transformedCenter - transformedHalfSize, transformedCenter + transformedHalfSize };
+		}
+
 		bool intersects(const Ray& ray, Intersection& outNearest) const;
 		bool intersects(const Ray& ray, MeshIntersection& outNearest) const;
 		
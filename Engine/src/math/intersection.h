@@ -20,6 +20,14 @@ namespace Engine::math
 		}
 	};
 
+	struct MeshClosestPoint
+	{
+		math::Vec3f position;
+		math::Vec3f barycentrics; // weights of the triangle vertices
+		float distance;
+		uint32_t triangle;
+	};
+
 	struct MeshIntersection
 	{
 		math::Vec3f position;
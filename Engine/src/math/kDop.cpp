@@ -0,0 +1,63 @@
+#include "kDop.h"
+#include "ray.h"
+#include <algorithm>
+
+namespace Engine::math
+{
+	const Vec3f KDop::DIRECTIONS[KDop::DIRECTION_COUNT] =
+	{
+		{ 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 1.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f },
+		{ 1.0f, 1.0f, 1.0f },
+		{ 1.0f, 1.0f, -1.0f },
+		{ 1.0f, -1.0f, 1.0f },
+		{ -1.0f, 1.0f, 1.0f }
+	};
+
+	KDop KDop::empty()
+	{
+		KDop dop;
+		std::fill(std::begin(dop.min), std::end(dop.min), Box::Inf);
+		std::fill(std::begin(dop.max), std::end(dop.max), -Box::Inf);
+		return dop;
+	}
+
+	void KDop::expand(const Vec3f& point)
+	{
+		for (uint32_t i = 0; i < DIRECTION_COUNT; ++i)
+		{
+			float distance = point.dot(DIRECTIONS[i]);
+			min[i] = std::min(min[i], distance);
+			max[i] = std::max(max[i], distance);
+		}
+	}
+
+	bool KDop::intersects(const Ray& ray, float tMax) const
+	{
+		float tEnter = 0.0f;
+		float tExit = tMax;
+
+		for (uint32_t i = 0; i < DIRECTION_COUNT && tEnter <= tExit; ++i)
+		{
+			float origin = ray.origin.dot(DIRECTIONS[i]);
+			float direction = ray.direction.dot(DIRECTIONS[i]);
+			if (direction == 0.0f)
+			{
+				// parallel to the slab, which it never leaves or enters
+				if (origin < min[i] || origin > max[i])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float t1 = (min[i] - origin) / direction;
+			float t2 = (max[i] - origin) / direction;
+			tEnter = std::max(tEnter, std::min(t1, t2));
+			tExit = std::min(tExit, std::max(t1, t2));
+		}
+
+		return tEnter <= tExit;
+	}
+}
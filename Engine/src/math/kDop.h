@@ -0,0 +1,32 @@
+#pragma once
+#include "box.h"
+#include <cstdint>
+
+namespace Engine::math
+{
+	struct Ray;
+
+	// Convex hull approximation bounded by pairs of planes along fixed directions: the axes and the four cube diagonals (a 14-DOP).
+	// The diagonals aren't normalized, so min and max along them are in units of their length.
+	struct KDop
+	{
+		static constexpr uint32_t DIRECTION_COUNT = 7;
+		static const Vec3f DIRECTIONS[DIRECTION_COUNT];
+
+		float min[DIRECTION_COUNT];
+		float max[DIRECTION_COUNT];
+
+		static KDop empty();
+
+		void expand(const Vec3f& point);
+
+		// the first three directions are the axes
+		Box getBounds() const
+		{
+			return { { min[0], min[1], min[2] }, { max[0], max[1], max[2] } };
+		}
+
+		// whether the ray enters the hull in [0, tMax), the origin lying inside counts
+		bool intersects(const Ray& ray, float tMax) const;
+	};
+}
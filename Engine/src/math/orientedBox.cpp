@@ -0,0 +1,34 @@
+#include "orientedBox.h"
+#include "ray.h"
+#include <algorithm>
+
+namespace Engine::math
+{
+	bool OrientedBox::intersects(const Ray& ray, float tMax) const
+	{
+		// slab test in the space of the box
+		const Vec3f origin = (ray.origin - center) * axes.transpose();
+		const Vec3f direction = ray.direction * axes.transpose();
+
+		float tEnter = 0.0f;
+		float tExit = tMax;
+		for (int i = 0; i < 3 && tEnter <= tExit; ++i)
+		{
+			if (direction[i] == 0.0f)
+			{
+				if (std::abs(origin[i]) > halfSize[i])
+				{
+					return false;
+				}
+				continue;
+			}
+
+			float t1 = (-halfSize[i] - origin[i]) / direction[i];
+			float t2 = (halfSize[i] - origin[i]) / direction[i];
+			tEnter = std::max(tEnter, std::min(t1, t2));
+			tExit = std::min(tExit, std::max(t1, t2));
+		}
+
+		return tEnter <= tExit;
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "box.h"
+
+namespace Engine::math
+{
+	struct Ray;
+
+	// Box rotated by axes, a point p is inside if |dot(p - center, axes.row(i))| <= halfSize[i] for every axis
+	struct OrientedBox
+	{
+		Vec3f center;
+		Mat3f axes; // orthonormal rows
+		Vec3f halfSize;
+
+		static OrientedBox fromBox(const Box& box)
+		{
+			return { box.center(), Mat3f::Identity(), box.size() / 2.0f };
+		}
+
+		float surfaceArea() const
+		{
+			return 8.0f * (halfSize.x() * halfSize.y() + halfSize.y() * halfSize.z() + halfSize.z() * halfSize.x());
+		}
+
+		// half of the extent of the box along direction, which doesn't have to be normalized
+		float projectedRadius(const Vec3f& direction) const
+		{
+			return (axes * direction.transpose()).cwiseAbs().transpose().dot(halfSize);
+		}
+
+		Box getBounds() const
+		{
+			Vec3f extent = halfSize * axes.cwiseAbs();
+			return { center - extent, center + extent };
+		}
+
+		// bounds of the box transformed by an affine (row-vector) matrix, exact even if the matrix skews the box
+		Box transformedBounds(const Mat4f& matrix) const
+		{
+			Vec3f transformedCenter = (Vec4f(center.x(), center.y(), center.z(), 1.0f) * matrix).head<3>();
+			Vec3f extent = halfSize * (axes * matrix.topLeftCorner<3, 3>()).cwiseAbs();
+			return { transformedCenter - extent, transformedCenter + extent };
+		}
+
+		// whether the ray enters the box in [0, tMax), the origin lying inside counts
+		bool intersects(const Ray& ray, float tMax) const;
+	};
+}
@@ -0,0 +1,164 @@
+#include "packedVertex.h"
+#include <algorithm>
+#include <cstring>
+
+namespace Engine::math
+{
+	const float PackedVertex::TEXTURE_COORDINATES_RELATIVE_ERROR = 1.0f / 2048.0f;
+	const float PackedVertex::NORMAL_MAX_ERROR_DEGREES = 0.09f;
+	const float PackedVertex::TANGENT_MAX_ERROR_DEGREES = 0.4f;
+	const Vec4f PackedVertex::COLOR = Vec4f(1.0f, 0.0f, 1.0f, 1.0f);
+
+	namespace
+	{
+		const uint32_t NORMAL_BITS = 11;
+		const uint32_t ANGLE_BITS = 9;
+		const int NORMAL_MAX = (1 << (NORMAL_BITS - 1)) - 1; // signed normalized, so 0 and +-1 are exact
+		const uint32_t ANGLE_STEPS = 1 << ANGLE_BITS;
+		const float TWO_PI = 2.0f * float(M_PI);
+
+		float signNotZero(float value)
+		{
+			return value >= 0.0f ? 1.0f : -1.0f;
+		}
+
+		Vec2f encodeOctahedral(const Vec3f& normal)
+		{
+			Vec2f p = Vec2f(normal.x(), normal.y()) / (std::abs(normal.x()) + std::abs(normal.y()) + std::abs(normal.z()));
+			if (normal.z() < 0.0f)
+			{
+				p = Vec2f((1.0f - std::abs(p.y())) * signNotZero(p.x()), (1.0f - std::abs(p.x())) * signNotZero(p.y()));
+			}
+			return p;
+		}
+
+		Vec3f decodeOctahedral(int x, int y)
+		{
+			Vec3f normal(float(x) / NORMAL_MAX, float(y) / NORMAL_MAX, 0.0f);
+			normal.z() = 1.0f - std::abs(normal.x()) - std::abs(normal.y());
+			float t = std::max(-normal.z(), 0.0f);
+			normal.x() += normal.x() >= 0.0f ? -t : t;
+			normal.y() += normal.y() >= 0.0f ? -t : t;
+			return normal.normalized();
+		}
+
+		// Orthonormal basis of the plane orthogonal to normal without branches on small components (Duff et al. 2017).
+		// The tangent angle is measured from basisX towards basisY, Shaders/vertex.hlsl has to build the same basis.
+		void buildBasis(const Vec3f& normal, Vec3f& basisX, Vec3f& basisY)
+		{
+			float sign = signNotZero(normal.z());
+			float a = -1.0f / (sign + normal.z());
+			float b = normal.x() * normal.y() * a;
+			basisX = Vec3f(1.0f + sign * normal.x() * normal.x() * a, sign * b, -sign * normal.x());
+			basisY = Vec3f(b, sign + normal.y() * normal.y() * a, -normal.y());
+		}
+	}
+
+	PackedVertex PackedVertex::pack(const Vertex& vertex)
+	{
+		PackedVertex packed;
+		packed.position = vertex.position;
+		packed.textureCoordinates[0] = floatToHalf(vertex.textureCoordinates.x());
+		packed.textureCoordinates[1] = floatToHalf(vertex.textureCoordinates.y());
+
+		Vec3f normal = vertex.normal.squaredNorm() > 0.0f ? vertex.normal.normalized() : Vec3f(0.0f, 0.0f, 1.0f);
+
+		// rounding both coordinates to the nearest step isn't always the closest direction, so the 4 neighbours are compared
+		Vec2f p = encodeOctahedral(normal) * float(NORMAL_MAX);
+		int bestX = 0, bestY = 0;
+		float bestCos = -2.0f;
+		for (int i = 0; i < 4; ++i)
+		{
+			int x = std::clamp(int(i & 1 ? std::ceil(p.x()) : std::floor(p.x())), -NORMAL_MAX, NORMAL_MAX);
+			int y = std::clamp(int(i & 2 ? std::ceil(p.y()) : std::floor(p.y())), -NORMAL_MAX, NORMAL_MAX);
+			float cos = decodeOctahedral(x, y).dot(normal);
+			if (cos > bestCos)
+			{
+				bestCos = cos;
+				bestX = x;
+				bestY = y;
+			}
+		}
+
+		// the angle is measured around the decoded normal, so that unpacking doesn't add the normal error to it twice
+		Vec3f decodedNormal = decodeOctahedral(bestX, bestY);
+		Vec3f basisX, basisY;
+		buildBasis(decodedNormal, basisX, basisY);
+
+		Vec3f tangent = vertex.tangent - decodedNormal * decodedNormal.dot(vertex.tangent);
+		float angle = std::atan2(tangent.dot(basisY), tangent.dot(basisX));
+		uint32_t angleStep = uint32_t(int(std::lround(angle / TWO_PI * ANGLE_STEPS)) & int(ANGLE_STEPS - 1));
+
+		uint32_t handedness = vertex.bitangent.dot(normal.cross(vertex.tangent)) < 0.0f ? 1 : 0;
+
+		packed.tangentFrame = uint32_t(bestX + NORMAL_MAX) | uint32_t(bestY + NORMAL_MAX) << NORMAL_BITS |
+			angleStep << (2 * NORMAL_BITS) | handedness << (2 * NORMAL_BITS + ANGLE_BITS);
+		return packed;
+	}
+
+	Vertex PackedVertex::unpack() const
+	{
+		const uint32_t normalMask = (1 << NORMAL_BITS) - 1;
+
+		Vertex vertex;
+		vertex.position = position;
+		vertex.color = COLOR;
+		vertex.textureCoordinates = Vec2f(halfToFloat(textureCoordinates[0]), halfToFloat(textureCoordinates[1]));
+
+		vertex.normal = decodeOctahedral(int(tangentFrame & normalMask) - NORMAL_MAX, int(tangentFrame >> NORMAL_BITS & normalMask) - NORMAL_MAX);
+
+		Vec3f basisX, basisY;
+		buildBasis(vertex.normal, basisX, basisY);
+		float angle = float(tangentFrame >> (2 * NORMAL_BITS) & (ANGLE_STEPS - 1)) * (TWO_PI / ANGLE_STEPS);
+		vertex.tangent = basisX * std::cos(angle) + basisY * std::sin(angle);
+
+		float handedness = tangentFrame >> (2 * NORMAL_BITS + ANGLE_BITS) ? -1.0f : 1.0f;
+		vertex.bitangent = vertex.normal.cross(vertex.tangent) * handedness;
+		return vertex;
+	}
+
+	uint16_t PackedVertex::floatToHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		uint16_t sign = uint16_t(bits >> 16 & 0x8000);
+		uint32_t absBits = bits & 0x7FFFFFFF;
+
+		if (absBits > 0x7F800000) // NaN
+		{
+			return sign | 0x7E00;
+		}
+		if (absBits >= 0x477FF000) // rounds to 65536 or more
+		{
+			return sign | 0x7C00;
+		}
+		if (absBits < 0x38800000) // below the smallest normal half, 2^-14
+		{
+			// scaling by a power of 2 is exact, rounding to 1024 gives the bits of the smallest normal half
+			return sign | uint16_t(std::nearbyint(std::abs(value) * 16777216.0f));
+		}
+
+		// round to nearest even and rebias the exponent from 127 to 15
+		uint32_t rounded = absBits + 0xFFF + (absBits >> 13 & 1);
+		return sign | uint16_t((rounded - (112 << 23)) >> 13);
+	}
+
+	float PackedVertex::halfToFloat(uint16_t value)
+	{
+		uint32_t sign = uint32_t(value & 0x8000) << 16;
+		uint32_t exponent = value >> 10 & 0x1F;
+		uint32_t mantissa = value & 0x3FF;
+
+		if (exponent == 0)
+		{
+			float result = float(mantissa) / 16777216.0f;
+			return sign ? -result : result;
+		}
+
+		uint32_t bits = exponent == 0x1F ? sign | 0x7F800000 | mantissa << 13 : sign | (exponent + 112) << 23 | mantissa << 13;
+		float result;
+		std::memcpy(&result, &bits, sizeof(result));
+		return result;
+	}
+}
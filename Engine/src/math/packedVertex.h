@@ -0,0 +1,33 @@
+#pragma once
+#include "vertex.h"
+#include <cstdint>
+
+namespace Engine::math
+{
+	// GPU vertex layout of 20 bytes instead of the 80 of Vertex. The position stays full precision, texture coordinates are half floats
+	// and the tangent frame is a single 32-bit value: 11+11 bits of the octahedral encoded normal, 9 bits of the tangent angle
+	// around the normal and 1 bit of handedness. Vertex colors aren't stored, unpacked vertices get COLOR.
+	struct PackedVertex
+	{
+		Vec3f position;
+		uint16_t textureCoordinates[2];
+		uint32_t tangentFrame;
+
+		// Upper bounds of the round trip error, for unit normals and tangents orthogonal to them.
+		// Texture coordinates are off by at most TEXTURE_COORDINATES_RELATIVE_ERROR * |uv| or 2^-25, whichever is larger.
+		const static float TEXTURE_COORDINATES_RELATIVE_ERROR;
+		const static float NORMAL_MAX_ERROR_DEGREES;
+		const static float TANGENT_MAX_ERROR_DEGREES;
+		const static Vec4f COLOR;
+
+		// The tangent is orthogonalized against the normal first, the bitangent only contributes its side (the handedness bit).
+		static PackedVertex pack(const Vertex& vertex);
+
+		// The unpacked bitangent is cross(normal, tangent) with the stored handedness.
+		Vertex unpack() const;
+
+		static uint16_t floatToHalf(float value);
+		static float halfToFloat(uint16_t value);
+	};
+	static_assert(sizeof(PackedVertex) == 20);
+}
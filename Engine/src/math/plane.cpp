@@ -23,4 +23,16 @@ namespace Engine::math
 
 		return false;
 	}
+
+	bool Plane::isOccluding(const Ray& ray, float tMax) const
+	{
+		float denominator = normal.dot(ray.direction);
+		if (std::abs(denominator) > std::numeric_limits<float>::epsilon())
+		{
+			float t = (point - ray.origin).dot(normal) / denominator;
+			return t >= 0.0f && t < tMax;
+		}
+
+		return false;
+	}
 }
\ No newline at end of file
@@ -17,5 +17,6 @@ namespace Engine::math
 		Vec3f normal;
 
 		bool isIntersecting(const Ray& ray, Intersection& outNearest) const;
+		bool isOccluding(const Ray& ray, float tMax) const;
 	};
 }
\ No newline at end of file
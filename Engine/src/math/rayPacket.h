@@ -0,0 +1,36 @@
+#pragma once
+#include "ray.h"
+#include "simd.h"
+
+namespace Engine::math
+{
+	// SIMD-width group of rays stored as structure of arrays, lane i holds the i-th ray
+	struct RayPacket
+	{
+		static constexpr uint32_t SIZE = simd::WIDTH;
+		static constexpr uint32_t FULL_MASK = simd::FULL_MASK;
+
+		float origin[3][SIZE];
+		float direction[3][SIZE];
+
+		void set(uint32_t lane, const Ray& ray)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				origin[axis][lane] = ray.origin[axis];
+				direction[axis][lane] = ray.direction[axis];
+			}
+		}
+
+		Ray get(uint32_t lane) const
+		{
+			Ray ray;
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				ray.origin[axis] = origin[axis][lane];
+				ray.direction[axis] = direction[axis][lane];
+			}
+			return ray;
+		}
+	};
+}
@@ -0,0 +1,200 @@
+#pragma once
+#include "mathUtils.h"
+#include <cstdint>
+#include <cstring>
+
+// AVX is used when the compiler is allowed to emit it (/arch:AVX, /arch:AVX2), SSE2 is the baseline on x64.
+// Everything else falls back to plain scalar loops with the same interface.
+#if defined(__AVX__)
+#include <immintrin.h>
+#define ENGINE_SIMD_AVX
+#elif defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ENGINE_SIMD_SSE
+#else
+#define ENGINE_SIMD_SCALAR
+#endif
+
+namespace Engine::math::simd
+{
+#if defined(ENGINE_SIMD_AVX)
+	constexpr uint32_t WIDTH = 8;
+
+	struct FloatN
+	{
+		__m256 v;
+	};
+
+	// every lane is either all ones or all zeros
+	struct MaskN
+	{
+		__m256 v;
+	};
+
+	inline FloatN set1(float value) { return { _mm256_set1_ps(value) }; }
+	inline FloatN load(const float* src) { return { _mm256_loadu_ps(src) }; }
+	inline FloatN loadBytes(const uint8_t* src) // WIDTH unsigned bytes converted to floats, widened with SSE2 as AVX has no 256-bit integer ops
+	{
+		__m128i bytes = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(src));
+		__m128i words = _mm_unpacklo_epi8(bytes, _mm_setzero_si128());
+		__m128 low = _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128()));
+		__m128 high = _mm_cvtepi32_ps(_mm_unpackhi_epi16(words, _mm_setzero_si128()));
+		return { _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1) };
+	}
+	inline void store(float* dst, const FloatN& a) { _mm256_storeu_ps(dst, a.v); }
+
+	inline FloatN operator+(const FloatN& a, const FloatN& b) { return { _mm256_add_ps(a.v, b.v) }; }
+	inline FloatN operator-(const FloatN& a, const FloatN& b) { return { _mm256_sub_ps(a.v, b.v) }; }
+	inline FloatN operator*(const FloatN& a, const FloatN& b) { return { _mm256_mul_ps(a.v, b.v) }; }
+	inline FloatN operator/(const FloatN& a, const FloatN& b) { return { _mm256_div_ps(a.v, b.v) }; }
+
+	inline FloatN min(const FloatN& a, const FloatN& b) { return { _mm256_min_ps(a.v, b.v) }; }
+	inline FloatN max(const FloatN& a, const FloatN& b) { return { _mm256_max_ps(a.v, b.v) }; }
+	inline FloatN abs(const FloatN& a) { return { _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v) }; }
+	inline FloatN sqrt(const FloatN& a) { return { _mm256_sqrt_ps(a.v) }; }
+
+	inline MaskN operator<(const FloatN& a, const FloatN& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ) }; }
+	inline MaskN operator<=(const FloatN& a, const FloatN& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_LE_OQ) }; }
+	inline MaskN operator>(const FloatN& a, const FloatN& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ) }; }
+	inline MaskN operator>=(const FloatN& a, const FloatN& b) { return { _mm256_cmp_ps(a.v, b.v, _CMP_GE_OQ) }; }
+
+	inline MaskN operator&(const MaskN& a, const MaskN& b) { return { _mm256_and_ps(a.v, b.v) }; }
+	inline MaskN operator|(const MaskN& a, const MaskN& b) { return { _mm256_or_ps(a.v, b.v) }; }
+
+	inline FloatN select(const MaskN& mask, const FloatN& a, const FloatN& b) { return { _mm256_blendv_ps(b.v, a.v, mask.v) }; }
+	inline uint32_t moveMask(const MaskN& mask) { return uint32_t(_mm256_movemask_ps(mask.v)); }
+
+#elif defined(ENGINE_SIMD_SSE)
+	constexpr uint32_t WIDTH = 4;
+
+	struct FloatN
+	{
+		__m128 v;
+	};
+
+	// every lane is either all ones or all zeros
+	struct MaskN
+	{
+		__m128 v;
+	};
+
+	inline FloatN set1(float value) { return { _mm_set1_ps(value) }; }
+	inline FloatN load(const float* src) { return { _mm_loadu_ps(src) }; }
+	inline FloatN loadBytes(const uint8_t* src) // WIDTH unsigned bytes converted to floats
+	{
+		int32_t packed;
+		memcpy(&packed, src, sizeof(packed));
+		__m128i words = _mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), _mm_setzero_si128());
+		return { _mm_cvtepi32_ps(_mm_unpacklo_epi16(words, _mm_setzero_si128())) };
+	}
+	inline void store(float* dst, const FloatN& a) { _mm_storeu_ps(dst, a.v); }
+
+	inline FloatN operator+(const FloatN& a, const FloatN& b) { return { _mm_add_ps(a.v, b.v) }; }
+	inline FloatN operator-(const FloatN& a, const FloatN& b) { return { _mm_sub_ps(a.v, b.v) }; }
+	inline FloatN operator*(const FloatN& a, const FloatN& b) { return { _mm_mul_ps(a.v, b.v) }; }
+	inline FloatN operator/(const FloatN& a, const FloatN& b) { return { _mm_div_ps(a.v, b.v) }; }
+
+	inline FloatN min(const FloatN& a, const FloatN& b) { return { _mm_min_ps(a.v, b.v) }; }
+	inline FloatN max(const FloatN& a, const FloatN& b) { return { _mm_max_ps(a.v, b.v) }; }
+	inline FloatN abs(const FloatN& a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+	inline FloatN sqrt(const FloatN& a) { return { _mm_sqrt_ps(a.v) }; }
+
+	inline MaskN operator<(const FloatN& a, const FloatN& b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+	inline MaskN operator<=(const FloatN& a, const FloatN& b) { return { _mm_cmple_ps(a.v, b.v) }; }
+	inline MaskN operator>(const FloatN& a, const FloatN& b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+	inline MaskN operator>=(const FloatN& a, const FloatN& b) { return { _mm_cmpge_ps(a.v, b.v) }; }
+
+	inline MaskN operator&(const MaskN& a, const MaskN& b) { return { _mm_and_ps(a.v, b.v) }; }
+	inline MaskN operator|(const MaskN& a, const MaskN& b) { return { _mm_or_ps(a.v, b.v) }; }
+
+	inline FloatN select(const MaskN& mask, const FloatN& a, const FloatN& b) { return { _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)) }; }
+	inline uint32_t moveMask(const MaskN& mask) { return uint32_t(_mm_movemask_ps(mask.v)); }
+
+#else
+	constexpr uint32_t WIDTH = 4;
+
+	struct FloatN
+	{
+		float v[WIDTH];
+	};
+
+	struct MaskN
+	{
+		bool v[WIDTH];
+	};
+
+	template<typename Result, typename Op>
+	inline Result perLane(Op op)
+	{
+		Result result;
+		for (uint32_t i = 0; i < WIDTH; ++i)
+		{
+			result.v[i] = op(i);
+		}
+		return result;
+	}
+
+	inline FloatN set1(float value) { return perLane<FloatN>([&](uint32_t) { return value; }); }
+	inline FloatN load(const float* src) { return perLane<FloatN>([&](uint32_t i) { return src[i]; }); }
+	inline FloatN loadBytes(const uint8_t* src) { return perLane<FloatN>([&](uint32_t i) { return float(src[i]); }); }
+	inline void store(float* dst, const FloatN& a) { for (uint32_t i = 0; i < WIDTH; ++i) dst[i] = a.v[i]; }
+
+	inline FloatN operator+(const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return a.v[i] + b.v[i]; }); }
+	inline FloatN operator-(const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return a.v[i] - b.v[i]; }); }
+	inline FloatN operator*(const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return a.v[i] * b.v[i]; }); }
+	inline FloatN operator/(const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return a.v[i] / b.v[i]; }); }
+
+	// operand order matches minps/maxps, so NaN handling is the same as in the SIMD versions
+	inline FloatN min(const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return a.v[i] < b.v[i] ? a.v[i] : b.v[i]; }); }
+	inline FloatN max(const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return a.v[i] > b.v[i] ? a.v[i] : b.v[i]; }); }
+	inline FloatN abs(const FloatN& a) { return perLane<FloatN>([&](uint32_t i) { return std::abs(a.v[i]); }); }
+	inline FloatN sqrt(const FloatN& a) { return perLane<FloatN>([&](uint32_t i) { return std::sqrt(a.v[i]); }); }
+
+	inline MaskN operator<(const FloatN& a, const FloatN& b) { return perLane<MaskN>([&](uint32_t i) { return a.v[i] < b.v[i]; }); }
+	inline MaskN operator<=(const FloatN& a, const FloatN& b) { return perLane<MaskN>([&](uint32_t i) { return a.v[i] <= b.v[i]; }); }
+	inline MaskN operator>(const FloatN& a, const FloatN& b) { return perLane<MaskN>([&](uint32_t i) { return a.v[i] > b.v[i]; }); }
+	inline MaskN operator>=(const FloatN& a, const FloatN& b) { return perLane<MaskN>([&](uint32_t i) { return a.v[i] >= b.v[i]; }); }
+
+	inline MaskN operator&(const MaskN& a, const MaskN& b) { return perLane<MaskN>([&](uint32_t i) { return a.v[i] && b.v[i]; }); }
+	inline MaskN operator|(const MaskN& a, const MaskN& b) { return perLane<MaskN>([&](uint32_t i) { return a.v[i] || b.v[i]; }); }
+
+	inline FloatN select(const MaskN& mask, const FloatN& a, const FloatN& b) { return perLane<FloatN>([&](uint32_t i) { return mask.v[i] ? a.v[i] : b.v[i]; }); }
+	inline uint32_t moveMask(const MaskN& mask)
+	{
+		uint32_t result = 0;
+		for (uint32_t i = 0; i < WIDTH; ++i)
+		{
+			result |= uint32_t(mask.v[i]) << i;
+		}
+		return result;
+	}
+#endif
+
+	constexpr uint32_t FULL_MASK = (1u << WIDTH) - 1;
+
+	struct Vec3N
+	{
+		FloatN x, y, z;
+	};
+
+	inline Vec3N set1(const Vec3f& value) { return { set1(value.x()), set1(value.y()), set1(value.z()) }; }
+
+	inline Vec3N operator+(const Vec3N& a, const Vec3N& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+	inline Vec3N operator-(const Vec3N& a, const Vec3N& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	inline Vec3N operator*(const Vec3N& a, const FloatN& b) { return { a.x * b, a.y * b, a.z * b }; }
+
+	inline FloatN dot(const Vec3N& a, const Vec3N& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	inline Vec3N cross(const Vec3N& a, const Vec3N& b)
+	{
+		return
+		{
+			a.y * b.z - a.z * b.y,
+			a.z * b.x - a.x * b.z,
+			a.x * b.y - a.y * b.x
+		};
+	}
+}
@@ -37,4 +37,28 @@ namespace Engine::math
 
         return true;
     }
+
+    bool Sphere::isOccluding(const Ray& ray, float tMax) const
+    {
+        math::Vec3f l = position - ray.origin;
+        float s = l.dot(ray.direction);
+        float l2 = l.dot(l);
+        float r2 = radius * radius;
+
+        if (s < 0 && l2 > r2)
+        {
+            return false;
+        }
+
+        float m2 = l2 - s * s;
+        if (m2 > r2)
+        {
+            return false;
+        }
+
+        float q = std::sqrtf(r2 - m2);
+        float t = l2 > r2 ? s - q : s + q;
+
+        return t < tMax;
+    }
 }
\ No newline at end of file
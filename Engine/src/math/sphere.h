@@ -1,5 +1,6 @@
 #pragma once
 #include "../dependencies/Eigen/Eigen/Dense"
+#include "box.h"
 #include "mathUtils.h"
 
 namespace Engine::math
@@ -12,6 +13,21 @@ namespace Engine::math
 		math::Vec3f position;
 		float radius;
 
+		Box getBounds() const
+		{
+			return { position - Vec3f(radius, radius, radius), position + Vec3f(radius, radius, radius) };
+		}
+
+		// The sphere enclosing the ellipsoid the sphere is transformed into by an affine (row-vector) matrix. The largest stretch
+		// is bounded by the largest row sum of |M * M^T| (Gershgorin), which is exact when the rows are orthogonal, e.g. for TRS matrices.
+		Sphere transformed(const Mat4f& matrix) const
+		{
+			const Mat3f linear = matrix.topLeftCorner<3, 3>();
+			float scale = std::sqrt((linear * linear.transpose()).cwiseAbs().rowwise().sum().maxCoeff());
+			return { (Vec4f(position.x(), position.y(), position.z(), 1.0f) * matrix).head<3>(), radius * scale };
+		}
+
 		bool isIntersecting(const Ray& ray, Intersection& outNearest) const;
+		bool isOccluding(const Ray& ray, float tMax) const;
 	};
 }
\ No newline at end of file
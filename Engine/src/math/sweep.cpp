@@ -0,0 +1,402 @@
+#include "sweep.h"
+#include "ray.h"
+#include "intersection.h"
+#include "triangle.h"
+#include <limits>
+#include <algorithm>
+
+namespace Engine::math
+{
+	struct SweepContact
+	{
+		float t;
+		Vec3f position;
+		Vec3f normal;
+		bool found;
+	};
+
+	inline void updateContact(SweepContact& contact, float t, const Vec3f& position, const Vec3f& normal)
+	{
+		if (t < contact.t)
+		{
+			contact.t = t;
+			contact.position = position;
+			contact.normal = normal;
+			contact.found = true;
+		}
+	}
+
+	inline Vec3f closestPointOnSegment(const Vec3f& point, const Vec3f& A, const Vec3f& B)
+	{
+		Vec3f segment = B - A;
+		float length2 = segment.squaredNorm();
+		if (length2 <= 0.0f)
+		{
+			return A;
+		}
+
+		float s = std::clamp((point - A).dot(segment) / length2, 0.0f, 1.0f);
+		return A + segment * s;
+	}
+
+	// source - Real-Time Collision Detection (Ericson), 5.1.9, returns the squared distance
+	inline float closestPointsSegmentSegment(const Vec3f& P1, const Vec3f& Q1, const Vec3f& P2, const Vec3f& Q2, Vec3f& outC1, Vec3f& outC2)
+	{
+		Vec3f d1 = Q1 - P1;
+		Vec3f d2 = Q2 - P2;
+		Vec3f r = P1 - P2;
+
+		float a = d1.squaredNorm();
+		float e = d2.squaredNorm();
+		float f = d2.dot(r);
+
+		float s, t;
+		if (a <= std::numeric_limits<float>::epsilon() && e <= std::numeric_limits<float>::epsilon())
+		{
+			s = t = 0.0f;
+		}
+		else if (a <= std::numeric_limits<float>::epsilon())
+		{
+			s = 0.0f;
+			t = std::clamp(f / e, 0.0f, 1.0f);
+		}
+		else
+		{
+			float c = d1.dot(r);
+			if (e <= std::numeric_limits<float>::epsilon())
+			{
+				t = 0.0f;
+				s = std::clamp(-c / a, 0.0f, 1.0f);
+			}
+			else
+			{
+				float b = d1.dot(d2);
+				float denominator = a * e - b * b;
+
+				s = denominator != 0.0f ? std::clamp((b * f - c * e) / denominator, 0.0f, 1.0f) : 0.0f;
+				t = (b * s + f) / e;
+
+				if (t < 0.0f)
+				{
+					t = 0.0f;
+					s = std::clamp(-c / a, 0.0f, 1.0f);
+				}
+				else if (t > 1.0f)
+				{
+					t = 1.0f;
+					s = std::clamp((b - c) / a, 0.0f, 1.0f);
+				}
+			}
+		}
+
+		outC1 = P1 + d1 * s;
+		outC2 = P2 + d2 * t;
+		return (outC1 - outC2).squaredNorm();
+	}
+
+	inline bool isInsideTriangle(const Vec3f& point, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, const Vec3f& normal)
+	{
+		return
+			normal.dot((V2 - V1).cross(point - V1)) >= 0.0f &&
+			normal.dot((V3 - V2).cross(point - V2)) >= 0.0f &&
+			normal.dot((V1 - V3).cross(point - V3)) >= 0.0f;
+	}
+
+	// squared distance between the segment P Q and the triangle, with the closest points on both of them
+	inline float closestPointsSegmentTriangle(const Vec3f& P, const Vec3f& Q, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, const Vec3f& normal, Vec3f& outOnSegment, Vec3f& outOnTriangle)
+	{
+		// the segment crossing the triangle
+		float distanceP = normal.dot(P - V1);
+		float distanceQ = normal.dot(Q - V1);
+		if (distanceP * distanceQ <= 0.0f && distanceP != distanceQ)
+		{
+			Vec3f crossing = P + (Q - P) * (distanceP / (distanceP - distanceQ));
+			if (isInsideTriangle(crossing, V1, V2, V3, normal))
+			{
+				outOnSegment = crossing;
+				outOnTriangle = crossing;
+				return 0.0f;
+			}
+		}
+
+		Vec3f barycentrics;
+		outOnSegment = P;
+		outOnTriangle = Triangle::closestPoint(P, V1, V2, V3, barycentrics);
+		float best = (outOnTriangle - P).squaredNorm();
+
+		auto update = [&best, &outOnSegment, &outOnTriangle](float distance, const Vec3f& onSegment, const Vec3f& onTriangle)
+		{
+			if (distance < best)
+			{
+				best = distance;
+				outOnSegment = onSegment;
+				outOnTriangle = onTriangle;
+			}
+		};
+
+		Vec3f onTriangle = Triangle::closestPoint(Q, V1, V2, V3, barycentrics);
+		update((onTriangle - Q).squaredNorm(), Q, onTriangle);
+
+		const Vec3f* vertices[3] = { &V1, &V2, &V3 };
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			Vec3f onSegment;
+			float distance = closestPointsSegmentSegment(P, Q, *vertices[edge], *vertices[(edge + 1) % 3], onSegment, onTriangle);
+			update(distance, onSegment, onTriangle);
+		}
+
+		return best;
+	}
+
+	// first t in [0, tMax) at which origin + direction * t enters the sphere, rays starting inside are ignored
+	inline bool intersectSphere(const Vec3f& origin, const Vec3f& direction, const Vec3f& center, float radius, float tMax, float& outT)
+	{
+		Vec3f toOrigin = origin - center;
+
+		float a = direction.squaredNorm();
+		float b = direction.dot(toOrigin);
+		float c = toOrigin.squaredNorm() - radius * radius;
+
+		if (c <= 0.0f || b >= 0.0f || a <= 0.0f)
+		{
+			return false;
+		}
+
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+
+		float t = (-b - std::sqrt(discriminant)) / a;
+		if (t < 0.0f || t >= tMax)
+		{
+			return false;
+		}
+
+		outT = t;
+		return true;
+	}
+
+	// first t in [0, tMax) at which origin + direction * t enters the side of the cylinder around the segment A B, caps are not tested
+	inline bool intersectCylinder(const Vec3f& origin, const Vec3f& direction, const Vec3f& A, const Vec3f& B, float radius, float tMax, float& outT)
+	{
+		Vec3f axis = B - A;
+		float axisLength2 = axis.squaredNorm();
+		if (axisLength2 <= 0.0f)
+		{
+			return false;
+		}
+
+		Vec3f toOrigin = origin - A;
+		Vec3f directionPerp = direction - axis * (direction.dot(axis) / axisLength2);
+		Vec3f originPerp = toOrigin - axis * (toOrigin.dot(axis) / axisLength2);
+
+		float a = directionPerp.squaredNorm();
+		float b = directionPerp.dot(originPerp);
+		float c = originPerp.squaredNorm() - radius * radius;
+
+		if (c <= 0.0f || b >= 0.0f || a <= 0.0f)
+		{
+			return false;
+		}
+
+		float discriminant = b * b - a * c;
+		if (discriminant < 0.0f)
+		{
+			return false;
+		}
+
+		float t = (-b - std::sqrt(discriminant)) / a;
+		if (t < 0.0f || t >= tMax)
+		{
+			return false;
+		}
+
+		float s = (toOrigin + direction * t).dot(axis) / axisLength2;
+		if (s < 0.0f || s > 1.0f)
+		{
+			return false;
+		}
+
+		outT = t;
+		return true;
+	}
+
+	// normal of an initial overlap, falls back to the face normal turned against the motion when the shape touches the surface
+	inline Vec3f getSeparationNormal(const Vec3f& onShape, const Vec3f& onTriangle, const Vec3f& faceNormal, const Vec3f& direction)
+	{
+		Vec3f separation = onShape - onTriangle;
+		float length = separation.norm();
+		if (length > std::numeric_limits<float>::epsilon())
+		{
+			return separation / length;
+		}
+
+		return faceNormal.dot(direction) > 0.0f ? Vec3f(-faceNormal) : faceNormal;
+	}
+
+	// sphere moving from center along direction, without the initial overlap test
+	inline void sweepSphereInternal(const Vec3f& center, const Vec3f& direction, float radius, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, const Vec3f& normal, SweepContact& contact)
+	{
+		// face
+		float distance = normal.dot(center - V1);
+		float speed = normal.dot(direction);
+		float side = distance >= 0.0f ? 1.0f : -1.0f;
+
+		if (std::abs(distance) > radius && side * speed < 0.0f)
+		{
+			float t = (side * radius - distance) / speed;
+			Vec3f position = center + direction * t - normal * (side * radius);
+
+			if (t < contact.t && isInsideTriangle(position, V1, V2, V3, normal))
+			{
+				updateContact(contact, t, position, normal * side);
+				return;
+			}
+		}
+
+		const Vec3f* vertices[3] = { &V1, &V2, &V3 };
+		for (int i = 0; i < 3; ++i)
+		{
+			float t;
+
+			const Vec3f& A = *vertices[i];
+			const Vec3f& B = *vertices[(i + 1) % 3];
+			if (intersectCylinder(center, direction, A, B, radius, contact.t, t))
+			{
+				Vec3f moved = center + direction * t;
+				Vec3f position = closestPointOnSegment(moved, A, B);
+				updateContact(contact, t, position, (moved - position).normalized());
+			}
+
+			if (intersectSphere(center, direction, A, radius, contact.t, t))
+			{
+				updateContact(contact, t, A, (center + direction * t - A).normalized());
+			}
+		}
+	}
+
+	inline bool commitContact(const SweepContact& contact, MeshIntersection& outNearest)
+	{
+		if (!contact.found)
+		{
+			return false;
+		}
+
+		outNearest.t = contact.t;
+		outNearest.position = contact.position;
+		outNearest.normal = contact.normal;
+		return true;
+	}
+
+	bool sweepSphere(const Ray& ray, float radius, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, MeshIntersection& outNearest)
+	{
+		Vec3f normal = (V2 - V1).cross(V3 - V1);
+		float normalLength = normal.norm();
+		normal = normalLength > 0.0f ? Vec3f(normal / normalLength) : Vec3f(0.0f, 0.0f, 0.0f);
+
+		SweepContact contact = { outNearest.t, {}, {}, false };
+
+		Vec3f barycentrics;
+		Vec3f closest = Triangle::closestPoint(ray.origin, V1, V2, V3, barycentrics);
+		if ((closest - ray.origin).squaredNorm() <= radius * radius)
+		{
+			if (0.0f < contact.t)
+			{
+				updateContact(contact, 0.0f, closest, getSeparationNormal(ray.origin, closest, normal, ray.direction));
+			}
+
+			return commitContact(contact, outNearest);
+		}
+
+		sweepSphereInternal(ray.origin, ray.direction, radius, V1, V2, V3, normal, contact);
+
+		return commitContact(contact, outNearest);
+	}
+
+	bool sweepCapsule(const Ray& ray, const Vec3f& halfSegment, float radius, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, MeshIntersection& outNearest)
+	{
+		Vec3f normal = (V2 - V1).cross(V3 - V1);
+		float normalLength = normal.norm();
+		normal = normalLength > 0.0f ? Vec3f(normal / normalLength) : Vec3f(0.0f, 0.0f, 0.0f);
+
+		const Vec3f P = ray.origin - halfSegment;
+		const Vec3f Q = ray.origin + halfSegment;
+
+		SweepContact contact = { outNearest.t, {}, {}, false };
+
+		Vec3f onSegment, onTriangle;
+		if (closestPointsSegmentTriangle(P, Q, V1, V2, V3, normal, onSegment, onTriangle) <= radius * radius)
+		{
+			if (0.0f < contact.t)
+			{
+				updateContact(contact, 0.0f, onTriangle, getSeparationNormal(onSegment, onTriangle, normal, ray.direction));
+			}
+
+			return commitContact(contact, outNearest);
+		}
+
+		// first contacts with the face and the contacts with the capsule ends
+		sweepSphereInternal(P, ray.direction, radius, V1, V2, V3, normal, contact);
+		sweepSphereInternal(Q, ray.direction, radius, V1, V2, V3, normal, contact);
+
+		const Vec3f axis = Q - P;
+		const Vec3f* vertices[3] = { &V1, &V2, &V3 };
+		for (int i = 0; i < 3; ++i)
+		{
+			const Vec3f& A = *vertices[i];
+			const Vec3f& B = *vertices[(i + 1) % 3];
+
+			// triangle vertex against the side of the capsule, found by moving the vertex the opposite way
+			float t;
+			if (intersectCylinder(A, -ray.direction, P, Q, radius, contact.t, t))
+			{
+				Vec3f onAxis = closestPointOnSegment(A, P + ray.direction * t, Q + ray.direction * t);
+				updateContact(contact, t, A, (onAxis - A).normalized());
+			}
+
+			// triangle edge against the side of the capsule, the distance between the two lines changes linearly with t
+			Vec3f edge = B - A;
+			Vec3f lineNormal = axis.cross(edge);
+			float lineNormalLength = lineNormal.norm();
+			if (lineNormalLength <= std::numeric_limits<float>::epsilon() * axis.norm() * edge.norm())
+			{
+				continue;
+			}
+			lineNormal /= lineNormalLength;
+
+			float distance = lineNormal.dot(P - A);
+			float speed = lineNormal.dot(ray.direction);
+			float side = distance >= 0.0f ? 1.0f : -1.0f;
+			if (std::abs(distance) <= radius || side * speed >= 0.0f)
+			{
+				continue;
+			}
+
+			t = (side * radius - distance) / speed;
+			if (t < 0.0f || t >= contact.t)
+			{
+				continue;
+			}
+
+			// the contact lies on the side only if the closest points of both lines are inside the segments
+			Vec3f r = P + ray.direction * t - A;
+			float a = axis.squaredNorm();
+			float b = axis.dot(edge);
+			float c = axis.dot(r);
+			float e = edge.squaredNorm();
+			float f = edge.dot(r);
+			float denominator = a * e - b * b;
+
+			float s = (b * f - c * e) / denominator;
+			float u = (b * s + f) / e;
+			if (s >= 0.0f && s <= 1.0f && u >= 0.0f && u <= 1.0f)
+			{
+				updateContact(contact, t, A + edge * u, lineNormal * side);
+			}
+		}
+
+		return commitContact(contact, outNearest);
+	}
+}
@@ -0,0 +1,18 @@
+#pragma once
+#include "mathUtils.h"
+
+namespace Engine::math
+{
+	struct Ray;
+	struct MeshIntersection;
+
+	// Volume casts against a single triangle. The shape moves along ray.direction, t has the same meaning as for rays,
+	// so outNearest.t bounds the search and is updated together with the contact position and normal on hit.
+	// The contact normal points from the triangle towards the shape. Shapes overlapping the triangle at t = 0 report t = 0.
+
+	// sphere centered at ray.origin
+	bool sweepSphere(const Ray& ray, float radius, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, MeshIntersection& outNearest);
+
+	// capsule with the segment from ray.origin - halfSegment to ray.origin + halfSegment
+	bool sweepCapsule(const Ray& ray, const Vec3f& halfSegment, float radius, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, MeshIntersection& outNearest);
+}
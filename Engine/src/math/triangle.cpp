@@ -31,9 +31,9 @@ namespace Engine::math
                 Vec3f C1 = P - v1.position;
                 Vec3f C2 = P - v2.position;
 
-                if (normal.dot(edge01.cross(C0)) > 0 &&
-                    normal.dot(edge12.cross(C1)) > 0 &&
-                    normal.dot(edge20.cross(C2)) > 0)
+                if (normal.dot(edge01.cross(C0)) >= 0 &&
+                    normal.dot(edge12.cross(C1)) >= 0 &&
+                    normal.dot(edge20.cross(C2)) >= 0)
                 {
                     outNearest.t = t;
                     outNearest.position = P;
@@ -65,4 +65,74 @@ namespace Engine::math
 
         return false;
     }
+    // source - Real-Time Collision Detection (Ericson), 5.1.5
+    Vec3f Triangle::closestPoint(const Vec3f& point, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, Vec3f& outBarycentrics)
+    {
+        Vec3f edge12 = V2 - V1;
+        Vec3f edge13 = V3 - V1;
+
+        // vertex region of V1
+        Vec3f toPoint1 = point - V1;
+        float d1 = edge12.dot(toPoint1);
+        float d2 = edge13.dot(toPoint1);
+        if (d1 <= 0.0f && d2 <= 0.0f)
+        {
+            outBarycentrics = { 1.0f, 0.0f, 0.0f };
+            return V1;
+        }
+
+        // vertex region of V2
+        Vec3f toPoint2 = point - V2;
+        float d3 = edge12.dot(toPoint2);
+        float d4 = edge13.dot(toPoint2);
+        if (d3 >= 0.0f && d4 <= d3)
+        {
+            outBarycentrics = { 0.0f, 1.0f, 0.0f };
+            return V2;
+        }
+
+        // edge region of V1 V2
+        float vc = d1 * d4 - d3 * d2;
+        if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f)
+        {
+            float v = d1 / (d1 - d3);
+            outBarycentrics = { 1.0f - v, v, 0.0f };
+            return V1 + edge12 * v;
+        }
+
+        // vertex region of V3
+        Vec3f toPoint3 = point - V3;
+        float d5 = edge12.dot(toPoint3);
+        float d6 = edge13.dot(toPoint3);
+        if (d6 >= 0.0f && d5 <= d6)
+        {
+            outBarycentrics = { 0.0f, 0.0f, 1.0f };
+            return V3;
+        }
+
+        // edge region of V1 V3
+        float vb = d5 * d2 - d1 * d6;
+        if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f)
+        {
+            float w = d2 / (d2 - d6);
+            outBarycentrics = { 1.0f - w, 0.0f, w };
+            return V1 + edge13 * w;
+        }
+
+        // edge region of V2 V3
+        float va = d3 * d6 - d5 * d4;
+        if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f)
+        {
+            float w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+            outBarycentrics = { 0.0f, 1.0f - w, w };
+            return V2 + (V3 - V2) * w;
+        }
+
+        // face region
+        float denominator = 1.0f / (va + vb + vc);
+        float v = vb * denominator;
+        float w = vc * denominator;
+        outBarycentrics = { 1.0f - v - w, v, w };
+        return V1 + edge12 * v + edge13 * w;
+    }
 }
\ No newline at end of file
@@ -43,5 +43,8 @@ namespace Engine::math
 
 		bool isIntersecting(const Ray& ray, Intersection& outNearest) const;
 		bool isIntersecting(const Ray& ray, MeshIntersection& outNearest) const;
+
+		// closest point of the triangle (V1, V2, V3) to point, outBarycentrics are the weights of V1, V2 and V3
+		static Vec3f closestPoint(const Vec3f& point, const Vec3f& V1, const Vec3f& V2, const Vec3f& V3, Vec3f& outBarycentrics);
 	};
 }
\ No newline at end of file
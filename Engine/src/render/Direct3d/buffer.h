@@ -87,6 +87,37 @@ namespace Engine
 			ALWAYS_ASSERT(result >= 0);
 		}
 
+		// D3D11_USAGE_DEFAULT buffer without initial data, filled by update and copyFrom, e.g. vertex and index buffers shared by many models
+		void createDefaultBuffer(int elementsCount, UINT bindFlags, ID3D11Device5* device)
+		{
+			DEV_ASSERT(elementsCount > 0);
+			capacity = elementsCount * sizeof(T);
+
+			D3D11_BUFFER_DESC desc = {};
+			desc.ByteWidth = capacity;
+			desc.Usage = D3D11_USAGE_DEFAULT;
+			desc.BindFlags = bindFlags;
+
+			HRESULT result = device->CreateBuffer(&desc, nullptr, buffer.reset());
+			ALWAYS_ASSERT(result >= 0);
+		}
+
+		// writes elementsCount elements starting at element first, for D3D11_USAGE_DEFAULT buffers
+		void update(ID3D11DeviceContext4* devcon, int first, int elementsCount, const T* data)
+		{
+			DEV_ASSERT(data && (first + elementsCount) * sizeof(T) <= size_t(capacity));
+			D3D11_BOX box = { UINT(first * sizeof(T)), 0, 0, UINT((first + elementsCount) * sizeof(T)), 1, 1 };
+			devcon->UpdateSubresource(buffer, 0, &box, data, 0, 0);
+		}
+
+		// copies elementsCount elements of another buffer on the GPU, the buffers must differ
+		void copyFrom(ID3D11DeviceContext4* devcon, const Buffer& source, int sourceFirst, int first, int elementsCount)
+		{
+			DEV_ASSERT(source.buffer.ptr() != buffer.ptr());
+			D3D11_BOX box = { UINT(sourceFirst * sizeof(T)), 0, 0, UINT((sourceFirst + elementsCount) * sizeof(T)), 1, 1 };
+			devcon->CopySubresourceRegion(buffer, 0, UINT(first * sizeof(T)), 0, 0, source.buffer, 0, &box);
+		}
+
 		void createConstantBuffer(ID3D11Device5* device)
 		{
 			capacity = sizeof(T);
@@ -217,11 +248,12 @@ namespace Engine
 			devcon->PSSetShaderResources(slot, 1, &srv);
 		}
 
-		void setVertexBufferForInputAssembler(ID3D11DeviceContext4* devcon, int slot = 0) const
+		// firstVertex lets draws address a part of the buffer from vertex 0
+		void setVertexBufferForInputAssembler(ID3D11DeviceContext4* devcon, int slot = 0, int firstVertex = 0) const
 		{
 			ID3D11Buffer* bufferPtr = buffer.ptr();
 			UINT vertexStride = sizeof(T);
-			UINT vertexOffset = 0;
+			UINT vertexOffset = firstVertex * sizeof(T);
 
 			devcon->IASetVertexBuffers(slot, 1, &bufferPtr, &vertexStride, &vertexOffset);
 		}
@@ -235,9 +267,9 @@ namespace Engine
 			devcon->IASetVertexBuffers(slot, 1, &bufferPtr, &vertexStride, &vertexOffset);
 		}
 
-		void setIndexBufferForInputAssembler(ID3D11DeviceContext4* devcon) const
+		void setIndexBufferForInputAssembler(ID3D11DeviceContext4* devcon, int firstIndex = 0) const
 		{
-			devcon->IASetIndexBuffer(buffer, DXGI_FORMAT_R32_UINT, 0);
+			devcon->IASetIndexBuffer(buffer, DXGI_FORMAT_R32_UINT, firstIndex * sizeof(unsigned int));
 		}
 
 		D3D11_MAPPED_SUBRESOURCE& map(ID3D11DeviceContext4* devcon)
@@ -36,22 +36,16 @@ namespace Engine
 	}
 	void HologramInstances::initShader()
 	{
-		std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc =
+		std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc = Model::getVertexInputElements();
+		inputElementDesc.insert(inputElementDesc.end(),
 		{
-			{"POS",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"COL",		0, DXGI_FORMAT_R32G32B32A32_FLOAT,	0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"TEX",		0, DXGI_FORMAT_R32G32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"NORM",	0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"TANG",	0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"BTANG",	0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-
 			{"INS", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INSCOL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS_NUMBER", 0, DXGI_FORMAT_R32_UINT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1}
-		};
+		});
 
 		shader.init(L"Shaders/hologram/hologramVS.hlsl", L"Shaders/hologram/hologramHS.hlsl", L"Shaders/hologram/hologramDS.hlsl", L"Shaders/hologram/hologramGS.hlsl", L"Shaders/hologram/hologramPS.hlsl", inputElementDesc);
 		shader.setTopology(D3D11_PRIMITIVE_TOPOLOGY_3_CONTROL_POINT_PATCHLIST);
@@ -160,6 +154,11 @@ namespace Engine
 			}
 		}
 
+		if (objectFound)
+		{
+			++m_instancesRevision;
+		}
+
 		return objectFound;
 	}
 	void HologramInstances::bindDepth2DShader()
@@ -170,6 +169,11 @@ namespace Engine
 	{
 		depthCubemapShader.bind();
 	}
+	bool HologramInstances::isDepthPositionOnly() const
+	{
+		// the hologram displaces vertices along their normals
+		return false;
+	}
 	void HologramInstances::bindMaterialData(const PerMaterial & perMaterial)
 	{}
 	
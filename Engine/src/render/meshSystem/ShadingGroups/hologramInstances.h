@@ -35,6 +35,7 @@ namespace Engine
 
 		void bindDepth2DShader() override;
 		void bindDepthCubemapShader() override;
+		bool isDepthPositionOnly() const override;
 	private:
 		struct InstanceInternal
 		{
@@ -94,6 +94,11 @@ namespace Engine
 			}
 		}
 
+		if (objectFound)
+		{
+			++m_instancesRevision;
+		}
+
 		return objectFound;
 	}
 
@@ -105,6 +110,11 @@ namespace Engine
 	{
 		depthCubemapShader.bind();
 	}
+	bool IncinerationInstances::isDepthPositionOnly() const
+	{
+		// the depth shaders pass texture coordinates on to the pixel shader
+		return false;
+	}
 	void IncinerationInstances::updateInstanceBufferData(const PerMesh& perMesh, void* instanceBufferData, int& copiedNum, const Mesh& mesh, const Camera& camera)
 	{
 		auto* transformSystem = TransformSystem::getInstance();
@@ -141,15 +151,9 @@ namespace Engine
 	}
 	void IncinerationInstances::initShader()
 	{
-		std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc =
+		std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc = Model::getVertexInputElements();
+		inputElementDesc.insert(inputElementDesc.end(),
 		{
-			{"POS",			0, DXGI_FORMAT_R32G32B32_FLOAT,		0, 0,								D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"COL",			0, DXGI_FORMAT_R32G32B32A32_FLOAT,	0, 16,								D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"TEX",			0, DXGI_FORMAT_R32G32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"NORM",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"TANG",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
-			{"BTANG",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
-
 			{"INS",			0, DXGI_FORMAT_R32G32B32A32_FLOAT,	1, 0,								D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS",			1, DXGI_FORMAT_R32G32B32A32_FLOAT,	1, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS",			2, DXGI_FORMAT_R32G32B32A32_FLOAT,	1, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_INSTANCE_DATA, 1},
@@ -159,7 +163,7 @@ namespace Engine
 			{"INS_SPHP",	0, DXGI_FORMAT_R32_FLOAT,			1, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS_SPHR",	0, DXGI_FORMAT_R32_FLOAT,			1, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_INSTANCE_DATA, 1},
 			{"INS_NUMBER",	0, DXGI_FORMAT_R32_UINT,			1, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_INSTANCE_DATA, 1}
-		};
+		});
 
 		//shader.init(L"Shaders/dissolution/dissolutionVS.hlsl", L"Shaders/dissolution/dissolutionPS.hlsl", inputElementDesc);
 		//lineNormalVisualization.init(L"Shaders/lineNormalVisualization/lineNormalVisualizationVS.hlsl", L"", L"", L"Shaders/lineNormalVisualization/lineNormalVisualizationGS.hlsl", L"Shaders/lineNormalVisualization/lineNormalVisualizationPS.hlsl", inputElementDesc);
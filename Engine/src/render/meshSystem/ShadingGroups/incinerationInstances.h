@@ -53,6 +53,7 @@ namespace Engine
 
 		void bindDepth2DShader() override;
 		void bindDepthCubemapShader() override;
+		bool isDepthPositionOnly() const override;
 
 		void createAndBindGBufferNormalCopy();
 	private:
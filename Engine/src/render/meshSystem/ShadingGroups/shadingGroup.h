@@ -2,6 +2,9 @@
 #include "../../../math/mathUtils.h"
 #include <vector>
 #include "../mesh/model.h"
+#include "../mesh/geometryPool.h"
+#include "../mesh/lodSelection.h"
+#include "../mesh/meshletCulling.h"
 #include "../../../utils/assert.h"
 #include "../../shader/shader.h"
 #include <chrono>
@@ -40,20 +43,15 @@ namespace Engine
 	public:
 		ShadingGroup()
 		{
-			std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc =
+			// the default depth shaders only read positions, see isDepthPositionOnly
+			std::vector<D3D11_INPUT_ELEMENT_DESC> inputElementDesc = Model::getPositionInputElements();
+			inputElementDesc.insert(inputElementDesc.end(),
 			{
-				{"POS",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
-				{"COL",		0, DXGI_FORMAT_R32G32B32A32_FLOAT,	0, 16, D3D11_INPUT_PER_VERTEX_DATA, 0},
-				{"TEX",		0, DXGI_FORMAT_R32G32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-				{"NORM",	0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-				{"TANG",	0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-				{"BTANG",	0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-
 				{"INS", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 				{"INS", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 				{"INS", 2, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1},
 				{"INS", 3, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_INSTANCE_DATA, 1}
-			};
+			});
 
 			depth2DShader.init(L"Shaders/depth/depth2DVS.hlsl", L"", inputElementDesc);
 			depthCubemapShader.init(L"Shaders/depth/depthCubemapVS.hlsl", L"", L"", L"Shaders/depth/depthCubemapGS.hlsl", L"", inputElementDesc);
@@ -61,8 +59,16 @@ namespace Engine
 			depthCubemapCBuffer.createConstantBuffer(D3D::getInstancePtr()->getDevice());
 		}
 
+		// Instances of a model that is still loading (see ModelManager::getModelAsync) are kept aside, since its meshes aren't known yet,
+		// and added by addReadyInstances once it's ready. Until then they aren't drawn and can't be found by ID, the returned PerModel is empty.
 		virtual PerModel add(std::shared_ptr<Model> model, std::shared_ptr<Material> material, Instance instance)
 		{
+			if (!model->isReady())
+			{
+				m_pendingInstances.push_back({ model, material, instance });
+				return { model, {} };
+			}
+
 			PerModel addedInstances;
 			addedInstances.model = model;
 
@@ -97,6 +103,8 @@ namespace Engine
 				}
 			}
 
+			++m_instancesRevision;
+
 			if (added)
 			{
 				return addedInstances;
@@ -161,6 +169,24 @@ namespace Engine
 			{
 				perModel.push_back(objectToAdd);
 			}
+
+			++m_instancesRevision;
+		}
+		void addReadyInstances()
+		{
+			for (size_t i = 0; i < m_pendingInstances.size();)
+			{
+				if (m_pendingInstances[i].model->isReady())
+				{
+					PendingInstance pending = std::move(m_pendingInstances[i]);
+					m_pendingInstances.erase(m_pendingInstances.begin() + i);
+					add(pending.model, pending.material, pending.instance);
+				}
+				else
+				{
+					++i;
+				}
+			}
 		}
 		void updateInstanceBuffers(const Camera& camera)
 		{
@@ -176,6 +202,8 @@ namespace Engine
 				}
 			}
 
+			m_lodInstanceCounts.clear();
+			m_meshletRanges.clear();
 			if (totalInstances == 0)
 			{
 				return;
@@ -193,7 +221,32 @@ namespace Engine
 				for (int meshIndex = 0; meshIndex < perModel.perMesh.size(); meshIndex++)
 				{
 					const Mesh& mesh = perModel.model->m_meshes[meshIndex];
-					updateInstanceBufferData(perModel.perMesh[meshIndex], instanceBufferData, copiedNum, mesh, camera);
+					const PerMesh& perMesh = perModel.perMesh[meshIndex];
+					std::span<const float> lodErrors = perModel.model->getLodErrors(meshIndex);
+					if (lodErrors.empty())
+					{
+						for (const auto& perMaterial : perMesh.perMaterial)
+						{
+							m_lodInstanceCounts.push_back({ uint32_t(perMaterial.instances.size()), { uint32_t(perMaterial.instances.size()) }, { uint32_t(perMaterial.instances.size()) } });
+						}
+						updateInstanceBufferData(perMesh, instanceBufferData, copiedNum, mesh, camera);
+					}
+					else
+					{
+						m_sortedPerMesh.perMaterial.resize(perMesh.perMaterial.size());
+						for (size_t materialIndex = 0; materialIndex < perMesh.perMaterial.size(); materialIndex++)
+						{
+							sortInstancesByLod(perMesh.perMaterial[materialIndex], mesh, lodErrors, camera, m_sortedPerMesh.perMaterial[materialIndex]);
+						}
+						updateInstanceBufferData(m_sortedPerMesh, instanceBufferData, copiedNum, mesh, camera);
+					}
+
+					// the counts of the mesh were appended above
+					const size_t firstCountsIndex = m_lodInstanceCounts.size() - perMesh.perMaterial.size();
+					for (size_t materialIndex = 0; materialIndex < perMesh.perMaterial.size(); materialIndex++)
+					{
+						cullMeshlets(perMesh.perMaterial[materialIndex], mesh, camera, firstCountsIndex + materialIndex);
+					}
 				}
 			}
 			
@@ -216,12 +269,22 @@ namespace Engine
 		{
 			depthCubemapShader.bind();
 		}
+		// Depth passes draw the position stream of models (Model::hasPositionBuffers) when their shaders read nothing but positions.
+		// Groups whose depth shaders need other attributes, e.g. for alpha testing, return false and get the full vertex buffers.
+		virtual bool isDepthPositionOnly() const
+		{
+			return true;
+		}
 		void renderDepth2D()
 		{
 			auto* devcon = D3D::getInstancePtr()->getDeviceContext();
 
+			// all models share the buffers of GeometryPool, they are only rebound to switch between the streams
 			setInstanceBufferForIA(devcon);
+			GeometryPool::getInstancePtr()->setBuffersForIA(devcon);
+			bool isPositionStreamBound = false;
 			int renderedInstances = 0;
+			size_t drawIndex = 0;
 			for (const auto& perModel : perModel)
 			{
 				if (!perModel.model)
@@ -230,16 +293,27 @@ namespace Engine
 						continue;
 				}
 
-				perModel.model->m_vertices.setVertexBufferForInputAssembler(devcon);
-				perModel.model->m_indices.setIndexBufferForInputAssembler(devcon);
+				const bool isPositionOnly = isDepthPositionOnly() && perModel.model->hasPositionBuffers();
+				if (isPositionOnly != isPositionStreamBound)
+				{
+					if (isPositionOnly)
+					{
+						GeometryPool::getInstancePtr()->setPositionBuffersForIA(devcon);
+					}
+					else
+					{
+						GeometryPool::getInstancePtr()->setBuffersForIA(devcon);
+					}
+					isPositionStreamBound = isPositionOnly;
+				}
 
 				for (int meshIndex = 0; meshIndex < perModel.perMesh.size(); meshIndex++)
 				{
 					const Mesh& mesh = perModel.model->m_meshes[meshIndex];
-					const auto& meshRange = perModel.model->m_ranges[meshIndex];
 
 					for (const auto& perMaterial : perModel.perMesh[meshIndex].perMaterial)
 					{
+						const size_t lodCountsIndex = drawIndex++;
 						if (perMaterial.instances.empty())
 						{
 							continue;
@@ -248,13 +322,14 @@ namespace Engine
 						bindMaterialData(perMaterial);
 
 						unsigned int numInstances = static_cast<unsigned int>(perMaterial.instances.size());
-						if (perModel.model->m_indices.isEmpty())
+						if (!perModel.model->hasIndices())
 						{
+							const Model::MeshRange meshRange = perModel.model->getDrawRange(meshIndex, 0, false);
 							D3D::getInstancePtr()->getDeviceContext()->DrawInstanced(meshRange.vertexNum, numInstances, meshRange.vertexOffset, renderedInstances);
 						}
 						else
 						{
-							D3D::getInstancePtr()->getDeviceContext()->DrawIndexedInstanced(meshRange.indexNum, numInstances, meshRange.indexOffset, meshRange.vertexOffset, renderedInstances);
+							drawLods(*perModel.model, meshIndex, lodCountsIndex, true, isPositionOnly, numInstances, renderedInstances);
 						}
 						renderedInstances += numInstances;
 					}
@@ -266,8 +341,12 @@ namespace Engine
 		{
 			auto* devcon = D3D::getInstancePtr()->getDeviceContext();
 
+			// all models share the buffers of GeometryPool, they are only rebound to switch between the streams
 			setInstanceBufferForIA(devcon);
+			GeometryPool::getInstancePtr()->setBuffersForIA(devcon);
+			bool isPositionStreamBound = false;
 			int renderedInstances = 0;
+			size_t drawIndex = 0;
 			for (const auto& perModel : perModel)
 			{
 				if (!perModel.model)
@@ -276,24 +355,36 @@ namespace Engine
 						continue;
 				}
 
-				perModel.model->m_vertices.setVertexBufferForInputAssembler(devcon);
-				perModel.model->m_indices.setIndexBufferForInputAssembler(devcon);
+				const bool isPositionOnly = isDepthPositionOnly() && perModel.model->hasPositionBuffers();
+				if (isPositionOnly != isPositionStreamBound)
+				{
+					if (isPositionOnly)
+					{
+						GeometryPool::getInstancePtr()->setPositionBuffersForIA(devcon);
+					}
+					else
+					{
+						GeometryPool::getInstancePtr()->setBuffersForIA(devcon);
+					}
+					isPositionStreamBound = isPositionOnly;
+				}
 
 				for (int meshIndex = 0; meshIndex < perModel.perMesh.size(); meshIndex++)
 				{
 					const Mesh& mesh = perModel.model->m_meshes[meshIndex];
-					const auto& meshRange = perModel.model->m_ranges[meshIndex];
 
 					for (const auto& perMaterial : perModel.perMesh[meshIndex].perMaterial)
 					{
+						const size_t lodCountsIndex = drawIndex++;
 						if (perMaterial.instances.empty())
 						{
 							continue;
 						}
 						bindMaterialData(perMaterial);
 						unsigned int numInstances = static_cast<unsigned int>(perMaterial.instances.size());
-						if (perModel.model->m_indices.isEmpty())
+						if (!perModel.model->hasIndices())
 						{
+							const Model::MeshRange meshRange = perModel.model->getDrawRange(meshIndex, 0, false);
 							D3D::getInstancePtr()->getDeviceContext()->DrawInstanced(meshRange.vertexNum, numInstances, meshRange.vertexOffset, renderedInstances);
 						}
 						else
@@ -314,7 +405,7 @@ namespace Engine
 								LightSystem::getInstancePtr()->setPerFrameBufferForGS(devcon);
 								LightSystem::getInstancePtr()->setPerFrameBufferForPS(devcon);
 
-								D3D::getInstancePtr()->getDeviceContext()->DrawIndexedInstanced(meshRange.indexNum, numInstances, meshRange.indexOffset, meshRange.vertexOffset, renderedInstances);
+								drawLods(*perModel.model, meshIndex, lodCountsIndex, true, isPositionOnly, numInstances, renderedInstances);
 							}
 						}
 						renderedInstances += numInstances;
@@ -337,9 +428,16 @@ namespace Engine
 		{
 			return perModel;
 		}
+		// incremented whenever instances are added or removed, lets MeshSystem know its instance BVH is stale
+		uint32_t getInstancesRevision() const
+		{
+			return m_instancesRevision;
+		}
 		void clear()
 		{
 			perModel.clear();
+			m_pendingInstances.clear();
+			++m_instancesRevision;
 			//instanceBuffer.reset();
 			//emissionBuffer.reset();
 			shader.reset();
@@ -349,74 +447,126 @@ namespace Engine
 			m_isNormalVisualizationOn = state;
 		}
 
-		void findIntersection(const math::Ray& ray, math::Intersection& outIntersection, TransformSystem::ID& outMatrixID, unsigned int& objectID)
+		virtual unsigned int getObjectID(int modelIndex, int meshIndex, int materialIndex, int instanceIndex) const = 0;
+		virtual bool getObjectByID(unsigned int objectID, PerModel*& outObjectModel, PerMesh*& outObjectMesh, PerMaterial*& outObjectMaterial, Instance*& outObjectInstance) = 0;
+		virtual bool getObjectTransformID(unsigned int objectID, TransformSystem::ID& outID) = 0;
+		virtual bool removeObjectByID(unsigned int objectID, PerModel& removedObject) = 0;
+	protected:
+		virtual void createInstanceBuffer(int totalInstances) = 0;
+		virtual void setInstanceBufferForIA(ID3D11DeviceContext4* devcon) = 0;
+		virtual void* getInstanceBufferMappedData() = 0;
+		virtual void unmapInstanceBuffer() = 0;
+		virtual void updateInstanceBufferData(const PerMesh& perMesh, void* instanceBufferData, int& copiedNum, const Mesh& mesh, const Camera& camera) = 0;
+		virtual void initShader() = 0;
+		virtual void bindMaterialData(const PerMaterial & perMaterial) = 0;
+
+		// Copies the instances to sorted from the largest to the smallest on screen and counts how many of them use every LOD.
+		// LOD selection never picks a finer LOD for a smaller instance, so every LOD draws a contiguous run of the sorted instances.
+		// Shadow passes draw runs of the same instance buffer, so their LODs come from the main camera sizes as well (see LodSelection::SHADOW_BIAS).
+		// Sizes per shadow view would need an instance order and buffer per shadow map and cubemap face.
+		void sortInstancesByLod(const PerMaterial& perMaterial, const Mesh& mesh, std::span<const float> lodErrors, const Camera& camera, PerMaterial& sorted)
 		{
 			auto* transformSystem = TransformSystem::getInstance();
-			math::Ray rayInModelSpace;
+			const auto& instances = perMaterial.instances;
 
-			for (int modelIndex = 0; modelIndex < perModel.size(); modelIndex++)
+			math::Mat4f meshToModel = math::Mat4f::Identity();
+			for (auto& m : mesh.instances)
 			{
-				auto& perModel = this->perModel[modelIndex];
+				meshToModel *= m;
+			}
+			const math::Vec3f center = mesh.boundingBox.center();
+			const float radius = mesh.boundingBox.radius();
+			const float projectionScale = camera.getProj()(1, 1);
 
-				if (!perModel.model)
-				{
-					continue;
-				}
+			m_projectedSizes.resize(instances.size());
+			m_sortedIndices.resize(instances.size());
+			for (size_t index = 0; index < instances.size(); index++)
+			{
+				math::Mat4f meshToWorld = meshToModel * transformSystem->getMatrix(instances[index].modelToWorldID);
+				math::Vec3f worldCenter = (math::Vec4f(center.x(), center.y(), center.z(), 1.0f) * meshToWorld).head<3>();
+				float scale = std::max({ meshToWorld.row(0).head<3>().norm(), meshToWorld.row(1).head<3>().norm(), meshToWorld.row(2).head<3>().norm() });
 
-				for (int meshIndex = 0; meshIndex < perModel.perMesh.size(); meshIndex++)
-				{
-					auto& perMesh = perModel.perMesh[meshIndex];
-					for (int materialIndex = 0; materialIndex < perMesh.perMaterial.size(); materialIndex++)
-					{
-						auto& perMaterial = perMesh.perMaterial[materialIndex];
-						for (int instanceIndex = 0; instanceIndex < perMaterial.instances.size(); instanceIndex++)
-						{
-							auto& instance = perMaterial.instances[instanceIndex];
+				m_projectedSizes[index] = LodSelection::getProjectedSize(worldCenter, radius * scale, camera.position(), projectionScale);
+				m_sortedIndices[index] = uint32_t(index);
+			}
+			std::stable_sort(m_sortedIndices.begin(), m_sortedIndices.end(), [this](uint32_t a, uint32_t b)
+			{
+				return m_projectedSizes[a] > m_projectedSizes[b];
+			});
 
-							auto& mesh = perModel.model->getMeshes()[meshIndex];
+			sorted.material = perMaterial.material;
+			sorted.instances.resize(instances.size());
+			LodInstanceCounts counts = { uint32_t(instances.size()) };
+			for (size_t index = 0; index < instances.size(); index++)
+			{
+				uint32_t instanceIndex = m_sortedIndices[index];
+				sorted.instances[index] = instances[instanceIndex];
+				++counts.main[LodSelection::selectLod(m_projectedSizes[instanceIndex], lodErrors, 0)];
+				++counts.shadow[LodSelection::selectLod(m_projectedSizes[instanceIndex], lodErrors, LodSelection::SHADOW_BIAS)];
+			}
+			m_lodInstanceCounts.push_back(counts);
+		}
 
-							math::Mat4f modelToWorld = transformSystem->getMatrix(instance.modelToWorldID);
-							math::Mat4f meshToModel = mesh.instances[0];
+		// A single instance drawing LOD 0 only draws the meshlets visible from camera in the main passes. Instanced draws of more
+		// instances share one index range and shadow passes draw from other views, they draw the whole range.
+		void cullMeshlets(const PerMaterial& perMaterial, const Mesh& mesh, const Camera& camera, size_t lodCountsIndex)
+		{
+			auto& counts = m_lodInstanceCounts[lodCountsIndex];
+			if (perMaterial.instances.size() != 1 || counts.main[0] != 1 || mesh.meshlets.empty())
+			{
+				return;
+			}
 
-							math::Mat4f transform = meshToModel * modelToWorld;
-							math::Mat4f transformInv = transform.inverse();
+			math::Mat4f meshToWorld = math::Mat4f::Identity();
+			for (auto& m : mesh.instances)
+			{
+				meshToWorld *= m;
+			}
+			meshToWorld *= TransformSystem::getInstance()->getMatrix(perMaterial.instances.front().modelToWorldID);
 
-							rayInModelSpace.origin = (math::Vec4f(ray.origin.x(), ray.origin.y(), ray.origin.z(), 1.0f) * transformInv).head<3>();
-							rayInModelSpace.direction = (math::Vec4f(ray.direction.x(), ray.direction.y(), ray.direction.z(), 0.0f) * transformInv).head<3>();
+			counts.isMeshletCulled = true;
+			counts.firstMeshletRange = uint32_t(m_meshletRanges.size());
+			MeshletCulling::cull(mesh, meshToWorld, camera.getViewProj(), camera.position(), m_meshletRanges);
+			counts.meshletRangeCount = uint32_t(m_meshletRanges.size()) - counts.firstMeshletRange;
+		}
 
-							math::MeshIntersection intersection;
-							intersection.reset(0.0f);
-							intersection.t = outIntersection.t;
+		// Draws the instances of the lodCountsIndex-th PerMaterial split into runs per LOD. Falls back to the full resolution mesh
+		// if instances changed since updateInstanceBuffers. Uses the buffers of GeometryPool, isPositionOnly picks its position stream.
+		void drawLods(const Model& model, int meshIndex, size_t lodCountsIndex, bool isShadowPass, bool isPositionOnly, unsigned int numInstances, int renderedInstances)
+		{
+			auto* devcon = D3D::getInstancePtr()->getDeviceContext();
 
-							if (mesh.octree.intersect(rayInModelSpace, intersection))
-							{
-								outIntersection.position = (math::Vec4f(intersection.position.x(), intersection.position.y(), intersection.position.z(), 1.0f) * transform).head<3>();
-								outIntersection.normal = (math::Vec4f(intersection.normal.x(), intersection.normal.y(), intersection.normal.z(), 0.0f) * transform).head<3>();
-								outIntersection.t = (outIntersection.position - ray.origin).norm();
+			if (lodCountsIndex >= m_lodInstanceCounts.size() || m_lodInstanceCounts[lodCountsIndex].total != numInstances)
+			{
+				const Model::MeshRange meshRange = model.getDrawRange(meshIndex, 0, isPositionOnly);
+				devcon->DrawIndexedInstanced(meshRange.indexNum, numInstances, meshRange.indexOffset, meshRange.vertexOffset, renderedInstances);
+				return;
+			}
 
-								outMatrixID = instance.modelToWorldID;
+			const LodInstanceCounts& counts = m_lodInstanceCounts[lodCountsIndex];
+			if (counts.isMeshletCulled && !isShadowPass)
+			{
+				const Model::MeshRange meshRange = model.getDrawRange(meshIndex, 0, isPositionOnly);
+				for (uint32_t i = 0; i < counts.meshletRangeCount; i++)
+				{
+					const MeshletCulling::IndexRange& range = m_meshletRanges[counts.firstMeshletRange + i];
+					devcon->DrawIndexedInstanced(range.indexNum, 1, meshRange.indexOffset + range.indexOffset, meshRange.vertexOffset, renderedInstances);
+				}
+				return;
+			}
 
-								objectID = getObjectID(modelIndex, meshIndex, materialIndex, instanceIndex);
-							}
-						}
-					}
+			const uint32_t* lodInstances = isShadowPass ? counts.shadow : counts.main;
+			for (uint32_t lod = 0; lod < model.getLodCount(meshIndex); lod++)
+			{
+				if (lodInstances[lod] > 0)
+				{
+					const Model::MeshRange meshRange = model.getDrawRange(meshIndex, lod, isPositionOnly);
+					devcon->DrawIndexedInstanced(meshRange.indexNum, lodInstances[lod], meshRange.indexOffset, meshRange.vertexOffset, renderedInstances);
+					renderedInstances += lodInstances[lod];
 				}
 			}
 		}
 
-		virtual unsigned int getObjectID(int modelIndex, int meshIndex, int materialIndex, int instanceIndex) const = 0;
-		virtual bool getObjectByID(unsigned int objectID, PerModel*& outObjectModel, PerMesh*& outObjectMesh, PerMaterial*& outObjectMaterial, Instance*& outObjectInstance) = 0;
-		virtual bool getObjectTransformID(unsigned int objectID, TransformSystem::ID& outID) = 0;
-		virtual bool removeObjectByID(unsigned int objectID, PerModel& removedObject) = 0;
-	protected:
-		virtual void createInstanceBuffer(int totalInstances) = 0;
-		virtual void setInstanceBufferForIA(ID3D11DeviceContext4* devcon) = 0;
-		virtual void* getInstanceBufferMappedData() = 0;
-		virtual void unmapInstanceBuffer() = 0;
-		virtual void updateInstanceBufferData(const PerMesh& perMesh, void* instanceBufferData, int& copiedNum, const Mesh& mesh, const Camera& camera) = 0;
-		virtual void initShader() = 0;
-		virtual void bindMaterialData(const PerMaterial & perMaterial) = 0;
-
 		void render(Shader& shader)
 		{
 			auto* devcon = D3D::getInstancePtr()->getDeviceContext();
@@ -436,8 +586,11 @@ namespace Engine
 			LightSystem::getInstancePtr()->setPerFrameBufferForPS(devcon);
 
 
+			// all models share the buffers of GeometryPool, so switching models costs no rebinding
 			setInstanceBufferForIA(devcon);
+			GeometryPool::getInstancePtr()->setBuffersForIA(devcon);
 			int renderedInstances = 0;
+			size_t drawIndex = 0;
 			for (const auto& perModel : perModel)
 			{
 				if (!perModel.model)
@@ -446,16 +599,13 @@ namespace Engine
 						continue;
 				}
 
-				perModel.model->m_vertices.setVertexBufferForInputAssembler(devcon);
-				perModel.model->m_indices.setIndexBufferForInputAssembler(devcon);
-
 				for (int meshIndex = 0; meshIndex < perModel.perMesh.size(); meshIndex++)
 				{
 					const Mesh& mesh = perModel.model->m_meshes[meshIndex];
-					const auto& meshRange = perModel.model->m_ranges[meshIndex];
 
 					for (const auto& perMaterial : perModel.perMesh[meshIndex].perMaterial)
 					{
+						const size_t lodCountsIndex = drawIndex++;
 						if (perMaterial.instances.empty())
 						{
 							continue;
@@ -464,13 +614,14 @@ namespace Engine
 						bindMaterialData(perMaterial);
 
 						unsigned int numInstances = static_cast<unsigned int>(perMaterial.instances.size());
-						if (perModel.model->m_indices.isEmpty())
+						if (!perModel.model->hasIndices())
 						{
+							const Model::MeshRange meshRange = perModel.model->getDrawRange(meshIndex, 0, false);
 							D3D::getInstancePtr()->getDeviceContext()->DrawInstanced(meshRange.vertexNum, numInstances, meshRange.vertexOffset, renderedInstances);
 						}
 						else
 						{
-							D3D::getInstancePtr()->getDeviceContext()->DrawIndexedInstanced(meshRange.indexNum, numInstances, meshRange.indexOffset, meshRange.vertexOffset, renderedInstances);
+							drawLods(*perModel.model, meshIndex, lodCountsIndex, false, false, numInstances, renderedInstances);
 						}
 						renderedInstances += numInstances;
 					}
@@ -478,7 +629,34 @@ namespace Engine
 			}
 		}
 
+		struct PendingInstance
+		{
+			std::shared_ptr<Model> model;
+			std::shared_ptr<Material> material;
+			Instance instance;
+		};
+
 		std::vector<PerModel> perModel;
+		std::vector<PendingInstance> m_pendingInstances; // instances of models that are still loading
+
+		// instances per LOD of every PerMaterial in draw order, written by updateInstanceBuffers
+		struct LodInstanceCounts
+		{
+			uint32_t total;
+			uint32_t main[LodSelection::MAX_LOD_COUNT];
+			uint32_t shadow[LodSelection::MAX_LOD_COUNT]; // main camera sizes with LodSelection::SHADOW_BIAS, the same for every shadow view
+
+			// ranges in m_meshletRanges the main passes draw instead of LOD 0, see cullMeshlets
+			bool isMeshletCulled;
+			uint32_t firstMeshletRange;
+			uint32_t meshletRangeCount;
+		};
+		std::vector<LodInstanceCounts> m_lodInstanceCounts;
+		std::vector<MeshletCulling::IndexRange> m_meshletRanges;
+		PerMesh m_sortedPerMesh;
+		std::vector<float> m_projectedSizes;
+		std::vector<uint32_t> m_sortedIndices;
+		uint32_t m_instancesRevision = 0;
 
 		Shader shader;
 		Shader depth2DShader;
@@ -0,0 +1,640 @@
+#include "instanceBVH.h"
+#include "mesh/boundingVolumes.h"
+#include "mesh/mesh.h"
+#include "../../math/ray.h"
+#include "../../utils/assert.h"
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <queue>
+
+namespace Engine
+{
+	const uint32_t InstanceBVH::MAX_LEAF_INSTANCES = 2;
+	const float InstanceBVH::REBUILD_AREA_RATIO = 2.0f;
+	const uint32_t InstanceBVH::MAX_STACK_DEPTH = 64;
+
+	// The near and the far face of every axis are picked by the sign of the direction and NaN distances are skipped. A ray running
+	// in a face plane gets 0 * inf = NaN for that face, skipping it keeps the slab open, as the ray lies within it.
+	inline bool intersectInstanceNode(const InstanceBVH::Node& node, const math::Vec3f& origin, const math::Vec3f& invDirection, float tMax, float& outTEnter)
+	{
+		float tEnter = 0.0f;
+		float tExit = std::numeric_limits<float>::infinity();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const bool isPositive = invDirection[axis] >= 0.0f;
+			const float tNear = ((isPositive ? node.min[axis] : node.max[axis]) - origin[axis]) * invDirection[axis];
+			const float tFar = ((isPositive ? node.max[axis] : node.min[axis]) - origin[axis]) * invDirection[axis];
+
+			// false for NaN
+			tEnter = tNear > tEnter ? tNear : tEnter;
+			tExit = tFar < tExit ? tFar : tExit;
+		}
+
+		outTEnter = tEnter;
+		return tEnter <= tExit && tEnter <= tMax;
+	}
+
+	InstanceBVH::Instance InstanceBVH::createInstance(const Mesh& mesh, TransformSystem::ID modelToWorldID, unsigned int objectID)
+	{
+		Instance instance;
+		instance.mesh = &mesh;
+		instance.modelToWorldID = modelToWorldID;
+		instance.objectID = objectID;
+
+		return instance;
+	}
+
+	void InstanceBVH::clear()
+	{
+		m_instances.clear();
+		m_instanceIndices.clear();
+		m_nodes.clear();
+		m_builtArea = 0.0f;
+	}
+
+	void InstanceBVH::build(std::vector<Instance>&& instances)
+	{
+		m_instances = std::move(instances);
+		m_nodes.clear();
+
+		auto* transformSystem = TransformSystem::getInstance();
+		for (auto& instance : m_instances)
+		{
+			updateInstance(instance, transformSystem->getMatrix(instance.modelToWorldID));
+		}
+
+		uint32_t instanceCount = uint32_t(m_instances.size());
+		m_instanceIndices.resize(instanceCount);
+		std::iota(m_instanceIndices.begin(), m_instanceIndices.end(), 0);
+		updateWorldBounds(m_instanceIndices);
+
+		if (instanceCount == 0)
+		{
+			m_builtArea = 0.0f;
+			return;
+		}
+
+		m_nodes.reserve(2 * instanceCount - 1);
+		Node& root = m_nodes.emplace_back();
+		root.leftOrFirst = 0;
+		root.count = instanceCount;
+
+		std::vector<uint32_t> toSplit = { 0 };
+		while (!toSplit.empty())
+		{
+			uint32_t nodeIndex = toSplit.back();
+			toSplit.pop_back();
+
+			Node& node = m_nodes[nodeIndex];
+			if (node.count <= MAX_LEAF_INSTANCES)
+			{
+				continue;
+			}
+
+			uint32_t* first = m_instanceIndices.data() + node.leftOrFirst;
+			uint32_t* last = first + node.count;
+
+			math::Box centroidBounds = math::Box::empty();
+			for (uint32_t* index = first; index != last; ++index)
+			{
+				centroidBounds.expand(m_instances[*index].worldBounds.center());
+			}
+
+			int axis = 0;
+			math::Vec3f extent = centroidBounds.size();
+			extent.maxCoeff(&axis);
+
+			// median split keeps the tree balanced, which matters more than SAH quality for the few thousand instances of a scene
+			uint32_t* middle = first + node.count / 2;
+			std::nth_element(first, middle, last,
+				[this, axis](uint32_t left, uint32_t right)
+				{
+					return m_instances[left].worldBounds.center()[axis] < m_instances[right].worldBounds.center()[axis];
+				});
+
+			uint32_t leftIndex = uint32_t(m_nodes.size());
+			uint32_t leftCount = node.count / 2;
+
+			Node& left = m_nodes.emplace_back();
+			left.leftOrFirst = node.leftOrFirst;
+			left.count = leftCount;
+
+			Node& right = m_nodes.emplace_back();
+			right.leftOrFirst = node.leftOrFirst + leftCount;
+			right.count = node.count - leftCount;
+
+			node.leftOrFirst = leftIndex;
+			node.count = 0;
+
+			toSplit.push_back(leftIndex);
+			toSplit.push_back(leftIndex + 1);
+		}
+
+		refitNodes();
+		m_builtArea = computeTotalArea();
+	}
+
+	void InstanceBVH::refit()
+	{
+		auto* transformSystem = TransformSystem::getInstance();
+
+		std::vector<uint32_t> changed;
+		for (uint32_t index = 0; index < uint32_t(m_instances.size()); ++index)
+		{
+			Instance& instance = m_instances[index];
+			const math::Mat4f& modelToWorld = transformSystem->getMatrix(instance.modelToWorldID);
+			if (modelToWorld != instance.modelToWorld)
+			{
+				updateInstance(instance, modelToWorld);
+				changed.push_back(index);
+			}
+		}
+
+		if (changed.empty())
+		{
+			return;
+		}
+		updateWorldBounds(changed);
+
+		refitNodes();
+
+		if (computeTotalArea() > REBUILD_AREA_RATIO * m_builtArea)
+		{
+			std::vector<Instance> instances = std::move(m_instances);
+			build(std::move(instances));
+		}
+	}
+
+	const InstanceBVH::Instance* InstanceBVH::intersect(const math::Ray& ray, math::Intersection& outNearest) const
+	{
+		if (m_nodes.empty())
+		{
+			return nullptr;
+		}
+
+		const math::Vec3f invDirection = ray.direction.cwiseInverse();
+
+		float tEnter;
+		if (!intersectInstanceNode(m_nodes[0], ray.origin, invDirection, outNearest.t, tEnter))
+		{
+			return nullptr;
+		}
+
+		struct StackEntry
+		{
+			uint32_t node;
+			float t;
+		};
+
+		StackEntry stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		const Instance* nearestInstance = nullptr;
+		math::Ray rayInMeshSpace;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					const Instance& instance = m_instances[m_instanceIndices[i]];
+
+					// the direction is not normalized, so t stays the same in mesh space
+					rayInMeshSpace.origin = (math::Vec4f(ray.origin.x(), ray.origin.y(), ray.origin.z(), 1.0f) * instance.worldToMesh).head<3>();
+					rayInMeshSpace.direction = (math::Vec4f(ray.direction.x(), ray.direction.y(), ray.direction.z(), 0.0f) * instance.worldToMesh).head<3>();
+
+					// the hull rejects rays passing the corners of the mesh bounds before the mesh BVH is entered
+					if (!instance.mesh->hull.intersects(rayInMeshSpace, outNearest.t))
+					{
+						continue;
+					}
+
+					math::MeshIntersection intersection;
+					intersection.reset(0.0f);
+					intersection.t = outNearest.t;
+
+					if (instance.mesh->bvh.intersect(rayInMeshSpace, intersection))
+					{
+						outNearest.position = (math::Vec4f(intersection.position.x(), intersection.position.y(), intersection.position.z(), 1.0f) * instance.meshToWorld).head<3>();
+						outNearest.normal = (math::Vec4f(intersection.normal.x(), intersection.normal.y(), intersection.normal.z(), 0.0f) * instance.meshToWorld).head<3>();
+						outNearest.t = intersection.t;
+
+						nearestInstance = &instance;
+					}
+				}
+			}
+			else
+			{
+				uint32_t closer = node.leftOrFirst;
+				uint32_t farther = closer + 1;
+
+				float tCloser, tFarther;
+				bool hitCloser = intersectInstanceNode(m_nodes[closer], ray.origin, invDirection, outNearest.t, tCloser);
+				bool hitFarther = intersectInstanceNode(m_nodes[farther], ray.origin, invDirection, outNearest.t, tFarther);
+
+				if (hitFarther && (!hitCloser || tFarther < tCloser))
+				{
+					std::swap(closer, farther);
+					std::swap(tCloser, tFarther);
+					std::swap(hitCloser, hitFarther);
+				}
+
+				if (hitCloser)
+				{
+					if (hitFarther)
+					{
+						DEV_ASSERT(stackSize < MAX_STACK_DEPTH);
+						stack[stackSize++] = { farther, tFarther };
+					}
+
+					nodeIndex = closer;
+					continue;
+				}
+			}
+
+			while (stackSize > 0 && stack[stackSize - 1].t > outNearest.t)
+			{
+				--stackSize;
+			}
+
+			if (stackSize == 0)
+			{
+				break;
+			}
+
+			nodeIndex = stack[--stackSize].node;
+		}
+
+		return nearestInstance;
+	}
+
+	bool InstanceBVH::occluded(const math::Ray& ray, float tMax) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		const math::Vec3f invDirection = ray.direction.cwiseInverse();
+
+		float tEnter;
+		if (!intersectInstanceNode(m_nodes[0], ray.origin, invDirection, tMax, tEnter))
+		{
+			return false;
+		}
+
+		uint32_t stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		math::Ray rayInMeshSpace;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					const Instance& instance = m_instances[m_instanceIndices[i]];
+
+					rayInMeshSpace.origin = (math::Vec4f(ray.origin.x(), ray.origin.y(), ray.origin.z(), 1.0f) * instance.worldToMesh).head<3>();
+					rayInMeshSpace.direction = (math::Vec4f(ray.direction.x(), ray.direction.y(), ray.direction.z(), 0.0f) * instance.worldToMesh).head<3>();
+
+					if (instance.mesh->hull.intersects(rayInMeshSpace, tMax) && instance.mesh->bvh.occluded(rayInMeshSpace, tMax))
+					{
+						return true;
+					}
+				}
+			}
+			else
+			{
+				uint32_t left = node.leftOrFirst;
+				uint32_t right = left + 1;
+
+				bool hitLeft = intersectInstanceNode(m_nodes[left], ray.origin, invDirection, tMax, tEnter);
+				bool hitRight = intersectInstanceNode(m_nodes[right], ray.origin, invDirection, tMax, tEnter);
+
+				if (hitLeft || hitRight)
+				{
+					if (hitLeft && hitRight)
+					{
+						DEV_ASSERT(stackSize < MAX_STACK_DEPTH);
+						stack[stackSize++] = right;
+					}
+
+					nodeIndex = hitLeft ? left : right;
+					continue;
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return false;
+			}
+
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	const InstanceBVH::Instance* InstanceBVH::sphereCast(const math::Ray& ray, float radius, math::Intersection& outNearest) const
+	{
+		return castInternal(ray, nullptr, radius, outNearest);
+	}
+
+	const InstanceBVH::Instance* InstanceBVH::capsuleCast(const math::Ray& ray, const math::Vec3f& halfSegment, float radius, math::Intersection& outNearest) const
+	{
+		return castInternal(ray, &halfSegment, radius, outNearest);
+	}
+
+	void InstanceBVH::findInstances(const math::Box& bounds, std::vector<const Instance*>& outInstances) const
+	{
+		if (m_nodes.empty())
+		{
+			return;
+		}
+
+		uint32_t stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = 0;
+
+		while (stackSize > 0)
+		{
+			const Node& node = m_nodes[stack[--stackSize]];
+			if (!bounds.overlaps(math::Box{ node.min, node.max }))
+			{
+				continue;
+			}
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					const Instance& instance = m_instances[m_instanceIndices[i]];
+					if (bounds.overlaps(instance.worldBounds))
+					{
+						outInstances.push_back(&instance);
+					}
+				}
+			}
+			else
+			{
+				DEV_ASSERT(stackSize + 2 <= MAX_STACK_DEPTH);
+				stack[stackSize++] = node.leftOrFirst;
+				stack[stackSize++] = node.leftOrFirst + 1;
+			}
+		}
+	}
+
+	const InstanceBVH::Instance* InstanceBVH::closestPoint(const math::Vec3f& point, float maxDistance, math::MeshClosestPoint& outNearest) const
+	{
+		if (m_nodes.empty())
+		{
+			return nullptr;
+		}
+
+		struct QueueEntry
+		{
+			float distance; // squared
+			uint32_t node;
+
+			bool operator>(const QueueEntry& other) const
+			{
+				return distance > other.distance;
+			}
+		};
+
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+		float bestDistance = maxDistance;
+		const Instance* nearestInstance = nullptr;
+
+		float rootDistance = math::Box{ m_nodes[0].min, m_nodes[0].max }.squaredDistance(point);
+		if (rootDistance < bestDistance * bestDistance)
+		{
+			queue.push({ rootDistance, 0 });
+		}
+
+		while (!queue.empty())
+		{
+			QueueEntry entry = queue.top();
+			queue.pop();
+
+			if (entry.distance >= bestDistance * bestDistance)
+			{
+				break;
+			}
+
+			const Node& node = m_nodes[entry.node];
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					const Instance& instance = m_instances[m_instanceIndices[i]];
+
+					if (instance.mesh->bvh.closestPoint(point, instance.meshToWorld, bestDistance, outNearest))
+					{
+						bestDistance = outNearest.distance;
+						nearestInstance = &instance;
+					}
+				}
+			}
+			else
+			{
+				for (uint32_t child = node.leftOrFirst; child < node.leftOrFirst + 2; ++child)
+				{
+					float distance = math::Box{ m_nodes[child].min, m_nodes[child].max }.squaredDistance(point);
+					if (distance < bestDistance * bestDistance)
+					{
+						queue.push({ distance, child });
+					}
+				}
+			}
+		}
+
+		return nearestInstance;
+	}
+
+	void InstanceBVH::updateInstance(Instance& instance, const math::Mat4f& modelToWorld)
+	{
+		instance.modelToWorld = modelToWorld;
+		instance.meshToWorld = instance.mesh->instances[0] * modelToWorld;
+		instance.worldToMesh = instance.meshToWorld.inverse();
+		instance.worldToMeshScale = Eigen::JacobiSVD<math::Mat3f>(instance.worldToMesh.topLeftCorner<3, 3>()).singularValues()[0];
+	}
+
+	void InstanceBVH::updateWorldBounds(std::span<const uint32_t> instanceIndices)
+	{
+		std::vector<const Mesh*> meshes(instanceIndices.size());
+		std::vector<const math::Mat4f*> meshToWorld(instanceIndices.size());
+		for (size_t i = 0; i < instanceIndices.size(); ++i)
+		{
+			const Instance& instance = m_instances[instanceIndices[i]];
+			meshes[i] = instance.mesh;
+			meshToWorld[i] = &instance.meshToWorld;
+		}
+
+		std::vector<math::Box> bounds(instanceIndices.size());
+		BoundingVolumes::computeWorldBounds(meshes, meshToWorld, bounds);
+
+		for (size_t i = 0; i < instanceIndices.size(); ++i)
+		{
+			m_instances[instanceIndices[i]].worldBounds = bounds[i];
+		}
+	}
+
+	const InstanceBVH::Instance* InstanceBVH::castInternal(const math::Ray& ray, const math::Vec3f* halfSegment, float radius, math::Intersection& outNearest) const
+	{
+		if (m_nodes.empty())
+		{
+			return nullptr;
+		}
+
+		const math::Vec3f extent = halfSegment ? math::Vec3f(halfSegment->cwiseAbs().array() + radius) : math::Vec3f(radius, radius, radius);
+		auto intersectExpandedNode = [&ray, &extent, invDirection = math::Vec3f(ray.direction.cwiseInverse())](Node node, float tMax, float& outTEnter)
+		{
+			node.min -= extent;
+			node.max += extent;
+			return intersectInstanceNode(node, ray.origin, invDirection, tMax, outTEnter);
+		};
+
+		float tEnter;
+		if (!intersectExpandedNode(m_nodes[0], outNearest.t, tEnter))
+		{
+			return nullptr;
+		}
+
+		struct StackEntry
+		{
+			uint32_t node;
+			float t;
+		};
+
+		StackEntry stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		const Instance* nearestInstance = nullptr;
+		math::Ray rayInMeshSpace;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+
+			if (node.isLeaf())
+			{
+				for (uint32_t i = node.leftOrFirst; i < node.leftOrFirst + node.count; ++i)
+				{
+					const Instance& instance = m_instances[m_instanceIndices[i]];
+					const math::Mat3f worldToMesh3x3 = instance.worldToMesh.topLeftCorner<3, 3>();
+
+					rayInMeshSpace.origin = (math::Vec4f(ray.origin.x(), ray.origin.y(), ray.origin.z(), 1.0f) * instance.worldToMesh).head<3>();
+					rayInMeshSpace.direction = ray.direction * worldToMesh3x3;
+
+					math::MeshIntersection intersection;
+					intersection.reset(0.0f);
+					intersection.t = outNearest.t;
+
+					float radiusInMeshSpace = radius * instance.worldToMeshScale;
+					bool hit = halfSegment ?
+						instance.mesh->bvh.capsuleCast(rayInMeshSpace, math::Vec3f(*halfSegment * worldToMesh3x3), radiusInMeshSpace, intersection) :
+						instance.mesh->bvh.sphereCast(rayInMeshSpace, radiusInMeshSpace, intersection);
+
+					if (hit)
+					{
+						outNearest.position = (math::Vec4f(intersection.position.x(), intersection.position.y(), intersection.position.z(), 1.0f) * instance.meshToWorld).head<3>();
+						outNearest.normal = (intersection.normal * worldToMesh3x3.transpose()).normalized();
+						outNearest.t = intersection.t;
+
+						nearestInstance = &instance;
+					}
+				}
+			}
+			else
+			{
+				uint32_t closer = node.leftOrFirst;
+				uint32_t farther = closer + 1;
+
+				float tCloser, tFarther;
+				bool hitCloser = intersectExpandedNode(m_nodes[closer], outNearest.t, tCloser);
+				bool hitFarther = intersectExpandedNode(m_nodes[farther], outNearest.t, tFarther);
+
+				if (hitFarther && (!hitCloser || tFarther < tCloser))
+				{
+					std::swap(closer, farther);
+					std::swap(tCloser, tFarther);
+					std::swap(hitCloser, hitFarther);
+				}
+
+				if (hitCloser)
+				{
+					if (hitFarther)
+					{
+						DEV_ASSERT(stackSize < MAX_STACK_DEPTH);
+						stack[stackSize++] = { farther, tFarther };
+					}
+
+					nodeIndex = closer;
+					continue;
+				}
+			}
+
+			while (stackSize > 0 && stack[stackSize - 1].t > outNearest.t)
+			{
+				--stackSize;
+			}
+
+			if (stackSize == 0)
+			{
+				break;
+			}
+
+			nodeIndex = stack[--stackSize].node;
+		}
+
+		return nearestInstance;
+	}
+
+	void InstanceBVH::refitNodes()
+	{
+		// children are always stored after their parent, so a reverse pass visits them first
+		for (size_t i = m_nodes.size(); i-- > 0;)
+		{
+			Node& node = m_nodes[i];
+
+			math::Box bounds = math::Box::empty();
+			if (node.isLeaf())
+			{
+				for (uint32_t j = node.leftOrFirst; j < node.leftOrFirst + node.count; ++j)
+				{
+					bounds.expand(m_instances[m_instanceIndices[j]].worldBounds);
+				}
+			}
+			else
+			{
+				bounds.expand(math::Box{ m_nodes[node.leftOrFirst].min, m_nodes[node.leftOrFirst].max });
+				bounds.expand(math::Box{ m_nodes[node.leftOrFirst + 1].min, m_nodes[node.leftOrFirst + 1].max });
+			}
+
+			node.min = bounds.min;
+			node.max = bounds.max;
+		}
+	}
+
+	float InstanceBVH::computeTotalArea() const
+	{
+		float area = 0.0f;
+		for (const Node& node : m_nodes)
+		{
+			area += math::Box{ node.min, node.max }.surfaceArea();
+		}
+
+		return area;
+	}
+}
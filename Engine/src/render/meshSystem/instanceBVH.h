@@ -0,0 +1,81 @@
+#pragma once
+#include "mesh/triangleBVH.h"
+#include "../../math/intersection.h"
+#include "../../transformSystem/transformSystem.h"
+#include <span>
+#include <vector>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// Top-level BVH over world-space bounds of mesh instances. Every leaf references instances whose ray queries
+	// are forwarded to the mesh's TriangleBVH in mesh space, using inverse transforms cached per instance.
+	class InstanceBVH
+	{
+	public:
+		using Node = TriangleBVH::Node;
+
+		struct Instance
+		{
+			const Mesh* mesh;
+			TransformSystem::ID modelToWorldID;
+			unsigned int objectID;
+
+			math::Mat4f modelToWorld; // copy of the TransformSystem matrix the cached values were computed from
+			math::Mat4f meshToWorld;
+			math::Mat4f worldToMesh;
+			float worldToMeshScale; // largest stretch of worldToMesh, turns world radii into conservative mesh space radii
+			math::Box worldBounds; // see BoundingVolumes::computeWorldBounds
+		};
+
+		const static uint32_t MAX_LEAF_INSTANCES;
+		const static float REBUILD_AREA_RATIO;
+		const static uint32_t MAX_STACK_DEPTH;
+
+		static Instance createInstance(const Mesh& mesh, TransformSystem::ID modelToWorldID, unsigned int objectID);
+
+		void clear();
+		void build(std::vector<Instance>&& instances);
+
+		// Updates instances whose TransformSystem matrix has changed and refits the nodes above them.
+		// Rebuilds the tree once refitting has made it too loose.
+		void refit();
+
+		// Returns the closest instance hit before outNearest.t or nullptr, outNearest is updated only on hit.
+		const Instance* intersect(const math::Ray& ray, math::Intersection& outNearest) const;
+
+		// Returns true as soon as any instance is hit in [0, tMax).
+		bool occluded(const math::Ray& ray, float tMax) const;
+
+		// Sphere and capsule casts, each instance is tested in its mesh space with the radius scaled by worldToMeshScale.
+		// Return the first instance touched before outNearest.t or nullptr, outNearest is updated only on hit.
+		const Instance* sphereCast(const math::Ray& ray, float radius, math::Intersection& outNearest) const;
+		const Instance* capsuleCast(const math::Ray& ray, const math::Vec3f& halfSegment, float radius, math::Intersection& outNearest) const;
+
+		// Collects instances whose world bounds overlap bounds.
+		void findInstances(const math::Box& bounds, std::vector<const Instance*>& outInstances) const;
+
+		// Returns the instance owning the closest surface point within maxDistance or nullptr, the result is in world space.
+		const Instance* closestPoint(const math::Vec3f& point, float maxDistance, math::MeshClosestPoint& outNearest) const;
+
+		const std::vector<Instance>& getInstances() const
+		{
+			return m_instances;
+		}
+
+	protected:
+		std::vector<Instance> m_instances;
+		std::vector<uint32_t> m_instanceIndices; // reordered so that every leaf references a contiguous range
+		std::vector<Node> m_nodes;
+
+		float m_builtArea = 0.0f; // sum of node surface areas right after the last build
+
+		// everything but worldBounds, which are computed for many instances at once by updateWorldBounds
+		void updateInstance(Instance& instance, const math::Mat4f& modelToWorld);
+		void updateWorldBounds(std::span<const uint32_t> instanceIndices);
+		const Instance* castInternal(const math::Ray& ray, const math::Vec3f* halfSegment, float radius, math::Intersection& outNearest) const;
+		void refitNodes();
+		float computeTotalArea() const;
+	};
+}
@@ -0,0 +1,498 @@
+#include "boundingVolumes.h"
+#include "mesh.h"
+#include "../../../math/simd.h"
+#include "../../../utils/assert.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace Engine
+{
+	const uint32_t BoundingVolumes::VERSION = 1;
+	const uint32_t BoundingVolumes::MAX_SPHERE_ITERATIONS = 64;
+
+	namespace
+	{
+		namespace simd = math::simd;
+
+		using Vec3d = Eigen::Matrix<double, 1, 3, Eigen::RowMajor>;
+
+		// relative padding of fitted volumes, covers the rounding of the tests against them
+		const float BOUNDS_PADDING = 4.0f * std::numeric_limits<float>::epsilon();
+
+		struct ExtremeVertices
+		{
+			uint32_t min[math::KDop::DIRECTION_COUNT];
+			uint32_t max[math::KDop::DIRECTION_COUNT];
+		};
+
+		ExtremeVertices findExtremeVertices(std::span<const math::Vertex> vertices)
+		{
+			ExtremeVertices extremes = {};
+			math::KDop dop = math::KDop::empty();
+			for (uint32_t v = 0; v < uint32_t(vertices.size()); ++v)
+			{
+				for (uint32_t i = 0; i < math::KDop::DIRECTION_COUNT; ++i)
+				{
+					float distance = vertices[v].position.dot(math::KDop::DIRECTIONS[i]);
+					if (distance < dop.min[i])
+					{
+						dop.min[i] = distance;
+						extremes.min[i] = v;
+					}
+					if (distance > dop.max[i])
+					{
+						dop.max[i] = distance;
+						extremes.max[i] = v;
+					}
+				}
+			}
+			return extremes;
+		}
+
+		struct Ball
+		{
+			Vec3d center;
+			double squaredRadius; // negative for the empty ball
+
+			bool contains(const Vec3d& point) const
+			{
+				// the points the ball passes through stay inside after rounding
+				return (point - center).squaredNorm() <= squaredRadius * (1.0 + 1e-9);
+			}
+		};
+
+		Ball circumscribe(const Vec3d* points, int count);
+
+		// the largest of the balls through all but one of the points, for points that don't span the dimension they should
+		Ball circumscribeDegenerate(const Vec3d* points, int count)
+		{
+			Ball largest = { Vec3d::Zero(), -1.0 };
+			for (int skipped = 0; skipped < count; ++skipped)
+			{
+				Vec3d subset[3];
+				for (int i = 0, j = 0; i < count; ++i)
+				{
+					if (i != skipped)
+					{
+						subset[j++] = points[i];
+					}
+				}
+
+				Ball ball = circumscribe(subset, count - 1);
+				if (ball.squaredRadius > largest.squaredRadius)
+				{
+					largest = ball;
+				}
+			}
+			return largest;
+		}
+
+		// the smallest ball with all points on its boundary
+		Ball circumscribe(const Vec3d* points, int count)
+		{
+			if (count == 0)
+			{
+				return { Vec3d::Zero(), -1.0 };
+			}
+			if (count == 1)
+			{
+				return { points[0], 0.0 };
+			}
+			if (count == 2)
+			{
+				Vec3d center = (points[0] + points[1]) / 2.0;
+				return { center, (points[0] - center).squaredNorm() };
+			}
+
+			const Vec3d a = points[1] - points[0];
+			const Vec3d b = points[2] - points[0];
+			if (count == 3)
+			{
+				const Vec3d normal = a.cross(b);
+				const double denominator = 2.0 * normal.squaredNorm();
+				if (denominator <= 1e-12 * a.squaredNorm() * b.squaredNorm())
+				{
+					return circumscribeDegenerate(points, count);
+				}
+
+				Vec3d offset = (a.squaredNorm() * b - b.squaredNorm() * a).cross(normal) / denominator;
+				return { points[0] + offset, offset.squaredNorm() };
+			}
+
+			const Vec3d c = points[3] - points[0];
+			const double determinant = a.dot(b.cross(c));
+			if (std::abs(determinant) <= 1e-9 * std::sqrt(a.squaredNorm() * b.squaredNorm() * c.squaredNorm()))
+			{
+				return circumscribeDegenerate(points, count);
+			}
+
+			Vec3d offset = (a.squaredNorm() * b.cross(c) + b.squaredNorm() * c.cross(a) + c.squaredNorm() * a.cross(b)) / (2.0 * determinant);
+			return { points[0] + offset, offset.squaredNorm() };
+		}
+
+		// Welzl's algorithm with the move-to-front heuristic, support holds the points on the boundary of the ball
+		Ball computeMinimalBall(std::vector<Vec3d>& points, size_t end, Vec3d* support, int supportCount)
+		{
+			Ball ball = circumscribe(support, supportCount);
+			if (supportCount == 4)
+			{
+				return ball;
+			}
+
+			for (size_t i = 0; i < end; ++i)
+			{
+				if (!ball.contains(points[i]))
+				{
+					support[supportCount] = points[i];
+					ball = computeMinimalBall(points, i, support, supportCount + 1);
+					std::rotate(points.begin(), points.begin() + i, points.begin() + i + 1);
+				}
+			}
+			return ball;
+		}
+
+		// orthonormal right handed rows, the first one along direction and the second one along the part of secondary perpendicular to it
+		math::Mat3f makeAxes(const math::Vec3f& direction, const math::Vec3f& secondary)
+		{
+			const math::Vec3f x = direction.normalized();
+			math::Vec3f y = secondary - x * secondary.dot(x);
+			if (y.squaredNorm() <= 1e-12f * secondary.squaredNorm() || secondary.squaredNorm() == 0.0f)
+			{
+				y = std::abs(x.x()) < 0.9f ? math::Vec3f(1.0f, 0.0f, 0.0f) : math::Vec3f(0.0f, 1.0f, 0.0f);
+				y -= x * y.dot(x);
+			}
+			y.normalize();
+
+			math::Mat3f axes;
+			axes.row(0) = x;
+			axes.row(1) = y;
+			axes.row(2) = x.cross(y);
+			return axes;
+		}
+
+		math::OrientedBox fitBox(std::span<const math::Vertex> vertices, const math::Mat3f& axes)
+		{
+			math::Vec3f min = math::Vec3f::Constant(math::Box::Inf);
+			math::Vec3f max = -min;
+			for (const auto& vertex : vertices)
+			{
+				const math::Vec3f projected = vertex.position * axes.transpose();
+				min = min.cwiseMin(projected);
+				max = max.cwiseMax(projected);
+			}
+
+			// the center is rotated back and forth by the tests, so the rounding depends on the magnitude of all coordinates
+			const float padding = std::max(min.cwiseAbs().maxCoeff(), max.cwiseAbs().maxCoeff()) * BOUNDS_PADDING;
+			return { ((min + max) / 2.0f) * axes, axes, (max - min) / 2.0f + math::Vec3f::Constant(padding) };
+		}
+
+		math::simd::Vec3N loadVec3(const float (*inputs)[simd::WIDTH])
+		{
+			return { simd::load(inputs[0]), simd::load(inputs[1]), simd::load(inputs[2]) };
+		}
+
+		math::simd::Vec3N absolute(const math::simd::Vec3N& v)
+		{
+			return { simd::abs(v.x), simd::abs(v.y), simd::abs(v.z) };
+		}
+	}
+
+	void BoundingVolumes::build(Mesh& mesh)
+	{
+		mesh.boundingSphere = computeSphere(mesh.vertices);
+		mesh.orientedBox = computeOrientedBox(mesh.vertices);
+		mesh.hull = computeHull(mesh.vertices);
+	}
+
+	math::Sphere BoundingVolumes::computeSphere(std::span<const math::Vertex> vertices)
+	{
+		if (vertices.empty())
+		{
+			return { math::Vec3f::Zero(), 0.0f };
+		}
+
+		const ExtremeVertices extremes = findExtremeVertices(vertices);
+		std::vector<Vec3d> supportSet;
+		for (uint32_t i = 0; i < math::KDop::DIRECTION_COUNT; ++i)
+		{
+			supportSet.push_back(vertices[extremes.min[i]].position.cast<double>());
+			supportSet.push_back(vertices[extremes.max[i]].position.cast<double>());
+		}
+
+		Ball ball;
+		for (uint32_t iteration = 0; iteration < MAX_SPHERE_ITERATIONS; ++iteration)
+		{
+			Vec3d support[4];
+			ball = computeMinimalBall(supportSet, supportSet.size(), support, 0);
+
+			double farthestDistance = -1.0;
+			Vec3d farthest;
+			for (const auto& vertex : vertices)
+			{
+				const Vec3d position = vertex.position.cast<double>();
+				const double distance = (position - ball.center).squaredNorm();
+				if (distance > farthestDistance)
+				{
+					farthestDistance = distance;
+					farthest = position;
+				}
+			}
+
+			if (ball.contains(farthest))
+			{
+				break;
+			}
+			supportSet.push_back(farthest);
+		}
+
+		// rounding and running out of iterations may leave vertices outside, the radius is grown to cover them
+		const math::Vec3f center = ball.center.cast<float>();
+		float radius = 0.0f;
+		for (const auto& vertex : vertices)
+		{
+			radius = std::max(radius, (vertex.position - center).norm());
+		}
+		return { center, radius + (radius + center.cwiseAbs().maxCoeff()) * BOUNDS_PADDING };
+	}
+
+	math::OrientedBox BoundingVolumes::computeOrientedBox(std::span<const math::Vertex> vertices)
+	{
+		if (vertices.empty())
+		{
+			return { math::Vec3f::Zero(), math::Mat3f::Identity(), math::Vec3f::Zero() };
+		}
+
+		std::vector<math::Mat3f> candidates = { math::Mat3f::Identity() };
+
+		// principal axes, the eigenvectors of the covariance of the vertices from the largest eigenvalue
+		Vec3d mean = Vec3d::Zero();
+		for (const auto& vertex : vertices)
+		{
+			mean += vertex.position.cast<double>();
+		}
+		mean /= double(vertices.size());
+
+		Eigen::Matrix3d covariance = Eigen::Matrix3d::Zero();
+		for (const auto& vertex : vertices)
+		{
+			const Vec3d offset = vertex.position.cast<double>() - mean;
+			covariance += offset.transpose() * offset;
+		}
+
+		Eigen::SelfAdjointEigenSolver<Eigen::Matrix3d> solver(covariance);
+		if (solver.info() == Eigen::Success)
+		{
+			const Eigen::Matrix3d& eigenvectors = solver.eigenvectors();
+			candidates.push_back(makeAxes(eigenvectors.col(2).transpose().cast<float>(), eigenvectors.col(1).transpose().cast<float>()));
+		}
+
+		// DiTO: the extreme vertices farthest apart, the extreme vertex farthest from the line through them and the edges of their triangle
+		const ExtremeVertices extremes = findExtremeVertices(vertices);
+		math::Vec3f p0, p1;
+		float farthestPair = -1.0f;
+		for (uint32_t i = 0; i < math::KDop::DIRECTION_COUNT; ++i)
+		{
+			const math::Vec3f& min = vertices[extremes.min[i]].position;
+			const math::Vec3f& max = vertices[extremes.max[i]].position;
+			if ((max - min).squaredNorm() > farthestPair)
+			{
+				farthestPair = (max - min).squaredNorm();
+				p0 = min;
+				p1 = max;
+			}
+		}
+
+		if (farthestPair > 0.0f)
+		{
+			const math::Vec3f direction = (p1 - p0).normalized();
+			math::Vec3f p2 = p0;
+			float farthestFromLine = 0.0f;
+			for (uint32_t i = 0; i < 2 * math::KDop::DIRECTION_COUNT; ++i)
+			{
+				const math::Vec3f& point = vertices[i % 2 ? extremes.max[i / 2] : extremes.min[i / 2]].position;
+				const math::Vec3f offset = point - p0;
+				const float distance = (offset - direction * offset.dot(direction)).squaredNorm();
+				if (distance > farthestFromLine)
+				{
+					farthestFromLine = distance;
+					p2 = point;
+				}
+			}
+
+			const math::Vec3f normal = (p1 - p0).cross(p2 - p0);
+			if (farthestFromLine > 0.0f && normal.squaredNorm() > 0.0f)
+			{
+				const math::Vec3f edges[] = { p1 - p0, p2 - p1, p0 - p2 };
+				for (const math::Vec3f& edge : edges)
+				{
+					if (edge.squaredNorm() > 0.0f)
+					{
+						candidates.push_back(makeAxes(edge, normal.cross(edge)));
+					}
+				}
+			}
+			else
+			{
+				candidates.push_back(makeAxes(p1 - p0, math::Vec3f::Zero()));
+			}
+		}
+
+		math::OrientedBox best = fitBox(vertices, candidates[0]);
+		for (size_t i = 1; i < candidates.size(); ++i)
+		{
+			math::OrientedBox box = fitBox(vertices, candidates[i]);
+			if (box.surfaceArea() < best.surfaceArea())
+			{
+				best = box;
+			}
+		}
+		return best;
+	}
+
+	math::KDop BoundingVolumes::computeHull(std::span<const math::Vertex> vertices)
+	{
+		math::KDop hull = math::KDop::empty();
+		for (const auto& vertex : vertices)
+		{
+			hull.expand(vertex.position);
+		}
+
+		// rays through a corner only touch the exact hull there, so rounding would reject them
+		for (uint32_t i = 0; i < math::KDop::DIRECTION_COUNT; ++i)
+		{
+			const float padding = std::max(std::abs(hull.min[i]), std::abs(hull.max[i])) * BOUNDS_PADDING;
+			hull.min[i] -= padding;
+			hull.max[i] += padding;
+		}
+		return hull;
+	}
+
+	BoundingVolumes::Visibility BoundingVolumes::testPlanes(const Mesh& mesh, std::span<const math::Vec4f> planes)
+	{
+		const math::Sphere& sphere = mesh.boundingSphere;
+		const math::OrientedBox& box = mesh.orientedBox;
+		const math::Vec4f sphereCenter(sphere.position.x(), sphere.position.y(), sphere.position.z(), 1.0f);
+		const math::Vec4f boxCenter(box.center.x(), box.center.y(), box.center.z(), 1.0f);
+
+		Visibility visibility = Visibility::INSIDE;
+		for (const auto& plane : planes)
+		{
+			const math::Vec3f normal = plane.head<3>();
+			const float sphereDistance = sphereCenter.dot(plane);
+			const float sphereRadius = sphere.radius * normal.norm();
+			if (sphereDistance < -sphereRadius)
+			{
+				return Visibility::OUTSIDE;
+			}
+			if (sphereDistance >= sphereRadius)
+			{
+				continue;
+			}
+
+			const float boxDistance = boxCenter.dot(plane);
+			const float boxRadius = box.projectedRadius(normal);
+			if (boxDistance < -boxRadius)
+			{
+				return Visibility::OUTSIDE;
+			}
+			if (boxDistance < boxRadius)
+			{
+				visibility = Visibility::INTERSECTING;
+			}
+		}
+		return visibility;
+	}
+
+	void BoundingVolumes::computeWorldBounds(std::span<const Mesh* const> meshes, std::span<const math::Mat4f* const> meshToWorld, std::span<math::Box> outBounds)
+	{
+		DEV_ASSERT(meshes.size() == meshToWorld.size() && meshes.size() == outBounds.size());
+
+		// The inputs of simd::WIDTH instances are transposed into lanes, the lanes past the last instance repeat it.
+		// Oriented box axes are scaled by the half size of the box.
+		enum Input
+		{
+			LINEAR = 0,
+			TRANSLATION = 9,
+			BOX_CENTER = 12,
+			BOX_HALF_SIZE = 15,
+			ORIENTED_CENTER = 18,
+			ORIENTED_AXES = 21,
+			SPHERE_CENTER = 30,
+			SPHERE_RADIUS = 33,
+			INPUT_COUNT = 34
+		};
+		float inputs[INPUT_COUNT][simd::WIDTH];
+		float outputs[6][simd::WIDTH];
+
+		for (size_t first = 0; first < meshes.size(); first += simd::WIDTH)
+		{
+			for (uint32_t lane = 0; lane < simd::WIDTH; ++lane)
+			{
+				const size_t index = std::min(first + lane, meshes.size() - 1);
+				const Mesh& mesh = *meshes[index];
+				const math::Mat4f& matrix = *meshToWorld[index];
+
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					for (int row = 0; row < 3; ++row)
+					{
+						inputs[LINEAR + 3 * row + axis][lane] = matrix(row, axis);
+						inputs[ORIENTED_AXES + 3 * row + axis][lane] = mesh.orientedBox.axes(row, axis) * mesh.orientedBox.halfSize[row];
+					}
+					inputs[TRANSLATION + axis][lane] = matrix(3, axis);
+					inputs[BOX_CENTER + axis][lane] = mesh.boundingBox.center()[axis];
+					inputs[BOX_HALF_SIZE + axis][lane] = mesh.boundingBox.size()[axis] / 2.0f;
+					inputs[ORIENTED_CENTER + axis][lane] = mesh.orientedBox.center[axis];
+					inputs[SPHERE_CENTER + axis][lane] = mesh.boundingSphere.position[axis];
+				}
+				inputs[SPHERE_RADIUS][lane] = mesh.boundingSphere.radius;
+			}
+
+			const simd::Vec3N rows[3] = { loadVec3(inputs + LINEAR), loadVec3(inputs + LINEAR + 3), loadVec3(inputs + LINEAR + 6) };
+			const simd::Vec3N translation = loadVec3(inputs + TRANSLATION);
+			auto transformVector = [&rows](const simd::Vec3N& v)
+			{
+				return rows[0] * v.x + rows[1] * v.y + rows[2] * v.z;
+			};
+
+			const simd::Vec3N boxCenter = transformVector(loadVec3(inputs + BOX_CENTER)) + translation;
+			const simd::Vec3N boxHalfSize = loadVec3(inputs + BOX_HALF_SIZE);
+			const simd::Vec3N boxExtent = absolute(rows[0]) * boxHalfSize.x + absolute(rows[1]) * boxHalfSize.y + absolute(rows[2]) * boxHalfSize.z;
+
+			const simd::Vec3N orientedCenter = transformVector(loadVec3(inputs + ORIENTED_CENTER)) + translation;
+			const simd::Vec3N orientedExtent = absolute(transformVector(loadVec3(inputs + ORIENTED_AXES))) + absolute(transformVector(loadVec3(inputs + ORIENTED_AXES + 3))) +
+				absolute(transformVector(loadVec3(inputs + ORIENTED_AXES + 6)));
+
+			// the stretch of the sphere is bounded as in math::Sphere::transformed
+			const simd::FloatN g01 = simd::abs(simd::dot(rows[0], rows[1]));
+			const simd::FloatN g02 = simd::abs(simd::dot(rows[0], rows[2]));
+			const simd::FloatN g12 = simd::abs(simd::dot(rows[1], rows[2]));
+			const simd::FloatN maxRowSum = simd::max(simd::max(simd::dot(rows[0], rows[0]) + g01 + g02, g01 + simd::dot(rows[1], rows[1]) + g12), g02 + g12 + simd::dot(rows[2], rows[2]));
+			const simd::FloatN sphereRadius = simd::load(inputs[SPHERE_RADIUS]) * simd::sqrt(maxRowSum);
+			const simd::Vec3N sphereCenter = transformVector(loadVec3(inputs + SPHERE_CENTER)) + translation;
+
+			const simd::FloatN centers[3][3] = { { boxCenter.x, boxCenter.y, boxCenter.z }, { orientedCenter.x, orientedCenter.y, orientedCenter.z }, { sphereCenter.x, sphereCenter.y, sphereCenter.z } };
+			const simd::FloatN extents[3][3] = { { boxExtent.x, boxExtent.y, boxExtent.z }, { orientedExtent.x, orientedExtent.y, orientedExtent.z }, { sphereRadius, sphereRadius, sphereRadius } };
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				simd::FloatN min = centers[0][axis] - extents[0][axis];
+				simd::FloatN max = centers[0][axis] + extents[0][axis];
+				for (int volume = 1; volume < 3; ++volume)
+				{
+					min = simd::max(min, centers[volume][axis] - extents[volume][axis]);
+					max = simd::min(max, centers[volume][axis] + extents[volume][axis]);
+				}
+				simd::store(outputs[axis], min);
+				simd::store(outputs[3 + axis], max);
+			}
+
+			const uint32_t laneCount = uint32_t(std::min<size_t>(simd::WIDTH, meshes.size() - first));
+			for (uint32_t lane = 0; lane < laneCount; ++lane)
+			{
+				outBounds[first + lane] = { { outputs[0][lane], outputs[1][lane], outputs[2][lane] }, { outputs[3][lane], outputs[4][lane], outputs[5][lane] } };
+			}
+		}
+	}
+}
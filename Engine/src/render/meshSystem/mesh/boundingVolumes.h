@@ -0,0 +1,49 @@
+#pragma once
+#include "../../../math/kDop.h"
+#include "../../../math/orientedBox.h"
+#include "../../../math/sphere.h"
+#include "../../../math/vertex.h"
+#include <cstdint>
+#include <span>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// Mesh space bounds of the vertices tighter than Mesh::boundingBox, whose transformed bounds get loose once instances are rotated:
+	// the minimal bounding sphere, an oriented box and a 14-DOP hull. From the cheapest to test to the tightest: sphere, box, hull.
+	class BoundingVolumes
+	{
+	public:
+		const static uint32_t VERSION; // part of the model cache key, bump when the output changes
+		const static uint32_t MAX_SPHERE_ITERATIONS;
+
+		// sets Mesh::boundingSphere, orientedBox and hull
+		static void build(Mesh& mesh);
+
+		// Minimal sphere (Welzl) of a support set, which starts with the extreme vertices along the hull directions and grows by the farthest
+		// vertex outside until none is left, so the result is the minimal sphere of all vertices up to rounding. The radius covers all vertices.
+		static math::Sphere computeSphere(std::span<const math::Vertex> vertices);
+
+		// The box of the smallest surface area among a few orientations: the axes, the principal axes (PCA) and the ones of the
+		// triangle spanned by the extreme vertices along the hull directions (DiTO).
+		static math::OrientedBox computeOrientedBox(std::span<const math::Vertex> vertices);
+
+		static math::KDop computeHull(std::span<const math::Vertex> vertices);
+
+		enum class Visibility
+		{
+			OUTSIDE,
+			INTERSECTING,
+			INSIDE
+		};
+
+		// Tests the mesh against mesh space planes with dot((p, 1), plane) >= 0 inside, not necessarily normalized, e.g. frustum planes.
+		// The sphere decides most planes, the box is only tested against the planes the sphere intersects.
+		static Visibility testPlanes(const Mesh& mesh, std::span<const math::Vec4f> planes);
+
+		// Axis aligned world bounds of meshes placed by meshToWorld, computed for simd::WIDTH instances at a time. Every instance gets
+		// the intersection of the bounds of its transformed boundingBox, orientedBox and boundingSphere, each of which is conservative.
+		static void computeWorldBounds(std::span<const Mesh* const> meshes, std::span<const math::Mat4f* const> meshToWorld, std::span<math::Box> outBounds);
+	};
+}
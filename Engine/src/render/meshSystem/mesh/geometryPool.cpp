@@ -0,0 +1,242 @@
+#include "geometryPool.h"
+#include "../../../utils/assert.h"
+#include "../../../utils/hash.h"
+#include <algorithm>
+
+namespace Engine
+{
+	GeometryPool* GeometryPool::s_instance = nullptr;
+
+	const uint32_t GeometryPool::MIN_VERTEX_CAPACITY = 1 << 20;
+	const uint32_t GeometryPool::MIN_INDEX_CAPACITY = 1 << 22;
+	const uint32_t GeometryPool::MIN_POSITION_CAPACITY = 1 << 20;
+
+	GeometryPool* GeometryPool::createInstance()
+	{
+		if (!s_instance)
+		{
+			s_instance = new GeometryPool();
+		}
+
+		return s_instance;
+	}
+
+	void GeometryPool::deleteInstance()
+	{
+		delete s_instance;
+
+		s_instance = nullptr;
+	}
+
+	GeometryPool* GeometryPool::getInstancePtr()
+	{
+		return s_instance;
+	}
+
+	template<typename T, size_t BufferCount>
+	RangeAllocator::Handle GeometryPool::allocate(Pool<T, BufferCount>& pool, uint32_t size, UINT bindFlags, uint32_t minCapacity)
+	{
+		RangeAllocator::Handle handle = pool.allocator.allocate(size);
+		if (handle != RangeAllocator::INVALID_HANDLE)
+		{
+			return handle;
+		}
+
+		// recreating the buffers compacts them anyway, so they only grow when the free space doesn't suffice in total
+		const uint32_t capacity = pool.allocator.getCapacity();
+		const uint32_t newCapacity = pool.allocator.getFreeSize() >= size ? capacity : std::max({ capacity * 2, pool.allocator.getUsedSize() + size, minCapacity });
+		pool.allocator.grow(newCapacity);
+		std::vector<RangeAllocator::Move> moves = pool.allocator.defragment();
+
+		// ranges before the first move kept their offsets, neighbouring moves are copied at once
+		const uint32_t keptSize = moves.empty() ? pool.allocator.getUsedSize() : moves.front().newOffset;
+		std::vector<RangeAllocator::Move> copies;
+		if (keptSize > 0)
+		{
+			copies.push_back({ RangeAllocator::INVALID_HANDLE, 0, 0, keptSize });
+		}
+		for (const auto& move : moves)
+		{
+			if (!copies.empty() && copies.back().oldOffset + copies.back().size == move.oldOffset && copies.back().newOffset + copies.back().size == move.newOffset)
+			{
+				copies.back().size += move.size;
+			}
+			else
+			{
+				copies.push_back(move);
+			}
+		}
+
+		auto* device = D3D::getInstancePtr()->getDevice();
+		auto* devcon = D3D::getInstancePtr()->getDeviceContext();
+		for (auto& buffer : pool.buffers)
+		{
+			Buffer<T> newBuffer;
+			newBuffer.createDefaultBuffer(int(newCapacity), bindFlags, device);
+			for (const auto& copy : copies)
+			{
+				newBuffer.copyFrom(devcon, buffer, int(copy.oldOffset), int(copy.newOffset), int(copy.size));
+			}
+			buffer = std::move(newBuffer);
+		}
+		++m_reallocationCount;
+
+		handle = pool.allocator.allocate(size);
+		DEV_ASSERT(handle != RangeAllocator::INVALID_HANDLE);
+		return handle;
+	}
+
+	Model::GeometryAllocation GeometryPool::allocate(std::span<const Model::GPUVertex> vertices, std::span<const unsigned int> indices,
+		std::span<const math::Vec3f> positions, std::span<const unsigned int> positionIndices)
+	{
+		DEV_ASSERT(positions.empty() == positionIndices.empty() && (positionIndices.empty() || positionIndices.size() == indices.size()));
+
+		auto* devcon = D3D::getInstancePtr()->getDeviceContext();
+		Model::GeometryAllocation allocation;
+
+		if (!vertices.empty())
+		{
+			allocation.vertices = allocate(m_vertices, uint32_t(vertices.size()), D3D11_BIND_VERTEX_BUFFER, MIN_VERTEX_CAPACITY);
+			m_vertices.buffers[0].update(devcon, int(getVertexOffset(allocation)), int(vertices.size()), vertices.data());
+		}
+		if (!indices.empty())
+		{
+			allocation.indices = allocate(m_indices, uint32_t(indices.size()), D3D11_BIND_INDEX_BUFFER, MIN_INDEX_CAPACITY);
+			m_indices.buffers[0].update(devcon, int(getIndexOffset(allocation)), int(indices.size()), indices.data());
+		}
+		if (!positions.empty())
+		{
+			allocation.positions = allocate(m_positions, uint32_t(positions.size()), D3D11_BIND_VERTEX_BUFFER, MIN_POSITION_CAPACITY);
+			m_positions.buffers[0].update(devcon, int(getPositionOffset(allocation)), int(positions.size()), positions.data());
+			m_indices.buffers[1].update(devcon, int(getIndexOffset(allocation)), int(positionIndices.size()), positionIndices.data());
+		}
+
+		return allocation;
+	}
+
+	std::shared_ptr<const Model::GeometryAllocation> GeometryPool::allocateShared(uint64_t contentHash, std::span<const Model::GPUVertex> vertices,
+		std::span<const unsigned int> indices, std::span<const math::Vec3f> positions, std::span<const unsigned int> positionIndices)
+	{
+		uint64_t key = mixHash(mixHash(contentHash, vertices.size()), indices.size());
+		key = mixHash(mixHash(key, positions.size()), positionIndices.size());
+
+		auto [iter, inserted] = m_sharedAllocations.try_emplace(key);
+		if (!inserted)
+		{
+			if (auto allocation = iter->second.allocation.lock())
+			{
+				const SharedAllocation& shared = iter->second;
+				const bool isEqual = std::equal(vertices.begin(), vertices.end(), shared.positions.begin(), shared.positions.end(),
+						[](const Model::GPUVertex& vertex, const math::Vec3f& position) { return vertex.position == position; }) &&
+					std::equal(indices.begin(), indices.end(), shared.indices.begin(), shared.indices.end());
+				if (isEqual)
+				{
+					return allocation;
+				}
+
+				// a hash collision, the registered allocation stays and this one isn't shared
+				return std::make_shared<const Model::GeometryAllocation>(allocate(vertices, indices, positions, positionIndices));
+			}
+		}
+
+		// the deleter runs when the last mesh referencing the ranges goes away, the ranges are freed by the destructor of the allocation
+		std::shared_ptr<const Model::GeometryAllocation> allocation(new Model::GeometryAllocation(allocate(vertices, indices, positions, positionIndices)),
+			[key](const Model::GeometryAllocation* allocation)
+			{
+				if (GeometryPool* pool = GeometryPool::getInstancePtr())
+				{
+					auto iter = pool->m_sharedAllocations.find(key);
+					if (iter != pool->m_sharedAllocations.end() && iter->second.allocation.expired())
+					{
+						pool->m_sharedAllocations.erase(iter);
+					}
+				}
+				delete allocation;
+			});
+
+		SharedAllocation& shared = iter->second;
+		shared.allocation = allocation;
+		shared.size = vertices.size_bytes() + indices.size_bytes() + positions.size_bytes() + positionIndices.size_bytes();
+		shared.positions.resize(vertices.size());
+		std::transform(vertices.begin(), vertices.end(), shared.positions.begin(), [](const Model::GPUVertex& vertex) { return vertex.position; });
+		shared.indices.assign(indices.begin(), indices.end());
+		return allocation;
+	}
+
+	void GeometryPool::free(Model::GeometryAllocation& allocation)
+	{
+		if (allocation.vertices != RangeAllocator::INVALID_HANDLE)
+		{
+			m_vertices.allocator.free(allocation.vertices);
+		}
+		if (allocation.indices != RangeAllocator::INVALID_HANDLE)
+		{
+			m_indices.allocator.free(allocation.indices);
+		}
+		if (allocation.positions != RangeAllocator::INVALID_HANDLE)
+		{
+			m_positions.allocator.free(allocation.positions);
+		}
+
+		allocation.vertices = allocation.indices = allocation.positions = RangeAllocator::INVALID_HANDLE;
+	}
+
+	uint32_t GeometryPool::getVertexOffset(const Model::GeometryAllocation& allocation) const
+	{
+		return allocation.vertices != RangeAllocator::INVALID_HANDLE ? m_vertices.allocator.getOffset(allocation.vertices) : 0;
+	}
+
+	uint32_t GeometryPool::getIndexOffset(const Model::GeometryAllocation& allocation) const
+	{
+		return allocation.indices != RangeAllocator::INVALID_HANDLE ? m_indices.allocator.getOffset(allocation.indices) : 0;
+	}
+
+	uint32_t GeometryPool::getPositionOffset(const Model::GeometryAllocation& allocation) const
+	{
+		return allocation.positions != RangeAllocator::INVALID_HANDLE ? m_positions.allocator.getOffset(allocation.positions) : 0;
+	}
+
+	void GeometryPool::setBuffersForIA(ID3D11DeviceContext4* devcon)
+	{
+		m_vertices.buffers[0].setVertexBufferForInputAssembler(devcon);
+		m_indices.buffers[0].setIndexBufferForInputAssembler(devcon);
+	}
+
+	void GeometryPool::setPositionBuffersForIA(ID3D11DeviceContext4* devcon)
+	{
+		m_positions.buffers[0].setVertexBufferForInputAssembler(devcon);
+		m_indices.buffers[1].setIndexBufferForInputAssembler(devcon);
+	}
+
+	void GeometryPool::setVertexBufferForIA(ID3D11DeviceContext4* devcon, const Model::GeometryAllocation& allocation)
+	{
+		m_vertices.buffers[0].setVertexBufferForInputAssembler(devcon, 0, int(getVertexOffset(allocation)));
+	}
+
+	void GeometryPool::setIndexBufferForIA(ID3D11DeviceContext4* devcon, const Model::GeometryAllocation& allocation)
+	{
+		m_indices.buffers[0].setIndexBufferForInputAssembler(devcon, int(getIndexOffset(allocation)));
+	}
+
+	GeometryPool::Stats GeometryPool::getStats() const
+	{
+		Stats stats =
+		{
+			m_vertices.allocator.getCapacity(), m_vertices.allocator.getUsedSize(),
+			m_indices.allocator.getCapacity(), m_indices.allocator.getUsedSize(),
+			m_positions.allocator.getCapacity(), m_positions.allocator.getUsedSize(),
+			m_reallocationCount, 0, 0
+		};
+
+		for (const auto& [key, shared] : m_sharedAllocations)
+		{
+			const long referenceCount = shared.allocation.use_count();
+			if (referenceCount > 1)
+			{
+				stats.sharedReferenceCount += uint32_t(referenceCount - 1);
+				stats.sharedBytes += uint64_t(referenceCount - 1) * shared.size;
+			}
+		}
+		return stats;
+	}
+}
@@ -0,0 +1,99 @@
+#pragma once
+#include "model.h"
+#include "../../../utils/allocators/rangeAllocator.h"
+#include "../../../utils/nonCopyable.h"
+#include <array>
+#include <span>
+#include <unordered_map>
+
+namespace Engine
+{
+	// Vertex and index buffers shared by all models, so passes bind them once instead of once per model.
+	// Every model gets ranges of them from a RangeAllocator. When a range doesn't fit, the buffers are recreated, compacted and grown
+	// if compacting isn't enough, and the ranges of all models are copied over on the GPU. Offsets of models change then,
+	// which is why draws ask for them every time (Model::getDrawRange). Render thread only.
+	class GeometryPool
+		: public NonCopyable
+	{
+	public:
+		static GeometryPool* createInstance();
+		static void deleteInstance();
+		static GeometryPool* getInstancePtr();
+
+		// initial sizes of the buffers in elements, they are created with the first model
+		const static uint32_t MIN_VERTEX_CAPACITY;
+		const static uint32_t MIN_INDEX_CAPACITY;
+		const static uint32_t MIN_POSITION_CAPACITY;
+
+		// Uploads the arrays of a mesh, empty ones get no range. Position indices share the range of the indices,
+		// so they either match them in size or are left empty together with the positions.
+		Model::GeometryAllocation allocate(std::span<const Model::GPUVertex> vertices, std::span<const unsigned int> indices,
+			std::span<const math::Vec3f> positions, std::span<const unsigned int> positionIndices);
+		void free(Model::GeometryAllocation& allocation);
+
+		// Same as allocate, but returns the ranges uploaded earlier for arrays of the same contentHash and sizes as long as they are referenced,
+		// e.g. of a sub-mesh repeated across the models of an asset pack. The vertex positions and indices are compared as well before sharing,
+		// arrays that only collide in their hash get ranges of their own.
+		std::shared_ptr<const Model::GeometryAllocation> allocateShared(uint64_t contentHash, std::span<const Model::GPUVertex> vertices, std::span<const unsigned int> indices,
+			std::span<const math::Vec3f> positions, std::span<const unsigned int> positionIndices);
+
+		// first elements of the ranges of an allocation, 0 for the arrays it has no range of
+		uint32_t getVertexOffset(const Model::GeometryAllocation& allocation) const;
+		uint32_t getIndexOffset(const Model::GeometryAllocation& allocation) const;
+		uint32_t getPositionOffset(const Model::GeometryAllocation& allocation) const;
+
+		// the whole buffers, for draws with the offsets of Model::getDrawRange
+		void setBuffersForIA(ID3D11DeviceContext4* devcon);
+		void setPositionBuffersForIA(ID3D11DeviceContext4* devcon);
+
+		// the ranges of one allocation, for draws with offsets relative to it
+		void setVertexBufferForIA(ID3D11DeviceContext4* devcon, const Model::GeometryAllocation& allocation);
+		void setIndexBufferForIA(ID3D11DeviceContext4* devcon, const Model::GeometryAllocation& allocation);
+
+		struct Stats
+		{
+			uint32_t vertexCapacity;
+			uint32_t vertexCount;
+			uint32_t indexCapacity;
+			uint32_t indexCount;
+			uint32_t positionCapacity;
+			uint32_t positionCount;
+			uint32_t reallocationCount; // times the buffers were recreated
+			uint32_t sharedReferenceCount; // references to shared allocations besides the first one of each
+			uint64_t sharedBytes; // bytes the references would take with their own ranges
+		};
+		Stats getStats() const;
+
+	private:
+		GeometryPool() = default;
+		static GeometryPool* s_instance;
+
+		// a RangeAllocator and the buffers it suballocates, indices and position indices share one
+		template<typename T, size_t BufferCount>
+		struct Pool
+		{
+			RangeAllocator allocator;
+			std::array<Buffer<T>, BufferCount> buffers;
+		};
+
+		Pool<Model::GPUVertex, 1> m_vertices;
+		Pool<unsigned int, 2> m_indices;
+		Pool<math::Vec3f, 1> m_positions;
+		uint32_t m_reallocationCount = 0;
+
+		// allocations of allocateShared by their content, entries are erased when the last reference goes away
+		struct SharedAllocation
+		{
+			std::weak_ptr<const Model::GeometryAllocation> allocation;
+			uint64_t size; // bytes
+
+			// copies of the uploaded arrays compared against on a hash match, the GPU ranges can't be read back
+			std::vector<math::Vec3f> positions;
+			std::vector<unsigned int> indices;
+		};
+		std::unordered_map<uint64_t, SharedAllocation> m_sharedAllocations;
+
+		template<typename T, size_t BufferCount>
+		RangeAllocator::Handle allocate(Pool<T, BufferCount>& pool, uint32_t size, UINT bindFlags, uint32_t minCapacity);
+	};
+}
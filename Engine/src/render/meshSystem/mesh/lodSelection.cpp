@@ -0,0 +1,30 @@
+#include "lodSelection.h"
+#include <algorithm>
+#include <limits>
+
+namespace Engine
+{
+	const float LodSelection::MAX_SCREEN_ERROR = 1.0f / 1080.0f; // about a pixel at 1080p
+	const int LodSelection::SHADOW_BIAS = 1;
+
+	float LodSelection::getProjectedSize(const math::Vec3f& center, float radius, const math::Vec3f& cameraPosition, float projectionScale)
+	{
+		float distance = (center - cameraPosition).norm();
+		if (distance <= radius)
+		{
+			return std::numeric_limits<float>::infinity();
+		}
+		return 2.0f * radius * projectionScale / distance;
+	}
+
+	uint32_t LodSelection::selectLod(float projectedSize, std::span<const float> lodErrors, int bias)
+	{
+		// the error of a LOD covers lodError * radius of the sphere, which is projectedSize / 2 on screen
+		int lod = 0;
+		while (lod < int(lodErrors.size()) && lodErrors[lod] * projectedSize * 0.5f <= MAX_SCREEN_ERROR)
+		{
+			++lod;
+		}
+		return uint32_t(std::clamp(lod + bias, 0, int(lodErrors.size())));
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include "../../../math/mathUtils.h"
+#include <cstdint>
+#include <span>
+
+namespace Engine
+{
+	// Picks the LOD of an instance from the size of its bounding sphere on screen. Depends only on its arguments,
+	// so the selection is deterministic and can be checked on the CPU without a device.
+	struct LodSelection
+	{
+		static constexpr uint32_t MAX_LOD_COUNT = 5; // including the full resolution mesh
+		const static float MAX_SCREEN_ERROR; // geometric error allowed on screen in fractions of its height
+		// Shadow passes use coarser LODs by this many levels. Their sizes are still the ones seen from the main camera, not from the light:
+		// instances close to a light but far from the camera may get too coarse a LOD in its shadow map, and the other way round.
+		const static int SHADOW_BIAS;
+
+		// Diameter of the sphere on screen in fractions of the screen height, projectionScale is Camera::getProj()(1, 1).
+		// Returns infinity if the camera is inside the sphere.
+		static float getProjectedSize(const math::Vec3f& center, float radius, const math::Vec3f& cameraPosition, float projectionScale);
+
+		// lodErrors are the errors of LOD 1 and coarser relative to the bounding sphere radius, non decreasing (see Mesh::Lod).
+		// Picks the coarsest LOD whose error stays below MAX_SCREEN_ERROR, then adds bias. The result never decreases with decreasing size.
+		static uint32_t selectLod(float projectedSize, std::span<const float> lodErrors, int bias);
+	};
+}
@@ -14,8 +14,13 @@ namespace Engine
 		}
 	}
 
-	void Mesh::initializeOctree()
+	void Mesh::initializeBVH(TriangleBVH::Layout layout)
 	{
-		octree.initialize(*this);
+		bvh.initialize(*this, layout);
+	}
+
+	void Mesh::initializeBVH(ParallelExecutor& executor, TriangleBVH::Layout layout)
+	{
+		bvh.initialize(*this, executor, layout);
 	}
 }
\ No newline at end of file
@@ -1,8 +1,11 @@
 #pragma once
 #include "../../math/triangle.h"
 #include "../../math/box.h"
+#include "../../math/kDop.h"
+#include "../../math/orientedBox.h"
+#include "../../math/sphere.h"
 #include <vector>
-#include "triangleOctree.h"
+#include "triangleBVH.h"
 
 namespace Engine
 {
@@ -13,17 +16,51 @@ namespace Engine
 			: triangles(triangles)
 		{}
 
+		// Simplified versions of triangles sharing their vertices, from the finest to the coarsest. Only used for drawing,
+		// picking and the BVH use the full resolution triangles.
+		struct Lod
+		{
+			std::vector<uint32_t> indices;
+			float error; // estimated distance of the simplified surface from the original one, relative to the bounding box radius
+		};
+
+		// Cluster of nearby triangles, a contiguous range of triangles (see MeshletBuilder), culled on its own by MeshletCulling
+		struct Meshlet
+		{
+			uint32_t triangleOffset;
+			uint32_t triangleCount;
+			uint32_t vertexCount; // unique vertices referenced by the triangles
+
+			// bounding sphere
+			math::Vec3f center;
+			float radius;
+
+			// all triangles face away from points p with dot(normalize(coneApex - p), coneAxis) >= coneCutoff, never if coneCutoff > 1
+			math::Vec3f coneApex;
+			math::Vec3f coneAxis;
+			float coneCutoff;
+		};
+
 		std::string name;
 
 		std::vector<math::Vertex> vertices;
 		std::vector<math::Triangle> triangles;
 		std::vector<math::Mat4f> instances;
 		std::vector<math::Mat4f> instancesInv;
+		std::vector<Lod> lods;
+		std::vector<Meshlet> meshlets;
 
 		math::Box boundingBox;
-		TriangleOctree octree;
+
+		// tighter than boundingBox for rotated instances, see BoundingVolumes
+		math::Sphere boundingSphere;
+		math::OrientedBox orientedBox;
+		math::KDop hull;
+
+		TriangleBVH bvh;
 
 		void createBoundingBox();
-		void initializeOctree();
+		void initializeBVH(TriangleBVH::Layout layout = TriangleBVH::Layout::BINARY);
+		void initializeBVH(ParallelExecutor& executor, TriangleBVH::Layout layout = TriangleBVH::Layout::BINARY);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,431 @@
+#include "meshOptimizer.h"
+#include "mesh.h"
+#include <algorithm>
+
+namespace Engine
+{
+	const uint32_t MeshOptimizer::VERSION = 1;
+	const uint32_t MeshOptimizer::CACHE_SIZE = 16;
+	const float MeshOptimizer::OVERDRAW_THRESHOLD = 1.05f;
+	const uint32_t MeshOptimizer::FETCH_LINE_SIZE = 64;
+	const uint32_t MeshOptimizer::FETCH_CACHE_LINES = 256;
+
+	namespace
+	{
+		// FIFO cache of entry indices, an entry is cached if it was inserted less than size misses ago
+		struct FifoCache
+		{
+			std::vector<uint32_t> timestamps;
+			uint32_t time;
+			uint32_t size;
+
+			FifoCache(uint32_t entryCount, uint32_t size)
+				: timestamps(entryCount, 0), time(size + 1), size(size)
+			{
+			}
+
+			bool isCached(uint32_t entry) const
+			{
+				return time - timestamps[entry] <= size;
+			}
+
+			// returns true on a miss
+			bool access(uint32_t entry)
+			{
+				if (isCached(entry))
+				{
+					return false;
+				}
+				timestamps[entry] = time++;
+				return true;
+			}
+
+			void flush()
+			{
+				time += size + 1;
+			}
+		};
+	}
+
+	void MeshOptimizer::optimize(Mesh& mesh)
+	{
+		const uint32_t triangleCount = uint32_t(mesh.triangles.size());
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> indices(triangleCount * 3);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				indices[t * 3 + k] = uint32_t(mesh.triangles[t].vertexIndices[k]);
+			}
+		}
+
+		std::vector<uint32_t> clusters;
+		std::vector<uint32_t> order = optimizeVertexCache(indices, vertexCount, clusters);
+		order = optimizeOverdraw(mesh, indices, order, clusters);
+
+		std::vector<math::Triangle> triangles(triangleCount);
+		std::vector<uint32_t> orderedIndices(triangleCount * 3);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			triangles[t] = mesh.triangles[order[t]];
+			for (int k = 0; k < 3; ++k)
+			{
+				orderedIndices[t * 3 + k] = indices[order[t] * 3 + k];
+			}
+		}
+
+		std::vector<uint32_t> remap;
+		optimizeVertexFetch(orderedIndices, vertexCount, remap);
+
+		std::vector<math::Vertex> vertices(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			vertices[remap[v]] = mesh.vertices[v];
+		}
+		mesh.vertices = std::move(vertices);
+
+		for (auto& triangle : triangles)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				triangle.vertexIndices[k] = int(remap[triangle.vertexIndices[k]]);
+			}
+			triangle.verticesArray = mesh.vertices.data();
+		}
+		mesh.triangles = std::move(triangles);
+	}
+
+	MeshOptimizer::Stats MeshOptimizer::analyze(const Mesh& mesh, uint32_t vertexStride)
+	{
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		if (mesh.triangles.empty() || vertexStride == 0)
+		{
+			return {};
+		}
+
+		FifoCache vertexCache(vertexCount, CACHE_SIZE);
+		FifoCache lineCache(uint32_t((uint64_t(vertexCount) * vertexStride + FETCH_LINE_SIZE - 1) / FETCH_LINE_SIZE), FETCH_CACHE_LINES);
+		std::vector<uint8_t> referenced(vertexCount, 0);
+
+		uint32_t misses = 0;
+		uint32_t fetchedLines = 0;
+		uint32_t referencedCount = 0;
+		for (const auto& triangle : mesh.triangles)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				uint32_t vertex = uint32_t(triangle.vertexIndices[k]);
+				if (!referenced[vertex])
+				{
+					referenced[vertex] = 1;
+					++referencedCount;
+				}
+
+				// only vertices missing the post-transform cache are shaded and fetch their data
+				if (vertexCache.access(vertex))
+				{
+					++misses;
+
+					uint64_t begin = uint64_t(vertex) * vertexStride;
+					for (uint64_t line = begin / FETCH_LINE_SIZE; line <= (begin + vertexStride - 1) / FETCH_LINE_SIZE; ++line)
+					{
+						fetchedLines += lineCache.access(uint32_t(line));
+					}
+				}
+			}
+		}
+
+		Stats stats;
+		stats.acmr = float(misses) / float(mesh.triangles.size());
+		stats.atvr = float(misses) / float(referencedCount);
+		stats.overfetch = float(uint64_t(fetchedLines) * FETCH_LINE_SIZE) / float(uint64_t(referencedCount) * vertexStride);
+		return stats;
+	}
+
+	void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		std::vector<uint32_t> clusters;
+		std::vector<uint32_t> order = optimizeVertexCache(indices, vertexCount, clusters);
+
+		std::vector<uint32_t> orderedIndices(triangleCount * 3);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			std::copy_n(indices.begin() + order[t] * 3, 3, orderedIndices.begin() + t * 3);
+		}
+		indices = std::move(orderedIndices);
+	}
+
+	std::vector<uint32_t> MeshOptimizer::optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& outClusters)
+	{
+		const uint32_t triangleCount = uint32_t(indices.size() / 3);
+
+		// triangles using every vertex
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (uint32_t index : indices)
+		{
+			++adjacencyOffsets[index + 1];
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		std::vector<uint32_t> adjacency(indices.size());
+		std::vector<uint32_t> adjacencyFill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t i = 0; i < indices.size(); ++i)
+		{
+			adjacency[adjacencyFill[indices[i]]++] = i / 3;
+		}
+
+		// number of triangles of every vertex still to be emitted
+		std::vector<uint32_t> live(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			live[v] = adjacencyOffsets[v + 1] - adjacencyOffsets[v];
+		}
+
+		FifoCache cache(vertexCount, CACHE_SIZE);
+		std::vector<uint8_t> emitted(triangleCount, 0);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+
+		std::vector<uint32_t> order;
+		order.reserve(triangleCount);
+		outClusters.clear();
+
+		uint32_t scanCursor = 0;
+		uint32_t fanning = indices.empty() ? 0 : indices[0];
+		bool startsCluster = true;
+		while (order.size() < triangleCount)
+		{
+			// emit all remaining triangles around the fanning vertex
+			candidates.clear();
+			for (uint32_t a = adjacencyOffsets[fanning]; a < adjacencyOffsets[fanning + 1]; ++a)
+			{
+				uint32_t triangle = adjacency[a];
+				if (emitted[triangle])
+				{
+					continue;
+				}
+
+				if (startsCluster)
+				{
+					outClusters.push_back(uint32_t(order.size()));
+					startsCluster = false;
+				}
+
+				emitted[triangle] = 1;
+				order.push_back(triangle);
+				for (int k = 0; k < 3; ++k)
+				{
+					uint32_t vertex = indices[triangle * 3 + k];
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					--live[vertex];
+					cache.access(vertex);
+				}
+			}
+
+			// Continue with the candidate which entered the cache earliest but still stays in it while its remaining triangles are emitted.
+			int next = -1;
+			uint32_t bestPriority = 0;
+			for (uint32_t vertex : candidates)
+			{
+				if (live[vertex] == 0)
+				{
+					continue;
+				}
+
+				uint32_t age = cache.time - cache.timestamps[vertex];
+				uint32_t priority = age + 2 * live[vertex] <= CACHE_SIZE ? age : 0;
+				if (priority > bestPriority)
+				{
+					bestPriority = priority;
+					next = int(vertex);
+				}
+			}
+
+			// dead end, fall back to recently used vertices and then to the input order
+			if (next < 0)
+			{
+				while (!deadEnd.empty() && next < 0)
+				{
+					uint32_t vertex = deadEnd.back();
+					deadEnd.pop_back();
+					if (live[vertex] > 0)
+					{
+						next = int(vertex);
+					}
+				}
+				for (; next < 0 && scanCursor < vertexCount; ++scanCursor)
+				{
+					if (live[scanCursor] > 0)
+					{
+						next = int(scanCursor);
+					}
+				}
+				if (next < 0)
+				{
+					break;
+				}
+
+				// the jump only breaks the locality if the new vertex isn't cached any more
+				startsCluster = !cache.isCached(uint32_t(next));
+			}
+
+			fanning = uint32_t(next);
+		}
+
+		return order;
+	}
+
+	std::vector<uint32_t> MeshOptimizer::optimizeOverdraw(const Mesh& mesh, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& order, const std::vector<uint32_t>& clusters)
+	{
+		const uint32_t triangleCount = uint32_t(order.size());
+		FifoCache cache(uint32_t(mesh.vertices.size()), CACHE_SIZE);
+
+		auto countMisses = [&cache, &indices](uint32_t triangle)
+		{
+			return uint32_t(cache.access(indices[triangle * 3])) + cache.access(indices[triangle * 3 + 1]) + cache.access(indices[triangle * 3 + 2]);
+		};
+
+		// Smaller clusters sort better, but splitting costs cache misses. A cluster is split as soon as its part so far
+		// reaches nearly the ACMR of the whole, which then costs only a few extra misses (Sander et al. 2007).
+		std::vector<uint32_t> boundaries;
+		for (size_t c = 0; c < clusters.size(); ++c)
+		{
+			const uint32_t begin = clusters[c];
+			const uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+			cache.flush();
+			uint32_t clusterMisses = 0;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				clusterMisses += countMisses(order[i]);
+			}
+			const float threshold = OVERDRAW_THRESHOLD * float(clusterMisses) / float(end - begin);
+
+			boundaries.push_back(begin);
+			cache.flush();
+			uint32_t runningMisses = 0;
+			uint32_t runningTriangles = 0;
+			for (uint32_t i = begin; i < end; ++i)
+			{
+				runningMisses += countMisses(order[i]);
+				++runningTriangles;
+
+				if (float(runningMisses) / float(runningTriangles) <= threshold)
+				{
+					boundaries.push_back(i + 1);
+					cache.flush();
+					runningMisses = 0;
+					runningTriangles = 0;
+				}
+			}
+			if (boundaries.back() == end)
+			{
+				boundaries.pop_back();
+			}
+		}
+
+		struct Cluster
+		{
+			uint32_t begin;
+			uint32_t end;
+			float key;
+		};
+		std::vector<Cluster> sorted(boundaries.size());
+		std::vector<math::Vec3f> clusterCentroids(boundaries.size());
+		std::vector<math::Vec3f> clusterNormals(boundaries.size());
+
+		math::Vec3f meshCentroid = math::Vec3f::Zero();
+		float meshArea = 0.0f;
+		for (size_t c = 0; c < boundaries.size(); ++c)
+		{
+			Cluster& cluster = sorted[c];
+			cluster.begin = boundaries[c];
+			cluster.end = c + 1 < boundaries.size() ? boundaries[c + 1] : triangleCount;
+
+			math::Vec3f centroid = math::Vec3f::Zero();
+			math::Vec3f normal = math::Vec3f::Zero();
+			float area = 0.0f;
+			for (uint32_t i = cluster.begin; i < cluster.end; ++i)
+			{
+				const uint32_t triangle = order[i];
+				const math::Vec3f& p0 = mesh.vertices[indices[triangle * 3]].position;
+				const math::Vec3f& p1 = mesh.vertices[indices[triangle * 3 + 1]].position;
+				const math::Vec3f& p2 = mesh.vertices[indices[triangle * 3 + 2]].position;
+
+				// front faces are clockwise in the left-handed space, so this points out of the visible side
+				// (opposite to Triangle::computeNormalVector), the length is twice the area
+				math::Vec3f triangleNormal = (p1 - p0).cross(p2 - p0);
+				float triangleArea = triangleNormal.norm();
+
+				centroid += (p0 + p1 + p2) * (triangleArea / 3.0f);
+				normal += triangleNormal;
+				area += triangleArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+
+			clusterCentroids[c] = area > 0.0f ? math::Vec3f(centroid / area) : math::Vec3f(mesh.vertices[indices[order[cluster.begin] * 3]].position);
+			clusterNormals[c] = normal.squaredNorm() > 0.0f ? math::Vec3f(normal.normalized()) : math::Vec3f::Zero();
+		}
+		if (meshArea > 0.0f)
+		{
+			meshCentroid /= meshArea;
+		}
+
+		// clusters on the outside facing away from the center occlude more of the mesh than they are occluded by, so they are drawn first
+		for (size_t c = 0; c < sorted.size(); ++c)
+		{
+			sorted[c].key = (clusterCentroids[c] - meshCentroid).dot(clusterNormals[c]);
+		}
+		std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b)
+		{
+			return a.key > b.key;
+		});
+
+		std::vector<uint32_t> result;
+		result.reserve(triangleCount);
+		for (const Cluster& cluster : sorted)
+		{
+			result.insert(result.end(), order.begin() + cluster.begin, order.begin() + cluster.end);
+		}
+		return result;
+	}
+
+	void MeshOptimizer::optimizeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& outRemap)
+	{
+		const uint32_t UNUSED = ~0u;
+		outRemap.assign(vertexCount, UNUSED);
+
+		uint32_t next = 0;
+		for (uint32_t index : indices)
+		{
+			if (outRemap[index] == UNUSED)
+			{
+				outRemap[index] = next++;
+			}
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			if (outRemap[v] == UNUSED)
+			{
+				outRemap[v] = next++;
+			}
+		}
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// Reorders mesh triangles and vertices for the GPU, so every pass drawing the index buffer (shadows, GBuffer, forward) gets cheaper:
+	// Tipsify (Sander et al. 2007) orders triangles for the post-transform vertex cache, the resulting clusters are sorted
+	// so that outward facing ones are drawn first to reduce overdraw, and vertices are renumbered in the order of their first use.
+	class MeshOptimizer
+	{
+	public:
+		const static uint32_t VERSION; // part of the model cache key, bump when the output order changes
+		const static uint32_t CACHE_SIZE; // simulated FIFO post-transform cache, in vertices
+		const static float OVERDRAW_THRESHOLD; // clusters are split once their ACMR reaches this much of the ACMR of the whole Tipsify cluster
+		const static uint32_t FETCH_LINE_SIZE; // bytes
+		const static uint32_t FETCH_CACHE_LINES;
+
+		// Efficiency of drawing a mesh, simulated with FIFO caches.
+		struct Stats
+		{
+			float acmr; // post-transform cache misses per triangle, 0.5 at best, 3 at worst
+			float atvr; // misses per referenced vertex, 1 at best
+			float overfetch; // vertex buffer bytes fetched per referenced byte, 1 at best
+		};
+
+		// Triangles keep their normals and verticesArray is updated, the mesh BVH has to be built afterwards.
+		// Unreferenced vertices are kept at the end.
+		static void optimize(Mesh& mesh);
+
+		// vertexStride is the size of a vertex in the GPU buffer, see Model::GPUVertex
+		static Stats analyze(const Mesh& mesh, uint32_t vertexStride);
+
+		// Reorders the triangles of an index list for the post-transform cache only, e.g. for LODs sharing the vertices of a mesh
+		static void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount);
+
+	private:
+		// returns the new triangle order and the first triangle of every cluster of it in outClusters
+		static std::vector<uint32_t> optimizeVertexCache(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& outClusters);
+
+		// splits the clusters further and returns the triangle order with outward facing clusters first
+		static std::vector<uint32_t> optimizeOverdraw(const Mesh& mesh, const std::vector<uint32_t>& indices, const std::vector<uint32_t>& order, const std::vector<uint32_t>& clusters);
+
+		// renumbers vertices in the order of their first use, writing the new index of every old vertex to outRemap
+		static void optimizeVertexFetch(const std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& outRemap);
+	};
+}
@@ -0,0 +1,345 @@
+#include "meshProcessing.h"
+#include "mesh.h"
+#include "../../../utils/parallelExecutor.h"
+#include "../../../utils/hash.h"
+#include "../../../utils/assert.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <unordered_map>
+
+namespace Engine
+{
+	const uint32_t MeshProcessing::PARALLEL_CHUNK_SIZE = 16 * 1024;
+
+	namespace
+	{
+		const uint32_t NONE = ~0u;
+
+		// Calls func(begin, end) for PARALLEL_CHUNK_SIZE long chunks of [0, count), on the calling thread without an executor.
+		template<typename Func>
+		void forEachChunk(ParallelExecutor* executor, uint32_t count, const Func& func)
+		{
+			const uint32_t chunkCount = (count + MeshProcessing::PARALLEL_CHUNK_SIZE - 1) / MeshProcessing::PARALLEL_CHUNK_SIZE;
+			if (!executor || chunkCount <= 1)
+			{
+				func(0u, count);
+				return;
+			}
+
+			executor->execute([count, &func](uint32_t threadIndex, uint32_t chunk)
+			{
+				uint32_t begin = chunk * MeshProcessing::PARALLEL_CHUNK_SIZE;
+				func(begin, std::min(begin + MeshProcessing::PARALLEL_CHUNK_SIZE, count));
+			}, chunkCount, 1);
+		}
+
+		// Corners (triangle * 3 + corner) around every vertex, or around the first vertex of every position group if groups are given.
+		void buildCornerAdjacency(const Mesh& mesh, const std::vector<uint32_t>* groups, std::vector<uint32_t>& outOffsets, std::vector<uint32_t>& outCorners)
+		{
+			const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+			auto getKey = [groups](int vertex)
+			{
+				return groups ? (*groups)[vertex] : uint32_t(vertex);
+			};
+
+			outOffsets.assign(vertexCount + 1, 0);
+			for (const auto& triangle : mesh.triangles)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					++outOffsets[getKey(triangle.vertexIndices[k]) + 1];
+				}
+			}
+			for (uint32_t v = 0; v < vertexCount; ++v)
+			{
+				outOffsets[v + 1] += outOffsets[v];
+			}
+
+			outCorners.resize(mesh.triangles.size() * 3);
+			std::vector<uint32_t> fill(outOffsets.begin(), outOffsets.end() - 1);
+			for (uint32_t t = 0; t < mesh.triangles.size(); ++t)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					outCorners[fill[getKey(mesh.triangles[t].vertexIndices[k])]++] = t * 3 + k;
+				}
+			}
+		}
+
+		// front faces are clockwise in the left-handed space, so this points out of the visible side, the length is twice the area
+		math::Vec3f getFrontFaceNormal(const Mesh& mesh, const math::Triangle& triangle)
+		{
+			const math::Vec3f& p0 = mesh.vertices[triangle.vertexIndices[0]].position;
+			return (mesh.vertices[triangle.vertexIndices[1]].position - p0).cross(mesh.vertices[triangle.vertexIndices[2]].position - p0);
+		}
+
+		math::Vec3f getAnyPerpendicular(const math::Vec3f& normal)
+		{
+			math::Vec3f axis = std::abs(normal.x()) < 0.9f ? math::Vec3f(1.0f, 0.0f, 0.0f) : math::Vec3f(0.0f, 1.0f, 0.0f);
+			return normal.cross(axis).normalized();
+		}
+
+		bool haveSameAttributes(const math::Vertex& a, const math::Vertex& b)
+		{
+			return a.color == b.color && a.textureCoordinates == b.textureCoordinates && a.normal == b.normal && a.tangent == b.tangent && a.bitangent == b.bitangent;
+		}
+	}
+
+	std::vector<uint32_t> MeshProcessing::findPositionGroups(const Mesh& mesh, float epsilon)
+	{
+		DEV_ASSERT(epsilon > 0.0f);
+
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		const float inverseCellSize = 1.0f / epsilon;
+		const float squaredEpsilon = epsilon * epsilon;
+
+		// first vertices of groups by grid cell, chained through nextInCell, a neighbour of a vertex within epsilon is at most one cell away.
+		// Cells are keyed by hash, colliding cells only share a chain.
+		std::unordered_map<uint64_t, uint32_t> cellHeads;
+		cellHeads.reserve(vertexCount);
+		std::vector<uint32_t> nextInCell(vertexCount, NONE);
+		auto getCellKey = [](int64_t x, int64_t y, int64_t z)
+		{
+			return mixHash(mixHash(uint64_t(x), uint64_t(y)), uint64_t(z));
+		};
+
+		std::vector<uint32_t> groups(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			const math::Vec3f& position = mesh.vertices[v].position;
+			groups[v] = v;
+			if (!position.allFinite())
+			{
+				continue;
+			}
+
+			const int64_t cell[3] = { int64_t(std::floor(position.x() * inverseCellSize)), int64_t(std::floor(position.y() * inverseCellSize)), int64_t(std::floor(position.z() * inverseCellSize)) };
+			for (int i = 0; i < 27 && groups[v] == v; ++i)
+			{
+				auto head = cellHeads.find(getCellKey(cell[0] + i % 3 - 1, cell[1] + i / 3 % 3 - 1, cell[2] + i / 9 - 1));
+				for (uint32_t first = head != cellHeads.end() ? head->second : NONE; first != NONE; first = nextInCell[first])
+				{
+					if ((mesh.vertices[first].position - position).squaredNorm() <= squaredEpsilon)
+					{
+						groups[v] = first;
+						break;
+					}
+				}
+			}
+
+			if (groups[v] == v)
+			{
+				auto [head, isInserted] = cellHeads.try_emplace(getCellKey(cell[0], cell[1], cell[2]), v);
+				if (!isInserted)
+				{
+					nextInCell[v] = head->second;
+					head->second = v;
+				}
+			}
+		}
+		return groups;
+	}
+
+	uint32_t MeshProcessing::weldVertices(Mesh& mesh, float epsilon)
+	{
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		const std::vector<uint32_t> groups = findPositionGroups(mesh, epsilon);
+
+		// welded vertices of every position group, chained through nextInGroup
+		std::vector<math::Vertex> vertices;
+		vertices.reserve(vertexCount);
+		std::vector<uint32_t> groupHeads(vertexCount, NONE);
+		std::vector<uint32_t> nextInGroup;
+		std::vector<uint32_t> remap(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			math::Vertex vertex = mesh.vertices[v];
+			vertex.position = mesh.vertices[groups[v]].position;
+
+			uint32_t welded = groupHeads[groups[v]];
+			while (welded != NONE && !haveSameAttributes(vertices[welded], vertex))
+			{
+				welded = nextInGroup[welded];
+			}
+			if (welded == NONE)
+			{
+				welded = uint32_t(vertices.size());
+				vertices.push_back(vertex);
+				nextInGroup.push_back(groupHeads[groups[v]]);
+				groupHeads[groups[v]] = welded;
+			}
+			remap[v] = welded;
+		}
+
+		const uint32_t removed = vertexCount - uint32_t(vertices.size());
+		mesh.vertices = std::move(vertices);
+
+		auto end = std::remove_if(mesh.triangles.begin(), mesh.triangles.end(), [&remap](math::Triangle& triangle)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				triangle.vertexIndices[k] = int(remap[triangle.vertexIndices[k]]);
+			}
+			return triangle.vertexIndices[0] == triangle.vertexIndices[1] || triangle.vertexIndices[1] == triangle.vertexIndices[2] || triangle.vertexIndices[2] == triangle.vertexIndices[0];
+		});
+		mesh.triangles.erase(end, mesh.triangles.end());
+
+		for (auto& triangle : mesh.triangles)
+		{
+			triangle.verticesArray = mesh.vertices.data();
+			triangle.computeNormalVector();
+		}
+		return removed;
+	}
+
+	void MeshProcessing::computeNormals(Mesh& mesh, NormalWeighting weighting, float weldEpsilon)
+	{
+		computeNormals(mesh, weighting, weldEpsilon, nullptr);
+	}
+
+	void MeshProcessing::computeNormals(Mesh& mesh, NormalWeighting weighting, float weldEpsilon, ParallelExecutor& executor)
+	{
+		computeNormals(mesh, weighting, weldEpsilon, &executor);
+	}
+
+	void MeshProcessing::computeNormals(Mesh& mesh, NormalWeighting weighting, float weldEpsilon, ParallelExecutor* executor)
+	{
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		const uint32_t triangleCount = uint32_t(mesh.triangles.size());
+
+		const std::vector<uint32_t> groups = findPositionGroups(mesh, weldEpsilon);
+		std::vector<uint32_t> cornerOffsets, corners;
+		buildCornerAdjacency(mesh, &groups, cornerOffsets, corners);
+
+		std::vector<math::Vec3f> faceNormals(triangleCount);
+		forEachChunk(executor, triangleCount, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t t = begin; t < end; ++t)
+			{
+				faceNormals[t] = getFrontFaceNormal(mesh, mesh.triangles[t]);
+			}
+		});
+
+		// sums are gathered per group, so no two tasks write the same normal
+		std::vector<math::Vec3f> groupNormals(vertexCount, math::Vec3f::Zero());
+		forEachChunk(executor, vertexCount, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t v = begin; v < end; ++v)
+			{
+				if (groups[v] != v)
+				{
+					continue;
+				}
+
+				math::Vec3f sum = math::Vec3f::Zero();
+				for (uint32_t c = cornerOffsets[v]; c < cornerOffsets[v + 1]; ++c)
+				{
+					const math::Triangle& triangle = mesh.triangles[corners[c] / 3];
+					const math::Vec3f& faceNormal = faceNormals[corners[c] / 3];
+					if (faceNormal.squaredNorm() == 0.0f)
+					{
+						continue;
+					}
+
+					if (weighting == NormalWeighting::AREA)
+					{
+						sum += faceNormal;
+					}
+					else
+					{
+						const uint32_t k = corners[c] % 3;
+						const math::Vec3f& position = mesh.vertices[triangle.vertexIndices[k]].position;
+						math::Vec3f a = mesh.vertices[triangle.vertexIndices[(k + 1) % 3]].position - position;
+						math::Vec3f b = mesh.vertices[triangle.vertexIndices[(k + 2) % 3]].position - position;
+						sum += faceNormal.normalized() * std::atan2(a.cross(b).norm(), a.dot(b));
+					}
+				}
+				groupNormals[v] = sum;
+			}
+		});
+
+		forEachChunk(executor, vertexCount, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t v = begin; v < end; ++v)
+			{
+				const math::Vec3f& normal = groupNormals[groups[v]];
+				if (normal.squaredNorm() > 0.0f)
+				{
+					mesh.vertices[v].normal = normal.normalized();
+				}
+			}
+		});
+	}
+
+	void MeshProcessing::computeTangents(Mesh& mesh)
+	{
+		computeTangents(mesh, nullptr);
+	}
+
+	void MeshProcessing::computeTangents(Mesh& mesh, ParallelExecutor& executor)
+	{
+		computeTangents(mesh, &executor);
+	}
+
+	void MeshProcessing::computeTangents(Mesh& mesh, ParallelExecutor* executor)
+	{
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		const uint32_t triangleCount = uint32_t(mesh.triangles.size());
+
+		// directions of increasing u and v on every triangle, texture coordinates aren't shared across seams, so these are summed per vertex
+		std::vector<math::Vec3f> uDirections(triangleCount), vDirections(triangleCount);
+		forEachChunk(executor, triangleCount, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t t = begin; t < end; ++t)
+			{
+				const math::Vertex& v0 = mesh.vertices[mesh.triangles[t].vertexIndices[0]];
+				const math::Vertex& v1 = mesh.vertices[mesh.triangles[t].vertexIndices[1]];
+				const math::Vertex& v2 = mesh.vertices[mesh.triangles[t].vertexIndices[2]];
+
+				math::Vec3f e1 = v1.position - v0.position, e2 = v2.position - v0.position;
+				math::Vec2f d1 = v1.textureCoordinates - v0.textureCoordinates, d2 = v2.textureCoordinates - v0.textureCoordinates;
+				float determinant = d1.x() * d2.y() - d2.x() * d1.y();
+				if (std::abs(determinant) <= std::numeric_limits<float>::min() || !std::isfinite(determinant))
+				{
+					uDirections[t] = vDirections[t] = math::Vec3f::Zero();
+					continue;
+				}
+
+				uDirections[t] = (e1 * d2.y() - e2 * d1.y()) / determinant;
+				vDirections[t] = (e2 * d1.x() - e1 * d2.x()) / determinant;
+			}
+		});
+
+		std::vector<uint32_t> cornerOffsets, corners;
+		buildCornerAdjacency(mesh, nullptr, cornerOffsets, corners);
+
+		forEachChunk(executor, vertexCount, [&](uint32_t begin, uint32_t end)
+		{
+			for (uint32_t v = begin; v < end; ++v)
+			{
+				math::Vertex& vertex = mesh.vertices[v];
+				if (vertex.normal.squaredNorm() == 0.0f)
+				{
+					continue;
+				}
+
+				math::Vec3f uSum = math::Vec3f::Zero(), vSum = math::Vec3f::Zero();
+				for (uint32_t c = cornerOffsets[v]; c < cornerOffsets[v + 1]; ++c)
+				{
+					uSum += uDirections[corners[c] / 3];
+					vSum += vDirections[corners[c] / 3];
+				}
+
+				const math::Vec3f normal = vertex.normal.normalized();
+				math::Vec3f tangent = uSum - normal * normal.dot(uSum);
+				tangent = tangent.squaredNorm() > 0.0f ? math::Vec3f(tangent.normalized()) : getAnyPerpendicular(normal);
+
+				// the bitangent follows v, which may be mirrored relative to the normal and tangent
+				math::Vec3f bitangent = normal.cross(tangent);
+				vertex.tangent = tangent;
+				vertex.bitangent = bitangent.dot(vSum) < 0.0f ? math::Vec3f(-bitangent) : bitangent;
+			}
+		});
+	}
+}
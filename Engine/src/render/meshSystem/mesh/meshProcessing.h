@@ -0,0 +1,46 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	struct Mesh;
+	struct ParallelExecutor;
+
+	// Vertex welding and normal and tangent generation for imported and generated meshes. Everything runs in linear time:
+	// vertices with close positions are found through a hash grid with cells of the weld epsilon, and the per-vertex sums
+	// are gathered over vertex to triangle adjacency, so the overloads taking an executor split them into independent chunks.
+	class MeshProcessing
+	{
+	public:
+		const static uint32_t PARALLEL_CHUNK_SIZE; // vertices or triangles per task
+
+		enum class NormalWeighting
+		{
+			AREA, // smooth, large triangles dominate
+			ANGLE, // independent of how the surface around a vertex is triangulated
+		};
+
+		// Returns the first vertex within epsilon of every vertex, in index order. Groups don't chain: every vertex of a group is within epsilon of its first vertex.
+		static std::vector<uint32_t> findPositionGroups(const Mesh& mesh, float epsilon);
+
+		// Merges vertices within epsilon of each other whose other attributes are equal, moving them onto the position of their group.
+		// Triangles are remapped, the ones collapsed to a line or a point are removed. Returns the number of removed vertices.
+		// Invalidates the BVH, LODs and meshlets of the mesh.
+		static uint32_t weldVertices(Mesh& mesh, float epsilon);
+
+		// Vertex normals averaged over all triangles around vertices within weldEpsilon, so seams of split vertices stay smooth.
+		// Vertices of degenerate triangles only keep their normal.
+		static void computeNormals(Mesh& mesh, NormalWeighting weighting, float weldEpsilon);
+		static void computeNormals(Mesh& mesh, NormalWeighting weighting, float weldEpsilon, ParallelExecutor& executor);
+
+		// Tangents and bitangents along the texture coordinates (Lengyel 2001), orthogonalized against the vertex normals.
+		// Vertices without usable texture coordinates get an arbitrary frame around their normal.
+		static void computeTangents(Mesh& mesh);
+		static void computeTangents(Mesh& mesh, ParallelExecutor& executor);
+
+	private:
+		static void computeNormals(Mesh& mesh, NormalWeighting weighting, float weldEpsilon, ParallelExecutor* executor);
+		static void computeTangents(Mesh& mesh, ParallelExecutor* executor);
+	};
+}
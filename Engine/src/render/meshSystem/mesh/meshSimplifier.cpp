@@ -0,0 +1,430 @@
+#include "meshSimplifier.h"
+#include "meshOptimizer.h"
+#include "lodSelection.h"
+#include "mesh.h"
+#include "../../../utils/hash.h"
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <unordered_map>
+
+namespace Engine
+{
+	const uint32_t MeshSimplifier::VERSION = 1;
+	const uint32_t MeshSimplifier::MAX_LODS = LodSelection::MAX_LOD_COUNT - 1;
+	const float MeshSimplifier::LOD_REDUCTION = 0.5f;
+	const uint32_t MeshSimplifier::MIN_LOD_TRIANGLES = 64;
+	const float MeshSimplifier::MAX_LOD_ERROR = 0.05f;
+
+	namespace
+	{
+		// Sum of squared distances to a set of planes weighted by triangle areas, as a symmetric 4x4 matrix.
+		// evaluate returns the weighted mean, so the error stays a squared distance however many planes were added.
+		struct Quadric
+		{
+			double a2 = 0.0, ab = 0.0, ac = 0.0, ad = 0.0, b2 = 0.0, bc = 0.0, bd = 0.0, c2 = 0.0, cd = 0.0, d2 = 0.0;
+			double weight = 0.0;
+
+			void addPlane(const math::Vec3f& normal, float d, double planeWeight)
+			{
+				const double a = normal.x(), b = normal.y(), c = normal.z();
+				a2 += planeWeight * a * a; ab += planeWeight * a * b; ac += planeWeight * a * c; ad += planeWeight * a * d;
+				b2 += planeWeight * b * b; bc += planeWeight * b * c; bd += planeWeight * b * d;
+				c2 += planeWeight * c * c; cd += planeWeight * c * d;
+				d2 += planeWeight * d * d;
+				weight += planeWeight;
+			}
+
+			void add(const Quadric& other)
+			{
+				a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+				b2 += other.b2; bc += other.bc; bd += other.bd;
+				c2 += other.c2; cd += other.cd;
+				d2 += other.d2;
+				weight += other.weight;
+			}
+
+			double evaluate(const math::Vec3f& point) const
+			{
+				const double x = point.x(), y = point.y(), z = point.z();
+				double error = a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x +
+					b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y +
+					c2 * z * z + 2.0 * cd * z + d2;
+				return weight > 0.0 ? std::max(error, 0.0) / weight : 0.0;
+			}
+		};
+
+		struct PositionKey
+		{
+			uint32_t bits[3];
+
+			bool operator==(const PositionKey& other) const
+			{
+				return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+			}
+		};
+
+		struct PositionKeyHash
+		{
+			size_t operator()(const PositionKey& key) const
+			{
+				return size_t(mixHash(mixHash(key.bits[0], key.bits[1]), key.bits[2]));
+			}
+		};
+
+		// State of the simplification of one mesh, LODs are snapshots of indices on the way down.
+		struct Simplifier
+		{
+			struct Collapse
+			{
+				uint32_t from;
+				uint32_t to;
+				double cost;
+			};
+
+			uint32_t vertexCount = 0;
+			std::vector<math::Vec3f> positions;
+			std::vector<uint32_t> indices;
+
+			std::vector<uint32_t> groups; // first vertex with the same position, quadrics and topology are tracked per group
+			std::vector<uint8_t> locked;
+			std::vector<Quadric> quadrics;
+			double maxCost = 0.0;
+
+			// rebuilt in every pass
+			std::vector<uint32_t> adjacencyOffsets;
+			std::vector<uint32_t> adjacency;
+			std::vector<Collapse> collapses;
+			std::vector<uint8_t> dead;
+			std::vector<uint8_t> touched;
+			std::vector<uint32_t> fromNeighbours, toNeighbours;
+
+			explicit Simplifier(const Mesh& mesh)
+			{
+				vertexCount = uint32_t(mesh.vertices.size());
+				positions.resize(vertexCount);
+				for (uint32_t v = 0; v < vertexCount; ++v)
+				{
+					positions[v] = mesh.vertices[v].position;
+				}
+
+				indices.reserve(mesh.triangles.size() * 3);
+				for (const auto& triangle : mesh.triangles)
+				{
+					indices.insert(indices.end(), { uint32_t(triangle.vertexIndices[0]), uint32_t(triangle.vertexIndices[1]), uint32_t(triangle.vertexIndices[2]) });
+				}
+
+				groups.resize(vertexCount);
+				std::vector<uint32_t> groupSizes(vertexCount, 0);
+				std::unordered_map<PositionKey, uint32_t, PositionKeyHash> groupByPosition;
+				for (uint32_t v = 0; v < vertexCount; ++v)
+				{
+					PositionKey key;
+					std::memcpy(key.bits, positions[v].data(), sizeof(key.bits));
+					groups[v] = groupByPosition.emplace(key, v).first->second;
+					++groupSizes[groups[v]];
+				}
+
+				// Attribute seams have several vertices per position, moving one of them would tear the seam.
+				// Border and non-manifold edges are kept too, either half-edge of them is missing or repeated.
+				locked.assign(vertexCount, 0);
+				std::unordered_map<uint64_t, uint32_t> halfEdges;
+				auto edgeKey = [this](uint32_t a, uint32_t b)
+				{
+					return uint64_t(groups[a]) << 32 | groups[b];
+				};
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						++halfEdges[edgeKey(indices[i + k], indices[i + (k + 1) % 3])];
+					}
+				}
+				std::vector<uint8_t> lockedGroups(vertexCount, 0);
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						uint32_t a = indices[i + k], b = indices[i + (k + 1) % 3];
+						auto opposite = halfEdges.find(edgeKey(b, a));
+						if (halfEdges[edgeKey(a, b)] != 1 || opposite == halfEdges.end() || opposite->second != 1)
+						{
+							lockedGroups[groups[a]] = 1;
+							lockedGroups[groups[b]] = 1;
+						}
+					}
+				}
+				for (uint32_t v = 0; v < vertexCount; ++v)
+				{
+					locked[v] = groupSizes[groups[v]] > 1 || lockedGroups[groups[v]];
+				}
+
+				quadrics.resize(vertexCount);
+				for (size_t i = 0; i < indices.size(); i += 3)
+				{
+					const math::Vec3f& p0 = positions[indices[i]];
+					math::Vec3f normal = (positions[indices[i + 1]] - p0).cross(positions[indices[i + 2]] - p0);
+					float doubleArea = normal.norm();
+					if (doubleArea <= 0.0f)
+					{
+						continue;
+					}
+					normal /= doubleArea;
+
+					for (int k = 0; k < 3; ++k)
+					{
+						quadrics[groups[indices[i + k]]].addPlane(normal, -normal.dot(p0), 0.5 * doubleArea);
+					}
+				}
+			}
+
+			uint32_t getTriangleCount() const
+			{
+				return uint32_t(indices.size() / 3);
+			}
+
+			// estimated distance between the original and the simplified surface
+			float getError() const
+			{
+				return float(std::sqrt(maxCost));
+			}
+
+			bool containsVertex(uint32_t triangle, uint32_t vertex) const
+			{
+				return indices[triangle * 3] == vertex || indices[triangle * 3 + 1] == vertex || indices[triangle * 3 + 2] == vertex;
+			}
+
+			void gatherNeighbourGroups(uint32_t vertex, uint32_t except, std::vector<uint32_t>& outGroups) const
+			{
+				outGroups.clear();
+				for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a)
+				{
+					for (int k = 0; k < 3; ++k)
+					{
+						uint32_t group = groups[indices[adjacency[a] * 3 + k]];
+						if (group != groups[vertex] && group != groups[except])
+						{
+							outGroups.push_back(group);
+						}
+					}
+				}
+				std::sort(outGroups.begin(), outGroups.end());
+				outGroups.erase(std::unique(outGroups.begin(), outGroups.end()), outGroups.end());
+			}
+
+			bool canCollapse(uint32_t from, uint32_t to)
+			{
+				// Only the vertices opposite to the removed edge may be neighbours of both ends,
+				// otherwise the collapse would fold the surface into non-manifold edges.
+				uint32_t sharedTriangles = 0;
+				for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+				{
+					sharedTriangles += containsVertex(adjacency[a], to);
+				}
+				gatherNeighbourGroups(from, to, fromNeighbours);
+				gatherNeighbourGroups(to, from, toNeighbours);
+
+				uint32_t sharedNeighbours = 0;
+				for (size_t i = 0, j = 0; i < fromNeighbours.size() && j < toNeighbours.size();)
+				{
+					if (fromNeighbours[i] == toNeighbours[j])
+					{
+						++sharedNeighbours;
+						++i;
+						++j;
+					}
+					else if (fromNeighbours[i] < toNeighbours[j])
+					{
+						++i;
+					}
+					else
+					{
+						++j;
+					}
+				}
+				if (sharedNeighbours > sharedTriangles)
+				{
+					return false;
+				}
+
+				// the remaining triangles around from must not flip or turn too much
+				for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+				{
+					uint32_t triangle = adjacency[a];
+					if (containsVertex(triangle, to))
+					{
+						continue;
+					}
+
+					math::Vec3f p[3], moved[3];
+					for (int k = 0; k < 3; ++k)
+					{
+						uint32_t vertex = indices[triangle * 3 + k];
+						p[k] = positions[vertex];
+						moved[k] = vertex == from ? positions[to] : p[k];
+					}
+					math::Vec3f normal = (p[1] - p[0]).cross(p[2] - p[0]);
+					math::Vec3f movedNormal = (moved[1] - moved[0]).cross(moved[2] - moved[0]);
+					if (normal.dot(movedNormal) <= 0.25f * normal.norm() * movedNormal.norm())
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+			// Collapses the cheapest edges of independent vertices until at most targetTriangles remain.
+			// Returns false if nothing could be collapsed.
+			bool collapsePass(uint32_t targetTriangles)
+			{
+				const uint32_t triangleCount = getTriangleCount();
+
+				adjacencyOffsets.assign(vertexCount + 1, 0);
+				for (uint32_t index : indices)
+				{
+					++adjacencyOffsets[index + 1];
+				}
+				for (uint32_t v = 0; v < vertexCount; ++v)
+				{
+					adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+				}
+				adjacency.resize(indices.size());
+				std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+				for (uint32_t i = 0; i < indices.size(); ++i)
+				{
+					adjacency[fill[indices[i]]++] = i / 3;
+				}
+
+				// the cheapest target of every movable vertex, positions don't change, so the cost is the quadric at the target
+				collapses.clear();
+				for (uint32_t from = 0; from < vertexCount; ++from)
+				{
+					if (locked[from] || adjacencyOffsets[from] == adjacencyOffsets[from + 1])
+					{
+						continue;
+					}
+
+					Collapse best = { from, from, std::numeric_limits<double>::max() };
+					for (uint32_t a = adjacencyOffsets[from]; a < adjacencyOffsets[from + 1]; ++a)
+					{
+						for (int k = 0; k < 3; ++k)
+						{
+							uint32_t to = indices[adjacency[a] * 3 + k];
+							double cost = quadrics[groups[from]].evaluate(positions[to]);
+							if (to != from && cost < best.cost)
+							{
+								best.to = to;
+								best.cost = cost;
+							}
+						}
+					}
+					if (best.to != from)
+					{
+						collapses.push_back(best);
+					}
+				}
+				std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b)
+				{
+					return a.cost < b.cost || (a.cost == b.cost && a.from < b.from);
+				});
+
+				// Costs and adjacency are only valid for vertices untouched by earlier collapses of the pass,
+				// so every collapse locks all vertices of the triangles it changes until the next pass.
+				dead.assign(triangleCount, 0);
+				touched.assign(vertexCount, 0);
+				uint32_t remaining = triangleCount;
+				bool collapsed = false;
+				for (const Collapse& collapse : collapses)
+				{
+					if (remaining <= targetTriangles)
+					{
+						break;
+					}
+					if (touched[collapse.from] || touched[collapse.to] || !canCollapse(collapse.from, collapse.to))
+					{
+						continue;
+					}
+
+					for (uint32_t a = adjacencyOffsets[collapse.from]; a < adjacencyOffsets[collapse.from + 1]; ++a)
+					{
+						uint32_t triangle = adjacency[a];
+						if (containsVertex(triangle, collapse.to))
+						{
+							dead[triangle] = 1;
+							--remaining;
+						}
+
+						for (int k = 0; k < 3; ++k)
+						{
+							uint32_t& index = indices[triangle * 3 + k];
+							touched[index] = 1;
+							if (index == collapse.from)
+							{
+								index = collapse.to;
+							}
+						}
+					}
+					touched[collapse.from] = 1;
+
+					quadrics[groups[collapse.to]].add(quadrics[groups[collapse.from]]);
+					maxCost = std::max(maxCost, collapse.cost);
+					collapsed = true;
+				}
+
+				size_t written = 0;
+				for (uint32_t t = 0; t < triangleCount; ++t)
+				{
+					if (!dead[t])
+					{
+						std::copy_n(indices.begin() + t * 3, 3, indices.begin() + written);
+						written += 3;
+					}
+				}
+				indices.resize(written);
+
+				return collapsed;
+			}
+		};
+	}
+
+	void MeshSimplifier::buildLods(Mesh& mesh)
+	{
+		mesh.lods.clear();
+
+		const float radius = mesh.boundingBox.radius();
+		uint32_t previousTriangles = uint32_t(mesh.triangles.size());
+		if (previousTriangles * LOD_REDUCTION < MIN_LOD_TRIANGLES || !(radius > 0.0f))
+		{
+			return;
+		}
+
+		Simplifier simplifier(mesh);
+		for (uint32_t lod = 0; lod < MAX_LODS; ++lod)
+		{
+			const uint32_t targetTriangles = uint32_t(previousTriangles * LOD_REDUCTION);
+			if (targetTriangles < MIN_LOD_TRIANGLES)
+			{
+				break;
+			}
+
+			while (simplifier.getTriangleCount() > targetTriangles && simplifier.collapsePass(targetTriangles))
+			{
+			}
+
+			// a LOD that doesn't get at least halfway to its target isn't worth its own draws, and coarser ones won't do better
+			const uint32_t triangles = simplifier.getTriangleCount();
+			const float error = simplifier.getError() / radius;
+			if (triangles > previousTriangles * (1.0f + LOD_REDUCTION) * 0.5f || error > MAX_LOD_ERROR)
+			{
+				break;
+			}
+
+			Mesh::Lod& added = mesh.lods.emplace_back();
+			added.indices = simplifier.indices;
+			added.error = error;
+			MeshOptimizer::optimizeVertexCache(added.indices, uint32_t(mesh.vertices.size()));
+
+			previousTriangles = triangles;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// Builds Mesh::lods with quadric error metric edge collapses (Garland and Heckbert 1997). Vertices are only collapsed onto
+	// their neighbours and never moved, so all LODs index the vertices of the mesh and share its vertex buffer.
+	// Vertices on open borders and attribute seams (several vertices with one position) are kept, which preserves silhouettes and UV mapping.
+	class MeshSimplifier
+	{
+	public:
+		const static uint32_t VERSION; // part of the model cache key, bump when the output changes
+		const static uint32_t MAX_LODS; // LOD 1 and coarser, at most LodSelection::MAX_LOD_COUNT - 1
+		const static float LOD_REDUCTION; // triangle count of every LOD relative to the previous one
+		const static uint32_t MIN_LOD_TRIANGLES; // coarser LODs aren't built below this
+		const static float MAX_LOD_ERROR; // relative to the bounding box radius, coarser LODs aren't built beyond this
+
+		// Replaces mesh.lods, the chain stops early once simplification stalls or gets too inaccurate.
+		// Every LOD is ordered for the post-transform cache.
+		static void buildLods(Mesh& mesh);
+	};
+}
@@ -0,0 +1,249 @@
+#include "meshletBuilder.h"
+#include "mesh.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace Engine
+{
+	const uint32_t MeshletBuilder::VERSION = 1;
+	const uint32_t MeshletBuilder::MAX_VERTICES = 64;
+	const uint32_t MeshletBuilder::MAX_TRIANGLES = 124;
+	const float MeshletBuilder::CONE_MIN_DOT = 0.1f;
+
+	namespace
+	{
+		void computeBounds(const Mesh& mesh, Mesh::Meshlet& meshlet)
+		{
+			const auto begin = mesh.triangles.begin() + meshlet.triangleOffset;
+			const auto end = begin + meshlet.triangleCount;
+
+			math::Box box = math::Box::empty();
+			for (auto triangle = begin; triangle != end; ++triangle)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					const math::Vec3f& position = mesh.vertices[triangle->vertexIndices[k]].position;
+					box.min = box.min.cwiseMin(position);
+					box.max = box.max.cwiseMax(position);
+				}
+			}
+
+			meshlet.center = box.center();
+			meshlet.radius = 0.0f;
+			for (auto triangle = begin; triangle != end; ++triangle)
+			{
+				for (int k = 0; k < 3; ++k)
+				{
+					meshlet.radius = std::max(meshlet.radius, (mesh.vertices[triangle->vertexIndices[k]].position - meshlet.center).norm());
+				}
+			}
+
+			// front faces are clockwise in the left-handed space, so (p1 - p0) x (p2 - p0) points out of the visible side
+			math::Vec3f normalSum = math::Vec3f::Zero();
+			for (auto triangle = begin; triangle != end; ++triangle)
+			{
+				const math::Vec3f& p0 = mesh.vertices[triangle->vertexIndices[0]].position;
+				math::Vec3f normal = (mesh.vertices[triangle->vertexIndices[1]].position - p0).cross(mesh.vertices[triangle->vertexIndices[2]].position - p0);
+				if (normal.squaredNorm() > 0.0f)
+				{
+					normalSum += normal.normalized();
+				}
+			}
+
+			meshlet.coneApex = meshlet.center;
+			meshlet.coneAxis = math::Vec3f(0.0f, 0.0f, 1.0f);
+			meshlet.coneCutoff = 2.0f;
+			if (normalSum.squaredNorm() == 0.0f)
+			{
+				return;
+			}
+			const math::Vec3f axis = normalSum.normalized();
+
+			float minDot = 1.0f;
+			for (auto triangle = begin; triangle != end; ++triangle)
+			{
+				const math::Vec3f& p0 = mesh.vertices[triangle->vertexIndices[0]].position;
+				math::Vec3f normal = (mesh.vertices[triangle->vertexIndices[1]].position - p0).cross(mesh.vertices[triangle->vertexIndices[2]].position - p0);
+				if (normal.squaredNorm() > 0.0f)
+				{
+					minDot = std::min(minDot, normal.normalized().dot(axis));
+				}
+			}
+			if (minDot < MeshletBuilder::CONE_MIN_DOT)
+			{
+				return;
+			}
+
+			// the apex is moved back along the axis until it lies behind the planes of all triangles,
+			// then every point inside the cone behind it sees only their back faces
+			float maxT = 0.0f;
+			for (auto triangle = begin; triangle != end; ++triangle)
+			{
+				const math::Vec3f& p0 = mesh.vertices[triangle->vertexIndices[0]].position;
+				math::Vec3f normal = (mesh.vertices[triangle->vertexIndices[1]].position - p0).cross(mesh.vertices[triangle->vertexIndices[2]].position - p0);
+				if (normal.squaredNorm() > 0.0f)
+				{
+					normal.normalize();
+					maxT = std::max(maxT, (meshlet.center - p0).dot(normal) / axis.dot(normal));
+				}
+			}
+
+			meshlet.coneApex = meshlet.center - axis * maxT;
+			meshlet.coneAxis = axis;
+			meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+		}
+	}
+
+	void MeshletBuilder::build(Mesh& mesh)
+	{
+		mesh.meshlets.clear();
+
+		const uint32_t triangleCount = uint32_t(mesh.triangles.size());
+		const uint32_t vertexCount = uint32_t(mesh.vertices.size());
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		// triangles using every vertex
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (const auto& triangle : mesh.triangles)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				++adjacencyOffsets[triangle.vertexIndices[k] + 1];
+			}
+		}
+		for (uint32_t v = 0; v < vertexCount; ++v)
+		{
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+		}
+		std::vector<uint32_t> adjacency(triangleCount * 3);
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			for (int k = 0; k < 3; ++k)
+			{
+				adjacency[fill[mesh.triangles[t].vertexIndices[k]]++] = t;
+			}
+		}
+
+		const uint32_t NONE = std::numeric_limits<uint32_t>::max();
+		std::vector<uint8_t> used(triangleCount, 0);
+		std::vector<uint32_t> vertexMeshlet(vertexCount, NONE); // the last meshlet using the vertex
+		std::vector<uint32_t> candidateMeshlet(triangleCount, NONE); // the last meshlet the triangle was a candidate of
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> order;
+		order.reserve(triangleCount);
+
+		// new meshlets start at the first unused triangle, which keeps them roughly in the order of MeshOptimizer
+		for (uint32_t seed = 0; seed < triangleCount; ++seed)
+		{
+			if (used[seed])
+			{
+				continue;
+			}
+
+			const uint32_t meshletIndex = uint32_t(mesh.meshlets.size());
+			Mesh::Meshlet meshlet = {};
+			meshlet.triangleOffset = uint32_t(order.size());
+
+			math::Vec3f positionSum = math::Vec3f::Zero();
+			candidates.clear();
+
+			auto addTriangle = [&](uint32_t triangle)
+			{
+				used[triangle] = 1;
+				order.push_back(triangle);
+				++meshlet.triangleCount;
+
+				for (int k = 0; k < 3; ++k)
+				{
+					const uint32_t vertex = mesh.triangles[triangle].vertexIndices[k];
+					if (vertexMeshlet[vertex] == meshletIndex)
+					{
+						continue;
+					}
+					vertexMeshlet[vertex] = meshletIndex;
+					++meshlet.vertexCount;
+					positionSum += mesh.vertices[vertex].position;
+
+					for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; ++a)
+					{
+						const uint32_t neighbour = adjacency[a];
+						if (!used[neighbour] && candidateMeshlet[neighbour] != meshletIndex)
+						{
+							candidateMeshlet[neighbour] = meshletIndex;
+							candidates.push_back(neighbour);
+						}
+					}
+				}
+			};
+
+			addTriangle(seed);
+			while (meshlet.triangleCount < MAX_TRIANGLES)
+			{
+				const math::Vec3f centroid = positionSum / float(meshlet.vertexCount);
+
+				uint32_t best = NONE;
+				uint32_t bestNewVertices = 4;
+				float bestDistance = std::numeric_limits<float>::max();
+				for (size_t c = 0; c < candidates.size();)
+				{
+					const uint32_t triangle = candidates[c];
+					if (used[triangle])
+					{
+						candidates[c] = candidates.back();
+						candidates.pop_back();
+						continue;
+					}
+					++c;
+
+					uint32_t newVertices = 0;
+					math::Vec3f triangleCentroid = math::Vec3f::Zero();
+					for (int k = 0; k < 3; ++k)
+					{
+						const uint32_t vertex = mesh.triangles[triangle].vertexIndices[k];
+						newVertices += vertexMeshlet[vertex] != meshletIndex;
+						triangleCentroid += mesh.vertices[vertex].position;
+					}
+					if (meshlet.vertexCount + newVertices > MAX_VERTICES)
+					{
+						continue;
+					}
+
+					const float distance = (triangleCentroid / 3.0f - centroid).squaredNorm();
+					if (newVertices < bestNewVertices || (newVertices == bestNewVertices && (distance < bestDistance || (distance == bestDistance && triangle < best))))
+					{
+						best = triangle;
+						bestNewVertices = newVertices;
+						bestDistance = distance;
+					}
+				}
+
+				if (best == NONE)
+				{
+					break;
+				}
+				addTriangle(best);
+			}
+
+			// within a meshlet the triangles keep the post-transform cache order
+			std::sort(order.begin() + meshlet.triangleOffset, order.end());
+			mesh.meshlets.push_back(meshlet);
+		}
+
+		std::vector<math::Triangle> triangles(triangleCount);
+		for (uint32_t t = 0; t < triangleCount; ++t)
+		{
+			triangles[t] = mesh.triangles[order[t]];
+		}
+		mesh.triangles = std::move(triangles);
+
+		for (auto& meshlet : mesh.meshlets)
+		{
+			computeBounds(mesh, meshlet);
+		}
+	}
+}
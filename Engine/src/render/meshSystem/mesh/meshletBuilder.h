@@ -0,0 +1,22 @@
+#pragma once
+#include <cstdint>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// Splits meshes into Mesh::meshlets, so large meshes can be culled in parts. Meshlets grow greedily over triangles sharing
+	// their vertices, preferring ones that add the fewest new vertices and then the ones nearest to the meshlet, and the triangles
+	// are reordered so that every meshlet is a contiguous range of them.
+	class MeshletBuilder
+	{
+	public:
+		const static uint32_t VERSION; // part of the model cache key, bump when the output changes
+		const static uint32_t MAX_VERTICES;
+		const static uint32_t MAX_TRIANGLES;
+		const static float CONE_MIN_DOT; // meshlets with normals spread wider than this from their average get no backface cone
+
+		// Triangles keep their relative order within a meshlet, so MeshOptimizer should run first. The mesh BVH has to be built afterwards.
+		static void build(Mesh& mesh);
+	};
+}
@@ -0,0 +1,76 @@
+#include "meshletCulling.h"
+#include "boundingVolumes.h"
+#include "mesh.h"
+
+namespace Engine
+{
+	MeshletCulling::Stats MeshletCulling::cull(const Mesh& mesh, const math::Mat4f& meshToWorld, const math::Mat4f& worldToClip, const math::Vec3f& cameraPosition, std::vector<IndexRange>& outRanges)
+	{
+		Stats stats = {};
+
+		// Clip space planes of the frustum in mesh space (Gribb and Hartmann), a point p is inside if dot((p, 1), plane) >= 0.
+		// Planes aren't normalized, so sphere radii are scaled by the length of the plane normal instead.
+		const math::Mat4f meshToClip = meshToWorld * worldToClip;
+		const math::Vec4f x = meshToClip.col(0).transpose(), y = meshToClip.col(1).transpose(), z = meshToClip.col(2).transpose(), w = meshToClip.col(3).transpose();
+		const math::Vec4f planes[6] = { w + x, w - x, w + y, w - y, z, w - z };
+		float planeNormalLengths[6];
+		for (int i = 0; i < 6; ++i)
+		{
+			planeNormalLengths[i] = planes[i].head<3>().norm();
+		}
+
+		// the whole mesh first, meshlets of a mesh entirely inside the frustum skip the planes
+		const BoundingVolumes::Visibility meshVisibility = BoundingVolumes::testPlanes(mesh, planes);
+		if (meshVisibility == BoundingVolumes::Visibility::OUTSIDE)
+		{
+			stats.frustumCulled = uint32_t(mesh.meshlets.size());
+			return stats;
+		}
+		const bool isInsideFrustum = meshVisibility == BoundingVolumes::Visibility::INSIDE;
+
+		const bool isMirrored = meshToWorld.topLeftCorner<3, 3>().determinant() < 0.0f;
+		const math::Vec4f cameraInMesh = math::Vec4f(cameraPosition.x(), cameraPosition.y(), cameraPosition.z(), 1.0f) * meshToWorld.inverse();
+		const math::Vec3f camera = cameraInMesh.head<3>() / cameraInMesh.w();
+
+		for (const auto& meshlet : mesh.meshlets)
+		{
+			const math::Vec4f center(meshlet.center.x(), meshlet.center.y(), meshlet.center.z(), 1.0f);
+
+			bool isInside = true;
+			for (int i = 0; i < 6 && isInside && !isInsideFrustum; ++i)
+			{
+				isInside = center.dot(planes[i]) >= -meshlet.radius * planeNormalLengths[i];
+			}
+			if (!isInside)
+			{
+				++stats.frustumCulled;
+				continue;
+			}
+
+			if (!isMirrored && meshlet.coneCutoff <= 1.0f)
+			{
+				math::Vec3f toApex = meshlet.coneApex - camera;
+				float distance = toApex.norm();
+				if (distance > 0.0f && toApex.dot(meshlet.coneAxis) >= meshlet.coneCutoff * distance)
+				{
+					++stats.backfaceCulled;
+					continue;
+				}
+			}
+
+			++stats.visible;
+			const uint32_t indexOffset = meshlet.triangleOffset * 3;
+			const uint32_t indexNum = meshlet.triangleCount * 3;
+			if (!outRanges.empty() && outRanges.back().indexOffset + outRanges.back().indexNum == indexOffset)
+			{
+				outRanges.back().indexNum += indexNum;
+			}
+			else
+			{
+				outRanges.push_back({ indexOffset, indexNum });
+			}
+		}
+
+		return stats;
+	}
+}
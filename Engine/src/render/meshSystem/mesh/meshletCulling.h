@@ -0,0 +1,33 @@
+#pragma once
+#include "../../../math/mathUtils.h"
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// CPU culling of Mesh::meshlets against a view frustum and their backface cones. Depends only on its arguments,
+	// so it can be checked without a device. ShadingGroup uses it for meshes drawn with a single instance in the main camera passes.
+	struct MeshletCulling
+	{
+		// relative to the first index of the mesh, add Model::MeshRange::indexOffset to draw
+		struct IndexRange
+		{
+			uint32_t indexOffset;
+			uint32_t indexNum;
+		};
+
+		struct Stats
+		{
+			uint32_t visible;
+			uint32_t frustumCulled;
+			uint32_t backfaceCulled;
+		};
+
+		// Appends the index ranges of the visible meshlets to outRanges, neighbouring visible meshlets are merged into one range.
+		// meshToWorld includes the mesh instances, worldToClip is the view projection matrix and cameraPosition is in world space.
+		// Meshes mirrored by meshToWorld are only frustum culled. The mesh bounding volumes are tested first, see BoundingVolumes::testPlanes.
+		static Stats cull(const Mesh& mesh, const math::Mat4f& meshToWorld, const math::Mat4f& worldToClip, const math::Vec3f& cameraPosition, std::vector<IndexRange>& outRanges);
+	};
+}
@@ -1,51 +1,310 @@
 #include "model.h"
+#include "geometryPool.h"
+#include "meshOptimizer.h"
 #include "../../../utils/assert.h"
+#include "../../../utils/hash.h"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <unordered_map>
 
 namespace Engine
 {
+	namespace
+	{
+		// positions are merged only when bitwise equal, so the merged stream draws exactly the same depth
+		struct PositionHash
+		{
+			size_t operator()(const math::Vec3f& position) const
+			{
+				return size_t(hashBytes(position.data(), sizeof(math::Vec3f)));
+			}
+		};
+		struct PositionEqual
+		{
+			bool operator()(const math::Vec3f& left, const math::Vec3f& right) const
+			{
+				return memcmp(left.data(), right.data(), sizeof(math::Vec3f)) == 0;
+			}
+		};
+
+		// The full precision vertices stand for the packed ones, Vertex has padding, so they are hashed member by member.
+		// Index values are relative to the mesh, so equal meshes hash equally wherever they are in their models.
+		uint64_t computeGeometryHash(std::span<const math::Vertex> vertices, std::span<const unsigned int> indices, std::span<const math::Vec3f> positions,
+			std::span<const unsigned int> positionIndices)
+		{
+			uint64_t hash = mixHash(mixHash(vertices.size(), indices.size()), positions.size());
+			for (const auto& vertex : vertices)
+			{
+				float members[18];
+				memcpy(members, vertex.position.data(), sizeof(math::Vec3f));
+				memcpy(members + 3, vertex.color.data(), sizeof(math::Vec4f));
+				memcpy(members + 7, vertex.textureCoordinates.data(), sizeof(math::Vec2f));
+				memcpy(members + 9, vertex.normal.data(), sizeof(math::Vec3f));
+				memcpy(members + 12, vertex.tangent.data(), sizeof(math::Vec3f));
+				memcpy(members + 15, vertex.bitangent.data(), sizeof(math::Vec3f));
+				hash = hashBytes(members, sizeof(members), hash);
+			}
+			hash = hashBytes(indices.data(), indices.size_bytes(), hash);
+			hash = hashBytes(positions.data(), positions.size_bytes(), hash);
+			return hashBytes(positionIndices.data(), positionIndices.size_bytes(), hash);
+		}
+	}
+
 	void Model::createVertexBuffer()
+	{
+		prepareBuffers();
+		createBuffers();
+	}
+	std::vector<D3D11_INPUT_ELEMENT_DESC> Model::getVertexInputElements()
+	{
+#if PACKED_VERTICES
+		return
+		{
+			{"POS",			0, DXGI_FORMAT_R32G32B32_FLOAT,		0, 0,								D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"TEX",			0, DXGI_FORMAT_R16G16_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"FRAME",		0, DXGI_FORMAT_R32_UINT,			0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+#else
+		return
+		{
+			{"POS",			0, DXGI_FORMAT_R32G32B32_FLOAT,		0, 0,								D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"COL",			0, DXGI_FORMAT_R32G32B32A32_FLOAT,	0, 16,								D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"TEX",			0, DXGI_FORMAT_R32G32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"NORM",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"TANG",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"BTANG",		0, DXGI_FORMAT_R32G32B32_FLOAT,		0, D3D11_APPEND_ALIGNED_ELEMENT,	D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+#endif
+	}
+	std::vector<D3D11_INPUT_ELEMENT_DESC> Model::getPositionInputElements()
+	{
+		return
+		{
+			{"POS",			0, DXGI_FORMAT_R32G32B32_FLOAT,		0, 0,								D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+	}
+	void Model::prepareBuffers()
 	{
 		if (m_meshes.empty())
 		{
 			return;
 		}
 
-		std::vector<math::Vertex> vertices;
-		std::vector<unsigned int> indices;
+		struct Storage
+		{
+			std::vector<GPUVertex> vertices;
+			std::vector<unsigned int> indices;
+			std::vector<math::Vec3f> positions;
+			std::vector<unsigned int> positionIndices;
+		};
+		auto storage = std::make_shared<Storage>();
+		auto& vertices = storage->vertices;
+		auto& indices = storage->indices;
+		auto& positions = storage->positions;
+		auto& positionIndices = storage->positionIndices;
+
+		// the arrays are sized up front and written in place, growing them would copy them and briefly need twice the memory
+		size_t vertexCount = 0, indexCount = 0;
+		for (const auto& mesh : m_meshes)
+		{
+			vertexCount += mesh.vertices.size();
+			indexCount += mesh.triangles.size() * 3;
+			for (const auto& lod : mesh.lods)
+			{
+				indexCount += lod.indices.size();
+			}
+		}
+		vertices.resize(vertexCount);
+		indices.resize(indexCount);
+		positionIndices.resize(indexCount);
+		positions.reserve(vertexCount); // merged positions are at most as many as vertices
+
+		m_ranges.reserve(m_meshes.size());
+		m_lods.reserve(m_meshes.size());
+		m_positionRanges.reserve(m_meshes.size());
+		m_geometryHashes.reserve(m_meshes.size());
+
+		std::unordered_map<math::Vec3f, uint32_t, PositionHash, PositionEqual> positionMap;
+		std::vector<uint32_t> positionRemap;
+		std::vector<uint32_t> rangeIndices;
+
+		int offset = 0;
+		int indOffset = 0;
 		for (const auto& mesh : m_meshes)
 		{
-			int offset = vertices.size();
-			vertices.insert(vertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+#if PACKED_VERTICES
+			std::transform(mesh.vertices.begin(), mesh.vertices.end(), vertices.begin() + offset, math::PackedVertex::pack);
+#else
+			std::copy(mesh.vertices.begin(), mesh.vertices.end(), vertices.begin() + offset);
+#endif
 			
-			int num = vertices.size() - offset;
+			int num = int(mesh.vertices.size());
 			
-			int indOffset = indices.size();
+			unsigned int* meshIndices = indices.data() + indOffset;
 			for (const auto& triangle : mesh.triangles)
 			{
-				indices.push_back(triangle.vertexIndices[0]);
-				indices.push_back(triangle.vertexIndices[1]);
-				indices.push_back(triangle.vertexIndices[2]);
+				*meshIndices++ = triangle.vertexIndices[0];
+				*meshIndices++ = triangle.vertexIndices[1];
+				*meshIndices++ = triangle.vertexIndices[2];
 			}
-			int indNum = indices.size() - indOffset;
+			int indNum = int(mesh.triangles.size()) * 3;
 
 			MeshRange range = { offset, indOffset, num, indNum };
 			m_ranges.push_back(MeshRange(range));
+
+			int lodOffset = indOffset + indNum;
+			MeshLods& lods = m_lods.emplace_back();
+			for (const auto& lod : mesh.lods)
+			{
+				std::copy(lod.indices.begin(), lod.indices.end(), indices.begin() + lodOffset);
+				lods.ranges.push_back({ offset, lodOffset, num, int(lod.indices.size()) });
+				lods.errors.push_back(lod.error);
+				lodOffset += int(lod.indices.size());
+			}
+
+			MeshRange positionRange = range;
+			positionRange.vertexOffset = int(positions.size());
+			positionMap.clear();
+			positionRemap.resize(mesh.vertices.size());
+			for (size_t v = 0; v < mesh.vertices.size(); ++v)
+			{
+				auto [iter, inserted] = positionMap.try_emplace(mesh.vertices[v].position, uint32_t(positions.size() - positionRange.vertexOffset));
+				if (inserted)
+				{
+					positions.push_back(mesh.vertices[v].position);
+				}
+				positionRemap[v] = iter->second;
+			}
+			positionRange.vertexNum = int(positions.size()) - positionRange.vertexOffset;
+			m_positionRanges.push_back(positionRange);
+
+			auto remapIndices = [&](const MeshRange& indexRange)
+			{
+				rangeIndices.resize(indexRange.indexNum);
+				for (int i = 0; i < indexRange.indexNum; ++i)
+				{
+					rangeIndices[i] = positionRemap[indices[indexRange.indexOffset + i]];
+				}
+				MeshOptimizer::optimizeVertexCache(rangeIndices, uint32_t(positionRange.vertexNum));
+				std::copy(rangeIndices.begin(), rangeIndices.end(), positionIndices.begin() + indexRange.indexOffset);
+			};
+			remapIndices(range);
+			for (const auto& lodRange : lods.ranges)
+			{
+				remapIndices(lodRange);
+			}
+
+			const size_t meshIndexCount = size_t(lodOffset - indOffset);
+			m_geometryHashes.push_back(computeGeometryHash(mesh.vertices, { indices.data() + indOffset, meshIndexCount },
+				{ positions.data() + positionRange.vertexOffset, size_t(positionRange.vertexNum) }, { positionIndices.data() + indOffset, meshIndexCount }));
+
+			offset += num;
+			indOffset = lodOffset;
+		}
+
+		m_pendingBuffers = { vertices, indices, positions, positionIndices, storage };
+	}
+	void Model::createBuffers()
+	{
+		if (m_pendingBuffers.vertices.empty())
+		{
+			return;
+		}
+
+		DEV_ASSERT(m_geometryHashes.size() == m_meshes.size());
+		m_hasIndices = !m_pendingBuffers.indices.empty();
+		m_hasPositionBuffers = !m_pendingBuffers.positions.empty() && !m_pendingBuffers.positionIndices.empty();
+
+		// the pool copies the data, so it may come from read-only memory
+		GeometryPool* pool = GeometryPool::getInstancePtr();
+		m_meshGeometry.resize(m_meshes.size());
+		for (size_t i = 0; i < m_meshes.size(); ++i)
+		{
+			const MeshRange& range = m_ranges[i];
+			const size_t indexCount = m_hasIndices ? size_t(getIndexEnd(int(i)) - range.indexOffset) : 0;
+			const auto vertices = m_pendingBuffers.vertices.subspan(range.vertexOffset, range.vertexNum);
+			const auto indices = m_pendingBuffers.indices.subspan(m_hasIndices ? range.indexOffset : 0, indexCount);
+
+			if (m_hasPositionBuffers)
+			{
+				m_meshGeometry[i] = pool->allocateShared(m_geometryHashes[i], vertices, indices, m_pendingBuffers.positions.subspan(m_positionRanges[i].vertexOffset, m_positionRanges[i].vertexNum),
+					m_pendingBuffers.positionIndices.subspan(range.indexOffset, indexCount));
+			}
+			else
+			{
+				m_meshGeometry[i] = pool->allocateShared(m_geometryHashes[i], vertices, indices, {}, {});
+			}
+		}
+
+		m_pendingBuffers = {};
+	}
+	int Model::getIndexEnd(int meshIndex) const
+	{
+		const MeshLods& lods = m_lods[meshIndex];
+		const MeshRange& last = lods.ranges.empty() ? m_ranges[meshIndex] : lods.ranges.back();
+		return last.indexOffset + last.indexNum;
+	}
+	void Model::setVertexBufferForIA(int meshIndex)
+	{
+		GeometryPool::getInstancePtr()->setVertexBufferForIA(D3D::getInstancePtr()->getDeviceContext(), *m_meshGeometry[meshIndex]);
+	}
+	void Model::setIndexBufferForIA(int meshIndex)
+	{
+		GeometryPool::getInstancePtr()->setIndexBufferForIA(D3D::getInstancePtr()->getDeviceContext(), *m_meshGeometry[meshIndex]);
+	}
+	bool Model::hasPositionBuffers() const
+	{
+		return m_hasPositionBuffers;
+	}
+	bool Model::hasIndices() const
+	{
+		return m_hasIndices;
+	}
+	Model::MeshRange Model::getDrawRange(int index, uint32_t lod, bool isPositionOnly) const
+	{
+		const GeometryPool& pool = *GeometryPool::getInstancePtr();
+		const GeometryAllocation& geometry = *m_meshGeometry[index];
+
+		MeshRange range = getMeshRange(index, lod);
+		range.indexOffset += int(pool.getIndexOffset(geometry)) - m_ranges[index].indexOffset;
+		if (isPositionOnly)
+		{
+			DEV_ASSERT(hasPositionBuffers());
+			range.vertexOffset = int(pool.getPositionOffset(geometry));
+			range.vertexNum = m_positionRanges[index].vertexNum;
 		}
-		
-		auto device = D3D::getInstancePtr()->getDevice();
-		m_vertices.createVertexBuffer(vertices.size(), vertices.data(), device);
-		if (!indices.empty())
+		else
 		{
-			m_indices.createIndexBuffer(indices.size(), indices.data(), device);
+			range.vertexOffset = int(pool.getVertexOffset(geometry));
 		}
+		return range;
+	}
+	Model::GeometryAllocation::GeometryAllocation(GeometryAllocation&& other) noexcept
+		: vertices(other.vertices), indices(other.indices), positions(other.positions)
+	{
+		other.vertices = other.indices = other.positions = RangeAllocator::INVALID_HANDLE;
 	}
-	void Model::setVertexBufferForIA()
+	Model::GeometryAllocation& Model::GeometryAllocation::operator=(GeometryAllocation&& other) noexcept
 	{
-		m_vertices.setVertexBufferForInputAssembler(D3D::getInstancePtr()->getDeviceContext());
+		if (this != &other)
+		{
+			GeometryAllocation previous(std::move(*this)); // freed at the end of the scope
+			vertices = other.vertices;
+			indices = other.indices;
+			positions = other.positions;
+			other.vertices = other.indices = other.positions = RangeAllocator::INVALID_HANDLE;
+		}
+		return *this;
 	}
-	void Model::setIndexBufferForIA()
+	Model::GeometryAllocation::~GeometryAllocation()
 	{
-		m_indices.setIndexBufferForInputAssembler(D3D::getInstancePtr()->getDeviceContext());
+		// models still referenced when the pool is deleted at shutdown just let go of their ranges
+		GeometryPool* pool = GeometryPool::getInstancePtr();
+		if (pool && (vertices != RangeAllocator::INVALID_HANDLE || indices != RangeAllocator::INVALID_HANDLE || positions != RangeAllocator::INVALID_HANDLE))
+		{
+			pool->free(*this);
+		}
 	}
 	const Mesh& Model::getMesh(int index) const
 	{
@@ -55,6 +314,19 @@ namespace Engine
 	{
 		return m_ranges[index];
 	}
+	uint32_t Model::getLodCount(int meshIndex) const
+	{
+		return meshIndex < int(m_lods.size()) ? uint32_t(m_lods[meshIndex].ranges.size()) + 1 : 1;
+	}
+	const Model::MeshRange& Model::getMeshRange(int index, uint32_t lod) const
+	{
+		DEV_ASSERT(lod < getLodCount(index));
+		return lod == 0 ? m_ranges[index] : m_lods[index].ranges[lod - 1];
+	}
+	std::span<const float> Model::getLodErrors(int meshIndex) const
+	{
+		return meshIndex < int(m_lods.size()) ? std::span<const float>(m_lods[meshIndex].errors) : std::span<const float>();
+	}
 	const math::Box& Model::getBoundingBox() const
 	{
 		return boundingBox;
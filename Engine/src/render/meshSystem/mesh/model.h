@@ -1,17 +1,29 @@
 #pragma once
 #include "mesh.h"
+#include "../../../math/packedVertex.h"
+#include "../../../utils/allocators/rangeAllocator.h"
+#include <memory>
+#include <span>
 #include <string>
 #include "../../Direct3d/buffer.h"
 
+// Vertex buffers of models hold math::PackedVertex instead of math::Vertex, Mesh::vertices stay full precision either way.
+// Also passed to shaders, which pick the matching vs_in layout in vertex.hlsl.
+#define PACKED_VERTICES 1
+
 namespace Engine
 {
 	class ModelManager;
+	class ModelCache;
+	class GeometryPool;
 	template<typename T, typename K>
 	class ShadingGroup;
 
 	class Model
 	{
 		friend ModelManager;
+		friend ModelCache;
+		friend GeometryPool;
 		template<typename T, typename K>
 		friend class ShadingGroup;
 
@@ -23,23 +35,110 @@ namespace Engine
 			int vertexNum;
 			int indexNum;
 		};
-		
+
+#if PACKED_VERTICES
+		using GPUVertex = math::PackedVertex;
+#else
+		using GPUVertex = math::Vertex;
+#endif
+
+		// per-vertex elements of input layouts of shaders drawing model vertex buffers, in slot 0
+		static std::vector<D3D11_INPUT_ELEMENT_DESC> getVertexInputElements();
+		// per-vertex elements of the position stream for depth passes, also matches the first element of the full vertex buffers
+		static std::vector<D3D11_INPUT_ELEMENT_DESC> getPositionInputElements();
+
 		void createVertexBuffer();
-		void setVertexBufferForIA();
-		void setIndexBufferForIA();
+		// Bind the ranges of a mesh in GeometryPool, so draws of it use offsets relative to getMeshRange(meshIndex), 0 for the mesh itself.
+		// Passes drawing many models bind GeometryPool once and use getDrawRange instead.
+		void setVertexBufferForIA(int meshIndex = 0);
+		void setIndexBufferForIA(int meshIndex = 0);
 
 		const std::vector<Mesh>& getMeshes() const;
 		const Mesh& getMesh(int index) const;
 		const MeshRange& getMeshRange(int index) const;
 
+		// LODs share the vertex range of their mesh, lod 0 is the full resolution mesh and getLodCount is 1 for meshes without LODs
+		uint32_t getLodCount(int meshIndex) const;
+		const MeshRange& getMeshRange(int index, uint32_t lod) const;
+		// errors of LOD 1 and coarser, for LodSelection::selectLod
+		std::span<const float> getLodErrors(int meshIndex) const;
+
+		// Position-only copy of the vertices for depth passes, vertices differing only in other attributes are merged in it.
+		// Its indices have the same layout as the main ones, only the vertex ranges of meshes differ. Empty for models without indices.
+		bool hasPositionBuffers() const;
+		bool hasIndices() const;
+
+		// Offsets of a mesh or LOD in the buffers of GeometryPool, in its position stream if isPositionOnly. They change when
+		// GeometryPool compacts its buffers, so they are only valid until the next model creates its buffers.
+		// Meshes with the same content in other models may have the same offsets, see GeometryPool::allocateShared.
+		MeshRange getDrawRange(int index, uint32_t lod, bool isPositionOnly) const;
+
 		const math::Box& getBoundingBox() const;
+
+		// false for placeholders returned by ModelManager::getModelAsync until the model is loaded and its GPU buffers are created
+		bool isReady() const
+		{
+			return m_isReady;
+		}
 	private:
+		// Concatenated vertex and index arrays waiting for createBuffers, owner keeps the memory they reference alive.
+		struct PendingBuffers
+		{
+			std::span<const GPUVertex> vertices;
+			std::span<const unsigned int> indices;
+			std::span<const math::Vec3f> positions;
+			std::span<const unsigned int> positionIndices;
+			std::shared_ptr<const void> owner;
+		};
+
 		std::vector<Mesh> m_meshes;
+		// LOD 1 and coarser of a mesh (see Mesh::lods), their indices follow the indices of the mesh in the index range of the model
+		struct MeshLods
+		{
+			std::vector<MeshRange> ranges;
+			std::vector<float> errors;
+		};
+
+		// Ranges of a mesh in GeometryPool, returned to it on destruction. Position indices share the range of the indices.
+		struct GeometryAllocation
+		{
+			RangeAllocator::Handle vertices = RangeAllocator::INVALID_HANDLE;
+			RangeAllocator::Handle indices = RangeAllocator::INVALID_HANDLE;
+			RangeAllocator::Handle positions = RangeAllocator::INVALID_HANDLE;
+
+			GeometryAllocation() = default;
+			GeometryAllocation(GeometryAllocation&& other) noexcept;
+			GeometryAllocation& operator=(GeometryAllocation&& other) noexcept;
+			~GeometryAllocation();
+		};
+
 		std::vector<MeshRange> m_ranges;
-		Buffer<math::Vertex> m_vertices;
-		Buffer<unsigned int> m_indices;
+		std::vector<MeshLods> m_lods;
+
+		// Vertex ranges of meshes in the position stream, the index ranges are the ones of m_ranges. The triangles of every
+		// mesh and LOD range are ordered for the vertex cache again, since merging vertices creates more reuse.
+		std::vector<MeshRange> m_positionRanges;
+
+		// Content of the vertices and indices of every mesh, including LODs and the position stream. Meshes with equal hashes share their ranges in GeometryPool once their arrays compare equal too.
+		std::vector<uint64_t> m_geometryHashes;
+		// indices into the ranges start at the index offset of the mesh in m_ranges, vertices at 0
+		std::vector<std::shared_ptr<const GeometryAllocation>> m_meshGeometry;
+		bool m_hasIndices = false;
+		bool m_hasPositionBuffers = false;
+
+		PendingBuffers m_pendingBuffers;
+		bool m_isReady = true;
 
 		std::string name;
 		math::Box boundingBox;
+
+		// CPU part of createVertexBuffer, fills m_ranges, m_lods, m_positionRanges, m_geometryHashes and m_pendingBuffers and may run on any thread
+		void prepareBuffers();
+
+		// uploads m_pendingBuffers to GeometryPool mesh by mesh and releases them, render thread only
+		void createBuffers();
+
+		// indices of a mesh followed by the ones of its LODs, the same range of the position indices belongs to the mesh as well
+		int getIndexEnd(int meshIndex) const;
 	};
 }
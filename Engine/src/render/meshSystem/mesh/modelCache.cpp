@@ -0,0 +1,498 @@
+#include "modelCache.h"
+#include "model.h"
+#include "../../../utils/hash.h"
+#include "../../../utils/mappedFile.h"
+#include "../../../utils/assert.h"
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+
+namespace Engine
+{
+	const uint32_t ModelCache::MAGIC = 0x4C444F4D; // "MODL"
+	const uint32_t ModelCache::VERSION = 6;
+	const uint32_t ModelCache::DATA_ALIGNMENT = 64;
+
+	// file-local, TriangleBVHCache uses the same names for its own layout
+	namespace
+	{
+		// The file starts with FileHeader followed by one MeshEntry per mesh, the arrays follow at DATA_ALIGNMENT aligned offsets.
+		// Vertices and indices are stored concatenated in mesh order, exactly as Model::createVertexBuffer uploads them (before packing, see PACKED_VERTICES).
+		// The LOD indices of a mesh follow its own indices and are described by an array of LodEntry per mesh, meshlets are stored as they are.
+		// The position stream of the depth passes follows, with its own vertex ranges and the index ranges of the main buffers.
+		// Like TriangleBVHCache files, these are only valid on machines with the same endianness and type layouts.
+		struct FileHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			uint64_t paramsHash; // import settings and sizes of the stored types
+			uint64_t fileSize; // detects truncated files
+
+			int64_t sourceWriteTime;
+			uint64_t sourceSize;
+			uint64_t sourceHash;
+
+			uint64_t verticesOffset;
+			uint64_t indicesOffset;
+			uint64_t positionsOffset;
+			uint64_t positionIndicesOffset; // indexCount indices
+			uint32_t vertexCount;
+			uint32_t indexCount;
+			uint32_t positionCount;
+			uint32_t meshCount;
+			math::Box boundingBox;
+		};
+
+		struct MeshEntry
+		{
+			uint64_t nameOffset;
+			uint64_t instancesOffset;
+			uint64_t instancesInvOffset;
+			uint64_t lodsOffset;
+			uint64_t meshletsOffset;
+			uint32_t nameLength;
+			uint32_t instanceCount;
+			uint32_t lodCount;
+			uint32_t meshletCount;
+			Model::MeshRange range;
+			Model::MeshRange positionRange;
+			math::Box boundingBox;
+			math::Sphere boundingSphere;
+			math::OrientedBox orientedBox;
+			math::KDop hull;
+			uint64_t geometryHash; // see Model::m_geometryHashes
+		};
+
+		struct LodEntry
+		{
+			Model::MeshRange range;
+			float error;
+		};
+
+		inline uint64_t alignOffset(uint64_t offset)
+		{
+			return (offset + ModelCache::DATA_ALIGNMENT - 1) / ModelCache::DATA_ALIGNMENT * ModelCache::DATA_ALIGNMENT;
+		}
+
+		inline bool isRangeValid(uint64_t offset, uint64_t size, uint64_t fileSize)
+		{
+			return offset % ModelCache::DATA_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+		}
+
+		inline uint64_t computeParamsHash(uint64_t importParamsHash)
+		{
+			uint64_t hash = mixHash(importParamsHash, sizeof(math::Vertex));
+			hash = mixHash(hash, sizeof(math::Vec3f));
+			hash = mixHash(hash, sizeof(Mesh::Meshlet));
+			hash = mixHash(hash, sizeof(math::Mat4f));
+			return mixHash(hash, sizeof(math::Box));
+		}
+
+		inline bool hashFile(const std::string& filePath, uint64_t& outHash)
+		{
+			std::error_code error;
+			if (std::filesystem::file_size(filePath, error) == 0 && !error)
+			{
+				outHash = hashBytes(nullptr, 0);
+				return true;
+			}
+
+			std::shared_ptr<const MappedFile> file = MappedFile::open(filePath);
+			if (!file)
+			{
+				return false;
+			}
+
+			outHash = hashBytes(file->data(), file->size());
+			return true;
+		}
+
+		// Comparing the write time and size is enough in most cases. Hashing the content as well catches files that were
+		// rewritten or checked out again with the same content, without reimporting them. outWriteTime is the current write time,
+		// which differs from the stored one only if the content hash matched.
+		inline bool isSourceUnchanged(const std::string& sourcePath, const FileHeader& header, int64_t& outWriteTime)
+		{
+			std::error_code error;
+			uint64_t size = std::filesystem::file_size(sourcePath, error);
+			if (error || size != header.sourceSize)
+			{
+				return false;
+			}
+
+			auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+			if (error)
+			{
+				return false;
+			}
+
+			outWriteTime = int64_t(writeTime.time_since_epoch().count());
+			if (outWriteTime == header.sourceWriteTime)
+			{
+				return true;
+			}
+
+			uint64_t hash;
+			return hashFile(sourcePath, hash) && hash == header.sourceHash;
+		}
+
+		// Stores the write time of a touched source in place, so it's hashed once instead of on every load.
+		// The file may be mapped at the same time, failing to write it just means hashing again next time.
+		inline void updateSourceWriteTime(const std::string& cachePath, int64_t sourceWriteTime)
+		{
+			std::fstream stream(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+			if (stream)
+			{
+				stream.seekp(offsetof(FileHeader, sourceWriteTime));
+				stream.write(reinterpret_cast<const char*>(&sourceWriteTime), sizeof(sourceWriteTime));
+			}
+		}
+	}
+
+	std::string ModelCache::getCachePath(const std::string& assetPath)
+	{
+		return assetPath + ".modelcache";
+	}
+
+	std::shared_ptr<Model> ModelCache::load(const std::string& cachePath, const std::string& sourcePath, uint64_t importParamsHash)
+	{
+		std::shared_ptr<const MappedFile> file = MappedFile::open(cachePath);
+		if (!file || file->size() < sizeof(FileHeader))
+		{
+			return nullptr;
+		}
+
+		const FileHeader& header = *reinterpret_cast<const FileHeader*>(file->data());
+		int64_t sourceWriteTime = 0;
+		if (header.magic != MAGIC || header.version != VERSION || header.paramsHash != computeParamsHash(importParamsHash) ||
+			header.fileSize != file->size() ||
+			sizeof(FileHeader) + uint64_t(header.meshCount) * sizeof(MeshEntry) > file->size() ||
+			!isRangeValid(header.verticesOffset, uint64_t(header.vertexCount) * sizeof(math::Vertex), file->size()) ||
+			!isRangeValid(header.indicesOffset, uint64_t(header.indexCount) * sizeof(unsigned int), file->size()) ||
+			!isRangeValid(header.positionsOffset, uint64_t(header.positionCount) * sizeof(math::Vec3f), file->size()) ||
+			!isRangeValid(header.positionIndicesOffset, uint64_t(header.indexCount) * sizeof(unsigned int), file->size()) ||
+			!isSourceUnchanged(sourcePath, header, sourceWriteTime))
+		{
+			return nullptr;
+		}
+
+		const MeshEntry* entries = reinterpret_cast<const MeshEntry*>(file->data() + sizeof(FileHeader));
+		const math::Vertex* vertices = reinterpret_cast<const math::Vertex*>(file->data() + header.verticesOffset);
+		const unsigned int* indices = reinterpret_cast<const unsigned int*>(file->data() + header.indicesOffset);
+		const math::Vec3f* positions = reinterpret_cast<const math::Vec3f*>(file->data() + header.positionsOffset);
+		const unsigned int* positionIndices = reinterpret_cast<const unsigned int*>(file->data() + header.positionIndicesOffset);
+
+		// the model is only handed out once everything has been validated, so a broken file just falls back to importing
+		std::shared_ptr<Model> model(new Model());
+		model->boundingBox = header.boundingBox;
+		model->m_meshes.resize(header.meshCount);
+		model->m_ranges.resize(header.meshCount);
+		model->m_lods.resize(header.meshCount);
+		model->m_positionRanges.resize(header.meshCount);
+		model->m_geometryHashes.resize(header.meshCount);
+
+		for (uint32_t i = 0; i < header.meshCount; ++i)
+		{
+			const MeshEntry& entry = entries[i];
+			const Model::MeshRange& range = entry.range;
+			const Model::MeshRange& positionRange = entry.positionRange;
+
+			if (range.vertexOffset < 0 || range.vertexNum < 0 || range.indexOffset < 0 || range.indexNum < 0 || range.indexNum % 3 != 0 ||
+				uint64_t(range.vertexOffset) + range.vertexNum > header.vertexCount || uint64_t(range.indexOffset) + range.indexNum > header.indexCount ||
+				entry.nameOffset > file->size() || entry.nameLength > file->size() - entry.nameOffset ||
+				!isRangeValid(entry.instancesOffset, uint64_t(entry.instanceCount) * sizeof(math::Mat4f), file->size()) ||
+				!isRangeValid(entry.instancesInvOffset, uint64_t(entry.instanceCount) * sizeof(math::Mat4f), file->size()) ||
+				!isRangeValid(entry.lodsOffset, uint64_t(entry.lodCount) * sizeof(LodEntry), file->size()) ||
+				!isRangeValid(entry.meshletsOffset, uint64_t(entry.meshletCount) * sizeof(Mesh::Meshlet), file->size()) ||
+				positionRange.vertexOffset < 0 || positionRange.vertexNum < 0 || uint64_t(positionRange.vertexOffset) + positionRange.vertexNum > header.positionCount ||
+				positionRange.indexOffset != range.indexOffset || positionRange.indexNum != range.indexNum)
+			{
+				return nullptr;
+			}
+
+			// LODs share the vertex range of their mesh, the position indices of the same range have to be valid as well
+			auto isIndexRangeValid = [&header, &range, &positionRange, indices, positionIndices](const Model::MeshRange& indexRange)
+			{
+				if (indexRange.vertexOffset != range.vertexOffset || indexRange.vertexNum != range.vertexNum ||
+					indexRange.indexOffset < 0 || indexRange.indexNum < 0 || indexRange.indexNum % 3 != 0 ||
+					uint64_t(indexRange.indexOffset) + indexRange.indexNum > header.indexCount)
+				{
+					return false;
+				}
+				return std::all_of(indices + indexRange.indexOffset, indices + indexRange.indexOffset + indexRange.indexNum,
+						[&range](unsigned int index) { return index < unsigned(range.vertexNum); }) &&
+					std::all_of(positionIndices + indexRange.indexOffset, positionIndices + indexRange.indexOffset + indexRange.indexNum,
+						[&positionRange](unsigned int index) { return index < unsigned(positionRange.vertexNum); });
+			};
+			if (!isIndexRangeValid(range))
+			{
+				return nullptr;
+			}
+
+			Mesh& mesh = model->m_meshes[i];
+			model->m_ranges[i] = range;
+			model->m_positionRanges[i] = positionRange;
+			model->m_geometryHashes[i] = entry.geometryHash;
+
+			mesh.name.assign(reinterpret_cast<const char*>(file->data() + entry.nameOffset), entry.nameLength);
+			mesh.boundingBox = entry.boundingBox;
+			mesh.boundingSphere = entry.boundingSphere;
+			mesh.orientedBox = entry.orientedBox;
+			mesh.hull = entry.hull;
+
+			const math::Mat4f* instances = reinterpret_cast<const math::Mat4f*>(file->data() + entry.instancesOffset);
+			const math::Mat4f* instancesInv = reinterpret_cast<const math::Mat4f*>(file->data() + entry.instancesInvOffset);
+			mesh.instances.assign(instances, instances + entry.instanceCount);
+			mesh.instancesInv.assign(instancesInv, instancesInv + entry.instanceCount);
+
+			mesh.vertices.assign(vertices + range.vertexOffset, vertices + range.vertexOffset + range.vertexNum);
+
+			mesh.triangles.resize(range.indexNum / 3);
+			const unsigned int* meshIndices = indices + range.indexOffset;
+			for (size_t t = 0; t < mesh.triangles.size(); ++t)
+			{
+				math::Triangle& triangle = mesh.triangles[t];
+				for (int v = 0; v < 3; ++v)
+				{
+					triangle.vertexIndices[v] = int(meshIndices[t * 3 + v]);
+				}
+
+				triangle.verticesArray = mesh.vertices.data();
+				triangle.computeNormalVector();
+			}
+
+			const Mesh::Meshlet* meshlets = reinterpret_cast<const Mesh::Meshlet*>(file->data() + entry.meshletsOffset);
+			mesh.meshlets.assign(meshlets, meshlets + entry.meshletCount);
+			for (const auto& meshlet : mesh.meshlets)
+			{
+				if (uint64_t(meshlet.triangleOffset) + meshlet.triangleCount > mesh.triangles.size())
+				{
+					return nullptr;
+				}
+			}
+
+			const LodEntry* lods = reinterpret_cast<const LodEntry*>(file->data() + entry.lodsOffset);
+			Model::MeshLods& modelLods = model->m_lods[i];
+			mesh.lods.resize(entry.lodCount);
+			for (uint32_t lod = 0; lod < entry.lodCount; ++lod)
+			{
+				if (!isIndexRangeValid(lods[lod].range))
+				{
+					return nullptr;
+				}
+
+				const unsigned int* lodIndices = indices + lods[lod].range.indexOffset;
+				mesh.lods[lod].indices.assign(lodIndices, lodIndices + lods[lod].range.indexNum);
+				mesh.lods[lod].error = lods[lod].error;
+				modelLods.ranges.push_back(lods[lod].range);
+				modelLods.errors.push_back(lods[lod].error);
+			}
+		}
+
+#if PACKED_VERTICES
+		// the file keeps full precision vertices for Mesh::vertices, so the GPU copy is packed here and only the indices come from the mapping
+		struct Storage
+		{
+			std::shared_ptr<const MappedFile> file;
+			std::vector<math::PackedVertex> vertices;
+		};
+		auto storage = std::make_shared<Storage>();
+		storage->file = file;
+		storage->vertices.resize(header.vertexCount);
+		std::transform(vertices, vertices + header.vertexCount, storage->vertices.begin(), math::PackedVertex::pack);
+
+		model->m_pendingBuffers = { storage->vertices, { indices, header.indexCount }, { positions, header.positionCount }, { positionIndices, header.indexCount }, storage };
+#else
+		// the GPU buffers are created from the mapping, which stays alive until then
+		model->m_pendingBuffers = { { vertices, header.vertexCount }, { indices, header.indexCount }, { positions, header.positionCount }, { positionIndices, header.indexCount }, file };
+#endif
+
+		if (sourceWriteTime != header.sourceWriteTime)
+		{
+			updateSourceWriteTime(cachePath, sourceWriteTime);
+		}
+
+		return model;
+	}
+
+	bool ModelCache::save(const std::string& cachePath, const std::string& sourcePath, uint64_t importParamsHash, const Model& model)
+	{
+		DEV_ASSERT(model.m_ranges.size() == model.m_meshes.size() && model.m_lods.size() == model.m_meshes.size() && model.m_positionRanges.size() == model.m_meshes.size() &&
+			model.m_geometryHashes.size() == model.m_meshes.size());
+
+		std::error_code error;
+		uint64_t sourceSize = std::filesystem::file_size(sourcePath, error);
+		if (error)
+		{
+			return false;
+		}
+
+		auto sourceWriteTime = std::filesystem::last_write_time(sourcePath, error);
+		if (error)
+		{
+			return false;
+		}
+
+		FileHeader header = {};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.paramsHash = computeParamsHash(importParamsHash);
+		header.sourceWriteTime = int64_t(sourceWriteTime.time_since_epoch().count());
+		header.sourceSize = sourceSize;
+		header.meshCount = uint32_t(model.m_meshes.size());
+		header.boundingBox = model.boundingBox;
+
+		if (!hashFile(sourcePath, header.sourceHash))
+		{
+			return false;
+		}
+
+		std::vector<MeshEntry> entries(model.m_meshes.size());
+		uint64_t offset = sizeof(FileHeader) + entries.size() * sizeof(MeshEntry);
+
+		for (size_t i = 0; i < model.m_meshes.size(); ++i)
+		{
+			const Mesh& mesh = model.m_meshes[i];
+			MeshEntry& entry = entries[i];
+
+			entry.range = model.m_ranges[i];
+			entry.positionRange = model.m_positionRanges[i];
+			entry.boundingBox = mesh.boundingBox;
+			entry.boundingSphere = mesh.boundingSphere;
+			entry.orientedBox = mesh.orientedBox;
+			entry.hull = mesh.hull;
+			entry.geometryHash = model.m_geometryHashes[i];
+			DEV_ASSERT(entry.range.vertexOffset == int(header.vertexCount) && entry.range.vertexNum == int(mesh.vertices.size()));
+			DEV_ASSERT(entry.range.indexOffset == int(header.indexCount) && entry.range.indexNum == int(mesh.triangles.size() * 3));
+			DEV_ASSERT(mesh.instances.size() == mesh.instancesInv.size());
+			DEV_ASSERT(model.m_lods[i].ranges.size() == mesh.lods.size());
+
+			header.vertexCount += uint32_t(mesh.vertices.size());
+			header.indexCount += uint32_t(mesh.triangles.size() * 3);
+			for (const auto& lod : mesh.lods)
+			{
+				header.indexCount += uint32_t(lod.indices.size());
+			}
+
+			entry.instanceCount = uint32_t(mesh.instances.size());
+			entry.instancesOffset = alignOffset(offset);
+			entry.instancesInvOffset = alignOffset(entry.instancesOffset + entry.instanceCount * sizeof(math::Mat4f));
+			entry.lodCount = uint32_t(mesh.lods.size());
+			entry.lodsOffset = alignOffset(entry.instancesInvOffset + entry.instanceCount * sizeof(math::Mat4f));
+			entry.meshletCount = uint32_t(mesh.meshlets.size());
+			entry.meshletsOffset = alignOffset(entry.lodsOffset + entry.lodCount * sizeof(LodEntry));
+			entry.nameOffset = entry.meshletsOffset + entry.meshletCount * sizeof(Mesh::Meshlet);
+			entry.nameLength = uint32_t(mesh.name.size());
+			offset = entry.nameOffset + entry.nameLength;
+		}
+
+		header.verticesOffset = alignOffset(offset);
+		header.indicesOffset = alignOffset(header.verticesOffset + uint64_t(header.vertexCount) * sizeof(math::Vertex));
+
+		// the position stream is only kept in the pending buffers, which is why the model mustn't have created its buffers yet
+		const auto& positions = model.m_pendingBuffers.positions;
+		const auto& positionIndices = model.m_pendingBuffers.positionIndices;
+		DEV_ASSERT(positionIndices.size() == header.indexCount);
+		if (positionIndices.size() != header.indexCount)
+		{
+			return false;
+		}
+		header.positionCount = uint32_t(positions.size());
+		header.positionsOffset = alignOffset(header.indicesOffset + uint64_t(header.indexCount) * sizeof(unsigned int));
+		header.positionIndicesOffset = alignOffset(header.positionsOffset + uint64_t(header.positionCount) * sizeof(math::Vec3f));
+		header.fileSize = header.positionIndicesOffset + uint64_t(header.indexCount) * sizeof(unsigned int);
+
+		// written under a temporary name and renamed at the end, so an interrupted save never leaves a truncated cache behind
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+			if (!stream)
+			{
+				return false;
+			}
+
+			uint64_t written = 0;
+			auto write = [&stream, &written](const void* data, uint64_t size)
+			{
+				stream.write(static_cast<const char*>(data), std::streamsize(size));
+				written += size;
+			};
+
+			auto writeAt = [&stream, &written, &write](uint64_t offset, const void* data, uint64_t size)
+			{
+				const char zeros[DATA_ALIGNMENT] = {};
+				while (written < offset)
+				{
+					write(zeros, std::min<uint64_t>(offset - written, sizeof(zeros)));
+				}
+				write(data, size);
+			};
+
+			write(&header, sizeof(header));
+			write(entries.data(), entries.size() * sizeof(MeshEntry));
+
+			for (size_t i = 0; i < model.m_meshes.size(); ++i)
+			{
+				const Mesh& mesh = model.m_meshes[i];
+				writeAt(entries[i].instancesOffset, mesh.instances.data(), mesh.instances.size() * sizeof(math::Mat4f));
+				writeAt(entries[i].instancesInvOffset, mesh.instancesInv.data(), mesh.instancesInv.size() * sizeof(math::Mat4f));
+
+				std::vector<LodEntry> lods(mesh.lods.size());
+				for (size_t lod = 0; lod < lods.size(); ++lod)
+				{
+					lods[lod] = { model.m_lods[i].ranges[lod], mesh.lods[lod].error };
+				}
+				writeAt(entries[i].lodsOffset, lods.data(), lods.size() * sizeof(LodEntry));
+				writeAt(entries[i].meshletsOffset, mesh.meshlets.data(), mesh.meshlets.size() * sizeof(Mesh::Meshlet));
+				writeAt(entries[i].nameOffset, mesh.name.data(), mesh.name.size());
+			}
+
+			for (size_t i = 0; i < model.m_meshes.size(); ++i)
+			{
+				const Mesh& mesh = model.m_meshes[i];
+				writeAt(header.verticesOffset + uint64_t(model.m_ranges[i].vertexOffset) * sizeof(math::Vertex), mesh.vertices.data(), mesh.vertices.size() * sizeof(math::Vertex));
+			}
+
+			std::vector<unsigned int> indices;
+			for (size_t i = 0; i < model.m_meshes.size(); ++i)
+			{
+				const Mesh& mesh = model.m_meshes[i];
+
+				indices.clear();
+				for (const auto& triangle : mesh.triangles)
+				{
+					indices.insert(indices.end(), { unsigned(triangle.vertexIndices[0]), unsigned(triangle.vertexIndices[1]), unsigned(triangle.vertexIndices[2]) });
+				}
+				writeAt(header.indicesOffset + uint64_t(model.m_ranges[i].indexOffset) * sizeof(unsigned int), indices.data(), indices.size() * sizeof(unsigned int));
+
+				for (size_t lod = 0; lod < mesh.lods.size(); ++lod)
+				{
+					const auto& lodIndices = mesh.lods[lod].indices;
+					writeAt(header.indicesOffset + uint64_t(model.m_lods[i].ranges[lod].indexOffset) * sizeof(unsigned int), lodIndices.data(), lodIndices.size() * sizeof(unsigned int));
+				}
+			}
+
+			writeAt(header.positionsOffset, positions.data(), positions.size() * sizeof(math::Vec3f));
+			writeAt(header.positionIndicesOffset, positionIndices.data(), positionIndices.size() * sizeof(unsigned int));
+
+			// pads the file up to the aligned offset of trailing empty arrays
+			writeAt(header.fileSize, nullptr, 0);
+
+			if (!stream)
+			{
+				stream.close();
+				std::filesystem::remove(tempPath, error);
+				return false;
+			}
+		}
+
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		return true;
+	}
+}
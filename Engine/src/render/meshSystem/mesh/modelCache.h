@@ -0,0 +1,33 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Engine
+{
+	class Model;
+
+	// Final state of an imported Model (meshes, mesh ranges, LODs, meshlets, instances, bounding volumes, geometry hashes and the concatenated vertex and index arrays)
+	// in a versioned binary file next to the source asset. Loading maps the file and the GPU buffers are later created from it,
+	// so warm starts don't need the importer at all. Loading doesn't touch the GPU, so it may run on any thread.
+	// The cache is valid while the source file keeps its write time and size, or, if it was only touched, its content hash.
+	// The write time of a touched source is then updated in the cache header, so the content isn't hashed again on later loads.
+	// Files referenced by the source asset (e.g. external buffers) aren't tracked.
+	class ModelCache
+	{
+	public:
+		const static uint32_t MAGIC;
+		const static uint32_t VERSION;
+		const static uint32_t DATA_ALIGNMENT;
+
+		static std::string getCachePath(const std::string& assetPath);
+
+		// importParamsHash identifies the import settings the cached model was produced with.
+		// Returns nullptr if the file is missing, stale or was written with other settings, the caller is expected to import and save the model then.
+		static std::shared_ptr<Model> load(const std::string& cachePath, const std::string& sourcePath, uint64_t importParamsHash);
+
+		// The model must have its buffers prepared by Model::prepareBuffers and not created yet, the position stream is only kept until then.
+		// Failing to write the file isn't an error, the model will be imported on the next load.
+		static bool save(const std::string& cachePath, const std::string& sourcePath, uint64_t importParamsHash, const Model& model);
+	};
+}
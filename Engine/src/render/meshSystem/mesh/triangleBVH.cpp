@@ -0,0 +1,1872 @@
+#include "triangleBVH.h"
+#include "mesh.h"
+#include "../../../math/ray.h"
+#include "../../../math/intersection.h"
+#include "../../../math/sweep.h"
+#include "../../../utils/assert.h"
+#include "../../../utils/hash.h"
+#include "../../../utils/parallelExecutor.h"
+#include <algorithm>
+#include <array>
+#include <numeric>
+#include <bit>
+#include <cmath>
+#include <queue>
+
+namespace Engine
+{
+	const uint32_t TriangleBVH::BIN_COUNT = 16;
+	const uint32_t TriangleBVH::MAX_LEAF_TRIANGLES = 8;
+	const float TriangleBVH::TRAVERSAL_COST = 1.0f;
+	const uint32_t TriangleBVH::MAX_STACK_DEPTH = 64;
+	const uint32_t TriangleBVH::PARALLEL_CHUNK_TRIANGLES = 16 * 1024;
+	const uint32_t TriangleBVH::SUBTREES_PER_THREAD = 8;
+	const uint32_t TriangleBVH::MAX_WIDE_LEAF_TRIANGLES = 255;
+
+	constexpr float INF = std::numeric_limits<float>::infinity();
+
+	// Traversals postpone all but one child per level. Wide trees may get a few levels deeper than the binary tree
+	// they are collapsed from, as leaves with too many triangles for a WideNode are split on the way.
+	const uint32_t MAX_TRAVERSAL_STACK = 2 * TriangleBVH::MAX_STACK_DEPTH * (TriangleBVH::WIDE_NODE_WIDTH - 1);
+
+	// Scales the slab exit distance to cover rounding errors of the box test (Ize - "Robust BVH Ray Traversal"),
+	// otherwise rays grazing a box face, e.g. along a shared edge of flat geometry, could miss triangles the watertight test would hit.
+	constexpr float BOX_EXIT_SCALE = 1.0f + 2.0f * (3.0f * std::numeric_limits<float>::epsilon() * 0.5f) / (1.0f - 3.0f * std::numeric_limits<float>::epsilon() * 0.5f);
+
+	inline const math::Vec3f& getPos(const Mesh& mesh, uint32_t triangleIndex, uint32_t vertexIndex)
+	{
+		return mesh.vertices[mesh.triangles[triangleIndex].vertexIndices[vertexIndex]].position;
+	}
+
+	// Slab tests pick the near and the far face of every axis by the sign of the direction and skip NaN distances. A ray running
+	// in a face plane gets 0 * inf = NaN for that face, skipping it keeps the slab open, as the ray lies within it.
+
+	// returns distance to the entry point or INF if the box is missed or lies beyond tMax
+	inline float intersectNode(const TriangleBVH::Node& node, const math::Vec3f& origin, const math::Vec3f& invDirection, float tMax)
+	{
+		float tEnter = -INF;
+		float tExit = INF;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const bool isPositive = invDirection[axis] >= 0.0f;
+			const float tNear = ((isPositive ? node.min[axis] : node.max[axis]) - origin[axis]) * invDirection[axis];
+			const float tFar = ((isPositive ? node.max[axis] : node.min[axis]) - origin[axis]) * invDirection[axis];
+
+			// false for NaN
+			tEnter = tNear > tEnter ? tNear : tEnter;
+			tExit = tFar < tExit ? tFar : tExit;
+		}
+		tExit *= BOX_EXIT_SCALE;
+
+		if (tExit < tEnter || tExit < 0.0f || tEnter > tMax)
+		{
+			return INF;
+		}
+
+		return std::max(tEnter, 0.0f);
+	}
+
+	// packet version of intersectNode, returns the mask of lanes that hit the box before their tMax
+	inline uint32_t intersectNode(const TriangleBVH::Node& node, const math::simd::Vec3N& origin, const math::simd::Vec3N& invDirection, const math::simd::FloatN& tMax, math::simd::FloatN& outTEnter)
+	{
+		using namespace math::simd;
+
+		const FloatN* rayOrigin[3] = { &origin.x, &origin.y, &origin.z };
+		const FloatN* rayInvDirection[3] = { &invDirection.x, &invDirection.y, &invDirection.z };
+
+		// min and max return the second operand if either is NaN, so the NaN distances come first
+		FloatN tEnter = set1(0.0f);
+		FloatN tExit = set1(INF);
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const MaskN isPositive = *rayInvDirection[axis] >= set1(0.0f);
+			const FloatN t1 = (set1(node.min[axis]) - *rayOrigin[axis]) * *rayInvDirection[axis];
+			const FloatN t2 = (set1(node.max[axis]) - *rayOrigin[axis]) * *rayInvDirection[axis];
+
+			tEnter = max(select(isPositive, t1, t2), tEnter);
+			tExit = min(select(isPositive, t2, t1), tExit);
+		}
+		tExit = tExit * set1(BOX_EXIT_SCALE);
+
+		outTEnter = tEnter;
+		return moveMask((tEnter <= tExit) & (tEnter <= tMax));
+	}
+
+	// Per-ray setup of the watertight test (Woop, Benthin, Wald - "Watertight Ray/Triangle Intersection").
+	// The ray is sheared so that it points along +kz, which turns the edge tests into exact 2D sign tests.
+	struct WatertightRay
+	{
+		int kx, ky, kz;
+		float shearX, shearY, shearZ;
+		math::Vec3f origin;
+	};
+
+	inline WatertightRay makeWatertightRay(const math::Ray& ray)
+	{
+		WatertightRay result;
+
+		math::Vec3f absDirection = ray.direction.cwiseAbs();
+		result.kz = absDirection.x() > absDirection.y() ?
+			(absDirection.x() > absDirection.z() ? 0 : 2) :
+			(absDirection.y() > absDirection.z() ? 1 : 2);
+		result.kx = (result.kz + 1) % 3;
+		result.ky = (result.kx + 1) % 3;
+
+		// keeps the winding, so U, V, W have the same sign for front and back facing hits
+		if (ray.direction[result.kz] < 0.0f)
+		{
+			std::swap(result.kx, result.ky);
+		}
+
+		result.shearX = ray.direction[result.kx] / ray.direction[result.kz];
+		result.shearY = ray.direction[result.ky] / ray.direction[result.kz];
+		result.shearZ = 1.0f / ray.direction[result.kz];
+		result.origin = ray.origin;
+
+		return result;
+	}
+
+	// Tests one ray against simd::WIDTH consecutive triangles of the SoA streams starting at slot first.
+	// Returns the mask of triangles hit closer than tMax and their distances in outT.
+	inline uint32_t intersectTriangles(const WatertightRay& ray, const float* const streams[3][3], uint32_t first, const math::simd::FloatN& tMax, math::simd::FloatN& outT)
+	{
+		using namespace math::simd;
+
+		const FloatN shearX = set1(ray.shearX);
+		const FloatN shearY = set1(ray.shearY);
+
+		FloatN x[3], y[3], z[3];
+		for (int vertex = 0; vertex < 3; ++vertex)
+		{
+			FloatN px = load(streams[vertex][ray.kx] + first) - set1(ray.origin[ray.kx]);
+			FloatN py = load(streams[vertex][ray.ky] + first) - set1(ray.origin[ray.ky]);
+			FloatN pz = load(streams[vertex][ray.kz] + first) - set1(ray.origin[ray.kz]);
+
+			x[vertex] = px - shearX * pz;
+			y[vertex] = py - shearY * pz;
+			z[vertex] = pz;
+		}
+
+		FloatN U = x[2] * y[1] - y[2] * x[1];
+		FloatN V = x[0] * y[2] - y[0] * x[2];
+		FloatN W = x[1] * y[0] - y[1] * x[0];
+
+		const FloatN zero = set1(0.0f);
+		MaskN inside = ((U >= zero) & (V >= zero) & (W >= zero)) | ((U <= zero) & (V <= zero) & (W <= zero));
+
+		FloatN det = U + V + W;
+		FloatN T = (U * z[0] + V * z[1] + W * z[2]) * set1(ray.shearZ);
+		FloatN t = T / det;
+
+		MaskN hit = inside & (abs(det) > zero) & (t >= zero) & (t < tMax);
+
+		outT = t;
+		return moveMask(hit);
+	}
+
+	// box of this tree placed in the space of the other tree, axes are scaled by the half size of the box
+	struct OrientedBox
+	{
+		math::Vec3f center;
+		math::Vec3f axes[3];
+	};
+
+	inline OrientedBox transformNode(const TriangleBVH::Node& node, const math::Mat4f& transform)
+	{
+		math::Vec3f center = (node.min + node.max) / 2.0f;
+		math::Vec3f halfSize = (node.max - node.min) / 2.0f;
+
+		OrientedBox box;
+		box.center = (math::Vec4f(center.x(), center.y(), center.z(), 1.0f) * transform).head<3>();
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			box.axes[axis] = transform.row(axis).head<3>() * halfSize[axis];
+		}
+
+		return box;
+	}
+
+	// Separating axis test of a parallelepiped (affine transforms may shear the box) against an axis aligned node.
+	// Tests the face normals of both boxes and the cross products of their edges.
+	inline bool overlapsNode(const OrientedBox& box, const TriangleBVH::Node& node)
+	{
+		const math::Vec3f center = (node.min + node.max) / 2.0f;
+		const math::Vec3f halfSize = (node.max - node.min) / 2.0f;
+		const math::Vec3f offset = box.center - center;
+
+		auto isSeparating = [&box, &halfSize, &offset](const math::Vec3f& axis)
+		{
+			float boxRadius = std::abs(box.axes[0].dot(axis)) + std::abs(box.axes[1].dot(axis)) + std::abs(box.axes[2].dot(axis));
+			float nodeRadius = halfSize.dot(axis.cwiseAbs());
+			return std::abs(offset.dot(axis)) > boxRadius + nodeRadius;
+		};
+
+		for (int i = 0; i < 3; ++i)
+		{
+			if (isSeparating(math::Vec3f::Unit(i)) || isSeparating(box.axes[(i + 1) % 3].cross(box.axes[(i + 2) % 3])))
+			{
+				return false;
+			}
+		}
+
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				if (isSeparating(box.axes[i].cross(math::Vec3f::Unit(j))))
+				{
+					return false;
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// Separating axis test of one triangle against simd::WIDTH consecutive triangles of the SoA streams starting at slot first.
+	// Besides the 11 axes of the general case, the in-plane edge normals are tested as well, so coplanar triangles are handled too.
+	// Returns the mask of overlapping triangles, touching counts as overlapping.
+	inline uint32_t overlapTriangles(const math::Vec3f (&triangle)[3], const float* const streams[3][3], uint32_t first)
+	{
+		using namespace math::simd;
+
+		const Vec3N A[3] = { set1(triangle[0]), set1(triangle[1]), set1(triangle[2]) };
+
+		Vec3N B[3];
+		for (int vertex = 0; vertex < 3; ++vertex)
+		{
+			B[vertex] = { load(streams[vertex][0] + first), load(streams[vertex][1] + first), load(streams[vertex][2] + first) };
+		}
+
+		const Vec3N edgesA[3] = { A[1] - A[0], A[2] - A[1], A[0] - A[2] };
+		const Vec3N edgesB[3] = { B[1] - B[0], B[2] - B[1], B[0] - B[2] };
+		const Vec3N normalA = cross(edgesA[0], edgesA[1]);
+		const Vec3N normalB = cross(edgesB[0], edgesB[1]);
+
+		MaskN separated = set1(0.0f) > set1(0.0f);
+		auto testAxis = [&A, &B, &separated](const Vec3N& axis)
+		{
+			FloatN a0 = dot(axis, A[0]), a1 = dot(axis, A[1]), a2 = dot(axis, A[2]);
+			FloatN b0 = dot(axis, B[0]), b1 = dot(axis, B[1]), b2 = dot(axis, B[2]);
+
+			FloatN minA = min(min(a0, a1), a2), maxA = max(max(a0, a1), a2);
+			FloatN minB = min(min(b0, b1), b2), maxB = max(max(b0, b1), b2);
+
+			separated = separated | (maxA < minB) | (maxB < minA);
+		};
+
+		testAxis(normalA);
+		testAxis(normalB);
+
+		for (int i = 0; i < 3; ++i)
+		{
+			for (int j = 0; j < 3; ++j)
+			{
+				testAxis(cross(edgesA[i], edgesB[j]));
+			}
+
+			testAxis(cross(normalA, edgesA[i]));
+			testAxis(cross(normalB, edgesB[i]));
+		}
+
+		return ~moveMask(separated) & ((1u << WIDTH) - 1);
+	}
+
+	// Tests the triangles of a leaf in simd::WIDTH batches, closer hits update tMax and outHitSlot.
+	inline void intersectLeaf(const WatertightRay& ray, const float* const streams[3][3], uint32_t first, uint32_t count, float& tMax, uint32_t& outHitSlot)
+	{
+		const uint32_t end = first + count;
+		for (; first < end; first += math::simd::WIDTH)
+		{
+			math::simd::FloatN t;
+			uint32_t mask = intersectTriangles(ray, streams, first, math::simd::set1(tMax), t);
+			if (end - first < math::simd::WIDTH)
+			{
+				mask &= (1u << (end - first)) - 1;
+			}
+
+			if (mask)
+			{
+				float tLanes[math::simd::WIDTH];
+				math::simd::store(tLanes, t);
+
+				for (; mask; mask &= mask - 1)
+				{
+					uint32_t lane = std::countr_zero(mask);
+					if (tLanes[lane] < tMax)
+					{
+						tMax = tLanes[lane];
+						outHitSlot = first + lane;
+					}
+				}
+			}
+		}
+	}
+
+	inline bool occludesLeaf(const WatertightRay& ray, const float* const streams[3][3], uint32_t first, uint32_t count, const math::simd::FloatN& tMax)
+	{
+		const uint32_t end = first + count;
+		for (; first < end; first += math::simd::WIDTH)
+		{
+			math::simd::FloatN t;
+			uint32_t mask = intersectTriangles(ray, streams, first, tMax, t);
+			if (end - first < math::simd::WIDTH)
+			{
+				mask &= (1u << (end - first)) - 1;
+			}
+
+			if (mask)
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	// 2^exponent, exponents of WideNodes are kept in the range of normal floats
+	inline float getQuantizationScale(int exponent)
+	{
+		return std::bit_cast<float>(uint32_t(exponent + 127) << 23);
+	}
+
+	// Decodes the bounds of all children of a wide node and tests them against the ray at once. q * 2^exponent is exact,
+	// so the decoded bounds are bit-exact with the ones checked to be conservative during the build.
+	// Returns the mask of existing children entered before tMax and their entry distances in outTEnter.
+	inline uint32_t intersectChildren(const TriangleBVH::WideNode& node, const math::simd::Vec3N& origin, const math::simd::Vec3N& invDirection, float tMax, math::simd::FloatN& outTEnter)
+	{
+		using namespace math::simd;
+
+		const FloatN* rayOrigin[3] = { &origin.x, &origin.y, &origin.z };
+		const FloatN* rayInvDirection[3] = { &invDirection.x, &invDirection.y, &invDirection.z };
+
+		FloatN tNear[3], tFar[3];
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const FloatN nodeOrigin = set1(node.origin[axis]);
+			const FloatN scale = set1(getQuantizationScale(node.exponents[axis]));
+
+			FloatN t1 = (nodeOrigin + loadBytes(node.bounds[axis]) * scale - *rayOrigin[axis]) * *rayInvDirection[axis];
+			FloatN t2 = (nodeOrigin + loadBytes(node.bounds[axis + 3]) * scale - *rayOrigin[axis]) * *rayInvDirection[axis];
+
+			const MaskN isPositive = *rayInvDirection[axis] >= set1(0.0f);
+			tNear[axis] = select(isPositive, t1, t2);
+			tFar[axis] = select(isPositive, t2, t1);
+		}
+
+		// NaN distances come first, see intersectNode
+		FloatN tEnter = max(tNear[0], max(tNear[1], max(tNear[2], set1(0.0f))));
+		FloatN tExit = min(tFar[0], min(tFar[1], min(tFar[2], set1(INF)))) * set1(BOX_EXIT_SCALE);
+
+		outTEnter = tEnter;
+		return moveMask((tEnter <= tExit) & (tEnter <= set1(tMax))) & node.childMask;
+	}
+
+	void TriangleBVH::initialize(const Mesh& mesh, Layout layout)
+	{
+		build(mesh, nullptr, layout);
+	}
+
+	void TriangleBVH::initialize(const Mesh& mesh, ParallelExecutor& executor, Layout layout)
+	{
+		build(mesh, &executor, layout);
+	}
+
+	// Calls func(chunkIndex, begin, end) for PARALLEL_CHUNK_TRIANGLES long chunks of [first, first + count).
+	// Without an executor or for short ranges the whole range is a single chunk processed on the calling thread.
+	inline uint32_t getChunkCount(ParallelExecutor* executor, uint32_t count)
+	{
+		return executor && count > TriangleBVH::PARALLEL_CHUNK_TRIANGLES ? (count + TriangleBVH::PARALLEL_CHUNK_TRIANGLES - 1) / TriangleBVH::PARALLEL_CHUNK_TRIANGLES : 1;
+	}
+
+	template<typename Func>
+	void forEachChunk(ParallelExecutor* executor, uint32_t first, uint32_t count, const Func& func)
+	{
+		uint32_t chunkCount = getChunkCount(executor, count);
+		if (chunkCount == 1)
+		{
+			func(0, first, first + count);
+			return;
+		}
+
+		executor->execute([first, count, &func](uint32_t threadIndex, uint32_t chunk)
+			{
+				uint32_t begin = first + chunk * TriangleBVH::PARALLEL_CHUNK_TRIANGLES;
+				func(chunk, begin, std::min(begin + TriangleBVH::PARALLEL_CHUNK_TRIANGLES, first + count));
+			}, chunkCount, 1);
+	}
+
+	void TriangleBVH::build(const Mesh& mesh, ParallelExecutor* executor, Layout layout)
+	{
+		clear();
+		m_mesh = &mesh;
+		m_layout = layout;
+
+		uint32_t triangleCount = uint32_t(mesh.triangles.size());
+		if (triangleCount == 0)
+		{
+			return;
+		}
+
+		std::vector<math::Box> triangleBounds(triangleCount);
+		std::vector<math::Vec3f> centroids(triangleCount);
+		forEachChunk(executor, 0, triangleCount, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					const math::Vec3f& V1 = getPos(mesh, i, 0);
+					const math::Vec3f& V2 = getPos(mesh, i, 1);
+					const math::Vec3f& V3 = getPos(mesh, i, 2);
+
+					triangleBounds[i] = { V1.cwiseMin(V2).cwiseMin(V3), V1.cwiseMax(V2).cwiseMax(V3) };
+					centroids[i] = (V1 + V2 + V3) / 3.0f;
+				}
+			});
+
+		m_triangleStorage.resize(triangleCount);
+		std::iota(m_triangleStorage.begin(), m_triangleStorage.end(), 0);
+
+		// a binary tree with N leaves has 2N - 1 nodes, so reserving it up front keeps node references valid during the build
+		m_nodeStorage.reserve(2 * triangleCount - 1);
+
+		Node& root = m_nodeStorage.emplace_back();
+		root.leftOrFirst = 0;
+		root.count = triangleCount;
+		updateNodeBounds(root, triangleBounds, executor);
+
+		if (!executor)
+		{
+			buildNodes(m_nodeStorage, { { 0, 1 } }, triangleBounds, centroids, nullptr, 0, nullptr);
+		}
+		else
+		{
+			// Nodes near the root are split one by one, each of them using all threads. Below subtreeSize triangles
+			// there are enough independent subtrees to keep the threads busy, so every subtree becomes a single-threaded task.
+			uint32_t subtreeSize = std::max(PARALLEL_CHUNK_TRIANGLES, triangleCount / (executor->numThreads() * SUBTREES_PER_THREAD));
+
+			std::vector<BuildEntry> subtreeRoots;
+			buildNodes(m_nodeStorage, { { 0, 1 } }, triangleBounds, centroids, executor, subtreeSize, &subtreeRoots);
+
+			// the largest subtrees go first, so that they don't end up being the last running tasks
+			std::sort(subtreeRoots.begin(), subtreeRoots.end(), [this](const BuildEntry& a, const BuildEntry& b)
+				{
+					return m_nodeStorage[a.node].count > m_nodeStorage[b.node].count;
+				});
+
+			std::vector<std::vector<Node>> subtrees(subtreeRoots.size());
+			executor->execute([&](uint32_t threadIndex, uint32_t taskIndex)
+				{
+					const Node& subtreeRoot = m_nodeStorage[subtreeRoots[taskIndex].node];
+
+					std::vector<Node>& nodes = subtrees[taskIndex];
+					nodes.reserve(2 * subtreeRoot.count - 1);
+					nodes.push_back(subtreeRoot);
+
+					buildNodes(nodes, { { 0, subtreeRoots[taskIndex].depth } }, triangleBounds, centroids, nullptr, 0, nullptr);
+				}, uint32_t(subtreeRoots.size()), 1);
+
+			// Subtree roots replace their placeholders, the other nodes are appended. Children of a subtree node at local index i > 0
+			// end up at base + i - 1, triangle ranges of leaves are already global.
+			for (size_t i = 0; i < subtrees.size(); ++i)
+			{
+				const std::vector<Node>& nodes = subtrees[i];
+				uint32_t base = uint32_t(m_nodeStorage.size());
+
+				auto relocate = [base](Node node)
+				{
+					if (!node.isLeaf())
+					{
+						node.leftOrFirst += base - 1;
+					}
+					return node;
+				};
+
+				m_nodeStorage[subtreeRoots[i].node] = relocate(nodes[0]);
+				for (size_t j = 1; j < nodes.size(); ++j)
+				{
+					m_nodeStorage.push_back(relocate(nodes[j]));
+				}
+			}
+		}
+
+		if (layout == Layout::QUANTIZED_WIDE)
+		{
+			// the binary tree is only an intermediate step, just its root is kept to start traversals from
+			Node root = m_nodeStorage[0];
+			if (!root.isLeaf() || root.count > MAX_WIDE_LEAF_TRIANGLES)
+			{
+				root.leftOrFirst = buildWideNode(root);
+				root.count = 0;
+			}
+
+			m_nodeStorage = { root };
+			m_wideNodeStorage.shrink_to_fit();
+		}
+
+		m_nodeStorage.shrink_to_fit();
+
+		buildTriangleData(executor);
+
+		m_nodes = m_nodeStorage;
+		m_wideNodes = m_wideNodeStorage;
+		m_triangles = m_triangleStorage;
+		m_triangleData = m_triangleDataStorage;
+	}
+
+	void TriangleBVH::buildNodes(std::vector<Node>& nodes, std::vector<BuildEntry>&& toSplit, const std::vector<math::Box>& triangleBounds, const std::vector<math::Vec3f>& centroids,
+		ParallelExecutor* executor, uint32_t deferCount, std::vector<BuildEntry>* outDeferred)
+	{
+		while (!toSplit.empty())
+		{
+			BuildEntry entry = toSplit.back();
+			toSplit.pop_back();
+
+			Node& node = nodes[entry.node];
+			if (entry.depth >= MAX_STACK_DEPTH)
+			{
+				continue;
+			}
+
+			if (outDeferred && node.count <= deferCount)
+			{
+				outDeferred->push_back(entry);
+				continue;
+			}
+
+			int axis;
+			float splitPosition;
+			if (!findBestSplit(node, triangleBounds, centroids, executor, axis, splitPosition))
+			{
+				continue;
+			}
+
+			uint32_t first = node.leftOrFirst;
+			uint32_t last = first + node.count;
+			uint32_t* middle = std::partition(m_triangleStorage.data() + first, m_triangleStorage.data() + last,
+				[&centroids, axis, splitPosition](uint32_t triangle)
+				{
+					return centroids[triangle][axis] < splitPosition;
+				});
+
+			uint32_t leftCount = uint32_t(middle - m_triangleStorage.data()) - first;
+			if (leftCount == 0 || leftCount == node.count)
+			{
+				continue;
+			}
+
+			uint32_t leftIndex = uint32_t(nodes.size());
+
+			Node& left = nodes.emplace_back();
+			left.leftOrFirst = first;
+			left.count = leftCount;
+			updateNodeBounds(left, triangleBounds, executor);
+
+			Node& right = nodes.emplace_back();
+			right.leftOrFirst = first + leftCount;
+			right.count = node.count - leftCount;
+			updateNodeBounds(right, triangleBounds, executor);
+
+			node.leftOrFirst = leftIndex;
+			node.count = 0;
+
+			toSplit.push_back({ leftIndex, entry.depth + 1 });
+			toSplit.push_back({ leftIndex + 1, entry.depth + 1 });
+		}
+	}
+
+	void TriangleBVH::initialize(const Mesh& mesh, Layout layout, std::span<const Node> nodes, std::span<const WideNode> wideNodes, std::span<const uint32_t> triangles,
+		std::span<const float> triangleData, uint32_t triangleStride, std::shared_ptr<const void> storageOwner)
+	{
+		DEV_ASSERT(triangles.size() == mesh.triangles.size());
+		DEV_ASSERT(triangleData.size() == 9 * size_t(triangleStride));
+
+		clear();
+		m_mesh = &mesh;
+
+		m_layout = layout;
+		m_nodes = nodes;
+		m_wideNodes = wideNodes;
+		m_triangles = triangles;
+		m_triangleData = triangleData;
+		m_triangleStride = triangleStride;
+		m_externalStorage = std::move(storageOwner);
+	}
+
+	std::shared_ptr<const void> TriangleBVH::shareStorage()
+	{
+		if (!m_externalStorage)
+		{
+			// moving a vector keeps its buffer, so the views stay valid
+			struct Storage
+			{
+				std::vector<Node> nodes;
+				std::vector<WideNode> wideNodes;
+				std::vector<uint32_t> triangles;
+				std::vector<float> triangleData;
+			};
+			m_externalStorage = std::make_shared<const Storage>(Storage{ std::move(m_nodeStorage), std::move(m_wideNodeStorage), std::move(m_triangleStorage), std::move(m_triangleDataStorage) });
+
+			m_nodeStorage.clear();
+			m_wideNodeStorage.clear();
+			m_triangleStorage.clear();
+			m_triangleDataStorage.clear();
+		}
+		return m_externalStorage;
+	}
+
+	uint64_t TriangleBVH::computeContentHash(const Mesh& mesh)
+	{
+		uint64_t hash = mixHash(mesh.vertices.size(), mesh.triangles.size());
+
+		for (const auto& vertex : mesh.vertices)
+		{
+			hash = hashBytes(vertex.position.data(), sizeof(math::Vec3f), hash);
+		}
+
+		for (const auto& triangle : mesh.triangles)
+		{
+			hash = hashBytes(triangle.vertexIndices, sizeof(triangle.vertexIndices), hash);
+		}
+
+		return hash;
+	}
+
+	bool TriangleBVH::hasEqualContent(const Mesh& mesh, const Mesh& other)
+	{
+		return std::equal(mesh.vertices.begin(), mesh.vertices.end(), other.vertices.begin(), other.vertices.end(),
+				[](const math::Vertex& a, const math::Vertex& b) { return a.position == b.position; }) &&
+			std::equal(mesh.triangles.begin(), mesh.triangles.end(), other.triangles.begin(), other.triangles.end(),
+				[](const math::Triangle& a, const math::Triangle& b) { return std::equal(a.vertexIndices, a.vertexIndices + 3, b.vertexIndices); });
+	}
+
+	bool TriangleBVH::isBuiltFrom(const Mesh& mesh, std::span<const uint32_t> triangles, std::span<const float> triangleData, uint32_t triangleStride)
+	{
+		if (triangles.size() != mesh.triangles.size() || triangleStride < triangles.size() || triangleData.size() != 9 * size_t(triangleStride))
+		{
+			return false;
+		}
+
+		for (uint32_t slot = 0; slot < uint32_t(triangles.size()); ++slot)
+		{
+			if (triangles[slot] >= mesh.triangles.size())
+			{
+				return false;
+			}
+
+			for (int vertex = 0; vertex < 3; ++vertex)
+			{
+				const math::Vec3f& position = getPos(mesh, triangles[slot], vertex);
+				for (int axis = 0; axis < 3; ++axis)
+				{
+					if (triangleData[(vertex * 3 + axis) * triangleStride + slot] != position[axis])
+					{
+						return false;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	uint64_t TriangleBVH::computeBuildParamsHash(Layout layout)
+	{
+		uint64_t hash = mixHash(uint64_t(layout), BIN_COUNT);
+		hash = mixHash(hash, MAX_LEAF_TRIANGLES);
+		hash = mixHash(hash, std::bit_cast<uint32_t>(TRAVERSAL_COST));
+		hash = mixHash(hash, MAX_STACK_DEPTH);
+		hash = mixHash(hash, math::simd::WIDTH); // padding of the triangle streams
+		hash = mixHash(hash, sizeof(WideNode));
+		return mixHash(hash, sizeof(Node));
+	}
+
+	bool TriangleBVH::intersect(const math::Ray& ray, math::MeshIntersection& nearest) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		if (m_layout == Layout::QUANTIZED_WIDE)
+		{
+			return intersectWide(ray, nearest);
+		}
+
+		const math::Vec3f invDirection = ray.direction.cwiseInverse();
+		if (intersectNode(m_nodes[0], ray.origin, invDirection, nearest.t) == INF)
+		{
+			return false;
+		}
+
+		const WatertightRay watertightRay = makeWatertightRay(ray);
+		const float* const streams[3][3] =
+		{
+			{ getTriangleStream(0, 0), getTriangleStream(0, 1), getTriangleStream(0, 2) },
+			{ getTriangleStream(1, 0), getTriangleStream(1, 1), getTriangleStream(1, 2) },
+			{ getTriangleStream(2, 0), getTriangleStream(2, 1), getTriangleStream(2, 2) }
+		};
+
+		struct StackEntry
+		{
+			uint32_t node;
+			float t;
+		};
+
+		StackEntry stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+
+		uint32_t nodeIndex = 0;
+		uint32_t hitSlot = UINT32_MAX;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+
+			if (node.isLeaf())
+			{
+				intersectLeaf(watertightRay, streams, node.leftOrFirst, node.count, nearest.t, hitSlot);
+			}
+			else
+			{
+				uint32_t closer = node.leftOrFirst;
+				uint32_t farther = closer + 1;
+
+				float tCloser = intersectNode(m_nodes[closer], ray.origin, invDirection, nearest.t);
+				float tFarther = intersectNode(m_nodes[farther], ray.origin, invDirection, nearest.t);
+
+				if (tFarther < tCloser)
+				{
+					std::swap(closer, farther);
+					std::swap(tCloser, tFarther);
+				}
+
+				if (tCloser != INF)
+				{
+					if (tFarther != INF)
+					{
+						DEV_ASSERT(stackSize < MAX_STACK_DEPTH);
+						stack[stackSize++] = { farther, tFarther };
+					}
+
+					nodeIndex = closer;
+					continue;
+				}
+			}
+
+			// skipping postponed nodes that are already behind the nearest hit
+			while (stackSize > 0 && stack[stackSize - 1].t > nearest.t)
+			{
+				--stackSize;
+			}
+
+			if (stackSize == 0)
+			{
+				break;
+			}
+
+			nodeIndex = stack[--stackSize].node;
+		}
+
+		if (hitSlot == UINT32_MAX)
+		{
+			return false;
+		}
+
+		nearest.triangle = m_triangles[hitSlot];
+		nearest.position = ray(nearest.t);
+		nearest.normal = m_mesh->triangles[nearest.triangle].normal;
+
+		return true;
+	}
+
+	bool TriangleBVH::intersectWide(const math::Ray& ray, math::MeshIntersection& nearest) const
+	{
+		using namespace math::simd;
+
+		const Node& root = m_nodes[0];
+		const math::Vec3f invDirection = ray.direction.cwiseInverse();
+
+		float tRoot = intersectNode(root, ray.origin, invDirection, nearest.t);
+		if (tRoot == INF)
+		{
+			return false;
+		}
+
+		const Vec3N origin = set1(ray.origin);
+		const Vec3N invDirectionN = set1(invDirection);
+
+		const WatertightRay watertightRay = makeWatertightRay(ray);
+		const float* const streams[3][3] =
+		{
+			{ getTriangleStream(0, 0), getTriangleStream(0, 1), getTriangleStream(0, 2) },
+			{ getTriangleStream(1, 0), getTriangleStream(1, 1), getTriangleStream(1, 2) },
+			{ getTriangleStream(2, 0), getTriangleStream(2, 1), getTriangleStream(2, 2) }
+		};
+
+		// references a leaf range or a WideNode the same way children of a WideNode do
+		struct StackEntry
+		{
+			uint32_t leftOrFirst;
+			uint32_t count;
+			float t;
+		};
+
+		StackEntry stack[MAX_TRAVERSAL_STACK];
+		uint32_t stackSize = 0;
+
+		StackEntry entry = { root.leftOrFirst, root.count, tRoot };
+		uint32_t hitSlot = UINT32_MAX;
+
+		while (true)
+		{
+			if (entry.count > 0)
+			{
+				intersectLeaf(watertightRay, streams, entry.leftOrFirst, entry.count, nearest.t, hitSlot);
+			}
+			else
+			{
+				const WideNode& node = m_wideNodes[entry.leftOrFirst];
+
+				FloatN tEnter;
+				uint32_t mask = intersectChildren(node, origin, invDirectionN, nearest.t, tEnter);
+				if (mask)
+				{
+					float tLanes[WIDTH];
+					store(tLanes, tEnter);
+
+					// sorted from the farthest child, so the closest one is visited next and the rest is postponed in order
+					StackEntry hits[WIDE_NODE_WIDTH];
+					uint32_t hitCount = 0;
+					for (; mask; mask &= mask - 1)
+					{
+						uint32_t child = std::countr_zero(mask);
+						StackEntry hit = { node.children[child], node.counts[child], tLanes[child] };
+
+						uint32_t position = hitCount++;
+						for (; position > 0 && hits[position - 1].t < hit.t; --position)
+						{
+							hits[position] = hits[position - 1];
+						}
+						hits[position] = hit;
+					}
+
+					DEV_ASSERT(stackSize + hitCount - 1 <= MAX_TRAVERSAL_STACK);
+					for (uint32_t i = 0; i + 1 < hitCount; ++i)
+					{
+						stack[stackSize++] = hits[i];
+					}
+
+					entry = hits[hitCount - 1];
+					continue;
+				}
+			}
+
+			while (stackSize > 0 && stack[stackSize - 1].t > nearest.t)
+			{
+				--stackSize;
+			}
+
+			if (stackSize == 0)
+			{
+				break;
+			}
+
+			entry = stack[--stackSize];
+		}
+
+		if (hitSlot == UINT32_MAX)
+		{
+			return false;
+		}
+
+		nearest.triangle = m_triangles[hitSlot];
+		nearest.position = ray(nearest.t);
+		nearest.normal = m_mesh->triangles[nearest.triangle].normal;
+
+		return true;
+	}
+
+	bool TriangleBVH::occluded(const math::Ray& ray, float tMax) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		if (m_layout == Layout::QUANTIZED_WIDE)
+		{
+			return occludedWide(ray, tMax);
+		}
+
+		const math::Vec3f invDirection = ray.direction.cwiseInverse();
+		if (intersectNode(m_nodes[0], ray.origin, invDirection, tMax) == INF)
+		{
+			return false;
+		}
+
+		const WatertightRay watertightRay = makeWatertightRay(ray);
+		const float* const streams[3][3] =
+		{
+			{ getTriangleStream(0, 0), getTriangleStream(0, 1), getTriangleStream(0, 2) },
+			{ getTriangleStream(1, 0), getTriangleStream(1, 1), getTriangleStream(1, 2) },
+			{ getTriangleStream(2, 0), getTriangleStream(2, 1), getTriangleStream(2, 2) }
+		};
+		const math::simd::FloatN tMaxN = math::simd::set1(tMax);
+
+		// any hit ends the query, so children are visited in storage order without sorting them by distance
+		uint32_t stack[MAX_STACK_DEPTH];
+		uint32_t stackSize = 0;
+		uint32_t nodeIndex = 0;
+
+		while (true)
+		{
+			const Node& node = m_nodes[nodeIndex];
+
+			if (node.isLeaf())
+			{
+				if (occludesLeaf(watertightRay, streams, node.leftOrFirst, node.count, tMaxN))
+				{
+					return true;
+				}
+			}
+			else
+			{
+				uint32_t left = node.leftOrFirst;
+				uint32_t right = left + 1;
+
+				bool hitLeft = intersectNode(m_nodes[left], ray.origin, invDirection, tMax) != INF;
+				bool hitRight = intersectNode(m_nodes[right], ray.origin, invDirection, tMax) != INF;
+
+				if (hitLeft || hitRight)
+				{
+					if (hitLeft && hitRight)
+					{
+						DEV_ASSERT(stackSize < MAX_STACK_DEPTH);
+						stack[stackSize++] = right;
+					}
+
+					nodeIndex = hitLeft ? left : right;
+					continue;
+				}
+			}
+
+			if (stackSize == 0)
+			{
+				return false;
+			}
+
+			nodeIndex = stack[--stackSize];
+		}
+	}
+
+	bool TriangleBVH::occludedWide(const math::Ray& ray, float tMax) const
+	{
+		using namespace math::simd;
+
+		const Node& root = m_nodes[0];
+		const math::Vec3f invDirection = ray.direction.cwiseInverse();
+		if (intersectNode(root, ray.origin, invDirection, tMax) == INF)
+		{
+			return false;
+		}
+
+		const Vec3N origin = set1(ray.origin);
+		const Vec3N invDirectionN = set1(invDirection);
+
+		const WatertightRay watertightRay = makeWatertightRay(ray);
+		const float* const streams[3][3] =
+		{
+			{ getTriangleStream(0, 0), getTriangleStream(0, 1), getTriangleStream(0, 2) },
+			{ getTriangleStream(1, 0), getTriangleStream(1, 1), getTriangleStream(1, 2) },
+			{ getTriangleStream(2, 0), getTriangleStream(2, 1), getTriangleStream(2, 2) }
+		};
+		const FloatN tMaxN = set1(tMax);
+
+		struct StackEntry
+		{
+			uint32_t leftOrFirst;
+			uint32_t count;
+		};
+
+		StackEntry stack[MAX_TRAVERSAL_STACK];
+		uint32_t stackSize = 0;
+		stack[stackSize++] = { root.leftOrFirst, root.count };
+
+		while (stackSize > 0)
+		{
+			StackEntry entry = stack[--stackSize];
+
+			if (entry.count > 0)
+			{
+				if (occludesLeaf(watertightRay, streams, entry.leftOrFirst, entry.count, tMaxN))
+				{
+					return true;
+				}
+				continue;
+			}
+
+			const WideNode& node = m_wideNodes[entry.leftOrFirst];
+
+			FloatN tEnter;
+			uint32_t mask = intersectChildren(node, origin, invDirectionN, tMax, tEnter);
+
+			DEV_ASSERT(stackSize + std::popcount(mask) <= MAX_TRAVERSAL_STACK);
+			for (; mask; mask &= mask - 1)
+			{
+				uint32_t child = std::countr_zero(mask);
+				stack[stackSize++] = { node.children[child], node.counts[child] };
+			}
+		}
+
+		return false;
+	}
+
+	bool TriangleBVH::sphereCast(const math::Ray& ray, float radius, math::MeshIntersection& nearest) const
+	{
+		return castInternal(ray, nullptr, radius, nearest);
+	}
+
+	bool TriangleBVH::capsuleCast(const math::Ray& ray, const math::Vec3f& halfSegment, float radius, math::MeshIntersection& nearest) const
+	{
+		return castInternal(ray, &halfSegment, radius, nearest);
+	}
+
+	bool TriangleBVH::overlaps(const TriangleBVH& other, const math::Mat4f& toOther) const
+	{
+		return overlapInternal(other, toOther, nullptr);
+	}
+
+	void TriangleBVH::findOverlaps(const TriangleBVH& other, const math::Mat4f& toOther, std::vector<TrianglePair>& outPairs) const
+	{
+		overlapInternal(other, toOther, &outPairs);
+	}
+
+	bool TriangleBVH::closestPoint(const math::Vec3f& point, float maxDistance, math::MeshClosestPoint& outNearest) const
+	{
+		return closestPointInternal(point, nullptr, maxDistance, outNearest);
+	}
+
+	bool TriangleBVH::closestPoint(const math::Vec3f& point, const math::Mat4f& meshToWorld, float maxDistance, math::MeshClosestPoint& outNearest) const
+	{
+		return closestPointInternal(point, &meshToWorld, maxDistance, outNearest);
+	}
+
+	uint32_t TriangleBVH::intersect(const math::RayPacket& packet, uint32_t activeMask, math::MeshIntersection* nearest) const
+	{
+		using namespace math::simd;
+
+		if (m_nodes.empty() || activeMask == 0)
+		{
+			return 0;
+		}
+
+		const Vec3N origin = { load(packet.origin[0]), load(packet.origin[1]), load(packet.origin[2]) };
+		const Vec3N direction = { load(packet.direction[0]), load(packet.direction[1]), load(packet.direction[2]) };
+		const Vec3N invDirection = { set1(1.0f) / direction.x, set1(1.0f) / direction.y, set1(1.0f) / direction.z };
+
+		// inactive lanes get negative tMax, so they never pass a box or a triangle test
+		float tMaxLanes[math::RayPacket::SIZE];
+		for (uint32_t lane = 0; lane < math::RayPacket::SIZE; ++lane)
+		{
+			tMaxLanes[lane] = (activeMask & (1u << lane)) ? nearest[lane].t : -INF;
+		}
+		FloatN tMax = load(tMaxLanes);
+
+		uint32_t hitTriangles[math::RayPacket::SIZE];
+		uint32_t hitMask = 0;
+
+		FloatN tEnter;
+		uint32_t nodeMask = intersectNode(m_nodes[0], origin, invDirection, tMax, tEnter); // lanes entering the current node
+		if (nodeMask == 0)
+		{
+			return 0;
+		}
+
+		// Leaves are intersected lane by lane with the watertight test of the single ray traversal, which tests a ray against
+		// simd::WIDTH triangles at once, so rays along shared edges and through vertices hit exactly what single rays hit.
+		WatertightRay watertightRays[math::RayPacket::SIZE];
+		for (uint32_t mask = activeMask; mask; mask &= mask - 1)
+		{
+			uint32_t lane = std::countr_zero(mask);
+			watertightRays[lane] = makeWatertightRay(packet.get(lane));
+		}
+
+		const float* const streams[3][3] =
+		{
+			{ getTriangleStream(0, 0), getTriangleStream(0, 1), getTriangleStream(0, 2) },
+			{ getTriangleStream(1, 0), getTriangleStream(1, 1), getTriangleStream(1, 2) },
+			{ getTriangleStream(2, 0), getTriangleStream(2, 1), getTriangleStream(2, 2) }
+		};
+
+		Node stack[MAX_TRAVERSAL_STACK];
+		uint32_t stackSize = 0;
+		Node node = m_nodes[0];
+
+		while (true)
+		{
+			if (node.isLeaf())
+			{
+				store(tMaxLanes, tMax);
+				for (uint32_t mask = nodeMask; mask; mask &= mask - 1)
+				{
+					uint32_t lane = std::countr_zero(mask);
+
+					uint32_t hitSlot = UINT32_MAX;
+					intersectLeaf(watertightRays[lane], streams, node.leftOrFirst, node.count, tMaxLanes[lane], hitSlot);
+					if (hitSlot != UINT32_MAX)
+					{
+						hitMask |= 1u << lane;
+						hitTriangles[lane] = m_triangles[hitSlot];
+					}
+				}
+				tMax = load(tMaxLanes);
+			}
+			else
+			{
+				Node children[WIDE_NODE_WIDTH];
+				uint32_t childCount = getChildNodes(node, children);
+
+				uint32_t childMasks[WIDE_NODE_WIDTH];
+				FloatN childTEnter[WIDE_NODE_WIDTH];
+				for (uint32_t i = 0; i < childCount; ++i)
+				{
+					childMasks[i] = intersectNode(children[i], origin, invDirection, tMax, childTEnter[i]);
+				}
+
+				uint32_t order[WIDE_NODE_WIDTH];
+				for (uint32_t i = 0; i < childCount; ++i)
+				{
+					order[i] = i;
+				}
+
+				if (childCount == 2)
+				{
+					// the child that is closer for the majority of lanes hitting both is visited first
+					uint32_t bothMask = childMasks[0] & childMasks[1];
+					uint32_t secondFirstMask = moveMask(childTEnter[1] < childTEnter[0]) & bothMask;
+					if (bothMask == 0 ? childMasks[0] == 0 : std::popcount(secondFirstMask) * 2 > std::popcount(bothMask))
+					{
+						std::swap(order[0], order[1]);
+					}
+				}
+				else
+				{
+					// wide nodes are ordered by the nearest entry of any lane
+					float minTEnter[WIDE_NODE_WIDTH];
+					for (uint32_t i = 0; i < childCount; ++i)
+					{
+						float tLanes[WIDTH];
+						store(tLanes, childTEnter[i]);
+
+						minTEnter[i] = INF;
+						for (uint32_t mask = childMasks[i]; mask; mask &= mask - 1)
+						{
+							minTEnter[i] = std::min(minTEnter[i], tLanes[std::countr_zero(mask)]);
+						}
+					}
+
+					std::sort(order, order + childCount, [&minTEnter](uint32_t a, uint32_t b) { return minTEnter[a] < minTEnter[b]; });
+				}
+
+				// missed children are skipped, the rest is postponed in reverse order so the closest ones are popped first
+				uint32_t first = UINT32_MAX;
+				for (uint32_t i = childCount; i-- > 0;)
+				{
+					if (childMasks[order[i]] == 0)
+					{
+						continue;
+					}
+
+					if (first != UINT32_MAX)
+					{
+						DEV_ASSERT(stackSize < MAX_TRAVERSAL_STACK);
+						stack[stackSize++] = children[first];
+					}
+					first = order[i];
+				}
+
+				if (first != UINT32_MAX)
+				{
+					node = children[first];
+					nodeMask = childMasks[first];
+					continue;
+				}
+			}
+
+			// postponed nodes are tested again, as every lane's tMax may have shrunk since they were pushed
+			nodeMask = 0;
+			while (stackSize > 0 && nodeMask == 0)
+			{
+				node = stack[--stackSize];
+				nodeMask = intersectNode(node, origin, invDirection, tMax, tEnter);
+			}
+
+			if (nodeMask == 0)
+			{
+				break;
+			}
+		}
+
+		store(tMaxLanes, tMax);
+		for (uint32_t mask = hitMask; mask; mask &= mask - 1)
+		{
+			uint32_t lane = std::countr_zero(mask);
+			math::MeshIntersection& hit = nearest[lane];
+
+			hit.t = tMaxLanes[lane];
+			hit.triangle = hitTriangles[lane];
+			hit.position = packet.get(lane)(hit.t);
+			hit.normal = m_mesh->triangles[hit.triangle].normal;
+		}
+
+		return hitMask;
+	}
+
+	bool TriangleBVH::overlapInternal(const TriangleBVH& other, const math::Mat4f& toOther, std::vector<TrianglePair>* outPairs) const
+	{
+		if (m_nodes.empty() || other.m_nodes.empty())
+		{
+			return false;
+		}
+
+		const float* const otherStreams[3][3] =
+		{
+			{ other.getTriangleStream(0, 0), other.getTriangleStream(0, 1), other.getTriangleStream(0, 2) },
+			{ other.getTriangleStream(1, 0), other.getTriangleStream(1, 1), other.getTriangleStream(1, 2) },
+			{ other.getTriangleStream(2, 0), other.getTriangleStream(2, 1), other.getTriangleStream(2, 2) }
+		};
+
+		struct NodePair
+		{
+			Node node;
+			Node otherNode;
+		};
+
+		// the number of pending pairs isn't bounded by the depth of the trees, so the stack can grow
+		std::vector<NodePair> stack;
+		stack.reserve(2 * MAX_STACK_DEPTH);
+		stack.push_back({ m_nodes[0], other.m_nodes[0] });
+
+		bool found = false;
+
+		while (!stack.empty())
+		{
+			NodePair pair = stack.back();
+			stack.pop_back();
+
+			const Node& node = pair.node;
+			const Node& otherNode = pair.otherNode;
+
+			if (!overlapsNode(transformNode(node, toOther), otherNode))
+			{
+				continue;
+			}
+
+			if (node.isLeaf() && otherNode.isLeaf())
+			{
+				const uint32_t otherEnd = otherNode.leftOrFirst + otherNode.count;
+
+				for (uint32_t slot = node.leftOrFirst; slot < node.leftOrFirst + node.count; ++slot)
+				{
+					math::Vec3f triangle[3];
+					for (int vertex = 0; vertex < 3; ++vertex)
+					{
+						math::Vec3f position = getTriangleVertex(slot, vertex);
+						triangle[vertex] = (math::Vec4f(position.x(), position.y(), position.z(), 1.0f) * toOther).head<3>();
+					}
+
+					for (uint32_t first = otherNode.leftOrFirst; first < otherEnd; first += math::simd::WIDTH)
+					{
+						uint32_t mask = overlapTriangles(triangle, otherStreams, first);
+						if (otherEnd - first < math::simd::WIDTH)
+						{
+							mask &= (1u << (otherEnd - first)) - 1;
+						}
+
+						if (mask == 0)
+						{
+							continue;
+						}
+
+						if (!outPairs)
+						{
+							return true;
+						}
+
+						found = true;
+						for (; mask; mask &= mask - 1)
+						{
+							outPairs->push_back({ m_triangles[slot], other.m_triangles[first + std::countr_zero(mask)] });
+						}
+					}
+				}
+
+				continue;
+			}
+
+			// descending into the bigger node keeps both boxes of a pair roughly the same size
+			bool descendThis = otherNode.isLeaf() ||
+				(!node.isLeaf() && math::Box{ node.min, node.max }.transformed(toOther).surfaceArea() > math::Box{ otherNode.min, otherNode.max }.surfaceArea());
+
+			Node children[WIDE_NODE_WIDTH];
+			if (descendThis)
+			{
+				uint32_t childCount = getChildNodes(node, children);
+				for (uint32_t i = 0; i < childCount; ++i)
+				{
+					stack.push_back({ children[i], otherNode });
+				}
+			}
+			else
+			{
+				uint32_t childCount = other.getChildNodes(otherNode, children);
+				for (uint32_t i = 0; i < childCount; ++i)
+				{
+					stack.push_back({ node, children[i] });
+				}
+			}
+		}
+
+		return found;
+	}
+
+	bool TriangleBVH::castInternal(const math::Ray& ray, const math::Vec3f* halfSegment, float radius, math::MeshIntersection& nearest) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		// a node can only be touched if the shape center passes through the node expanded by the shape extent
+		const math::Vec3f extent = halfSegment ? math::Vec3f(halfSegment->cwiseAbs().array() + radius) : math::Vec3f(radius, radius, radius);
+		auto intersectExpandedNode = [&ray, &extent, invDirection = math::Vec3f(ray.direction.cwiseInverse())](Node node, float tMax)
+		{
+			node.min -= extent;
+			node.max += extent;
+			return intersectNode(node, ray.origin, invDirection, tMax);
+		};
+
+		if (intersectExpandedNode(m_nodes[0], nearest.t) == INF)
+		{
+			return false;
+		}
+
+		struct StackEntry
+		{
+			Node node;
+			float t;
+		};
+
+		StackEntry stack[MAX_TRAVERSAL_STACK];
+		uint32_t stackSize = 0;
+
+		Node node = m_nodes[0];
+		uint32_t hitSlot = UINT32_MAX;
+
+		while (true)
+		{
+			if (node.isLeaf())
+			{
+				for (uint32_t slot = node.leftOrFirst; slot < node.leftOrFirst + node.count; ++slot)
+				{
+					const math::Vec3f V1 = getTriangleVertex(slot, 0);
+					const math::Vec3f V2 = getTriangleVertex(slot, 1);
+					const math::Vec3f V3 = getTriangleVertex(slot, 2);
+
+					bool hit = halfSegment ?
+						math::sweepCapsule(ray, *halfSegment, radius, V1, V2, V3, nearest) :
+						math::sweepSphere(ray, radius, V1, V2, V3, nearest);
+
+					if (hit)
+					{
+						hitSlot = slot;
+					}
+				}
+			}
+			else
+			{
+				Node children[WIDE_NODE_WIDTH];
+				uint32_t childCount = getChildNodes(node, children);
+
+				// sorted from the farthest child, children at equal distances keep their storage order
+				StackEntry hits[WIDE_NODE_WIDTH];
+				uint32_t hitCount = 0;
+				for (uint32_t i = 0; i < childCount; ++i)
+				{
+					float t = intersectExpandedNode(children[i], nearest.t);
+					if (t == INF)
+					{
+						continue;
+					}
+
+					uint32_t position = hitCount++;
+					for (; position > 0 && hits[position - 1].t <= t; --position)
+					{
+						hits[position] = hits[position - 1];
+					}
+					hits[position] = { children[i], t };
+				}
+
+				if (hitCount > 0)
+				{
+					DEV_ASSERT(stackSize + hitCount - 1 <= MAX_TRAVERSAL_STACK);
+					for (uint32_t i = 0; i + 1 < hitCount; ++i)
+					{
+						stack[stackSize++] = hits[i];
+					}
+
+					node = hits[hitCount - 1].node;
+					continue;
+				}
+			}
+
+			while (stackSize > 0 && stack[stackSize - 1].t > nearest.t)
+			{
+				--stackSize;
+			}
+
+			if (stackSize == 0)
+			{
+				break;
+			}
+
+			node = stack[--stackSize].node;
+		}
+
+		if (hitSlot == UINT32_MAX)
+		{
+			return false;
+		}
+
+		nearest.triangle = m_triangles[hitSlot];
+		return true;
+	}
+
+	bool TriangleBVH::closestPointInternal(const math::Vec3f& point, const math::Mat4f* meshToWorld, float maxDistance, math::MeshClosestPoint& outNearest) const
+	{
+		if (m_nodes.empty())
+		{
+			return false;
+		}
+
+		auto getNodeDistance = [&point, meshToWorld](const Node& node)
+		{
+			math::Box bounds = { node.min, node.max };
+			return (meshToWorld ? bounds.transformed(*meshToWorld) : bounds).squaredDistance(point);
+		};
+
+		auto getVertex = [this, meshToWorld](uint32_t slot, int vertex)
+		{
+			math::Vec3f position = getTriangleVertex(slot, vertex);
+			return meshToWorld ? math::Vec3f((math::Vec4f(position.x(), position.y(), position.z(), 1.0f) * *meshToWorld).head<3>()) : position;
+		};
+
+		struct QueueEntry
+		{
+			float distance; // squared
+			Node node;
+
+			bool operator>(const QueueEntry& other) const
+			{
+				return distance > other.distance;
+			}
+		};
+
+		std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> queue;
+
+		float bestDistance = maxDistance * maxDistance;
+		uint32_t bestSlot = UINT32_MAX;
+
+		float rootDistance = getNodeDistance(m_nodes[0]);
+		if (rootDistance < bestDistance)
+		{
+			queue.push({ rootDistance, m_nodes[0] });
+		}
+
+		while (!queue.empty())
+		{
+			QueueEntry entry = queue.top();
+			queue.pop();
+
+			// every remaining node is at least as far as this one
+			if (entry.distance >= bestDistance)
+			{
+				break;
+			}
+
+			const Node& node = entry.node;
+			if (node.isLeaf())
+			{
+				for (uint32_t slot = node.leftOrFirst; slot < node.leftOrFirst + node.count; ++slot)
+				{
+					math::Vec3f barycentrics;
+					math::Vec3f position = math::Triangle::closestPoint(point, getVertex(slot, 0), getVertex(slot, 1), getVertex(slot, 2), barycentrics);
+
+					float distance = (position - point).squaredNorm();
+					if (distance < bestDistance)
+					{
+						bestDistance = distance;
+						bestSlot = slot;
+
+						outNearest.position = position;
+						outNearest.barycentrics = barycentrics;
+					}
+				}
+			}
+			else
+			{
+				Node children[WIDE_NODE_WIDTH];
+				uint32_t childCount = getChildNodes(node, children);
+
+				for (uint32_t i = 0; i < childCount; ++i)
+				{
+					float distance = getNodeDistance(children[i]);
+					if (distance < bestDistance)
+					{
+						queue.push({ distance, children[i] });
+					}
+				}
+			}
+		}
+
+		if (bestSlot == UINT32_MAX)
+		{
+			return false;
+		}
+
+		outNearest.distance = std::sqrt(bestDistance);
+		outNearest.triangle = m_triangles[bestSlot];
+
+		return true;
+	}
+
+	uint32_t TriangleBVH::getChildNodes(const Node& node, Node* outChildren) const
+	{
+		DEV_ASSERT(!node.isLeaf());
+
+		if (m_layout == Layout::BINARY)
+		{
+			outChildren[0] = m_nodes[node.leftOrFirst];
+			outChildren[1] = m_nodes[node.leftOrFirst + 1];
+			return 2;
+		}
+
+		const WideNode& wideNode = m_wideNodes[node.leftOrFirst];
+
+		uint32_t childCount = 0;
+		for (uint32_t mask = wideNode.childMask; mask; mask &= mask - 1)
+		{
+			uint32_t child = std::countr_zero(mask);
+			Node& decoded = outChildren[childCount++];
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float scale = getQuantizationScale(wideNode.exponents[axis]);
+				decoded.min[axis] = wideNode.origin[axis] + float(wideNode.bounds[axis][child]) * scale;
+				decoded.max[axis] = wideNode.origin[axis] + float(wideNode.bounds[axis + 3][child]) * scale;
+			}
+
+			decoded.leftOrFirst = wideNode.children[child];
+			decoded.count = wideNode.counts[child];
+		}
+
+		return childCount;
+	}
+
+	uint32_t TriangleBVH::buildWideNode(const Node& node)
+	{
+		// leaves too big for the 8-bit triangle count are split into halves with the same bounds
+		auto canOpen = [](const Node& child)
+		{
+			return !child.isLeaf() || child.count > MAX_WIDE_LEAF_TRIANGLES;
+		};
+
+		auto open = [this](Node parent, Node& outLeft, Node& outRight)
+		{
+			if (!parent.isLeaf())
+			{
+				outLeft = m_nodeStorage[parent.leftOrFirst];
+				outRight = m_nodeStorage[parent.leftOrFirst + 1];
+			}
+			else
+			{
+				outLeft = outRight = parent;
+				outLeft.count = parent.count / 2;
+				outRight.leftOrFirst += outLeft.count;
+				outRight.count -= outLeft.count;
+			}
+		};
+
+		Node children[WIDE_NODE_WIDTH];
+		uint32_t childCount = 2;
+		open(node, children[0], children[1]);
+
+		// the child with the largest surface area is replaced by its own children until the node is full
+		while (childCount < WIDE_NODE_WIDTH)
+		{
+			uint32_t largest = UINT32_MAX;
+			float largestArea = -1.0f;
+			for (uint32_t i = 0; i < childCount; ++i)
+			{
+				float area = math::Box{ children[i].min, children[i].max }.surfaceArea();
+				if (canOpen(children[i]) && area > largestArea)
+				{
+					largest = i;
+					largestArea = area;
+				}
+			}
+
+			if (largest == UINT32_MAX)
+			{
+				break;
+			}
+
+			open(children[largest], children[largest], children[childCount++]);
+		}
+
+		uint32_t index = uint32_t(m_wideNodeStorage.size());
+		m_wideNodeStorage.emplace_back();
+
+		uint32_t childReferences[WIDE_NODE_WIDTH];
+		for (uint32_t i = 0; i < childCount; ++i)
+		{
+			childReferences[i] = canOpen(children[i]) ? buildWideNode(children[i]) : children[i].leftOrFirst;
+		}
+
+		// the recursion may have reallocated the storage
+		WideNode& wideNode = m_wideNodeStorage[index];
+		wideNode = {};
+
+		math::Box bounds = math::Box::empty();
+		for (uint32_t i = 0; i < childCount; ++i)
+		{
+			bounds.expand(math::Box{ children[i].min, children[i].max });
+		}
+		wideNode.origin = bounds.min;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			const float origin = wideNode.origin[axis];
+
+			// the smallest power of two step that covers the extent in 255 steps, increased while rounding pushes a child out of range
+			int exponent;
+			std::frexp((bounds.max[axis] - origin) / 255.0f, &exponent);
+			exponent = std::clamp(exponent, -126, 127);
+
+			for (;; ++exponent)
+			{
+				const float scale = getQuantizationScale(exponent);
+				bool fits = true;
+
+				for (uint32_t i = 0; i < childCount && fits; ++i)
+				{
+					// bounds are rounded outwards, checked with the same arithmetic the traversal decodes them with
+					int low = std::max(0, int(std::floor((children[i].min[axis] - origin) / scale)));
+					while (low > 0 && origin + float(low) * scale > children[i].min[axis])
+					{
+						--low;
+					}
+
+					int high = std::max(low, int(std::ceil((children[i].max[axis] - origin) / scale)));
+					while (high <= 255 && origin + float(high) * scale < children[i].max[axis])
+					{
+						++high;
+					}
+
+					fits = high <= 255;
+					wideNode.bounds[axis][i] = uint8_t(low);
+					wideNode.bounds[axis + 3][i] = uint8_t(high);
+				}
+
+				if (fits || exponent == 127)
+				{
+					DEV_ASSERT(fits);
+					wideNode.exponents[axis] = int8_t(exponent);
+					break;
+				}
+			}
+		}
+
+		for (uint32_t i = 0; i < childCount; ++i)
+		{
+			wideNode.childMask |= uint8_t(1u << i);
+			wideNode.counts[i] = canOpen(children[i]) ? 0 : uint8_t(children[i].count);
+			wideNode.children[i] = childReferences[i];
+		}
+
+		return index;
+	}
+
+	void TriangleBVH::buildTriangleData(ParallelExecutor* executor)
+	{
+		uint32_t triangleCount = uint32_t(m_triangleStorage.size());
+		m_triangleStride = triangleCount + math::simd::WIDTH;
+		m_triangleDataStorage.assign(9 * m_triangleStride, 0.0f);
+
+		forEachChunk(executor, 0, triangleCount, [this](uint32_t chunk, uint32_t begin, uint32_t end)
+			{
+				for (uint32_t slot = begin; slot < end; ++slot)
+				{
+					for (int vertex = 0; vertex < 3; ++vertex)
+					{
+						const math::Vec3f& position = getPos(*m_mesh, m_triangleStorage[slot], vertex);
+						for (int axis = 0; axis < 3; ++axis)
+						{
+							m_triangleDataStorage[(vertex * 3 + axis) * m_triangleStride + slot] = position[axis];
+						}
+					}
+				}
+			});
+	}
+
+	// leaves are tested simd::WIDTH triangles at once, so the SAH counts SIMD batches instead of triangles
+	inline float getLeafTestCount(uint32_t triangleCount)
+	{
+		return float((triangleCount + math::simd::WIDTH - 1) / math::simd::WIDTH);
+	}
+
+	void TriangleBVH::updateNodeBounds(Node& node, const std::vector<math::Box>& triangleBounds, ParallelExecutor* executor) const
+	{
+		std::vector<math::Box> chunkBounds(getChunkCount(executor, node.count), math::Box::empty());
+		forEachChunk(executor, node.leftOrFirst, node.count, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					chunkBounds[chunk].expand(triangleBounds[m_triangleStorage[i]]);
+				}
+			});
+
+		math::Box bounds = math::Box::empty();
+		for (const math::Box& box : chunkBounds)
+		{
+			bounds.expand(box);
+		}
+
+		node.min = bounds.min;
+		node.max = bounds.max;
+	}
+
+	bool TriangleBVH::findBestSplit(const Node& node, const std::vector<math::Box>& triangleBounds, const std::vector<math::Vec3f>& centroids, ParallelExecutor* executor, int& outAxis, float& outSplitPosition) const
+	{
+		struct Bin
+		{
+			math::Box bounds = math::Box::empty();
+			uint32_t count = 0;
+		};
+
+		using AxisBins = std::array<Bin, BIN_COUNT>;
+
+		// chunks collect centroid bounds and bins of all axes in separate passes, partial results are merged afterwards
+		uint32_t chunkCount = getChunkCount(executor, node.count);
+
+		std::vector<math::Box> chunkCentroidBounds(chunkCount, math::Box::empty());
+		forEachChunk(executor, node.leftOrFirst, node.count, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+			{
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					chunkCentroidBounds[chunk].expand(centroids[m_triangleStorage[i]]);
+				}
+			});
+
+		math::Box centroidBounds = math::Box::empty();
+		for (const math::Box& box : chunkCentroidBounds)
+		{
+			centroidBounds.expand(box);
+		}
+
+		math::Vec3f scale;
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			float extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			scale[axis] = extent > 0.0f ? BIN_COUNT / extent : 0.0f;
+		}
+
+		std::vector<std::array<AxisBins, 3>> chunkBins(chunkCount);
+		forEachChunk(executor, node.leftOrFirst, node.count, [&](uint32_t chunk, uint32_t begin, uint32_t end)
+			{
+				std::array<AxisBins, 3>& bins = chunkBins[chunk];
+				for (uint32_t i = begin; i < end; ++i)
+				{
+					uint32_t triangle = m_triangleStorage[i];
+					for (int axis = 0; axis < 3; ++axis)
+					{
+						uint32_t binIndex = std::min(BIN_COUNT - 1, uint32_t((centroids[triangle][axis] - centroidBounds.min[axis]) * scale[axis]));
+
+						bins[axis][binIndex].count++;
+						bins[axis][binIndex].bounds.expand(triangleBounds[triangle]);
+					}
+				}
+			});
+
+		float bestCost = INF;
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			if (scale[axis] == 0.0f)
+			{
+				continue;
+			}
+
+			AxisBins bins = chunkBins[0][axis];
+			for (uint32_t chunk = 1; chunk < chunkCount; ++chunk)
+			{
+				for (uint32_t i = 0; i < BIN_COUNT; ++i)
+				{
+					bins[i].count += chunkBins[chunk][axis][i].count;
+					bins[i].bounds.expand(chunkBins[chunk][axis][i].bounds);
+				}
+			}
+
+			float leftArea[BIN_COUNT - 1], rightArea[BIN_COUNT - 1];
+			uint32_t leftCount[BIN_COUNT - 1], rightCount[BIN_COUNT - 1];
+
+			math::Box leftBox = math::Box::empty();
+			math::Box rightBox = math::Box::empty();
+			uint32_t leftSum = 0, rightSum = 0;
+
+			for (uint32_t i = 0; i < BIN_COUNT - 1; ++i)
+			{
+				leftSum += bins[i].count;
+				leftCount[i] = leftSum;
+				leftBox.expand(bins[i].bounds);
+				leftArea[i] = leftSum ? leftBox.surfaceArea() : 0.0f;
+
+				rightSum += bins[BIN_COUNT - 1 - i].count;
+				rightCount[BIN_COUNT - 2 - i] = rightSum;
+				rightBox.expand(bins[BIN_COUNT - 1 - i].bounds);
+				rightArea[BIN_COUNT - 2 - i] = rightSum ? rightBox.surfaceArea() : 0.0f;
+			}
+
+			for (uint32_t i = 0; i < BIN_COUNT - 1; ++i)
+			{
+				if (leftCount[i] == 0 || rightCount[i] == 0)
+				{
+					continue;
+				}
+
+				float cost = getLeafTestCount(leftCount[i]) * leftArea[i] + getLeafTestCount(rightCount[i]) * rightArea[i];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					outAxis = axis;
+					outSplitPosition = centroidBounds.min[axis] + (i + 1) / scale[axis];
+				}
+			}
+		}
+
+		if (bestCost == INF)
+		{
+			return false;
+		}
+
+		if (node.count <= MAX_LEAF_TRIANGLES)
+		{
+			math::Box nodeBounds = { node.min, node.max };
+			float splitCost = TRAVERSAL_COST + bestCost / nodeBounds.surfaceArea();
+			float leafCost = getLeafTestCount(node.count);
+
+			return splitCost < leafCost;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,248 @@
+#pragma once
+#include "../../../math/box.h"
+#include "../../../math/rayPacket.h"
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <vector>
+
+namespace Engine::math
+{
+	struct MeshClosestPoint;
+}
+
+namespace Engine
+{
+	struct Mesh;
+	struct ParallelExecutor;
+
+	class TriangleBVH
+	{
+	public:
+		// Children of an inner node are always stored next to each other, so a single index is enough for both of them.
+		struct Node
+		{
+			math::Vec3f min;
+			uint32_t leftOrFirst; // inner node - index of the left child, leaf - index of the first triangle in m_triangles
+			math::Vec3f max;
+			uint32_t count; // 0 for inner nodes
+
+			bool isLeaf() const
+			{
+				return count > 0;
+			}
+		};
+		static_assert(sizeof(Node) == 32);
+
+		// Node of the QUANTIZED_WIDE layout with up to WIDE_NODE_WIDTH children, so one SIMD test covers all of them.
+		// Child bounds are stored as 8-bit offsets from origin in units of 2^exponent, rounded outwards.
+		static constexpr uint32_t WIDE_NODE_WIDTH = math::simd::WIDTH;
+		struct WideNode
+		{
+			math::Vec3f origin;
+			int8_t exponents[3];
+			uint8_t childMask; // bit i is set if child i exists
+			uint8_t counts[WIDE_NODE_WIDTH]; // leaf child - number of triangles, inner child - 0
+			uint8_t bounds[6][WIDE_NODE_WIDTH]; // quantized min x, y, z and max x, y, z of every child
+			uint32_t children[WIDE_NODE_WIDTH]; // leaf child - index of the first triangle in m_triangles, inner child - index of its WideNode
+		};
+
+		// BINARY keeps full-float bounds in 32 bytes per node. QUANTIZED_WIDE collapses the built binary tree into WideNodes,
+		// which takes 2 (SSE) to 3 (AVX) times less node memory at the cost of slightly looser bounds.
+		enum class Layout : uint8_t
+		{
+			BINARY,
+			QUANTIZED_WIDE
+		};
+
+		struct TrianglePair
+		{
+			uint32_t triangle;
+			uint32_t otherTriangle;
+		};
+
+		TriangleBVH() = default;
+		TriangleBVH(const TriangleBVH&) = delete;
+		TriangleBVH& operator=(const TriangleBVH&) = delete;
+		TriangleBVH(TriangleBVH&&) noexcept = default;
+		TriangleBVH& operator=(TriangleBVH&&) noexcept = default;
+
+		const static uint32_t BIN_COUNT;
+		const static uint32_t MAX_LEAF_TRIANGLES;
+		const static float TRAVERSAL_COST;
+		const static uint32_t MAX_STACK_DEPTH;
+		const static uint32_t PARALLEL_CHUNK_TRIANGLES;
+		const static uint32_t SUBTREES_PER_THREAD;
+		const static uint32_t MAX_WIDE_LEAF_TRIANGLES;
+
+		void clear()
+		{
+			m_mesh = nullptr;
+			m_layout = Layout::BINARY;
+			m_nodes = {};
+			m_wideNodes = {};
+			m_triangles = {};
+			m_triangleData = {};
+			m_triangleStride = 0;
+
+			m_nodeStorage.clear();
+			m_wideNodeStorage.clear();
+			m_triangleStorage.clear();
+			m_triangleDataStorage.clear();
+			m_externalStorage.reset();
+		}
+
+		bool inited() const
+		{
+			return m_mesh != nullptr;
+		}
+
+		void initialize(const Mesh& mesh, Layout layout = Layout::BINARY);
+
+		// Parallel build with the same result as the serial one. Large nodes near the root are binned and bounded in chunks
+		// on the executor, once nodes get small enough the remaining subtrees are built as independent tasks and merged.
+		void initialize(const Mesh& mesh, ParallelExecutor& executor, Layout layout = Layout::BINARY);
+
+		// Uses arrays of a tree built earlier for the same mesh without copying them, e.g. from a memory mapped TriangleBVHCache file.
+		// storageOwner keeps the memory alive as long as the tree references it.
+		void initialize(const Mesh& mesh, Layout layout, std::span<const Node> nodes, std::span<const WideNode> wideNodes, std::span<const uint32_t> triangles,
+			std::span<const float> triangleData, uint32_t triangleStride, std::shared_ptr<const void> storageOwner);
+
+		// Moves the arrays of the tree into reference counted storage and returns it, unless they are external already. The tree keeps using them,
+		// and trees of meshes with the same content hash can use them too by passing it to initialize as storageOwner.
+		std::shared_ptr<const void> shareStorage();
+
+		// Identifies the input of the build, trees built from meshes with equal hashes are interchangeable.
+		static uint64_t computeContentHash(const Mesh& mesh);
+		static uint64_t computeBuildParamsHash(Layout layout);
+
+		// Compare what computeContentHash hashes, so trees are only shared between meshes that really are equal. hasEqualContent compares
+		// two meshes, isBuiltFrom checks the arrays of a tree against a mesh: every triangle must have the positions stored for its slot.
+		static bool hasEqualContent(const Mesh& mesh, const Mesh& other);
+		static bool isBuiltFrom(const Mesh& mesh, std::span<const uint32_t> triangles, std::span<const float> triangleData, uint32_t triangleStride);
+
+		Layout getLayout() const
+		{
+			return m_layout;
+		}
+		bool intersect(const math::Ray& ray, math::MeshIntersection& nearest) const;
+
+		// Any-hit query, returns true as soon as some triangle is hit in [0, tMax). Doesn't compute the hit position or normal.
+		bool occluded(const math::Ray& ray, float tMax) const;
+
+		// Sphere and capsule casts (see math/sweep.h), node bounds are expanded by the extent of the shape during traversal.
+		bool sphereCast(const math::Ray& ray, float radius, math::MeshIntersection& nearest) const;
+		bool capsuleCast(const math::Ray& ray, const math::Vec3f& halfSegment, float radius, math::MeshIntersection& nearest) const;
+
+		// Dual-tree overlap tests against another mesh, toOther maps this mesh space into the mesh space of the other one.
+		// Nodes of this tree are tested as oriented boxes against the axis aligned nodes of the other tree.
+		bool overlaps(const TriangleBVH& other, const math::Mat4f& toOther) const;
+		void findOverlaps(const TriangleBVH& other, const math::Mat4f& toOther, std::vector<TrianglePair>& outPairs) const;
+
+		// Closest point of the mesh to point, if it lies within maxDistance. Nodes are visited in the order of their distance
+		// and the search stops once the nearest remaining node is farther than the best point found.
+		bool closestPoint(const math::Vec3f& point, float maxDistance, math::MeshClosestPoint& outNearest) const;
+
+		// Same query for the mesh placed in the world by meshToWorld, point and the result are in world space.
+		bool closestPoint(const math::Vec3f& point, const math::Mat4f& meshToWorld, float maxDistance, math::MeshClosestPoint& outNearest) const;
+
+		// Traverses all rays of the packet together. Bit i of activeMask enables lane i, nearest must hold RayPacket::SIZE entries.
+		// Returns the mask of lanes whose nearest intersection was updated.
+		uint32_t intersect(const math::RayPacket& packet, uint32_t activeMask, math::MeshIntersection* nearest) const;
+
+		// the QUANTIZED_WIDE layout keeps only the root here, referencing the first WideNode unless it's a leaf
+		std::span<const Node> getNodes() const
+		{
+			return m_nodes;
+		}
+
+		std::span<const WideNode> getWideNodes() const
+		{
+			return m_wideNodes;
+		}
+
+		std::span<const uint32_t> getTriangles() const
+		{
+			return m_triangles;
+		}
+
+		std::span<const float> getTriangleData() const
+		{
+			return m_triangleData;
+		}
+
+		uint32_t getTriangleStride() const
+		{
+			return m_triangleStride;
+		}
+
+		// heap memory only, arrays referenced from external storage aren't counted
+		size_t getMemoryUsage() const
+		{
+			return m_nodeStorage.capacity() * sizeof(Node) + m_wideNodeStorage.capacity() * sizeof(WideNode) +
+				m_triangleStorage.capacity() * sizeof(uint32_t) + m_triangleDataStorage.capacity() * sizeof(float);
+		}
+
+	protected:
+		const Mesh* m_mesh = nullptr;
+
+		Layout m_layout = Layout::BINARY;
+
+		// Queries read the tree through these views, they point either to the storage vectors below or to m_externalStorage.
+		std::span<const Node> m_nodes;
+		std::span<const WideNode> m_wideNodes;
+		std::span<const uint32_t> m_triangles; // triangle indices reordered so that every leaf references a contiguous range
+
+		// Vertex positions of m_triangles as 9 float streams (vertex 0 x, y, z, vertex 1 x, ...), each m_triangleStride long.
+		// Streams are padded, so a SIMD load starting at any leaf triangle never reads past the end.
+		std::span<const float> m_triangleData;
+		uint32_t m_triangleStride = 0;
+
+		// moving a vector keeps its buffer, so the views stay valid when the tree is moved
+		std::vector<Node> m_nodeStorage;
+		std::vector<WideNode> m_wideNodeStorage;
+		std::vector<uint32_t> m_triangleStorage;
+		std::vector<float> m_triangleDataStorage;
+		std::shared_ptr<const void> m_externalStorage;
+
+		const float* getTriangleStream(int vertex, int axis) const
+		{
+			return m_triangleData.data() + (vertex * 3 + axis) * m_triangleStride;
+		}
+
+		math::Vec3f getTriangleVertex(uint32_t slot, int vertex) const
+		{
+			return { getTriangleStream(vertex, 0)[slot], getTriangleStream(vertex, 1)[slot], getTriangleStream(vertex, 2)[slot] };
+		}
+
+		struct BuildEntry
+		{
+			uint32_t node;
+			uint32_t depth;
+		};
+
+		// Children of an inner node as plain nodes in either layout, quantized bounds are decoded conservatively.
+		// Decoded inner children reference their WideNode. Returns the number of children, at most WIDE_NODE_WIDTH.
+		uint32_t getChildNodes(const Node& node, Node* outChildren) const;
+
+		// specialized traversals of the QUANTIZED_WIDE layout, testing all children of a node at once
+		bool intersectWide(const math::Ray& ray, math::MeshIntersection& nearest) const;
+		bool occludedWide(const math::Ray& ray, float tMax) const;
+
+		void build(const Mesh& mesh, ParallelExecutor* executor, Layout layout);
+		uint32_t buildWideNode(const Node& node);
+		void buildTriangleData(ParallelExecutor* executor);
+
+		// Splits nodes from toSplit recursively, appending children to nodes. Nodes with at most deferCount triangles
+		// are moved to outDeferred instead of being split, if it's provided.
+		void buildNodes(std::vector<Node>& nodes, std::vector<BuildEntry>&& toSplit, const std::vector<math::Box>& triangleBounds, const std::vector<math::Vec3f>& centroids,
+			ParallelExecutor* executor, uint32_t deferCount, std::vector<BuildEntry>* outDeferred);
+
+		bool overlapInternal(const TriangleBVH& other, const math::Mat4f& toOther, std::vector<TrianglePair>* outPairs) const;
+		bool castInternal(const math::Ray& ray, const math::Vec3f* halfSegment, float radius, math::MeshIntersection& nearest) const;
+		bool closestPointInternal(const math::Vec3f& point, const math::Mat4f* meshToWorld, float maxDistance, math::MeshClosestPoint& outNearest) const;
+
+		void updateNodeBounds(Node& node, const std::vector<math::Box>& triangleBounds, ParallelExecutor* executor) const;
+		bool findBestSplit(const Node& node, const std::vector<math::Box>& triangleBounds, const std::vector<math::Vec3f>& centroids, ParallelExecutor* executor, int& outAxis, float& outSplitPosition) const;
+	};
+}
@@ -0,0 +1,195 @@
+#include "triangleBVHCache.h"
+#include "mesh.h"
+#include "../../../utils/mappedFile.h"
+#include "../../../utils/assert.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+
+namespace Engine
+{
+	const uint32_t TriangleBVHCache::MAGIC = 0x48564254; // "TBVH"
+	const uint32_t TriangleBVHCache::VERSION = 2;
+	const uint32_t TriangleBVHCache::DATA_ALIGNMENT = 64;
+
+	// The file starts with FileHeader followed by one MeshEntry per mesh, the arrays of the trees follow at DATA_ALIGNMENT aligned offsets.
+	// Arrays are stored exactly as TriangleBVH keeps them in memory, so the file is only valid on machines with the same endianness.
+	struct FileHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t buildParamsHash; // includes the layout of the trees
+		uint64_t fileSize; // detects truncated files
+		uint32_t meshCount;
+		uint32_t padding;
+	};
+
+	struct MeshEntry
+	{
+		uint64_t contentHash;
+		uint64_t nodesOffset;
+		uint64_t wideNodesOffset;
+		uint64_t trianglesOffset;
+		uint64_t triangleDataOffset;
+		uint32_t nodeCount;
+		uint32_t wideNodeCount;
+		uint32_t triangleCount;
+		uint32_t triangleStride;
+	};
+
+	inline uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + TriangleBVHCache::DATA_ALIGNMENT - 1) / TriangleBVHCache::DATA_ALIGNMENT * TriangleBVHCache::DATA_ALIGNMENT;
+	}
+
+	inline bool isRangeValid(uint64_t offset, uint64_t size, uint64_t fileSize)
+	{
+		return offset % TriangleBVHCache::DATA_ALIGNMENT == 0 && offset <= fileSize && size <= fileSize - offset;
+	}
+
+	std::string TriangleBVHCache::getCachePath(const std::string& assetPath)
+	{
+		return assetPath + ".bvhcache";
+	}
+
+	bool TriangleBVHCache::load(const std::string& cachePath, std::vector<Mesh>& meshes, TriangleBVH::Layout layout)
+	{
+		std::shared_ptr<const MappedFile> file = MappedFile::open(cachePath);
+		if (!file || file->size() < sizeof(FileHeader))
+		{
+			return false;
+		}
+
+		const FileHeader& header = *reinterpret_cast<const FileHeader*>(file->data());
+		if (header.magic != MAGIC || header.version != VERSION || header.buildParamsHash != TriangleBVH::computeBuildParamsHash(layout) ||
+			header.fileSize != file->size() || header.meshCount != meshes.size() ||
+			sizeof(FileHeader) + uint64_t(header.meshCount) * sizeof(MeshEntry) > file->size())
+		{
+			return false;
+		}
+
+		const MeshEntry* entries = reinterpret_cast<const MeshEntry*>(file->data() + sizeof(FileHeader));
+
+		// everything is validated before the first tree is touched, so a mismatch leaves all meshes as they were
+		for (uint32_t i = 0; i < header.meshCount; ++i)
+		{
+			const MeshEntry& entry = entries[i];
+			const Mesh& mesh = meshes[i];
+
+			if (entry.triangleCount != mesh.triangles.size() || entry.nodeCount > 2 * uint64_t(entry.triangleCount) ||
+				(entry.nodeCount == 0) != (entry.triangleCount == 0) ||
+				!isRangeValid(entry.nodesOffset, uint64_t(entry.nodeCount) * sizeof(TriangleBVH::Node), file->size()) ||
+				!isRangeValid(entry.wideNodesOffset, uint64_t(entry.wideNodeCount) * sizeof(TriangleBVH::WideNode), file->size()) ||
+				!isRangeValid(entry.trianglesOffset, uint64_t(entry.triangleCount) * sizeof(uint32_t), file->size()) ||
+				!isRangeValid(entry.triangleDataOffset, 9 * uint64_t(entry.triangleStride) * sizeof(float), file->size()) ||
+				entry.contentHash != TriangleBVH::computeContentHash(mesh))
+			{
+				return false;
+			}
+		}
+
+		for (uint32_t i = 0; i < header.meshCount; ++i)
+		{
+			const MeshEntry& entry = entries[i];
+
+			meshes[i].bvh.initialize(meshes[i], layout,
+				{ reinterpret_cast<const TriangleBVH::Node*>(file->data() + entry.nodesOffset), entry.nodeCount },
+				{ reinterpret_cast<const TriangleBVH::WideNode*>(file->data() + entry.wideNodesOffset), entry.wideNodeCount },
+				{ reinterpret_cast<const uint32_t*>(file->data() + entry.trianglesOffset), entry.triangleCount },
+				{ reinterpret_cast<const float*>(file->data() + entry.triangleDataOffset), 9 * size_t(entry.triangleStride) },
+				entry.triangleStride, file);
+		}
+
+		return true;
+	}
+
+	bool TriangleBVHCache::save(const std::string& cachePath, const std::vector<Mesh>& meshes)
+	{
+		FileHeader header = {};
+		header.magic = MAGIC;
+		header.version = VERSION;
+		header.buildParamsHash = TriangleBVH::computeBuildParamsHash(meshes.empty() ? TriangleBVH::Layout::BINARY : meshes[0].bvh.getLayout());
+		header.meshCount = uint32_t(meshes.size());
+
+		std::vector<MeshEntry> entries(meshes.size());
+		uint64_t offset = sizeof(FileHeader) + entries.size() * sizeof(MeshEntry);
+
+		for (size_t i = 0; i < meshes.size(); ++i)
+		{
+			const TriangleBVH& bvh = meshes[i].bvh;
+			MeshEntry& entry = entries[i];
+
+			entry.contentHash = TriangleBVH::computeContentHash(meshes[i]);
+			DEV_ASSERT(bvh.getLayout() == meshes[0].bvh.getLayout());
+
+			entry.nodeCount = uint32_t(bvh.getNodes().size());
+			entry.wideNodeCount = uint32_t(bvh.getWideNodes().size());
+			entry.triangleCount = uint32_t(bvh.getTriangles().size());
+			entry.triangleStride = bvh.getTriangleStride();
+
+			entry.nodesOffset = alignOffset(offset);
+			entry.wideNodesOffset = alignOffset(entry.nodesOffset + bvh.getNodes().size_bytes());
+			entry.trianglesOffset = alignOffset(entry.wideNodesOffset + bvh.getWideNodes().size_bytes());
+			entry.triangleDataOffset = alignOffset(entry.trianglesOffset + bvh.getTriangles().size_bytes());
+			offset = entry.triangleDataOffset + bvh.getTriangleData().size_bytes();
+		}
+		header.fileSize = offset;
+
+		// written under a temporary name and renamed at the end, so an interrupted save never leaves a truncated cache behind
+		std::string tempPath = cachePath + ".tmp";
+		{
+			std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+			if (!stream)
+			{
+				return false;
+			}
+
+			uint64_t written = 0;
+			auto write = [&stream, &written](const void* data, uint64_t size)
+			{
+				stream.write(static_cast<const char*>(data), std::streamsize(size));
+				written += size;
+			};
+
+			auto writeAt = [&stream, &written, &write](uint64_t offset, const void* data, uint64_t size)
+			{
+				const char zeros[DATA_ALIGNMENT] = {};
+				while (written < offset)
+				{
+					write(zeros, std::min<uint64_t>(offset - written, sizeof(zeros)));
+				}
+				write(data, size);
+			};
+
+			write(&header, sizeof(header));
+			write(entries.data(), entries.size() * sizeof(MeshEntry));
+
+			for (size_t i = 0; i < meshes.size(); ++i)
+			{
+				const TriangleBVH& bvh = meshes[i].bvh;
+				writeAt(entries[i].nodesOffset, bvh.getNodes().data(), bvh.getNodes().size_bytes());
+				writeAt(entries[i].wideNodesOffset, bvh.getWideNodes().data(), bvh.getWideNodes().size_bytes());
+				writeAt(entries[i].trianglesOffset, bvh.getTriangles().data(), bvh.getTriangles().size_bytes());
+				writeAt(entries[i].triangleDataOffset, bvh.getTriangleData().data(), bvh.getTriangleData().size_bytes());
+			}
+
+			if (!stream)
+			{
+				stream.close();
+				std::error_code error;
+				std::filesystem::remove(tempPath, error);
+				return false;
+			}
+		}
+
+		std::error_code error;
+		std::filesystem::rename(tempPath, cachePath, error);
+		if (error)
+		{
+			std::filesystem::remove(tempPath, error);
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include "triangleBVH.h"
+#include <string>
+#include <vector>
+
+namespace Engine
+{
+	struct Mesh;
+
+	// Built TriangleBVHs of all meshes of a model, stored in a versioned binary file next to the source asset.
+	// On load the file is memory mapped and the trees reference its arrays directly, there is no deserialization pass.
+	// Every mesh is keyed by TriangleBVH::computeContentHash and the whole file by TriangleBVH::computeBuildParamsHash.
+	class TriangleBVHCache
+	{
+	public:
+		const static uint32_t MAGIC;
+		const static uint32_t VERSION;
+		const static uint32_t DATA_ALIGNMENT;
+
+		static std::string getCachePath(const std::string& assetPath);
+
+		// Initializes the BVHs of all meshes from the cache file. Returns false and leaves the meshes untouched
+		// if the file is missing, stale, built with another layout or doesn't match the meshes, the caller is expected to build and save the trees then.
+		static bool load(const std::string& cachePath, std::vector<Mesh>& meshes, TriangleBVH::Layout layout);
+
+		// All trees must have the same layout. Failing to write the file isn't an error, the trees will be rebuilt on the next load.
+		static bool save(const std::string& cachePath, const std::vector<Mesh>& meshes);
+	};
+}
@@ -1,11 +1,71 @@
 #include "meshSystem.h"
 #include "../../math/intersection.h"
 #include "../../objectMover/matrixMover.h"
+#include "../../utils/assert.h"
+#include <algorithm>
 
 namespace Engine
 {
 	MeshSystem* MeshSystem::s_instance = nullptr;
 
+	const uint32_t MeshSystem::RAYS_PER_BATCH = 64;
+
+	// spreads the lowest 10 bits of value so that there are two zero bits between each of them
+	inline uint32_t expandBits(uint32_t value)
+	{
+		value &= 0x3ff;
+		value = (value | (value << 16)) & 0x030000ff;
+		value = (value | (value << 8)) & 0x0300f00f;
+		value = (value | (value << 4)) & 0x030c30c3;
+		value = (value | (value << 2)) & 0x09249249;
+		return value;
+	}
+
+	// direction octant in the top bits, then the Morton code of the origin quantized inside the origins' bounds
+	inline uint32_t computeRaySortKey(const math::Ray& ray, const math::Vec3f& originsMin, const math::Vec3f& originsScale)
+	{
+		uint32_t octant = (ray.direction.x() < 0.0f ? 1u : 0u) | (ray.direction.y() < 0.0f ? 2u : 0u) | (ray.direction.z() < 0.0f ? 4u : 0u);
+
+		math::Vec3f cell = (ray.origin - originsMin).cwiseProduct(originsScale);
+		uint32_t morton = expandBits(uint32_t(cell.x())) | (expandBits(uint32_t(cell.y())) << 1) | (expandBits(uint32_t(cell.z())) << 2);
+
+		return (octant << 29) | (morton >> 3);
+	}
+
+	template <typename Group>
+	void gatherBVHInstances(Group& group, std::vector<InstanceBVH::Instance>& outInstances)
+	{
+		for (auto& perModel : group.getModels())
+		{
+			if (!perModel.model)
+			{
+				continue;
+			}
+
+			for (int meshIndex = 0; meshIndex < perModel.perMesh.size(); meshIndex++)
+			{
+				const Mesh& mesh = perModel.model->getMeshes()[meshIndex];
+				for (auto& perMaterial : perModel.perMesh[meshIndex].perMaterial)
+				{
+					for (auto& instance : perMaterial.instances)
+					{
+						outInstances.push_back(InstanceBVH::createInstance(mesh, instance.modelToWorldID, instance.objectID));
+					}
+				}
+			}
+		}
+	}
+
+	inline bool overlaps(const InstanceBVH::Instance& a, const InstanceBVH::Instance& b)
+	{
+		return a.worldBounds.overlaps(b.worldBounds) && a.mesh->bvh.overlaps(b.mesh->bvh, a.meshToWorld * b.worldToMesh);
+	}
+
+	MeshSystem::MeshSystem()
+		: m_parallelExecutor(ParallelExecutor::HALF_THREADS)
+	{
+	}
+
 	MeshSystem* MeshSystem::createInstance()
 	{
 		if (!s_instance)
@@ -32,19 +92,47 @@ namespace Engine
 	void MeshSystem::deinit()
 	{
 		deleteAllInstances();
+		m_instanceBVH.clear();
+		m_instanceBVHRevision = UINT32_MAX;
 	}
 
 	bool MeshSystem::findIntersection(const math::Ray& ray, MeshIntersectionQuery& outIntersection)
 	{
-		TransformSystem::ID matID;
-		int instanceNumber = -1;
+		updateInstanceBVH();
+
+		const InstanceBVH::Instance* instance = m_instanceBVH.intersect(ray, outIntersection.nearest);
+		if (instance)
+		{
+			outIntersection.objectID = instance->objectID;
+			if (outIntersection.mover)
+			{
+				outIntersection.mover->reset(new MatrixMover(instance->modelToWorldID));
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	bool MeshSystem::occluded(const math::Ray& ray, float tMax)
+	{
+		updateInstanceBVH();
+
+		return m_instanceBVH.occluded(ray, tMax);
+	}
+
+	bool MeshSystem::sphereCast(const math::Ray& ray, float radius, MeshIntersectionQuery& outIntersection)
+	{
+		updateInstanceBVH();
 
-		findIntersectionInternal(ray, matID, outIntersection.nearest, instanceNumber, outIntersection.objectID);
-		if (outIntersection.nearest.valid())
+		const InstanceBVH::Instance* instance = m_instanceBVH.sphereCast(ray, radius, outIntersection.nearest);
+		if (instance)
 		{
+			outIntersection.objectID = instance->objectID;
 			if (outIntersection.mover)
 			{
-				outIntersection.mover->reset(new MatrixMover(matID));
+				outIntersection.mover->reset(new MatrixMover(instance->modelToWorldID));
 			}
 
 			return true;
@@ -53,6 +141,144 @@ namespace Engine
 		return false;
 	}
 
+	bool MeshSystem::capsuleCast(const math::Ray& ray, const math::Vec3f& halfSegment, float radius, MeshIntersectionQuery& outIntersection)
+	{
+		updateInstanceBVH();
+
+		const InstanceBVH::Instance* instance = m_instanceBVH.capsuleCast(ray, halfSegment, radius, outIntersection.nearest);
+		if (instance)
+		{
+			outIntersection.objectID = instance->objectID;
+			if (outIntersection.mover)
+			{
+				outIntersection.mover->reset(new MatrixMover(instance->modelToWorldID));
+			}
+
+			return true;
+		}
+
+		return false;
+	}
+
+	bool MeshSystem::findClosestPoint(const math::Vec3f& point, float maxDistance, ClosestPointQuery& outQuery)
+	{
+		updateInstanceBVH();
+
+		const InstanceBVH::Instance* instance = m_instanceBVH.closestPoint(point, maxDistance, outQuery.nearest);
+		if (instance)
+		{
+			outQuery.objectID = instance->objectID;
+			outQuery.transformID = instance->modelToWorldID;
+
+			return true;
+		}
+
+		return false;
+	}
+
+	bool MeshSystem::overlaps(unsigned int objectA, unsigned int objectB)
+	{
+		updateInstanceBVH();
+
+		for (const auto& a : m_instanceBVH.getInstances())
+		{
+			if (a.objectID != objectA)
+			{
+				continue;
+			}
+
+			for (const auto& b : m_instanceBVH.getInstances())
+			{
+				if (b.objectID == objectB && Engine::overlaps(a, b))
+				{
+					return true;
+				}
+			}
+		}
+
+		return false;
+	}
+
+	void MeshSystem::findOverlappingObjects(unsigned int objectID, std::vector<unsigned int>& outObjectIDs)
+	{
+		updateInstanceBVH();
+
+		std::vector<const InstanceBVH::Instance*> candidates;
+		for (const auto& instance : m_instanceBVH.getInstances())
+		{
+			if (instance.objectID != objectID)
+			{
+				continue;
+			}
+
+			candidates.clear();
+			m_instanceBVH.findInstances(instance.worldBounds, candidates);
+
+			for (const InstanceBVH::Instance* candidate : candidates)
+			{
+				if (candidate->objectID == objectID || std::find(outObjectIDs.begin(), outObjectIDs.end(), candidate->objectID) != outObjectIDs.end())
+				{
+					continue;
+				}
+
+				if (Engine::overlaps(instance, *candidate))
+				{
+					outObjectIDs.push_back(candidate->objectID);
+				}
+			}
+		}
+	}
+
+	void MeshSystem::intersectBatch(std::span<const math::Ray> rays, std::span<RayHit> hits)
+	{
+		intersectBatch(rays, hits, m_parallelExecutor);
+	}
+
+	void MeshSystem::intersectBatch(std::span<const math::Ray> rays, std::span<RayHit> hits, ParallelExecutor& executor)
+	{
+		DEV_ASSERT(rays.size() == hits.size());
+
+		// the BVH is only read by the worker threads
+		updateInstanceBVH();
+
+		uint32_t rayCount = uint32_t(rays.size());
+		if (rayCount == 0)
+		{
+			return;
+		}
+
+		math::Box originsBounds = math::Box::empty();
+		for (const math::Ray& ray : rays)
+		{
+			originsBounds.expand(ray.origin);
+		}
+
+		constexpr float CELL_COUNT = 1023.0f;
+		math::Vec3f originsScale = originsBounds.size().unaryExpr([](float extent) { return extent > 0.0f ? CELL_COUNT / extent : 0.0f; });
+
+		// sort key in the high half, ray index in the low half
+		std::vector<uint64_t> order(rayCount);
+		for (uint32_t i = 0; i < rayCount; ++i)
+		{
+			order[i] = (uint64_t(computeRaySortKey(rays[i], originsBounds.min, originsScale)) << 32) | i;
+		}
+		std::sort(order.begin(), order.end());
+
+		auto func = [this, &rays, &hits, &order](uint32_t threadIndex, uint32_t taskIndex)
+		{
+			uint32_t rayIndex = uint32_t(order[taskIndex]);
+			RayHit& hit = hits[rayIndex];
+
+			const InstanceBVH::Instance* instance = m_instanceBVH.intersect(rays[rayIndex], hit.nearest);
+			if (instance)
+			{
+				hit.objectID = instance->objectID;
+				hit.transformID = instance->modelToWorldID;
+			}
+		};
+		executor.execute(func, rayCount, RAYS_PER_BATCH);
+	}
+
 	void MeshSystem::setNormalVisualization(bool state)
 	{
 		m_hologramInstances.setNormalVisualization(state);
@@ -146,6 +372,14 @@ namespace Engine
 
 	void MeshSystem::updateShadingGroupsInstanceBuffers(Camera& camera)
 	{
+		m_hologramInstances.addReadyInstances();
+		m_normalVisInstances.addReadyInstances();
+		m_textureOnlyInstances.addReadyInstances();
+		m_litInstances.addReadyInstances();
+		m_emissionOnlyInstances.addReadyInstances();
+		m_dissolutionInstances.addReadyInstances();
+		m_incinerationInstances.addReadyInstances();
+
 		m_hologramInstances.updateInstanceBuffers(camera);
 		m_normalVisInstances.updateInstanceBuffers(camera);
 		m_textureOnlyInstances.updateInstanceBuffers(camera);
@@ -153,15 +387,35 @@ namespace Engine
 		m_emissionOnlyInstances.updateInstanceBuffers(camera);
 		m_dissolutionInstances.updateInstanceBuffers(camera);
 		m_incinerationInstances.updateInstanceBuffers(camera);
+
+		// once per frame, queries use the transforms of the last refit
+		if (!updateInstanceBVH())
+		{
+			m_instanceBVH.refit();
+		}
 	}
 
-	void MeshSystem::findIntersectionInternal(const math::Ray& ray, TransformSystem::ID& outMatrixID, math::Intersection& outNearest, int& instanceNumber, unsigned int& objectID)
+	bool MeshSystem::updateInstanceBVH()
 	{
-		m_hologramInstances.findIntersection(ray, outNearest, outMatrixID, objectID);
-		m_normalVisInstances.findIntersection(ray, outNearest, outMatrixID, objectID);
-		m_textureOnlyInstances.findIntersection(ray, outNearest, outMatrixID, objectID);
-		m_litInstances.findIntersection(ray, outNearest, outMatrixID, objectID);
-		m_emissionOnlyInstances.findIntersection(ray, outNearest, outMatrixID, objectID);
-		m_dissolutionInstances.findIntersection(ray, outNearest, outMatrixID, objectID);
+		// incineration instances are being destroyed, so they are not pickable
+		uint32_t revision = m_hologramInstances.getInstancesRevision() + m_normalVisInstances.getInstancesRevision() + m_textureOnlyInstances.getInstancesRevision() +
+			m_litInstances.getInstancesRevision() + m_emissionOnlyInstances.getInstancesRevision() + m_dissolutionInstances.getInstancesRevision();
+
+		if (revision == m_instanceBVHRevision)
+		{
+			return false;
+		}
+
+		std::vector<InstanceBVH::Instance> instances;
+		gatherBVHInstances(m_hologramInstances, instances);
+		gatherBVHInstances(m_normalVisInstances, instances);
+		gatherBVHInstances(m_textureOnlyInstances, instances);
+		gatherBVHInstances(m_litInstances, instances);
+		gatherBVHInstances(m_emissionOnlyInstances, instances);
+		gatherBVHInstances(m_dissolutionInstances, instances);
+
+		m_instanceBVH.build(std::move(instances));
+		m_instanceBVHRevision = revision;
+		return true;
 	}
 }
\ No newline at end of file
@@ -11,6 +11,9 @@
 #include "ShadingGroups/dissolutionInstances.h"
 #include "ShadingGroups/incinerationInstances.h"
 #include "../../utils/nonCopyable.h"
+#include "instanceBVH.h"
+#include "../../utils/parallelExecutor.h"
+#include <span>
 
 namespace Engine
 {
@@ -25,6 +28,20 @@ namespace Engine
 			std::unique_ptr<IObjectMover>* mover;
 		};
 
+		struct ClosestPointQuery
+		{
+			math::MeshClosestPoint nearest;
+			unsigned int objectID;
+			TransformSystem::ID transformID;
+		};
+
+		struct RayHit
+		{
+			math::Intersection nearest; // nearest.t limits the query, so it has to be reset before the call
+			unsigned int objectID;
+			TransformSystem::ID transformID;
+		};
+
 	public:
 		static MeshSystem* createInstance();
 		static void deleteInstance();
@@ -296,7 +313,21 @@ namespace Engine
 		void removeObjectByID(unsigned int objectID);
 		void updateShadingGroupsInstanceBuffers(Camera& camera);
 
+		// Queries see the transforms of the last updateShadingGroupsInstanceBuffers, objects moved since are found where they were drawn.
 		bool findIntersection(const math::Ray& ray, MeshIntersectionQuery& intersection);
+		bool occluded(const math::Ray& ray, float tMax);
+		bool sphereCast(const math::Ray& ray, float radius, MeshIntersectionQuery& outIntersection);
+		bool capsuleCast(const math::Ray& ray, const math::Vec3f& halfSegment, float radius, MeshIntersectionQuery& outIntersection);
+		bool findClosestPoint(const math::Vec3f& point, float maxDistance, ClosestPointQuery& outQuery);
+
+		// Intersects all rays on the worker threads, hits[i] receives the result of rays[i].
+		// Rays are traced in an order sorted by direction octant and origin, so neighbouring tasks touch the same nodes.
+		void intersectBatch(std::span<const math::Ray> rays, std::span<RayHit> hits);
+		void intersectBatch(std::span<const math::Ray> rays, std::span<RayHit> hits, ParallelExecutor& executor);
+
+		// Exact test of the meshes of two objects, uses dual-tree traversal of the mesh BVHs for instances whose world bounds overlap.
+		bool overlaps(unsigned int objectA, unsigned int objectB);
+		void findOverlappingObjects(unsigned int objectID, std::vector<unsigned int>& outObjectIDs);
 
 		void setNormalVisualization(bool state);
 
@@ -311,7 +342,7 @@ namespace Engine
 			return m_incinerationInstances;
 		}
 	private:
-		MeshSystem() = default;
+		MeshSystem();
 
 		static MeshSystem* s_instance;
 
@@ -325,7 +356,16 @@ namespace Engine
 
 		unsigned int instanceCounter = 0;
 
-		void findIntersectionInternal(const math::Ray& ray, TransformSystem::ID& outMatrixID, math::Intersection& outNearest, int& instanceNumber, unsigned int& objectID);
+		InstanceBVH m_instanceBVH;
+		uint32_t m_instanceBVHRevision = UINT32_MAX; // sum of the shading group revisions the BVH was built for
+
+		ParallelExecutor m_parallelExecutor;
+
+		const static uint32_t RAYS_PER_BATCH;
+
+		// Rebuilds the BVH if instances were added or removed since it was built, returns whether it did. Called by every query, which
+		// keeps it cheap: moved instances are only refitted once per frame by updateShadingGroupsInstanceBuffers.
+		bool updateInstanceBVH();
 		void deleteAllInstances();
 	};
 }
@@ -197,22 +197,33 @@ namespace Engine
 	}
 
 	// without lights visualizations (their spheres)
-	void Scene::findShadowRayIntersectionInternal(const math::Ray& ray, ObjRef& outRef, math::Intersection& outNearest, Material& outMaterial)
+	bool Scene::occluded(const math::Ray& ray, float tMax) const
 	{
 		for (auto& plane : m_planes)
 		{
-			plane.isIntersecting(ray, outRef, outNearest, outMaterial);
+			if (plane.isOccluding(ray, tMax))
+			{
+				return true;
+			}
 		}
 
 		for (auto& sphere : m_spheres)
 		{
-			sphere.isIntersecting(ray, outRef, outNearest, outMaterial);
+			if (sphere.isOccluding(ray, tMax))
+			{
+				return true;
+			}
 		}
 
 		for (auto& cube : m_cubes)
 		{
-			cube.isIntersecting(ray, outRef, outNearest, outMaterial);
+			if (cube.isOccluding(ray, tMax))
+			{
+				return true;
+			}
 		}
+
+		return false;
 	}
 
 	void Scene::lighting(math::Vec3f& outColor, const math::Vec3f& cameraPosition, const math::Vec3f& position, const math::Vec3f& normal, const Material& material)
@@ -228,18 +239,13 @@ namespace Engine
 
 		math::Ray shadowRay;
 		shadowRay.origin = math::Vec3f(position[0] + 0.01f * normal[0], position[1] + 0.01f * normal[1], position[2] + 0.01f * normal[2]);
-		math::Intersection shadowRayIntersection;
-		Material mat;
-		Scene::ObjRef ref = { nullptr, Scene::IntersectedType::NUM };
 
 		// directional light
 		for (auto& directionalLight : m_directionalLights)
 		{
 			shadowRay.direction = -directionalLight.getDirection();
-			shadowRayIntersection.reset();
 
-			findShadowRayIntersectionInternal(shadowRay, ref, shadowRayIntersection, mat);
-			if (!shadowRayIntersection.valid())
+			if (!occluded(shadowRay, std::numeric_limits<float>::infinity()))
 			{
 				diffuseAndSpecular += calculateLighting_DirectionalLight(directionalLight, cameraPosition, position, normal, material);
 			}
@@ -252,10 +258,7 @@ namespace Engine
 			shadowRay.direction = toLight.normalized();
 			float maxT = toLight.norm();
 
-			shadowRayIntersection.reset();
-
-			findShadowRayIntersectionInternal(shadowRay, ref, shadowRayIntersection, mat);
-			if (!shadowRayIntersection.valid() || shadowRayIntersection.t > maxT)
+			if (!occluded(shadowRay, maxT))
 			{
 				diffuseAndSpecular += calculateLighting_PointLight(pointLight, cameraPosition, position, normal, material);
 			}
@@ -270,10 +273,7 @@ namespace Engine
 				shadowRay.direction = toLight.normalized();
 				float maxT = toLight.norm();
 
-				shadowRayIntersection.reset();
-
-				findShadowRayIntersectionInternal(shadowRay, ref, shadowRayIntersection, mat);
-				if (!shadowRayIntersection.valid() || shadowRayIntersection.t > maxT)
+				if (!occluded(shadowRay, maxT))
 				{
 					diffuseAndSpecular += calculateLighting_SpotLight(spotLight, cameraPosition, position, normal, material);
 				}
@@ -97,6 +97,7 @@ namespace Engine
 			Transform transform;
 
 			bool isIntersecting(const math::Ray& ray, Scene::ObjRef& ref, math::Intersection& outNearest, Material& outMaterial);
+			bool isOccluding(const math::Ray& ray, float tMax) const;
 		};
 
 	public:
@@ -125,10 +126,12 @@ namespace Engine
 		bool findIntersection(const math::Ray& ray, math::Intersection& outNearest, Material& outMaterial);
 		bool findIntersection(const math::Ray& ray, IntersectionQuery& query);
 
+		// true if anything except light visualizers is hit in [0, tMax), stops at the first hit
+		bool occluded(const math::Ray& ray, float tMax) const;
+
 	private:
 		void computePixelColor(const math::Vec2i& pixelCoordiante, Window& window, Camera& camera);
 		void findIntersectionInternal(const math::Ray& ray, ObjRef& outRef, math::Intersection& outNearest, Material& outMaterial);
-		void findShadowRayIntersectionInternal(const math::Ray& ray, ObjRef& outRef, math::Intersection& outNearest, Material& outMaterial);
 		void lighting(math::Vec3f& outColor, const math::Vec3f& cameraPosition, const math::Vec3f& position, const math::Vec3f& normal, const Material& material);
 
 		std::vector<Plane> m_planes;
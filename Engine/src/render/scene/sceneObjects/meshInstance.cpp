@@ -23,7 +23,7 @@ namespace Engine
 
 		//for (auto& triangle : mesh->triangles)
 		//{
-			if (mesh->octree.intersect(rayInMS, inter))
+			if (mesh->bvh.intersect(rayInMS, inter))
 			{
 				outNearest.position = (math::Vec4f(inter.position[0], inter.position[1], inter.position[2], 1.0f) * transform.transformMat).head<3>();
 				outNearest.normal = (math::Vec4f(inter.normal[0], inter.normal[1], inter.normal[2], 0.0f) * transform.transformMat).head<3>().normalized();
@@ -39,4 +39,13 @@ namespace Engine
 		//}
 		return false;
 	}
+	bool Scene::MeshInstance::isOccluding(const math::Ray& ray, float tMax) const
+	{
+		// the direction is not normalized, so tMax stays valid in mesh space
+		math::Ray rayInMS;
+		rayInMS.origin = (math::Vec4f(ray.origin.x(), ray.origin.y(), ray.origin.z(), 1.0f) * transform.transformInvMat).head<3>();
+		rayInMS.direction = (math::Vec4f(ray.direction.x(), ray.direction.y(), ray.direction.z(), 0.0f) * transform.transformInvMat).head<3>();
+
+		return mesh->bvh.occluded(rayInMS, tMax);
+	}
 }
\ No newline at end of file
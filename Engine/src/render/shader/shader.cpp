@@ -2,6 +2,7 @@
 #include "../lightSystem/lightSystem.h"
 #include "../../engine/renderer.h"
 #include "../fogRenderer/fogRenderer.h"
+#include "../meshSystem/mesh/model.h"
 
 namespace Engine
 {
@@ -19,12 +20,14 @@ namespace Engine
 		std::string shaderCalcInViewSpace = std::to_string(SHADER_CALCULATION_IN_CAMERA_CENTERED_WORLD_SPACE);
 		std::string maxGPUParticles = std::to_string(MAX_GPU_PARTICLES);
 		std::string maxFogInstances = std::to_string(MAX_VOLUMETRIC_FOG_INSTANCES);
+		std::string packedVertices = std::to_string(PACKED_VERTICES);
 
 		D3D_SHADER_MACRO globalMacros[] = { 
 			"MAX_POINT_LIGHTS", maxPointLights.c_str(),
 			"SHADER_CALCULATION_IN_CAMERA_CENTERED_WORLD_SPACE", shaderCalcInViewSpace.c_str(),
 			"MAX_GPU_PARTICLES", maxGPUParticles.c_str(),
 			"MAX_VOLUMETRIC_FOG_INSTANCES", maxFogInstances.c_str(),
+			"PACKED_VERTICES", packedVertices.c_str(),
 			NULL, NULL
 		};
 		
@@ -70,12 +73,14 @@ namespace Engine
 		std::string shaderCalcInViewSpace = std::to_string(SHADER_CALCULATION_IN_CAMERA_CENTERED_WORLD_SPACE);
 		std::string maxGPUParticles = std::to_string(MAX_GPU_PARTICLES);
 		std::string maxFogInstances = std::to_string(MAX_VOLUMETRIC_FOG_INSTANCES);
+		std::string packedVertices = std::to_string(PACKED_VERTICES);
 
 		D3D_SHADER_MACRO globalMacros[] = {
 			"MAX_POINT_LIGHTS", maxPointLights.c_str(),
 			"SHADER_CALCULATION_IN_CAMERA_CENTERED_WORLD_SPACE", shaderCalcInViewSpace.c_str(),
 			"MAX_GPU_PARTICLES", maxGPUParticles.c_str(),
 			"MAX_VOLUMETRIC_FOG_INSTANCES", maxFogInstances.c_str(),
+			"PACKED_VERTICES", packedVertices.c_str(),
 			NULL, NULL
 		};
 
@@ -120,12 +125,14 @@ namespace Engine
 		std::string shaderCalcInViewSpace = std::to_string(SHADER_CALCULATION_IN_CAMERA_CENTERED_WORLD_SPACE);
 		std::string maxGPUParticles = std::to_string(MAX_GPU_PARTICLES);
 		std::string maxFogInstances = std::to_string(MAX_VOLUMETRIC_FOG_INSTANCES);
+		std::string packedVertices = std::to_string(PACKED_VERTICES);
 
 		D3D_SHADER_MACRO globalMacros[] = {
 			"MAX_POINT_LIGHTS", maxPointLights.c_str(),
 			"SHADER_CALCULATION_IN_CAMERA_CENTERED_WORLD_SPACE", shaderCalcInViewSpace.c_str(),
 			"MAX_GPU_PARTICLES", maxGPUParticles.c_str(),
 			"MAX_VOLUMETRIC_FOG_INSTANCES", maxFogInstances.c_str(),
+			"PACKED_VERTICES", packedVertices.c_str(),
 			NULL, NULL
 		};
 
@@ -2,13 +2,62 @@
 #include "assimp/postprocess.h"
 #include "assimp/Importer.hpp"
 #include "assimp/scene.h"
+#include "../render/meshSystem/mesh/boundingVolumes.h"
+#include "../render/meshSystem/mesh/geometryPool.h"
+#include "../render/meshSystem/mesh/meshOptimizer.h"
+#include "../render/meshSystem/mesh/meshSimplifier.h"
+#include "../render/meshSystem/mesh/meshletBuilder.h"
+#include "../render/meshSystem/mesh/meshProcessing.h"
+#include "../render/meshSystem/mesh/modelCache.h"
+#include "../render/meshSystem/mesh/triangleBVHCache.h"
 #include "../utils/assert.h"
+#include "../utils/debug/debugOutput.h"
+#include "../utils/hash.h"
 #include <algorithm>
+#include <chrono>
+#include <filesystem>
 
 namespace Engine
 {
 	ModelManager* ModelManager::s_instance = nullptr;
 
+	const uint32_t ModelManager::IMPORT_FLAGS = uint32_t(aiProcess_Triangulate | aiProcess_GenBoundingBoxes | aiProcess_ConvertToLeftHanded | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
+	const uint32_t ModelManager::IMPORT_CHUNK_SIZE = 16 * 1024;
+
+	inline float getMillisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// vertex streams and faces, the rest of a mesh is small
+	inline uint64_t getAssimpMeshSize(const aiMesh& mesh)
+	{
+		uint32_t vectorStreams = uint32_t(mesh.HasPositions()) + uint32_t(mesh.HasNormals()) + 2 * uint32_t(mesh.HasTangentsAndBitangents()) + mesh.GetNumUVChannels();
+		return uint64_t(mesh.mNumVertices) * (vectorStreams * sizeof(aiVector3D) + mesh.GetNumColorChannels() * sizeof(aiColor4D)) +
+			uint64_t(mesh.mNumFaces) * (sizeof(aiFace) + 3 * sizeof(unsigned int));
+	}
+
+	// arrays of the meshes but the BVHs
+	inline uint64_t getMeshesSize(const std::vector<Mesh>& meshes)
+	{
+		uint64_t size = 0;
+		for (const auto& mesh : meshes)
+		{
+			size += mesh.vertices.capacity() * sizeof(math::Vertex) + mesh.triangles.capacity() * sizeof(math::Triangle) +
+				(mesh.instances.capacity() + mesh.instancesInv.capacity()) * sizeof(math::Mat4f) + mesh.meshlets.capacity() * sizeof(Mesh::Meshlet);
+			for (const auto& lod : mesh.lods)
+			{
+				size += lod.indices.capacity() * sizeof(uint32_t);
+			}
+		}
+		return size;
+	}
+
+	uint64_t ModelManager::getImportParamsHash()
+	{
+		return mixHash(mixHash(mixHash(mixHash(IMPORT_FLAGS, MeshOptimizer::VERSION), MeshSimplifier::VERSION), MeshletBuilder::VERSION), BoundingVolumes::VERSION);
+	}
+
 	ModelManager* ModelManager::createInstance()
 	{
 		if (!s_instance)
@@ -27,6 +76,11 @@ namespace Engine
 		s_instance = nullptr;
 	}
 
+	ModelManager::ModelManager()
+		: m_parallelExecutor(ParallelExecutor::MAX_THREADS)
+	{
+	}
+
 	ModelManager* ModelManager::getInstancePtr()
 	{
 		return s_instance;
@@ -43,9 +97,67 @@ namespace Engine
 		{
 			return iter->second;
 		}
+
+		if (auto iter = m_pendingModels.find(filePath); iter != m_pendingModels.end())
+		{
+			std::shared_ptr<Model> model = finishPendingModel(filePath, iter->second);
+			m_pendingModels.erase(iter);
+			return model;
+		}
 		
 		return loadModel(filePath);
 	}
+	std::shared_ptr<Model> ModelManager::getModelAsync(const std::string& filePath)
+	{
+		if (auto iter = m_models.find(filePath); iter != m_models.end())
+		{
+			return iter->second;
+		}
+
+		if (auto iter = m_pendingModels.find(filePath); iter != m_pendingModels.end())
+		{
+			return iter->second.model;
+		}
+
+		std::shared_ptr<Model> model(new Model());
+		model->m_isReady = false;
+
+		PendingModel& pending = m_pendingModels[filePath];
+		pending.model = model;
+		pending.loaded = std::async(std::launch::async, [this, filePath, bvhLayout = m_bvhLayout]()
+		{
+			return loadModelData(filePath, bvhLayout);
+		});
+
+		return model;
+	}
+	ModelManager::LoadTimings ModelManager::getLoadTimings(const std::string& filePath) const
+	{
+		std::lock_guard<std::mutex> lock(m_loadTimingsMutex);
+		auto iter = m_loadTimings.find(filePath);
+		return iter != m_loadTimings.end() ? iter->second : LoadTimings{};
+	}
+	uint64_t ModelManager::getLoadPeakMemory(const std::string& filePath) const
+	{
+		std::lock_guard<std::mutex> lock(m_loadTimingsMutex);
+		auto iter = m_loadPeakMemory.find(filePath);
+		return iter != m_loadPeakMemory.end() ? iter->second.last : 0;
+	}
+	void ModelManager::update()
+	{
+		for (auto iter = m_pendingModels.begin(); iter != m_pendingModels.end();)
+		{
+			if (iter->second.loaded.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				finishPendingModel(iter->first, iter->second);
+				iter = m_pendingModels.erase(iter);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+	}
 	std::shared_ptr<Model> ModelManager::getUnitSphereModel()
 	{
 		if (auto iter = m_basicShapesModels.find(UNIT_SPHERE_MODEL_NAME); iter != m_basicShapesModels.end())
@@ -59,21 +171,284 @@ namespace Engine
 
 	std::shared_ptr<Model> ModelManager::loadModel(const std::string& filePath)
 	{
-		uint32_t flags = uint32_t(aiProcess_Triangulate | aiProcess_GenBoundingBoxes | aiProcess_ConvertToLeftHanded | aiProcess_CalcTangentSpace | aiProcess_JoinIdenticalVertices);
+		std::shared_ptr<Model> model = loadModelData(filePath, m_bvhLayout);
+		model->createBuffers();
+
+		return m_models.insert({ filePath, model }).first->second;
+	}
+
+	std::shared_ptr<Model> ModelManager::finishPendingModel(const std::string& filePath, PendingModel& pending)
+	{
+		// blocks if the worker hasn't finished yet
+		std::shared_ptr<Model> loaded = pending.loaded.get();
+
+		// moving keeps the mesh array, so mesh BVHs and triangles still reference valid memory
+		Model& model = *pending.model;
+		model = std::move(*loaded);
+		model.createBuffers();
+		model.m_isReady = true;
+
+		return m_models.insert({ filePath, pending.model }).first->second;
+	}
+
+	std::shared_ptr<Model> ModelManager::loadModelData(const std::string& filePath, TriangleBVH::Layout bvhLayout)
+	{
+		// Loads first expect the peak of the last cache read of the model, and the peak of its last import if the cache misses.
+		// Unknown peaks reserve the whole limit, so those loads run alone.
+		LoadPeakMemory expectedPeak;
+		{
+			std::lock_guard<std::mutex> lock(m_loadTimingsMutex);
+			if (auto iter = m_loadPeakMemory.find(filePath); iter != m_loadPeakMemory.end())
+			{
+				expectedPeak = iter->second;
+			}
+		}
+		const uint64_t expectedImportPeak = expectedPeak.import ? expectedPeak.import : m_loadMemoryBudget.getLimit();
+
+		// the time spent waiting for the memory of other loads isn't part of the timings
+		MemoryBudget::Reservation memory(m_loadMemoryBudget);
+		memory.start(expectedPeak.cacheRead ? expectedPeak.cacheRead : expectedImportPeak);
+
+		LoadTimings timings = {};
+		const auto loadStart = std::chrono::steady_clock::now();
+		float memoryWait = 0.0f;
+
+		// warm starts read the model cache and never touch assimp, a missing or stale cache is rewritten after importing
+		const std::string modelCachePath = ModelCache::getCachePath(filePath);
+		std::shared_ptr<Model> model = ModelCache::load(modelCachePath, filePath, getImportParamsHash());
+		timings.cacheRead = getMillisecondsSince(loadStart);
+		const bool isCacheRead = model != nullptr;
+
+		if (isCacheRead)
+		{
+			// the staging arrays reference the mapped file, only packed vertices are copied out of it
+			std::error_code error;
+			const uintmax_t cacheSize = std::filesystem::file_size(modelCachePath, error);
+			const uint64_t stagingSize = PACKED_VERTICES ? model->m_pendingBuffers.vertices.size_bytes() : 0;
+			memory.add((error ? 0 : uint64_t(cacheSize)) + getMeshesSize(model->m_meshes) + stagingSize);
+		}
+		else
+		{
+			// the reservation was sized for a cache read, importing waits again for its own peak
+			if (expectedPeak.cacheRead)
+			{
+				const auto waitStart = std::chrono::steady_clock::now();
+				memory.restart(expectedImportPeak);
+				memoryWait = getMillisecondsSince(waitStart);
+			}
+
+			model = importModel(filePath, memory, timings);
+
+			const auto cacheWriteStart = std::chrono::steady_clock::now();
+			ModelCache::save(modelCachePath, filePath, getImportParamsHash(), *model);
+			timings.cacheWrite = getMillisecondsSince(cacheWriteStart);
+		}
+
+		model->name = filePath;
+		std::replace(model->name.begin(), model->name.end(), '\\', '/');
+
+		const auto bvhStart = std::chrono::steady_clock::now();
+		const uint32_t sharedBVHCount = initializeBVHs(filePath, *model, bvhLayout, memory);
+		timings.bvh = getMillisecondsSince(bvhStart);
+		timings.total = getMillisecondsSince(loadStart) - memoryWait;
+
+		_DEBUG_OUTPUT("Loaded " << filePath.c_str() << " in " << timings.total << " ms: cache read " << timings.cacheRead << ", import " << timings.import <<
+			", convert " << timings.convert << ", optimize " << timings.optimize << ", finalize " << timings.finalize << ", cache write " << timings.cacheWrite << ", BVH " << timings.bvh <<
+			", peak memory " << memory.getPeakSize() / (1024 * 1024) << " MB, shared BVHs " << sharedBVHCount);
+
+		{
+			std::lock_guard<std::mutex> lock(m_loadTimingsMutex);
+			m_loadTimings[filePath] = timings;
+			LoadPeakMemory& peak = m_loadPeakMemory[filePath];
+			(isCacheRead ? peak.cacheRead : peak.import) = memory.getPeakSize();
+			peak.last = memory.getPeakSize();
+		}
+
+		return model;
+	}
+
+	uint32_t ModelManager::initializeBVHs(const std::string& filePath, Model& model, TriangleBVH::Layout bvhLayout, MemoryBudget::Reservation& memory)
+	{
+		std::vector<Mesh>& meshes = model.m_meshes;
 
+		std::vector<uint64_t> keys(meshes.size());
+		const uint64_t buildParamsHash = TriangleBVH::computeBuildParamsHash(bvhLayout);
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			keys[i] = mixHash(TriangleBVH::computeContentHash(meshes[i]), buildParamsHash);
+		}
+
+		// Meshes found in the registry use its trees, a mesh equal to an earlier one of the model uses the tree of that one (its source),
+		// the others get trees of their own. The owners are held until the trees reference them.
+		std::vector<SharedBVH> sharedBVHs(meshes.size());
+		std::vector<std::shared_ptr<const void>> owners(meshes.size());
+		std::vector<int> sources(meshes.size(), -1);
+		std::vector<int> unsharedMeshes;
+		{
+			std::lock_guard<std::mutex> lock(m_sharedBVHsMutex);
+			for (int i = 0; i < int(meshes.size()); i++)
+			{
+				if (auto iter = m_sharedBVHs.find(keys[i]); iter != m_sharedBVHs.end())
+				{
+					owners[i] = iter->second.owner.lock();
+					sharedBVHs[i] = iter->second;
+				}
+			}
+		}
+
+		// equal keys are only trusted once the content compares equal as well, meshes colliding in their key get trees of their own
+		std::unordered_map<uint64_t, std::vector<int>> firstMeshes;
+		for (int i = 0; i < int(meshes.size()); i++)
+		{
+			const SharedBVH& shared = sharedBVHs[i];
+			if (owners[i] && !TriangleBVH::isBuiltFrom(meshes[i], shared.triangles, shared.triangleData, shared.triangleStride))
+			{
+				owners[i].reset();
+			}
+			if (!owners[i])
+			{
+				std::vector<int>& candidates = firstMeshes[keys[i]];
+				auto source = std::find_if(candidates.begin(), candidates.end(), [&meshes, i](int first)
+				{
+					return TriangleBVH::hasEqualContent(meshes[first], meshes[i]);
+				});
+				if (source != candidates.end())
+				{
+					sources[i] = *source;
+				}
+				else
+				{
+					candidates.push_back(i);
+					unsharedMeshes.push_back(i);
+				}
+			}
+		}
+
+		// a stale or mismatching cache is rebuilt and overwritten silently
+		const std::string bvhCachePath = TriangleBVHCache::getCachePath(filePath);
+		bool isBuilt = false;
+		if (!unsharedMeshes.empty() && !TriangleBVHCache::load(bvhCachePath, meshes, bvhLayout))
+		{
+			std::lock_guard<std::mutex> lock(m_parallelExecutorMutex);
+
+			// Large meshes are built one after another by the parallel build, small ones can't use many threads,
+			// so they are built by the serial build one mesh per task. Both give the same trees.
+			std::vector<Mesh*> smallMeshes;
+			for (int meshIndex : unsharedMeshes)
+			{
+				Mesh& mesh = meshes[meshIndex];
+				if (mesh.triangles.size() < TriangleBVH::PARALLEL_CHUNK_TRIANGLES)
+				{
+					smallMeshes.push_back(&mesh);
+				}
+				else
+				{
+					mesh.initializeBVH(m_parallelExecutor, bvhLayout);
+				}
+			}
+
+			m_parallelExecutor.execute([&smallMeshes, bvhLayout](uint32_t threadIndex, uint32_t taskIndex)
+			{
+				smallMeshes[taskIndex]->initializeBVH(bvhLayout);
+			}, uint32_t(smallMeshes.size()), 1);
+			isBuilt = true;
+		}
+
+		// every entry gets an owner of its own over the storage, so its use count tells the trees sharing it,
+		// even when the storage is a cache file mapped once for all meshes
+		for (int meshIndex : unsharedMeshes)
+		{
+			TriangleBVH& bvh = meshes[meshIndex].bvh;
+			memory.add(bvh.getMemoryUsage());
+
+			owners[meshIndex] = std::make_shared<const std::shared_ptr<const void>>(bvh.shareStorage());
+			sharedBVHs[meshIndex] = { owners[meshIndex], bvh.getNodes(), bvh.getWideNodes(), bvh.getTriangles(), bvh.getTriangleData(), bvh.getTriangleStride() };
+		}
+		if (!unsharedMeshes.empty())
+		{
+			std::lock_guard<std::mutex> lock(m_sharedBVHsMutex);
+			std::erase_if(m_sharedBVHs, [](const auto& entry)
+			{
+				return entry.second.owner.expired();
+			});
+
+			// A concurrent load of equal meshes may have registered them meanwhile, either tree can be shared.
+			// Meshes colliding in their key replace each other's entry, lookups compare the content anyway.
+			for (int meshIndex : unsharedMeshes)
+			{
+				m_sharedBVHs[keys[meshIndex]] = sharedBVHs[meshIndex];
+			}
+		}
+
+		for (size_t i = 0; i < meshes.size(); i++)
+		{
+			if (sources[i] >= 0)
+			{
+				owners[i] = owners[sources[i]];
+				sharedBVHs[i] = sharedBVHs[sources[i]];
+			}
+			const SharedBVH& shared = sharedBVHs[i];
+			meshes[i].bvh.initialize(meshes[i], bvhLayout, shared.nodes, shared.wideNodes, shared.triangles, shared.triangleData, shared.triangleStride, std::move(owners[i]));
+		}
+
+		// the cache stores the trees of all meshes, shared ones included
+		if (isBuilt)
+		{
+			TriangleBVHCache::save(bvhCachePath, meshes);
+		}
+		return uint32_t(meshes.size() - unsharedMeshes.size());
+	}
+
+	ModelManager::GeometrySharingStats ModelManager::getGeometrySharingStats() const
+	{
+		GeometrySharingStats stats = {};
+		if (const GeometryPool* pool = GeometryPool::getInstancePtr())
+		{
+			const GeometryPool::Stats poolStats = pool->getStats();
+			stats.sharedGeometryReferences = poolStats.sharedReferenceCount;
+			stats.sharedGeometryBytes = poolStats.sharedBytes;
+		}
+
+		std::lock_guard<std::mutex> lock(m_sharedBVHsMutex);
+		for (const auto& [key, shared] : m_sharedBVHs)
+		{
+			// besides the locked reference and the first tree
+			const long references = shared.owner.lock().use_count() - 2;
+			if (references > 0)
+			{
+				stats.sharedBVHReferences += uint32_t(references);
+				stats.sharedBVHBytes += uint64_t(references) * (shared.nodes.size_bytes() + shared.wideNodes.size_bytes() + shared.triangles.size_bytes() + shared.triangleData.size_bytes());
+			}
+		}
+		return stats;
+	}
+
+	std::shared_ptr<Model> ModelManager::importModel(const std::string& filePath, MemoryBudget::Reservation& memory, LoadTimings& timings)
+	{
+		const auto importStart = std::chrono::steady_clock::now();
+
+		// the scene is taken over from the importer, so its meshes can be deleted one by one as soon as they are converted
 		Assimp::Importer importer;
-		const aiScene* assimpScene = importer.ReadFile(filePath, flags);
+		importer.ReadFile(filePath, IMPORT_FLAGS);
+		std::unique_ptr<aiScene> assimpScene(importer.GetOrphanedScene());
 		DEV_ASSERT(assimpScene);
 
+		timings.import = getMillisecondsSince(importStart);
+		const auto convertStart = std::chrono::steady_clock::now();
+
 		int numMeshes = assimpScene->mNumMeshes;
 		std::shared_ptr<Model> model(new Model());
-		
-		model->name = filePath;
-		std::replace(model->name.begin(), model->name.end(), '\\', '/');
 
 		model->boundingBox.reset();
 		model->m_meshes.resize(numMeshes);
 
+		std::vector<uint64_t> assimpMeshSizes(numMeshes);
+		for (int i = 0; i < numMeshes; i++)
+		{
+			assimpMeshSizes[i] = getAssimpMeshSize(*assimpScene->mMeshes[i]);
+			memory.add(assimpMeshSizes[i]);
+		}
+
 		static_assert(sizeof(math::Vec3f) == sizeof(aiVector3D));
 
 		for (int i = 0; i < numMeshes; i++)
@@ -87,46 +462,14 @@ namespace Engine
 
 			model->boundingBox.expand(dstMesh.boundingBox);
 
-			dstMesh.vertices.resize(srcMesh->mNumVertices);
-			dstMesh.triangles.resize(srcMesh->mNumFaces);
-
-			for (int v = 0; v < srcMesh->mNumVertices; v++)
-			{
-				math::Vertex& vertex = dstMesh.vertices[v];
-
-				vertex.position = reinterpret_cast<math::Vec3f&>(srcMesh->mVertices[v]);
-				vertex.color = math::Vec4f(1.0f, 0.0f, 1.0f, 1.0f);
-				vertex.textureCoordinates = reinterpret_cast<math::Vec2f&>(srcMesh->mTextureCoords[0][v]);
-				vertex.normal = reinterpret_cast<math::Vec3f&>(srcMesh->mNormals[v]);
-				vertex.tangent = reinterpret_cast<math::Vec3f&>(srcMesh->mTangents[v]);
-				vertex.bitangent = reinterpret_cast<math::Vec3f&>(srcMesh->mBitangents[v]) * -1.0f;
-			}
-			math::Vertex* array = dstMesh.vertices.data();
-
-			for (int f = 0; f < srcMesh->mNumFaces; f++)
-			{
-				const auto& face = srcMesh->mFaces[f];
-				DEV_ASSERT(face.mNumIndices == 3);
-
-				dstMesh.triangles[f].verticesArray = array;
-				for (int index = 0; index < face.mNumIndices; index++)
-				{
-					dstMesh.triangles[f].vertexIndices[index] = face.mIndices[index];
-				}
-
-				dstMesh.triangles[f].computeNormalVector();
-			}
-
 			auto* assimpMaterial = assimpScene->mMaterials[srcMesh->mMaterialIndex];
 			aiString diffuse, metalness, roughness;
 			assimpMaterial->GetTexture(aiTextureType_DIFFUSE, 0, &diffuse);
 			assimpMaterial->GetTexture(aiTextureType_METALNESS, 0, &metalness);
 			assimpMaterial->GetTexture(aiTextureType_SHININESS, 0, &roughness);
-
-
-			dstMesh.initializeOctree();
 		}
 
+		// instances only need the node hierarchy, reading them first lets the scene go right after the last mesh is converted
 		std::function<void(aiNode*)> loadInstances;
 		loadInstances = [&loadInstances, &model](aiNode* node)
 		{
@@ -147,9 +490,154 @@ namespace Engine
 		};
 
 		loadInstances(assimpScene->mRootNode);
-		model->createVertexBuffer();
 
-		return m_models.insert({ filePath, model }).first->second;
+		// Meshes are independent and large ones are split into chunks, every task writes its own range of a mesh,
+		// so the result doesn't depend on the order the tasks run in.
+		struct Chunk
+		{
+			uint32_t mesh;
+			uint32_t begin;
+			uint32_t end;
+		};
+		std::vector<Chunk> vertexChunks;
+		std::vector<Chunk> triangleChunks;
+
+		// Meshes are converted in batches of about a vertex chunk per thread and the assimp meshes of a batch are deleted right after it,
+		// so the scene and the converted meshes are never resident in full at the same time.
+		uint64_t meshesSize = 0;
+		for (int batchBegin = 0, batchEnd = 0; batchBegin < numMeshes; batchBegin = batchEnd)
+		{
+			vertexChunks.clear();
+			triangleChunks.clear();
+
+			for (; batchEnd < numMeshes && vertexChunks.size() < m_parallelExecutor.numThreads(); batchEnd++)
+			{
+				const auto& srcMesh = assimpScene->mMeshes[batchEnd];
+				auto& dstMesh = model->m_meshes[batchEnd];
+
+				// the final arrays, they are written in place
+				dstMesh.vertices.resize(srcMesh->mNumVertices);
+				dstMesh.triangles.resize(srcMesh->mNumFaces);
+
+				const uint64_t meshSize = dstMesh.vertices.capacity() * sizeof(math::Vertex) + dstMesh.triangles.capacity() * sizeof(math::Triangle);
+				memory.add(meshSize);
+				meshesSize += meshSize;
+
+				for (uint32_t begin = 0; begin < srcMesh->mNumVertices; begin += IMPORT_CHUNK_SIZE)
+				{
+					vertexChunks.push_back({ uint32_t(batchEnd), begin, std::min(begin + IMPORT_CHUNK_SIZE, srcMesh->mNumVertices) });
+				}
+				for (uint32_t begin = 0; begin < srcMesh->mNumFaces; begin += IMPORT_CHUNK_SIZE)
+				{
+					triangleChunks.push_back({ uint32_t(batchEnd), begin, std::min(begin + IMPORT_CHUNK_SIZE, srcMesh->mNumFaces) });
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(m_parallelExecutorMutex);
+
+				m_parallelExecutor.execute([&assimpScene, &model, &vertexChunks](uint32_t threadIndex, uint32_t taskIndex)
+				{
+					const Chunk& chunk = vertexChunks[taskIndex];
+					const auto& srcMesh = assimpScene->mMeshes[chunk.mesh];
+					auto& dstMesh = model->m_meshes[chunk.mesh];
+
+					for (uint32_t v = chunk.begin; v < chunk.end; v++)
+					{
+						math::Vertex& vertex = dstMesh.vertices[v];
+
+						vertex.position = reinterpret_cast<math::Vec3f&>(srcMesh->mVertices[v]);
+						vertex.color = math::Vec4f(1.0f, 0.0f, 1.0f, 1.0f);
+						vertex.textureCoordinates = reinterpret_cast<math::Vec2f&>(srcMesh->mTextureCoords[0][v]);
+						vertex.normal = reinterpret_cast<math::Vec3f&>(srcMesh->mNormals[v]);
+						vertex.tangent = reinterpret_cast<math::Vec3f&>(srcMesh->mTangents[v]);
+						vertex.bitangent = reinterpret_cast<math::Vec3f&>(srcMesh->mBitangents[v]) * -1.0f;
+					}
+				}, uint32_t(vertexChunks.size()), 1);
+
+				// triangle normals read vertex positions, so triangles wait for all vertices
+				m_parallelExecutor.execute([&assimpScene, &model, &triangleChunks](uint32_t threadIndex, uint32_t taskIndex)
+				{
+					const Chunk& chunk = triangleChunks[taskIndex];
+					const auto& srcMesh = assimpScene->mMeshes[chunk.mesh];
+					auto& dstMesh = model->m_meshes[chunk.mesh];
+					math::Vertex* array = dstMesh.vertices.data();
+
+					for (uint32_t f = chunk.begin; f < chunk.end; f++)
+					{
+						const auto& face = srcMesh->mFaces[f];
+						DEV_ASSERT(face.mNumIndices == 3);
+
+						dstMesh.triangles[f].verticesArray = array;
+						for (int index = 0; index < face.mNumIndices; index++)
+						{
+							dstMesh.triangles[f].vertexIndices[index] = face.mIndices[index];
+						}
+
+						dstMesh.triangles[f].computeNormalVector();
+					}
+				}, uint32_t(triangleChunks.size()), 1);
+			}
+
+			// the scene deletes its remaining meshes, null ones are skipped
+			for (int i = batchBegin; i < batchEnd; i++)
+			{
+				delete assimpScene->mMeshes[i];
+				assimpScene->mMeshes[i] = nullptr;
+				memory.remove(assimpMeshSizes[i]);
+			}
+		}
+		assimpScene.reset();
+
+		timings.convert = getMillisecondsSince(convertStart);
+		const auto optimizeStart = std::chrono::steady_clock::now();
+
+		// reordering triangles and vertices once here benefits every pass drawing the model, the model cache stores the result.
+		// Meshlets keep the triangle order within them and LODs index the reordered vertices, so both are built afterwards.
+		std::vector<MeshOptimizer::Stats> statsBefore(numMeshes), statsAfter(numMeshes);
+		{
+			std::lock_guard<std::mutex> lock(m_parallelExecutorMutex);
+
+			m_parallelExecutor.execute([&model, &statsBefore, &statsAfter](uint32_t threadIndex, uint32_t taskIndex)
+			{
+				Mesh& mesh = model->m_meshes[taskIndex];
+				statsBefore[taskIndex] = MeshOptimizer::analyze(mesh, sizeof(Model::GPUVertex));
+				MeshOptimizer::optimize(mesh);
+				MeshletBuilder::build(mesh);
+				statsAfter[taskIndex] = MeshOptimizer::analyze(mesh, sizeof(Model::GPUVertex));
+				MeshSimplifier::buildLods(mesh);
+				BoundingVolumes::build(mesh);
+			}, uint32_t(numMeshes), 1);
+		}
+		for (int i = 0; i < numMeshes; i++)
+		{
+			_DEBUG_OUTPUT("Optimized mesh " << model->m_meshes[i].name.c_str() << " of " << filePath.c_str() << ": ACMR " << statsBefore[i].acmr << " -> " << statsAfter[i].acmr <<
+				", ATVR " << statsBefore[i].atvr << " -> " << statsAfter[i].atvr << ", overfetch " << statsBefore[i].overfetch << " -> " << statsAfter[i].overfetch <<
+				", " << model->m_meshes[i].meshlets.size() << " meshlets, " << model->m_meshes[i].lods.size() << " LODs");
+		}
+
+		// meshlets and LODs are added, instances weren't counted yet
+		const uint64_t optimizedSize = getMeshesSize(model->m_meshes);
+		if (optimizedSize > meshesSize)
+		{
+			memory.add(optimizedSize - meshesSize);
+		}
+		else
+		{
+			memory.remove(meshesSize - optimizedSize);
+		}
+
+		timings.optimize = getMillisecondsSince(optimizeStart);
+		const auto finalizeStart = std::chrono::steady_clock::now();
+
+		model->prepareBuffers();
+
+		const auto& staging = model->m_pendingBuffers;
+		memory.add(staging.vertices.size_bytes() + staging.indices.size_bytes() + staging.positions.size_bytes() + staging.positionIndices.size_bytes());
+
+		timings.finalize = getMillisecondsSince(finalizeStart);
+
+		return model;
 	}
 	
 	std::shared_ptr<Model> ModelManager::createUnitSphereModel()
@@ -269,44 +757,16 @@ namespace Engine
 			}
 		}
 
-		// list of (vertices group and avg normal)
-		std::list<std::pair<std::list<math::Vertex*>, math::Vec3f>> vertices;
-
-		for (auto& vert : mesh.vertices)
-		{
-			bool added = false;
-			for (auto& vertGroup : vertices)
-			{
-				if ((vert.position - vertGroup.first.front()->position).norm() < 0.0001f)
-				{
-					vertGroup.first.push_back(&vert);
-					vertGroup.second += vert.normal;
-
-					added = true;
-					break;
-				}
-			}
-
-			if (!added)
-			{
-				vertices.emplace_back();
-				vertices.back().first.push_back(&vert);
-				vertices.back().second = vert.normal;
-			}
-		}
-
-		// calculating averaged normals
-		for (auto& vertGroup : vertices)
-		{
-			vertGroup.second.normalize();
-			for (auto* vert : vertGroup.first)
-			{
-				vert->normal = vertGroup.second;
-			}
-		}
+		// Smooth normals over the triangles around every corner of the cube grid, after that the vertices sharing a position are identical
+		// and welding shares them between triangles.
+		const float WELD_EPSILON = 0.0001f;
+		MeshProcessing::computeNormals(mesh, MeshProcessing::NormalWeighting::ANGLE, WELD_EPSILON);
+		MeshProcessing::computeTangents(mesh);
+		MeshProcessing::weldVertices(mesh, WELD_EPSILON);
 
 		mesh.createBoundingBox();
-		mesh.initializeOctree();
+		BoundingVolumes::build(mesh);
+		mesh.initializeBVH();
 		
 		model.createVertexBuffer();
 		return m_basicShapesModels.insert({ UNIT_SPHERE_MODEL_NAME, modelPtr }).first->second;
@@ -314,6 +774,11 @@ namespace Engine
 
 	void ModelManager::deleteAllModels()
 	{
+		// waits for the workers still loading
+		m_pendingModels.clear();
 		m_models.clear();
+
+		std::lock_guard<std::mutex> lock(m_sharedBVHsMutex);
+		m_sharedBVHs.clear();
 	}
 }
\ No newline at end of file
@@ -1,8 +1,12 @@
 #pragma once
+#include <future>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include "../render/meshSystem/mesh/model.h"
+#include "../utils/memoryBudget.h"
 #include "../utils/nonCopyable.h"
+#include "../utils/parallelExecutor.h"
 
 namespace Engine
 {
@@ -16,19 +20,126 @@ namespace Engine
 
 		void deinit();
 
+		// waits for the model if it's being loaded asynchronously
 		std::shared_ptr<Model> getModel(const std::string& filePath);
+
+		// Returns a placeholder at once and loads the model on a worker thread: reading the cache or importing, building the mesh BVHs.
+		// The placeholder becomes ready in the update() after the worker finishes. It can be passed to shading groups right away,
+		// its instances are drawn from the first frame the model is ready.
+		std::shared_ptr<Model> getModelAsync(const std::string& filePath);
+
+		// Creates the GPU buffers of models loaded asynchronously since the last call and makes them ready.
+		// Must be called on the render thread at a frame boundary.
+		void update();
 		std::shared_ptr<Model> getUnitSphereModel();
 
+		// Wall time of the stages of the last load of a model in milliseconds, skipped stages are 0.
+		struct LoadTimings
+		{
+			float cacheRead; // reading the model cache
+			float import; // assimp ReadFile including its post processing
+			float convert; // instances, vertices and triangles, in parallel across meshes and chunks of large meshes
+			float optimize; // vertex cache, overdraw and vertex fetch order, meshlets, LODs and bounding volumes of the meshes, see MeshOptimizer, MeshletBuilder, MeshSimplifier and BoundingVolumes
+			float finalize; // concatenated vertex and index arrays
+			float cacheWrite;
+			float bvh; // loading or building the mesh BVHs
+			float total;
+		};
+
+		// returns zeros for models that weren't loaded from a file
+		LoadTimings getLoadTimings(const std::string& filePath) const;
+
+		// Peak of the large arrays of the last load of a model in bytes: assimp meshes, converted meshes and their LODs and meshlets,
+		// the mapped model cache, the staging arrays of the GPU buffers and the BVHs. 0 for models that weren't loaded from a file.
+		uint64_t getLoadPeakMemory(const std::string& filePath) const;
+
+		// Ceiling of the memory of loads running at once in bytes, 0 is no limit. Loads wait to start until their expected peak fits
+		// next to the loads running, see MemoryBudget. The expected peak of a model is the one of its last read of the model cache,
+		// or of its last import when the cache misses. Loads whose peak is unknown reserve the whole limit, so they run alone.
+		// Loads exceeding their expected peak aren't stopped, so the limit holds only as far as the last loads predict the next ones.
+		void setLoadMemoryLimit(uint64_t bytes)
+		{
+			m_loadMemoryBudget.setLimit(bytes);
+		}
+
+		// Meshes whose content is equal to a mesh of a model loaded earlier and still alive share its GPU ranges and BVH,
+		// see GeometryPool::allocateShared. References count the meshes using memory of another one.
+		struct GeometrySharingStats
+		{
+			uint32_t sharedGeometryReferences;
+			uint64_t sharedGeometryBytes; // GPU memory saved
+			uint32_t sharedBVHReferences;
+			uint64_t sharedBVHBytes; // CPU memory saved
+		};
+		GeometrySharingStats getGeometrySharingStats() const;
+
+		// layout of the mesh BVHs of models loaded from now on, QUANTIZED_WIDE saves memory when many big models are resident
+		void setBVHLayout(TriangleBVH::Layout layout)
+		{
+			m_bvhLayout = layout;
+		}
+
 	private:
-		ModelManager() = default;
+		ModelManager();
 		static ModelManager* s_instance;
 
+		const static uint32_t IMPORT_FLAGS; // assimp post processing steps, cached models are keyed by them
+		const static uint32_t IMPORT_CHUNK_SIZE; // vertices or triangles per conversion task
+
+		// key of cached models, covers everything that changes the imported result
+		static uint64_t getImportParamsHash();
+
+		struct PendingModel
+		{
+			std::shared_ptr<Model> model; // placeholder handed out by getModelAsync
+			std::future<std::shared_ptr<Model>> loaded;
+		};
+
+		ParallelExecutor m_parallelExecutor; // builds mesh BVHs, loading blocks the caller anyway, so it may take all cores
+		std::mutex m_parallelExecutorMutex; // asynchronous loads share the executor
+		TriangleBVH::Layout m_bvhLayout = TriangleBVH::Layout::BINARY;
+		MemoryBudget m_loadMemoryBudget; // outlives m_pendingModels, whose workers reserve from it
+
 		std::unordered_map<std::string, std::shared_ptr<Model>> m_models;
+		std::unordered_map<std::string, PendingModel> m_pendingModels;
+
+		std::unordered_map<std::string, LoadTimings> m_loadTimings;
+		// the expected peaks of the next load of a model, 0 is unknown
+		struct LoadPeakMemory
+		{
+			uint64_t cacheRead = 0; // of the last load from the model cache
+			uint64_t import = 0; // of the last load that imported the model
+			uint64_t last = 0; // of the last load, either way
+		};
+		std::unordered_map<std::string, LoadPeakMemory> m_loadPeakMemory;
+		mutable std::mutex m_loadTimingsMutex; // written by asynchronous loads, guards m_loadPeakMemory as well
+
+		// BVH arrays of the meshes loaded so far, keyed by the content hash of the mesh and the build parameters
+		struct SharedBVH
+		{
+			std::weak_ptr<const void> owner; // one per entry, its use count is the number of trees using the arrays
+			std::span<const TriangleBVH::Node> nodes;
+			std::span<const TriangleBVH::WideNode> wideNodes;
+			std::span<const uint32_t> triangles;
+			std::span<const float> triangleData;
+			uint32_t triangleStride;
+		};
+		std::unordered_map<uint64_t, SharedBVH> m_sharedBVHs;
+		mutable std::mutex m_sharedBVHsMutex; // asynchronous loads share the registry
 
 		std::unordered_map<std::string, std::shared_ptr<Model>> m_basicShapesModels;
 		const std::string UNIT_SPHERE_MODEL_NAME{ "UnitSphere" };
 
 		std::shared_ptr<Model> loadModel(const std::string& filePath);
+		std::shared_ptr<Model> finishPendingModel(const std::string& filePath, PendingModel& pending);
+
+		// Everything but the GPU buffers, may run on any thread. The memory of the load is reserved from m_loadMemoryBudget until it returns,
+		// the staging arrays it leaves for createBuffers aren't covered after that.
+		std::shared_ptr<Model> loadModelData(const std::string& filePath, TriangleBVH::Layout bvhLayout);
+		// Initializes the BVHs of the meshes from the shared ones, then from the cache or by building the rest, and shares those.
+		// Returns the number of meshes that got a shared tree.
+		uint32_t initializeBVHs(const std::string& filePath, Model& model, TriangleBVH::Layout bvhLayout, MemoryBudget::Reservation& memory);
+		std::shared_ptr<Model> importModel(const std::string& filePath, MemoryBudget::Reservation& memory, LoadTimings& timings);
 		std::shared_ptr<Model> createUnitSphereModel();
 
 		void deleteAllModels();
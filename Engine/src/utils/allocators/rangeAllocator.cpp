@@ -0,0 +1,300 @@
+#include "rangeAllocator.h"
+#include "../assert.h"
+#include <algorithm>
+#include <bit>
+
+namespace Engine
+{
+	const RangeAllocator::Handle RangeAllocator::INVALID_HANDLE = ~0u;
+
+	RangeAllocator::RangeAllocator(uint32_t capacity)
+	{
+		for (auto& lists : m_freeLists)
+		{
+			std::fill(std::begin(lists), std::end(lists), NONE);
+		}
+		grow(capacity);
+	}
+
+	void RangeAllocator::getSizeClass(uint32_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel)
+	{
+		// sizes below SECOND_LEVEL_COUNT get a class each, above every power of two is split into SECOND_LEVEL_COUNT classes
+		if (size < SECOND_LEVEL_COUNT)
+		{
+			outFirstLevel = 0;
+			outSecondLevel = size;
+			return;
+		}
+
+		const uint32_t log2 = uint32_t(std::bit_width(size)) - 1;
+		outFirstLevel = log2 - SECOND_LEVEL_BITS + 1;
+		outSecondLevel = (size >> (log2 - SECOND_LEVEL_BITS)) ^ SECOND_LEVEL_COUNT;
+	}
+
+	uint32_t RangeAllocator::createBlock(uint32_t offset, uint32_t size, uint32_t previous, uint32_t next)
+	{
+		uint32_t block;
+		if (!m_unusedBlocks.empty())
+		{
+			block = m_unusedBlocks.back();
+			m_unusedBlocks.pop_back();
+		}
+		else
+		{
+			block = uint32_t(m_blocks.size());
+			m_blocks.emplace_back();
+		}
+
+		m_blocks[block] = { offset, size, previous, next, NONE, NONE, false, true };
+		(previous != NONE ? m_blocks[previous].next : m_firstBlock) = block;
+		(next != NONE ? m_blocks[next].previous : m_lastBlock) = block;
+		return block;
+	}
+
+	void RangeAllocator::releaseBlock(uint32_t block)
+	{
+		Block& data = m_blocks[block];
+		(data.previous != NONE ? m_blocks[data.previous].next : m_firstBlock) = data.next;
+		(data.next != NONE ? m_blocks[data.next].previous : m_lastBlock) = data.previous;
+
+		data.isAllocated = false;
+		m_unusedBlocks.push_back(block);
+	}
+
+	void RangeAllocator::insertFree(uint32_t block)
+	{
+		Block& data = m_blocks[block];
+		uint32_t firstLevel, secondLevel;
+		getSizeClass(data.size, firstLevel, secondLevel);
+
+		uint32_t& head = m_freeLists[firstLevel][secondLevel];
+		data.isFree = true;
+		data.previousFree = NONE;
+		data.nextFree = head;
+		if (head != NONE)
+		{
+			m_blocks[head].previousFree = block;
+		}
+		head = block;
+
+		m_firstLevelBitmap |= 1u << firstLevel;
+		m_secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+	}
+
+	void RangeAllocator::removeFree(uint32_t block)
+	{
+		Block& data = m_blocks[block];
+		DEV_ASSERT(data.isFree);
+
+		uint32_t firstLevel, secondLevel;
+		getSizeClass(data.size, firstLevel, secondLevel);
+
+		if (data.previousFree != NONE)
+		{
+			m_blocks[data.previousFree].nextFree = data.nextFree;
+		}
+		else
+		{
+			m_freeLists[firstLevel][secondLevel] = data.nextFree;
+			if (data.nextFree == NONE)
+			{
+				m_secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+				if (m_secondLevelBitmaps[firstLevel] == 0)
+				{
+					m_firstLevelBitmap &= ~(1u << firstLevel);
+				}
+			}
+		}
+		if (data.nextFree != NONE)
+		{
+			m_blocks[data.nextFree].previousFree = data.previousFree;
+		}
+
+		data.isFree = false;
+	}
+
+	uint32_t RangeAllocator::findFree(uint32_t size) const
+	{
+		// Every range in the classes above the class of size fits, so the search starts at the next class unless size is its lower bound.
+		// The class of size itself holds smaller ranges as well, it's only searched when nothing larger is free.
+		uint32_t firstLevel, secondLevel;
+		getSizeClass(size, firstLevel, secondLevel);
+
+		uint32_t classFirstLevel = firstLevel, classSecondLevel = secondLevel;
+		const uint32_t classSize = firstLevel == 0 ? size : (SECOND_LEVEL_COUNT | secondLevel) << (firstLevel - 1);
+		if (classSize != size)
+		{
+			if (++secondLevel == SECOND_LEVEL_COUNT)
+			{
+				secondLevel = 0;
+				++firstLevel;
+			}
+		}
+
+		if (firstLevel < FIRST_LEVEL_COUNT)
+		{
+			uint32_t secondLevelMap = m_secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+			if (secondLevelMap == 0)
+			{
+				const uint32_t firstLevelMap = firstLevel + 1 < FIRST_LEVEL_COUNT ? m_firstLevelBitmap & (~0u << (firstLevel + 1)) : 0;
+				if (firstLevelMap != 0)
+				{
+					firstLevel = uint32_t(std::countr_zero(firstLevelMap));
+					secondLevelMap = m_secondLevelBitmaps[firstLevel];
+				}
+			}
+			if (secondLevelMap != 0)
+			{
+				return m_freeLists[firstLevel][std::countr_zero(secondLevelMap)];
+			}
+		}
+
+		for (uint32_t block = m_freeLists[classFirstLevel][classSecondLevel]; block != NONE; block = m_blocks[block].nextFree)
+		{
+			if (m_blocks[block].size >= size)
+			{
+				return block;
+			}
+		}
+		return NONE;
+	}
+
+	RangeAllocator::Handle RangeAllocator::allocate(uint32_t size)
+	{
+		DEV_ASSERT(size > 0);
+
+		const uint32_t block = findFree(size);
+		if (block == NONE)
+		{
+			return INVALID_HANDLE;
+		}
+
+		removeFree(block);
+		if (m_blocks[block].size > size)
+		{
+			const uint32_t rest = createBlock(m_blocks[block].offset + size, m_blocks[block].size - size, block, m_blocks[block].next);
+			m_blocks[block].size = size;
+			insertFree(rest);
+		}
+
+		m_usedSize += size;
+		++m_allocationCount;
+		return block;
+	}
+
+	void RangeAllocator::free(Handle handle)
+	{
+		DEV_ASSERT(handle < m_blocks.size() && m_blocks[handle].isAllocated && !m_blocks[handle].isFree);
+
+		uint32_t block = handle;
+		m_usedSize -= m_blocks[block].size;
+		--m_allocationCount;
+
+		const uint32_t next = m_blocks[block].next;
+		if (next != NONE && m_blocks[next].isFree)
+		{
+			removeFree(next);
+			m_blocks[block].size += m_blocks[next].size;
+			releaseBlock(next);
+		}
+
+		const uint32_t previous = m_blocks[block].previous;
+		if (previous != NONE && m_blocks[previous].isFree)
+		{
+			removeFree(previous);
+			m_blocks[previous].size += m_blocks[block].size;
+			releaseBlock(block);
+			block = previous;
+		}
+
+		insertFree(block);
+	}
+
+	uint32_t RangeAllocator::getOffset(Handle handle) const
+	{
+		DEV_ASSERT(handle < m_blocks.size() && m_blocks[handle].isAllocated && !m_blocks[handle].isFree);
+		return m_blocks[handle].offset;
+	}
+
+	uint32_t RangeAllocator::getSize(Handle handle) const
+	{
+		DEV_ASSERT(handle < m_blocks.size() && m_blocks[handle].isAllocated && !m_blocks[handle].isFree);
+		return m_blocks[handle].size;
+	}
+
+	uint32_t RangeAllocator::getLargestFreeSize() const
+	{
+		if (m_firstLevelBitmap == 0)
+		{
+			return 0;
+		}
+
+		const uint32_t firstLevel = 31 - uint32_t(std::countl_zero(m_firstLevelBitmap));
+		const uint32_t secondLevel = 31 - uint32_t(std::countl_zero(m_secondLevelBitmaps[firstLevel]));
+
+		uint32_t largest = 0;
+		for (uint32_t block = m_freeLists[firstLevel][secondLevel]; block != NONE; block = m_blocks[block].nextFree)
+		{
+			largest = std::max(largest, m_blocks[block].size);
+		}
+		return largest;
+	}
+
+	void RangeAllocator::grow(uint32_t capacity)
+	{
+		DEV_ASSERT(capacity >= m_capacity);
+		if (capacity == m_capacity)
+		{
+			return;
+		}
+
+		const uint32_t added = capacity - m_capacity;
+		if (m_lastBlock != NONE && m_blocks[m_lastBlock].isFree)
+		{
+			removeFree(m_lastBlock);
+			m_blocks[m_lastBlock].size += added;
+			insertFree(m_lastBlock);
+		}
+		else
+		{
+			insertFree(createBlock(m_capacity, added, m_lastBlock, NONE));
+		}
+
+		m_capacity = capacity;
+	}
+
+	std::vector<RangeAllocator::Move> RangeAllocator::defragment()
+	{
+		std::vector<Move> moves;
+
+		uint32_t offset = 0;
+		uint32_t block = m_firstBlock;
+		while (block != NONE)
+		{
+			const uint32_t next = m_blocks[block].next;
+			Block& data = m_blocks[block];
+			if (data.isFree)
+			{
+				removeFree(block);
+				releaseBlock(block);
+			}
+			else
+			{
+				if (data.offset != offset)
+				{
+					moves.push_back({ block, data.offset, offset, data.size });
+					data.offset = offset;
+				}
+				offset += data.size;
+			}
+			block = next;
+		}
+
+		if (offset < m_capacity)
+		{
+			insertFree(createBlock(offset, m_capacity - offset, m_lastBlock, NONE));
+		}
+
+		return moves;
+	}
+}
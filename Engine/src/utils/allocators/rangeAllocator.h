@@ -0,0 +1,101 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+namespace Engine
+{
+	// Suballocates ranges of a linear resource of capacity units, e.g. vertices of a GPU buffer. Only the offsets are managed,
+	// the resource itself is never touched, so the logic doesn't depend on what the units are.
+	// Free ranges are kept in two-level segregated fit (TLSF) lists: the first level by the power of two of their size,
+	// the second one splits each power of two linearly, and bitmaps of the non-empty lists make allocating and freeing O(1).
+	// Neighbouring free ranges are merged at once, and defragment packs all allocations to the start of the resource.
+	class RangeAllocator
+	{
+	public:
+		using Handle = uint32_t;
+		const static Handle INVALID_HANDLE;
+
+		struct Move
+		{
+			Handle handle;
+			uint32_t oldOffset;
+			uint32_t newOffset;
+			uint32_t size;
+		};
+
+		explicit RangeAllocator(uint32_t capacity = 0);
+
+		// Returns INVALID_HANDLE if no free range is large enough, even though getFreeSize may be, then defragment or grow help.
+		// Handles stay valid until they are freed, offsets only change in defragment.
+		Handle allocate(uint32_t size);
+		void free(Handle handle);
+
+		uint32_t getOffset(Handle handle) const;
+		uint32_t getSize(Handle handle) const;
+
+		uint32_t getCapacity() const
+		{
+			return m_capacity;
+		}
+		uint32_t getUsedSize() const
+		{
+			return m_usedSize;
+		}
+		uint32_t getFreeSize() const
+		{
+			return m_capacity - m_usedSize;
+		}
+		uint32_t getLargestFreeSize() const;
+		uint32_t getAllocationCount() const
+		{
+			return m_allocationCount;
+		}
+
+		// Adds free space at the end, allocations keep their offsets.
+		void grow(uint32_t capacity);
+
+		// Moves all allocations to the start in the order of their offsets, leaving one free range at the end. Returns the moves
+		// in that order, every range moves to a lower offset, so copying them one after another never overwrites a range still to be copied.
+		std::vector<Move> defragment();
+
+	private:
+		static constexpr uint32_t SECOND_LEVEL_BITS = 4;
+		static constexpr uint32_t SECOND_LEVEL_COUNT = 1 << SECOND_LEVEL_BITS;
+		static constexpr uint32_t FIRST_LEVEL_COUNT = 32 - SECOND_LEVEL_BITS + 1;
+		static constexpr uint32_t NONE = ~0u;
+
+		// Ranges in the order of their offsets, both allocated and free. Free ranges are also linked in the list of their size class.
+		struct Block
+		{
+			uint32_t offset;
+			uint32_t size;
+			uint32_t previous;
+			uint32_t next;
+			uint32_t previousFree;
+			uint32_t nextFree;
+			bool isFree;
+			bool isAllocated; // allocated or free, false for unused entries of m_blocks
+		};
+
+		std::vector<Block> m_blocks;
+		std::vector<uint32_t> m_unusedBlocks;
+		uint32_t m_firstBlock = NONE;
+		uint32_t m_lastBlock = NONE;
+
+		uint32_t m_firstLevelBitmap = 0;
+		uint32_t m_secondLevelBitmaps[FIRST_LEVEL_COUNT] = {};
+		uint32_t m_freeLists[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+
+		uint32_t m_capacity = 0;
+		uint32_t m_usedSize = 0;
+		uint32_t m_allocationCount = 0;
+
+		static void getSizeClass(uint32_t size, uint32_t& outFirstLevel, uint32_t& outSecondLevel);
+
+		uint32_t createBlock(uint32_t offset, uint32_t size, uint32_t previous, uint32_t next);
+		void releaseBlock(uint32_t block);
+		void insertFree(uint32_t block);
+		void removeFree(uint32_t block);
+		uint32_t findFree(uint32_t size) const;
+	};
+}
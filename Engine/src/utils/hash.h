@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+
+namespace Engine
+{
+	// Non-cryptographic 64-bit hashing for content keys, e.g. to detect stale caches. Not suitable for untrusted input.
+	inline uint64_t mixHash(uint64_t hash, uint64_t value)
+	{
+		hash ^= value * 0x9E3779B97F4A7C15ull;
+		hash = (hash ^ (hash >> 32)) * 0xD6E8FEB86659FD93ull;
+		return hash ^ (hash >> 32);
+	}
+
+	// consumes 8 bytes per step, pass the previous result as hash to chain several ranges
+	inline uint64_t hashBytes(const void* data, size_t size, uint64_t hash = 0)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (; size >= sizeof(uint64_t); bytes += sizeof(uint64_t), size -= sizeof(uint64_t))
+		{
+			uint64_t value;
+			memcpy(&value, bytes, sizeof(uint64_t));
+			hash = mixHash(hash, value);
+		}
+
+		uint64_t tail = 0;
+		memcpy(&tail, bytes, size);
+		return mixHash(hash, tail ^ (uint64_t(size) << 56));
+	}
+}
@@ -0,0 +1,57 @@
+#include "mappedFile.h"
+#include "../dependencies/Windows/win.h"
+
+namespace Engine
+{
+	std::shared_ptr<const MappedFile> MappedFile::open(const std::string& filePath)
+	{
+		std::shared_ptr<MappedFile> file(new MappedFile());
+
+		// writers are allowed so ModelCache can update header fields of a cache that is still mapped, the data itself is never rewritten in place
+		HANDLE handle = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+		if (handle == INVALID_HANDLE_VALUE)
+		{
+			return nullptr;
+		}
+		file->m_file = handle;
+
+		LARGE_INTEGER size;
+		if (!GetFileSizeEx(handle, &size) || size.QuadPart == 0)
+		{
+			return nullptr;
+		}
+
+		file->m_mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (!file->m_mapping)
+		{
+			return nullptr;
+		}
+
+		file->m_data = static_cast<const uint8_t*>(MapViewOfFile(file->m_mapping, FILE_MAP_READ, 0, 0, 0));
+		if (!file->m_data)
+		{
+			return nullptr;
+		}
+		file->m_size = size_t(size.QuadPart);
+
+		return file;
+	}
+
+	MappedFile::~MappedFile()
+	{
+		if (m_data)
+		{
+			UnmapViewOfFile(m_data);
+		}
+
+		if (m_mapping)
+		{
+			CloseHandle(m_mapping);
+		}
+
+		if (m_file)
+		{
+			CloseHandle(m_file);
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace Engine
+{
+	// Read-only mapping of a whole file into memory, pages are loaded by the OS on first access.
+	// The mapping is released together with the object.
+	class MappedFile
+	{
+	public:
+		// returns nullptr if the file doesn't exist, is empty or can't be mapped
+		static std::shared_ptr<const MappedFile> open(const std::string& filePath);
+
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile();
+
+		const uint8_t* data() const
+		{
+			return m_data;
+		}
+
+		size_t size() const
+		{
+			return m_size;
+		}
+
+	protected:
+		MappedFile() = default;
+
+		void* m_file = nullptr; // HANDLE
+		void* m_mapping = nullptr; // HANDLE
+		const uint8_t* m_data = nullptr;
+		size_t m_size = 0;
+	};
+}
@@ -0,0 +1,114 @@
+#include "memoryBudget.h"
+#include "assert.h"
+#include <algorithm>
+
+namespace Engine
+{
+	MemoryBudget::MemoryBudget(uint64_t limit)
+		: m_limit(limit)
+	{
+	}
+
+	void MemoryBudget::setLimit(uint64_t limit)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_limit = limit;
+		}
+		m_released.notify_all();
+	}
+
+	uint64_t MemoryBudget::getLimit() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_limit;
+	}
+
+	uint64_t MemoryBudget::getReservedSize() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_reservedSize;
+	}
+
+	void MemoryBudget::reserve(uint64_t bytes, bool wait)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (wait)
+		{
+			m_released.wait(lock, [this, bytes]()
+			{
+				return m_limit == 0 || m_reservedSize == 0 || (m_reservedSize <= m_limit && bytes <= m_limit - m_reservedSize);
+			});
+		}
+		m_reservedSize += bytes;
+	}
+
+	void MemoryBudget::release(uint64_t bytes)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			DEV_ASSERT(bytes <= m_reservedSize);
+			m_reservedSize -= bytes;
+		}
+		m_released.notify_all();
+	}
+
+	MemoryBudget::Reservation::Reservation(MemoryBudget& budget)
+		: m_budget(budget)
+	{
+	}
+
+	MemoryBudget::Reservation::~Reservation()
+	{
+		if (m_reservedSize > 0)
+		{
+			m_budget.release(m_reservedSize);
+		}
+	}
+
+	void MemoryBudget::Reservation::start(uint64_t expectedPeak)
+	{
+		DEV_ASSERT(!m_isStarted);
+		m_isStarted = true;
+
+		// bytes added before are still held, they only have to be reserved now
+		const uint64_t bytes = std::max(expectedPeak, m_size);
+		m_budget.reserve(bytes, true);
+		m_reservedSize = bytes;
+	}
+
+	void MemoryBudget::Reservation::restart(uint64_t expectedPeak)
+	{
+		DEV_ASSERT(m_isStarted);
+
+		// released first, waiting while holding it could deadlock with other restarting users
+		if (m_reservedSize > 0)
+		{
+			m_budget.release(m_reservedSize);
+			m_reservedSize = 0;
+		}
+
+		const uint64_t bytes = std::max(expectedPeak, m_size);
+		m_budget.reserve(bytes, true);
+		m_reservedSize = bytes;
+	}
+
+	void MemoryBudget::Reservation::add(uint64_t bytes)
+	{
+		m_size += bytes;
+		m_peakSize = std::max(m_peakSize, m_size);
+
+		// never waits, the bytes are already allocated
+		if (m_isStarted && m_size > m_reservedSize)
+		{
+			m_budget.reserve(m_size - m_reservedSize, false);
+			m_reservedSize = m_size;
+		}
+	}
+
+	void MemoryBudget::Reservation::remove(uint64_t bytes)
+	{
+		DEV_ASSERT(bytes <= m_size);
+		m_size -= bytes;
+	}
+}
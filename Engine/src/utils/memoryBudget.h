@@ -0,0 +1,71 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include "nonCopyable.h"
+
+namespace Engine
+{
+	// Bytes shared by users running concurrently, e.g. model loads. Users reserve their expected peak before they start and wait while it
+	// doesn't fit under the limit next to the others, a user that doesn't fit even alone starts once nothing else is reserved.
+	// Only the expected peaks are waited for: a user growing past its expected peak isn't stopped, since two users waiting for each other's
+	// memory while holding their own would deadlock. So the reserved size stays under the limit only while the expected peaks hold,
+	// otherwise it exceeds it by as much as the running users underestimated theirs.
+	class MemoryBudget
+		: public NonCopyable
+	{
+	public:
+		// 0 is no limit
+		explicit MemoryBudget(uint64_t limit = 0);
+
+		// wakes the users waiting to start, a lower limit doesn't affect the ones running
+		void setLimit(uint64_t limit);
+		uint64_t getLimit() const;
+		uint64_t getReservedSize() const;
+
+		// Bytes of one user, reserved on start and returned on destruction. Counts the bytes the user allocates (add) and frees (remove)
+		// to know its peak. Allocating past the reservation grows it without waiting, see MemoryBudget.
+		// Used by a single thread.
+		class Reservation
+			: public NonCopyable
+		{
+		public:
+			explicit Reservation(MemoryBudget& budget);
+			~Reservation();
+
+			// blocks until expectedPeak fits, once per reservation
+			void start(uint64_t expectedPeak);
+			// Returns the reservation and blocks until the new expectedPeak fits, for users that learn after starting that they
+			// take another path. Nothing is reserved while waiting, so the user shouldn't hold counted bytes then.
+			void restart(uint64_t expectedPeak);
+
+			void add(uint64_t bytes);
+			void remove(uint64_t bytes);
+
+			uint64_t getSize() const
+			{
+				return m_size;
+			}
+			uint64_t getPeakSize() const
+			{
+				return m_peakSize;
+			}
+
+		private:
+			MemoryBudget& m_budget;
+			uint64_t m_reservedSize = 0;
+			uint64_t m_size = 0;
+			uint64_t m_peakSize = 0;
+			bool m_isStarted = false;
+		};
+
+	private:
+		mutable std::mutex m_mutex;
+		std::condition_variable m_released;
+		uint64_t m_limit;
+		uint64_t m_reservedSize = 0;
+
+		void reserve(uint64_t bytes, bool wait);
+		void release(uint64_t bytes);
+	};
+}
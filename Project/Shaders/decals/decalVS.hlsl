@@ -1,13 +1,9 @@
 #include "../globals.hlsl"
+#include "../vertex.hlsl"
 
 struct vs_in
 {
-    float3 position_local : POS;
-    float4 color_local : COL;
-    float2 textureCoordinates : TEX;
-    float3 normal : NORM;
-    float3 tangent : TANG;
-    float3 bitangent : BTANG;
+    VERTEX_INPUT
 
     float4 decalToWorld0 : INS0;
     float4 decalToWorld1 : INS1;
@@ -2,12 +2,7 @@
 
 struct vs_in
 {
-    float3 position_local : POS;
-    float4 color_local : COL;
-    float2 textureCoordinates : TEX;
-    float3 normal : NORM;
-    float3 tangent : TANG;
-    float3 bitangent : BTANG;
+    float3 position_local : POS; // position stream of models, see Model::getPositionInputElements
 
     float4 instanceMat0 : INS0;
     float4 instanceMat1 : INS1;
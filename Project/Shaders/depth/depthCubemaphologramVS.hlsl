@@ -1,14 +1,10 @@
 #include "../globals.hlsl"
+#include "../vertex.hlsl"
 #include "distortion.hlsl"
 
 struct vs_in
 {
-    float3 position_local : POS;
-    float4 color_local : COL;
-    float2 textureCoordinates : TEX;
-    float3 normal : NORM;
-    float3 tangent : TANG;
-    float3 bitangent : BTANG;
+    VERTEX_INPUT
 
     float4 instanceMat0 : INS0;
     float4 instanceMat1 : INS1;
@@ -37,7 +33,7 @@ vs_out main(vs_in input)
     float3 axisY = normalize(input.instanceMat1.xyz);
     float3 axisZ = normalize(input.instanceMat2.xyz);
 
-    float3 normal = input.normal.x * axisX + input.normal.y * axisY + input.normal.z * axisZ;
+    float3 normal = mul(VERTEX_NORMAL(input), float3x3(axisX, axisY, axisZ));
     output.normal = normal;
 
     float3 pos3 = worldPos.xyz;
@@ -21,6 +21,10 @@
     #define MAX_VOLUMETRIC_FOG_INSTANCES 8
 #endif
 
+#ifndef PACKED_VERTICES
+    #define PACKED_VERTICES 0
+#endif
+
 cbuffer PerFrame : register(b0)
 {
     float g_time; 
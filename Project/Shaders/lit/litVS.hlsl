@@ -1,13 +1,9 @@
 #include "../globals.hlsl"
+#include "../vertex.hlsl"
 
 struct vs_in
 {
-	float3 position_local : POS;
-	float4 color_local : COL;
-	float2 textureCoordinates : TEX;
-	float3 normal : NORM;
-	float3 tangent : TANG;
-	float3 bitangent : BTANG;
+	VERTEX_INPUT
 
 	float4 instanceMat0 : INS0;
 	float4 instanceMat1 : INS1;
@@ -40,14 +36,14 @@ vs_out main(vs_in input)
 
 	output.position_clip = mul(worldPos, g_viewProj);
 
-	output.color = input.color_local;
+	output.color = VERTEX_COLOR(input);
 
 	float3 axisX = normalize(input.instanceMat0.xyz);
 	float3 axisY = normalize(input.instanceMat1.xyz);
 	float3 axisZ = normalize(input.instanceMat2.xyz);
 
-	float3 N = normalize(input.normal.x * axisX + input.normal.y * axisY + input.normal.z * axisZ);
-	float3 T = normalize(input.tangent.x * axisX + input.tangent.y * axisY + input.tangent.z * axisZ);
+	float3 N = normalize(mul(VERTEX_NORMAL(input), float3x3(axisX, axisY, axisZ)));
+	float3 T = normalize(mul(VERTEX_TANGENT(input), float3x3(axisX, axisY, axisZ)));
 	float3 B = cross(T, N);
 
 	float3x3 TBN = float3x3(T, B, N);
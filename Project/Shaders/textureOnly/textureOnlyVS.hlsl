@@ -1,13 +1,9 @@
 #include "../globals.hlsl"
+#include "../vertex.hlsl"
 
 struct vs_in
 {
-	float3 position_local : POS;
-	float4 color_local : COL;
-	float2 textureCoordinates : TEX;
-	float3 normal : NORM;
-	float3 tangent : TANG;
-	float3 bitangent : BTANG;
+	VERTEX_INPUT
 
 	float4 instanceMat0 : INS0;
 	float4 instanceMat1 : INS1;
@@ -36,7 +32,7 @@ vs_out main(vs_in input)
 	pos = mul(pos, g_viewProj);
 
 	output.position_clip = pos;
-	output.color = input.color_local;
+	output.color = VERTEX_COLOR(input);
 	output.texCoord = input.textureCoordinates;
     output.instanceNumber = input.instanceNumber;
 	
@@ -0,0 +1,63 @@
+#ifndef __VERTEX_HLSL__
+#define __VERTEX_HLSL__
+
+// Per-vertex part of vs_in of shaders drawing model vertex buffers, matching Model::getVertexInputElements.
+// Shaders read the attributes through the VERTEX_* macros, so they work with both layouts.
+#if PACKED_VERTICES
+    // math::PackedVertex, see packedVertex.cpp for the encoding
+    #define VERTEX_INPUT \
+        float3 position_local : POS; \
+        float2 textureCoordinates : TEX; \
+        uint tangentFrame : FRAME;
+
+    #define VERTEX_COLOR(input) float4(1.0, 0.0, 1.0, 1.0)
+    #define VERTEX_NORMAL(input) unpackVertexNormal(input.tangentFrame)
+    #define VERTEX_TANGENT(input) unpackVertexTangent(input.tangentFrame)
+
+    static const uint VERTEX_NORMAL_BITS = 11;
+    static const uint VERTEX_ANGLE_BITS = 9;
+    static const int VERTEX_NORMAL_MAX = (1 << (VERTEX_NORMAL_BITS - 1)) - 1;
+    static const uint VERTEX_ANGLE_STEPS = 1 << VERTEX_ANGLE_BITS;
+
+    float3 unpackVertexNormal(uint tangentFrame)
+    {
+        uint normalMask = (1 << VERTEX_NORMAL_BITS) - 1;
+        int2 quantized = int2(tangentFrame & normalMask, (tangentFrame >> VERTEX_NORMAL_BITS) & normalMask) - VERTEX_NORMAL_MAX;
+
+        float2 p = float2(quantized) / VERTEX_NORMAL_MAX;
+        float3 normal = float3(p, 1.0 - abs(p.x) - abs(p.y));
+        float t = saturate(-normal.z);
+        normal.xy += normal.xy >= 0.0 ? -t : t;
+        return normalize(normal);
+    }
+
+    // the tangent is stored as its angle in the same basis as buildBasis in packedVertex.cpp builds
+    float3 unpackVertexTangent(uint tangentFrame)
+    {
+        float3 normal = unpackVertexNormal(tangentFrame);
+
+        float sign = normal.z >= 0.0 ? 1.0 : -1.0;
+        float a = -1.0 / (sign + normal.z);
+        float b = normal.x * normal.y * a;
+        float3 basisX = float3(1.0 + sign * normal.x * normal.x * a, sign * b, -sign * normal.x);
+        float3 basisY = float3(b, sign + normal.y * normal.y * a, -normal.y);
+
+        float angle = float((tangentFrame >> (2 * VERTEX_NORMAL_BITS)) & (VERTEX_ANGLE_STEPS - 1)) * (2.0 * PI / VERTEX_ANGLE_STEPS);
+        return basisX * cos(angle) + basisY * sin(angle);
+    }
+#else
+    // math::Vertex
+    #define VERTEX_INPUT \
+        float3 position_local : POS; \
+        float4 color_local : COL; \
+        float2 textureCoordinates : TEX; \
+        float3 normal : NORM; \
+        float3 tangent : TANG; \
+        float3 bitangent : BTANG;
+
+    #define VERTEX_COLOR(input) input.color_local
+    #define VERTEX_NORMAL(input) input.normal
+    #define VERTEX_TANGENT(input) input.tangent
+#endif
+
+#endif
@@ -39,6 +39,13 @@ Application::Application(HWND windowHandle)
 
 	initCamera();
 
+	// Models are parsed on worker threads while the textures below are loaded. Objects with per-mesh materials
+	// still wait for their model in getModel, the others are added with the placeholder and appear once it's loaded.
+	for (const char* modelPath : { "Assets/Models/EastTower/EastTower.fbx", "Assets/Models/Knight/Knight.fbx", "Assets/Models/KnightHorse/KnightHorse.fbx", "Assets/Models/Samurai/Samurai.fbx" })
+	{
+		Engine::ModelManager::getInstancePtr()->getModelAsync(modelPath);
+	}
+
 	auto* textureManager = Engine::TextureManager::getInstance();
 	{
 		auto tex = textureManager->getTexture(L"Assets/Textures/Cubemaps/Cubemap_mountains.dds");
@@ -290,7 +297,7 @@ void Application::createHologramObjects()
 	using namespace Engine::ShadingGroupsDetails;
 	using namespace Engine::math;
 
-	auto samurai = Engine::ModelManager::getInstancePtr()->getModel("Assets/Models/Samurai/Samurai.fbx");
+	auto samurai = Engine::ModelManager::getInstancePtr()->getModelAsync("Assets/Models/Samurai/Samurai.fbx");
 	
 	Mat4f transform = Mat4f::Identity();
 	setTranslation(transform, { 0.0f, 0.0f, 1.0f });
@@ -0,0 +1,273 @@
+#include "test.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "render/meshSystem/mesh/boundingVolumes.h"
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Engine;
+
+namespace
+{
+	const float TOLERANCE = 1e-4f; // relative
+
+	std::vector<math::Vertex> createVertices(const std::vector<math::Vec3f>& positions)
+	{
+		std::vector<math::Vertex> vertices(positions.size());
+		for (size_t i = 0; i < positions.size(); ++i)
+		{
+			vertices[i].position = positions[i];
+		}
+		return vertices;
+	}
+
+	// points on a sphere around center, rotated and stretched per axis by scale
+	std::vector<math::Vertex> createRandomVertices(std::mt19937& random, uint32_t count, const math::Vec3f& center, const math::Vec3f& scale, const math::Mat3f& rotation)
+	{
+		std::normal_distribution<float> distribution;
+		std::vector<math::Vec3f> positions;
+		while (positions.size() < count)
+		{
+			const math::Vec3f direction(distribution(random), distribution(random), distribution(random));
+			if (direction.squaredNorm() > 1e-6f)
+			{
+				positions.push_back(center + direction.normalized().cwiseProduct(scale) * rotation);
+			}
+		}
+		return createVertices(positions);
+	}
+
+	bool contains(const math::Sphere& sphere, const math::Vec3f& point)
+	{
+		return (point - sphere.position).norm() <= sphere.radius * (1.0f + TOLERANCE) + TOLERANCE;
+	}
+
+	bool contains(const math::OrientedBox& box, const math::Vec3f& point)
+	{
+		const math::Vec3f local = (point - box.center) * box.axes.transpose();
+		return (local.cwiseAbs() - box.halfSize).maxCoeff() <= TOLERANCE * (1.0f + box.halfSize.maxCoeff());
+	}
+
+	bool contains(const math::KDop& hull, const math::Vec3f& point)
+	{
+		for (uint32_t i = 0; i < math::KDop::DIRECTION_COUNT; ++i)
+		{
+			const float distance = point.dot(math::KDop::DIRECTIONS[i]);
+			if (distance < hull.min[i] || distance > hull.max[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool contains(const math::Box& box, const math::Vec3f& point)
+	{
+		const float tolerance = TOLERANCE * (1.0f + box.size().maxCoeff());
+		return (box.min - point).maxCoeff() <= tolerance && (point - box.max).maxCoeff() <= tolerance;
+	}
+}
+
+TEST(boundingSphereOfKnownShapes)
+{
+	// a single point, two points, an equilateral triangle and a regular tetrahedron around (1, 2, 3)
+	const math::Vec3f center(1.0f, 2.0f, 3.0f);
+	math::Sphere sphere = BoundingVolumes::computeSphere(createVertices({ center }));
+	CHECK((sphere.position - center).norm() < TOLERANCE);
+	CHECK(sphere.radius >= 0.0f && sphere.radius < TOLERANCE);
+
+	sphere = BoundingVolumes::computeSphere(createVertices({ center - math::Vec3f(2.0f, 0.0f, 0.0f), center + math::Vec3f(2.0f, 0.0f, 0.0f) }));
+	CHECK((sphere.position - center).norm() < TOLERANCE);
+	CHECK(std::abs(sphere.radius - 2.0f) < TOLERANCE);
+
+	const float s = std::sqrt(3.0f) / 2.0f;
+	sphere = BoundingVolumes::computeSphere(createVertices({ center + math::Vec3f(1.0f, 0.0f, 0.0f), center + math::Vec3f(-0.5f, s, 0.0f), center + math::Vec3f(-0.5f, -s, 0.0f) }));
+	CHECK((sphere.position - center).norm() < TOLERANCE);
+	CHECK(std::abs(sphere.radius - 1.0f) < TOLERANCE);
+
+	sphere = BoundingVolumes::computeSphere(createVertices({ center + math::Vec3f(1, 1, 1), center + math::Vec3f(1, -1, -1), center + math::Vec3f(-1, 1, -1), center + math::Vec3f(-1, -1, 1) }));
+	CHECK((sphere.position - center).norm() < TOLERANCE);
+	CHECK(std::abs(sphere.radius - std::sqrt(3.0f)) < TOLERANCE);
+
+	// points inside don't change it
+	sphere = BoundingVolumes::computeSphere(createVertices({ center, center + math::Vec3f(0.0f, 0.0f, 3.0f), center + math::Vec3f(0.1f, 0.2f, 1.0f), center + math::Vec3f(0.0f, 0.0f, -3.0f) }));
+	CHECK((sphere.position - center).norm() < TOLERANCE);
+	CHECK(std::abs(sphere.radius - 3.0f) < TOLERANCE);
+
+	CHECK(BoundingVolumes::computeSphere({}).radius == 0.0f);
+}
+
+TEST(boundingSphereOfRandomPoints)
+{
+	std::mt19937 random(7);
+	const math::Vec3f center(-5.0f, 10.0f, 0.5f);
+	for (int i = 0; i < 20; ++i)
+	{
+		// on a sphere of radius 3 the minimal sphere is that sphere, up to how well the points cover it
+		const std::vector<math::Vertex> vertices = createRandomVertices(random, 2000, center, math::Vec3f(3.0f, 3.0f, 3.0f), math::Mat3f::Identity());
+		const math::Sphere sphere = BoundingVolumes::computeSphere(vertices);
+		CHECK(sphere.radius <= 3.0f * (1.0f + TOLERANCE));
+		CHECK(sphere.radius >= 2.9f);
+		for (const math::Vertex& vertex : vertices)
+		{
+			CHECK(contains(sphere, vertex.position));
+		}
+	}
+}
+
+TEST(orientedBoxFitsRotatedBoxes)
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+	const math::Vec3f halfSize(4.0f, 1.0f, 0.25f);
+
+	for (int i = 0; i < 20; ++i)
+	{
+		const math::Mat3f rotation = Eigen::AngleAxisf(3.0f * distribution(random), math::Vec3f(distribution(random), distribution(random), distribution(random)).normalized()).toRotationMatrix();
+		const math::Vec3f center(distribution(random) * 10.0f, distribution(random) * 10.0f, distribution(random) * 10.0f);
+
+		// the corners and points inside the rotated box
+		std::vector<math::Vec3f> positions;
+		for (int corner = 0; corner < 8; ++corner)
+		{
+			const math::Vec3f sign(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+			positions.push_back(center + sign.cwiseProduct(halfSize) * rotation);
+		}
+		for (int point = 0; point < 200; ++point)
+		{
+			const math::Vec3f local(distribution(random), distribution(random), distribution(random));
+			positions.push_back(center + local.cwiseProduct(halfSize) * rotation);
+		}
+		const std::vector<math::Vertex> vertices = createVertices(positions);
+
+		const math::OrientedBox box = BoundingVolumes::computeOrientedBox(vertices);
+		for (const math::Vertex& vertex : vertices)
+		{
+			CHECK(contains(box, vertex.position));
+		}
+
+		// never larger than the axis aligned box, and close to the rotated one, the candidate orientations only approximate its axes
+		const math::OrientedBox exact = { center, rotation, halfSize };
+		CHECK(box.surfaceArea() <= math::OrientedBox::fromBox(BoundingVolumes::computeHull(vertices).getBounds()).surfaceArea() * (1.0f + TOLERANCE));
+		CHECK(box.surfaceArea() <= exact.surfaceArea() * 1.25f);
+		CHECK(std::abs(box.axes.determinant()) > 1.0f - TOLERANCE);
+	}
+}
+
+TEST(hullContainsVertices)
+{
+	std::mt19937 random(3);
+	const std::vector<math::Vertex> vertices = createRandomVertices(random, 500, math::Vec3f(1.0f, -2.0f, 3.0f), math::Vec3f(5.0f, 1.0f, 2.0f), math::Mat3f::Identity());
+	const math::KDop hull = BoundingVolumes::computeHull(vertices);
+
+	math::Box bounds = math::Box::empty();
+	for (const math::Vertex& vertex : vertices)
+	{
+		CHECK(contains(hull, vertex.position));
+		bounds.expand(vertex.position);
+	}
+
+	// the first directions are the axes, every plane touches a vertex up to the padding against rounding
+	CHECK(contains(bounds, hull.getBounds().min) && contains(bounds, hull.getBounds().max));
+	for (uint32_t i = 0; i < math::KDop::DIRECTION_COUNT; ++i)
+	{
+		float minDistance = math::Box::Inf, maxDistance = -math::Box::Inf;
+		for (const math::Vertex& vertex : vertices)
+		{
+			minDistance = std::min(minDistance, vertex.position.dot(math::KDop::DIRECTIONS[i]));
+			maxDistance = std::max(maxDistance, vertex.position.dot(math::KDop::DIRECTIONS[i]));
+		}
+		CHECK(hull.min[i] <= minDistance && minDistance - hull.min[i] < TOLERANCE);
+		CHECK(hull.max[i] >= maxDistance && hull.max[i] - maxDistance < TOLERANCE);
+	}
+}
+
+TEST(boundingVolumesTestPlanes)
+{
+	std::mt19937 random(5);
+	Mesh mesh;
+	mesh.vertices = createRandomVertices(random, 1000, math::Vec3f(2.0f, 0.0f, 0.0f), math::Vec3f(1.0f, 0.2f, 0.2f), math::Mat3f::Identity());
+	BoundingVolumes::build(mesh);
+
+	// the mesh spans x in [1, 3], planes are scaled to check they don't have to be normalized
+	for (float scale : { 1.0f, 0.01f, 25.0f })
+	{
+		const math::Vec4f outside[] = { math::Vec4f(-1.0f, 0.0f, 0.0f, 0.5f) * scale };
+		const math::Vec4f inside[] = { math::Vec4f(1.0f, 0.0f, 0.0f, -0.5f) * scale, math::Vec4f(0.0f, 1.0f, 0.0f, 5.0f) * scale };
+		const math::Vec4f intersecting[] = { math::Vec4f(1.0f, 0.0f, 0.0f, -2.0f) * scale, math::Vec4f(0.0f, 1.0f, 0.0f, 5.0f) * scale };
+		CHECK(BoundingVolumes::testPlanes(mesh, outside) == BoundingVolumes::Visibility::OUTSIDE);
+		CHECK(BoundingVolumes::testPlanes(mesh, inside) == BoundingVolumes::Visibility::INSIDE);
+		CHECK(BoundingVolumes::testPlanes(mesh, intersecting) == BoundingVolumes::Visibility::INTERSECTING);
+	}
+
+	// the sphere of the thin mesh reaches y = 1, the box doesn't
+	const math::Vec4f boxOutside[] = { math::Vec4f(0.0f, 1.0f, 0.0f, -0.5f) };
+	CHECK(mesh.boundingSphere.radius > 0.5f);
+	CHECK(BoundingVolumes::testPlanes(mesh, boxOutside) == BoundingVolumes::Visibility::OUTSIDE);
+}
+
+TEST(boundingVolumesWorldBoundsContainInstances)
+{
+	std::mt19937 random(9);
+	std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+
+	// not a multiple of any SIMD width, so the last batch has unused lanes
+	const uint32_t meshCount = 3;
+	const uint32_t instanceCount = 13;
+	std::vector<Mesh> meshes(meshCount);
+	for (Mesh& mesh : meshes)
+	{
+		mesh.vertices = createRandomVertices(random, 300, math::Vec3f(distribution(random), distribution(random), distribution(random)) * 5.0f,
+			math::Vec3f(3.0f, 1.0f, 0.5f), Eigen::AngleAxisf(distribution(random) * 3.0f, math::Vec3f(1.0f, 1.0f, 0.0f).normalized()).toRotationMatrix());
+		mesh.boundingBox = math::Box::empty();
+		for (const math::Vertex& vertex : mesh.vertices)
+		{
+			mesh.boundingBox.expand(vertex.position);
+		}
+		BoundingVolumes::build(mesh);
+	}
+
+	std::vector<math::Mat4f> matrices(instanceCount);
+	std::vector<const Mesh*> instanceMeshes(instanceCount);
+	std::vector<const math::Mat4f*> instanceMatrices(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		// rotation, non-uniform scale and translation, the last one mirrored
+		math::Mat4f& matrix = matrices[i];
+		matrix = math::Mat4f::Identity();
+		const math::Mat3f rotation = Eigen::AngleAxisf(distribution(random) * 3.0f, math::Vec3f(distribution(random), distribution(random), 1.0f).normalized()).toRotationMatrix();
+		const math::Vec3f scale(1.0f + distribution(random) * 0.5f, 1.0f, i + 1 == instanceCount ? -2.0f : 2.0f);
+		matrix.topLeftCorner<3, 3>() = scale.asDiagonal() * rotation;
+		math::setTranslation(matrix, math::Vec3f(distribution(random), distribution(random), distribution(random)) * 100.0f);
+
+		instanceMeshes[i] = &meshes[i % meshCount];
+		instanceMatrices[i] = &matrix;
+	}
+
+	float boundsVolume = 0.0f, transformedBoxVolume = 0.0f;
+	std::vector<math::Box> bounds(instanceCount);
+	BoundingVolumes::computeWorldBounds(instanceMeshes, instanceMatrices, bounds);
+
+	for (uint32_t i = 0; i < instanceCount; ++i)
+	{
+		const math::Box transformedBox = instanceMeshes[i]->boundingBox.transformed(matrices[i]);
+		math::Box exact = math::Box::empty();
+		for (const math::Vertex& vertex : instanceMeshes[i]->vertices)
+		{
+			const math::Vec3f position = (math::Vec4f(vertex.position.x(), vertex.position.y(), vertex.position.z(), 1.0f) * matrices[i]).head<3>();
+			CHECK(contains(bounds[i], position));
+			exact.expand(position);
+		}
+
+		// no looser than the transformed AABB
+		CHECK((transformedBox.min - bounds[i].min).maxCoeff() <= TOLERANCE * transformedBox.size().maxCoeff());
+		CHECK((bounds[i].max - transformedBox.max).maxCoeff() <= TOLERANCE * transformedBox.size().maxCoeff());
+		CHECK(bounds[i].size().prod() >= exact.size().prod());
+		boundsVolume += bounds[i].size().prod();
+		transformedBoxVolume += transformedBox.size().prod();
+	}
+
+	// and clearly tighter for these rotated meshes
+	CHECK(boundsVolume < transformedBoxVolume * 0.8f);
+}
@@ -0,0 +1,75 @@
+#include "test.h"
+#include "render/meshSystem/mesh/lodSelection.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+using namespace Engine;
+
+namespace
+{
+	const std::vector<float> LOD_ERRORS = { 0.001f, 0.004f, 0.02f, 0.1f };
+}
+
+TEST(lodSelectionNeverGetsFinerWithSmallerSize)
+{
+	for (int bias : { -2, 0, LodSelection::SHADOW_BIAS })
+	{
+		uint32_t previousLod = 0;
+		for (float size = 100.0f; size > 1e-6f; size *= 0.9f)
+		{
+			const uint32_t lod = LodSelection::selectLod(size, LOD_ERRORS, bias);
+			CHECK(lod >= previousLod);
+			CHECK(lod <= LOD_ERRORS.size());
+			previousLod = lod;
+		}
+		CHECK(previousLod == uint32_t(std::clamp(int(LOD_ERRORS.size()) + bias, 0, int(LOD_ERRORS.size()))));
+	}
+
+	// the same arguments give the same LOD
+	CHECK(LodSelection::selectLod(0.05f, LOD_ERRORS, 0) == LodSelection::selectLod(0.05f, LOD_ERRORS, 0));
+}
+
+TEST(lodSelectionClampsBias)
+{
+	const float fullSize = std::numeric_limits<float>::infinity();
+	const float tinySize = 1e-9f;
+
+	CHECK(LodSelection::selectLod(fullSize, LOD_ERRORS, 0) == 0);
+	CHECK(LodSelection::selectLod(fullSize, LOD_ERRORS, -3) == 0);
+	CHECK(LodSelection::selectLod(fullSize, LOD_ERRORS, LodSelection::SHADOW_BIAS) == uint32_t(LodSelection::SHADOW_BIAS));
+	CHECK(LodSelection::selectLod(fullSize, LOD_ERRORS, 100) == LOD_ERRORS.size());
+
+	CHECK(LodSelection::selectLod(tinySize, LOD_ERRORS, 0) == LOD_ERRORS.size());
+	CHECK(LodSelection::selectLod(tinySize, LOD_ERRORS, LodSelection::SHADOW_BIAS) == LOD_ERRORS.size());
+	CHECK(LodSelection::selectLod(tinySize, LOD_ERRORS, -1) == LOD_ERRORS.size() - 1);
+	CHECK(LodSelection::selectLod(tinySize, LOD_ERRORS, -100) == 0);
+}
+
+TEST(lodSelectionWithoutLods)
+{
+	for (float size : { std::numeric_limits<float>::infinity(), 1.0f, 1e-9f })
+	{
+		CHECK(LodSelection::selectLod(size, {}, 0) == 0);
+		CHECK(LodSelection::selectLod(size, {}, LodSelection::SHADOW_BIAS) == 0);
+		CHECK(LodSelection::selectLod(size, {}, -1) == 0);
+	}
+}
+
+TEST(lodSelectionProjectedSize)
+{
+	const math::Vec3f center(1.0f, 2.0f, 3.0f);
+
+	// inside and on the sphere
+	CHECK(std::isinf(LodSelection::getProjectedSize(center, 2.0f, center, 1.0f)));
+	CHECK(std::isinf(LodSelection::getProjectedSize(center, 2.0f, center + math::Vec3f(1.0f, 1.0f, 0.0f), 1.0f)));
+	CHECK(std::isinf(LodSelection::getProjectedSize(center, 2.0f, center + math::Vec3f(0.0f, 0.0f, 2.0f), 1.0f)));
+
+	// outside it halves with twice the distance
+	const float nearSize = LodSelection::getProjectedSize(center, 1.0f, center + math::Vec3f(0.0f, 0.0f, 10.0f), 1.5f);
+	const float farSize = LodSelection::getProjectedSize(center, 1.0f, center + math::Vec3f(0.0f, 20.0f, 0.0f), 1.5f);
+	CHECK(std::isfinite(nearSize));
+	CHECK(std::abs(nearSize - 2.0f * 1.0f * 1.5f / 10.0f) < 1e-6f);
+	CHECK(std::abs(farSize - nearSize / 2.0f) < 1e-6f);
+}
@@ -0,0 +1,52 @@
+#include "test.h"
+#include "math/simd.h"
+#include <cstdio>
+#include <cstring>
+
+namespace Tests
+{
+	static uint32_t s_failureCount = 0;
+
+	std::vector<TestCase>& getTestCases()
+	{
+		static std::vector<TestCase> testCases;
+		return testCases;
+	}
+
+	void reportFailure(const char* file, int line, const char* expression)
+	{
+		++s_failureCount;
+		std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	}
+
+	uint32_t getFailureCount()
+	{
+		return s_failureCount;
+	}
+}
+
+// Runs every test, or the ones whose name contains the first argument. Returns 1 if any check failed.
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : nullptr;
+	std::printf("simd width %u\n", Engine::math::simd::WIDTH);
+
+	uint32_t failedTests = 0;
+	for (const Tests::TestCase& testCase : Tests::getTestCases())
+	{
+		if (filter && !std::strstr(testCase.name, filter))
+		{
+			continue;
+		}
+
+		uint32_t failuresBefore = Tests::getFailureCount();
+		testCase.function();
+
+		bool passed = Tests::getFailureCount() == failuresBefore;
+		failedTests += passed ? 0 : 1;
+		std::printf("%s %s\n", passed ? "PASS" : "FAIL", testCase.name);
+	}
+
+	std::printf("%u of %zu tests failed\n", failedTests, Tests::getTestCases().size());
+	return failedTests > 0 ? 1 : 0;
+}
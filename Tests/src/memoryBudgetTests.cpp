@@ -0,0 +1,147 @@
+#include "test.h"
+#include "utils/memoryBudget.h"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+
+using namespace Engine;
+
+namespace
+{
+	// long enough for a thread that isn't blocked to get through
+	const std::chrono::milliseconds SETTLE_TIME(50);
+}
+
+TEST(memoryBudgetWaitsForExpectedPeak)
+{
+	MemoryBudget budget(100);
+	auto first = std::make_unique<MemoryBudget::Reservation>(budget);
+	first->start(60);
+	CHECK(budget.getReservedSize() == 60);
+
+	std::atomic<bool> isStarted = false;
+	std::thread second([&]
+	{
+		MemoryBudget::Reservation reservation(budget);
+		reservation.start(60);
+		isStarted = true;
+	});
+
+	std::this_thread::sleep_for(SETTLE_TIME);
+	CHECK(!isStarted);
+
+	first.reset();
+	second.join();
+	CHECK(isStarted);
+	CHECK(budget.getReservedSize() == 0);
+}
+
+TEST(memoryBudgetStartsUsersLargerThanLimitAlone)
+{
+	MemoryBudget budget(100);
+	{
+		MemoryBudget::Reservation reservation(budget);
+		reservation.start(500);
+		CHECK(budget.getReservedSize() == 500);
+	}
+
+	// no limit
+	budget.setLimit(0);
+	MemoryBudget::Reservation first(budget), second(budget);
+	first.start(1000);
+	second.start(1000);
+	CHECK(budget.getReservedSize() == 2000);
+}
+
+TEST(memoryBudgetAddGrowsWithoutWaiting)
+{
+	MemoryBudget budget(100);
+	MemoryBudget::Reservation first(budget), second(budget);
+	first.start(60);
+	second.start(30);
+
+	// growing past the expected peak and past the limit doesn't block
+	second.add(20);
+	CHECK(budget.getReservedSize() == 90);
+	second.add(60);
+	CHECK(budget.getReservedSize() == 140);
+	CHECK(second.getSize() == 80);
+	CHECK(second.getPeakSize() == 80);
+
+	// freed bytes stay reserved, allocating them again doesn't grow it
+	second.remove(50);
+	second.add(40);
+	CHECK(second.getSize() == 70);
+	CHECK(second.getPeakSize() == 80);
+	CHECK(budget.getReservedSize() == 140);
+}
+
+TEST(memoryBudgetStartReservesBytesAddedBefore)
+{
+	MemoryBudget budget(100);
+	MemoryBudget::Reservation reservation(budget);
+	reservation.add(30);
+	CHECK(budget.getReservedSize() == 0);
+
+	reservation.start(10);
+	CHECK(budget.getReservedSize() == 30);
+	reservation.add(5);
+	CHECK(budget.getReservedSize() == 35);
+}
+
+TEST(memoryBudgetRestartReleasesBeforeWaiting)
+{
+	// each user waits for more than fits next to the other's current reservation, they only get through one after the other
+	// because restart gives up its reservation first
+	MemoryBudget budget(100);
+	MemoryBudget::Reservation first(budget), second(budget);
+	first.start(50);
+	second.start(50);
+
+	std::atomic<uint32_t> finished = 0;
+	auto restart = [&finished](MemoryBudget::Reservation& reservation)
+	{
+		reservation.restart(80);
+		reservation.add(10);
+		reservation.remove(10);
+		++finished;
+	};
+	std::thread firstThread([&] { restart(first); });
+	std::thread secondThread([&] { restart(second); });
+
+	std::this_thread::sleep_for(SETTLE_TIME);
+	CHECK(finished == 1);
+	CHECK(budget.getReservedSize() == 80);
+
+	// whichever got through keeps its reservation until destroyed, raising the limit lets the other one through
+	budget.setLimit(160);
+	firstThread.join();
+	secondThread.join();
+	CHECK(finished == 2);
+	CHECK(budget.getReservedSize() == 160);
+}
+
+TEST(memoryBudgetSetLimitWakesWaitingUsers)
+{
+	MemoryBudget budget(100);
+	MemoryBudget::Reservation first(budget);
+	first.start(80);
+
+	std::atomic<bool> isStarted = false;
+	std::thread second([&]
+	{
+		MemoryBudget::Reservation reservation(budget);
+		reservation.start(50);
+		isStarted = true;
+	});
+
+	std::this_thread::sleep_for(SETTLE_TIME);
+	CHECK(!isStarted);
+
+	budget.setLimit(200);
+	second.join();
+	CHECK(isStarted);
+	CHECK(budget.getLimit() == 200);
+	CHECK(budget.getReservedSize() == 80);
+}
@@ -0,0 +1,158 @@
+#include "test.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "render/meshSystem/mesh/meshProcessing.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+using namespace Engine;
+
+namespace
+{
+	const float EPSILON = 0.01f;
+
+	math::Vertex createVertex(const math::Vec3f& position, const math::Vec2f& textureCoordinates = math::Vec2f::Zero())
+	{
+		math::Vertex vertex;
+		vertex.position = position;
+		vertex.color = math::Vec4f::Ones();
+		vertex.textureCoordinates = textureCoordinates;
+		vertex.normal = math::Vec3f::Zero();
+		vertex.tangent = math::Vec3f::Zero();
+		vertex.bitangent = math::Vec3f::Zero();
+		return vertex;
+	}
+
+	// winds the triangle so that its front face points towards outward
+	void addTriangle(Mesh& mesh, int v0, int v1, int v2, const math::Vec3f& outward)
+	{
+		const math::Vec3f& p0 = mesh.vertices[v0].position;
+		const math::Vec3f normal = (mesh.vertices[v1].position - p0).cross(mesh.vertices[v2].position - p0);
+		if (normal.dot(outward) < 0.0f)
+		{
+			std::swap(v1, v2);
+		}
+		mesh.triangles.emplace_back(v0, v1, v2, mesh.vertices.data());
+	}
+}
+
+TEST(findPositionGroupsAcrossCells)
+{
+	Mesh mesh;
+	mesh.vertices = {
+		createVertex({ 0.0099f, 0.5f, 0.5f }), createVertex({ 0.0101f, 0.5f, 0.5f }), // neighbouring cells along x
+		createVertex({ -0.0001f, -0.0001f, -0.0001f }), createVertex({ 0.0001f, 0.0001f, 0.0001f }), // across zero, diagonal cells
+		createVertex({ -3.00002f, -7.0f, -0.99995f }), createVertex({ -2.99998f, -7.0f, -1.00005f }), // negative coordinates
+		createVertex({ 2.0f, 0.0f, 0.0f }), createVertex({ 2.0f + 2.0f * EPSILON, 0.0f, 0.0f }), // too far apart
+		createVertex({ 4.0f, 0.0f, 0.0f }), createVertex({ 4.008f, 0.0f, 0.0f }), createVertex({ 4.016f, 0.0f, 0.0f }), // no chaining
+		createVertex({ std::numeric_limits<float>::quiet_NaN(), 0.0f, 0.0f }), createVertex({ std::numeric_limits<float>::quiet_NaN(), 0.0f, 0.0f }),
+	};
+
+	const std::vector<uint32_t> groups = MeshProcessing::findPositionGroups(mesh, EPSILON);
+	CHECK(groups.size() == mesh.vertices.size());
+	CHECK(groups[0] == 0 && groups[1] == 0);
+	CHECK(groups[2] == 2 && groups[3] == 2);
+	CHECK(groups[4] == 4 && groups[5] == 4);
+	CHECK(groups[6] == 6 && groups[7] == 7);
+	CHECK(groups[8] == 8 && groups[9] == 8 && groups[10] == 10);
+	CHECK(groups[11] == 11 && groups[12] == 12);
+}
+
+TEST(weldVerticesKeepsSeamsAndDropsCollapsedTriangles)
+{
+	Mesh mesh;
+	mesh.vertices = {
+		createVertex({ 0.0f, 0.0f, 0.0f }), createVertex({ 1.0f, 0.0f, 0.0f }), createVertex({ 0.0f, 1.0f, 0.0f }),
+		createVertex({ 1.0f, 0.0f, 0.001f }), // duplicate of 1 with equal attributes
+		createVertex({ 0.0f, 1.0f, 0.001f }, { 1.0f, 0.0f }), // texture seam at the position of 2
+		createVertex({ 1.0f, 1.0f, 0.0f }),
+		createVertex({ 5.0f, 5.0f, 5.0f }), createVertex({ 5.0f, 5.0f, 5.001f }), createVertex({ 6.0f, 5.0f, 5.0f }), // 6 and 7 collapse
+	};
+	const math::Vec3f outward(0.0f, 0.0f, -1.0f);
+	addTriangle(mesh, 0, 1, 2, outward);
+	addTriangle(mesh, 3, 5, 4, outward);
+	addTriangle(mesh, 6, 7, 8, math::Vec3f(0.0f, 1.0f, 0.0f));
+
+	CHECK(MeshProcessing::weldVertices(mesh, EPSILON) == 2);
+	CHECK(mesh.vertices.size() == 7);
+	CHECK(mesh.triangles.size() == 2);
+
+	for (const math::Triangle& triangle : mesh.triangles)
+	{
+		CHECK(triangle.verticesArray == mesh.vertices.data());
+	}
+
+	// the seam vertex is kept but moved onto the position of its group
+	const math::Triangle& second = mesh.triangles[1];
+	int seam = -1;
+	for (int k = 0; k < 3; ++k)
+	{
+		const math::Vertex& vertex = mesh.vertices[second.vertexIndices[k]];
+		if (vertex.textureCoordinates.x() == 1.0f)
+		{
+			seam = second.vertexIndices[k];
+			CHECK(vertex.position == math::Vec3f(0.0f, 1.0f, 0.0f));
+		}
+	}
+	CHECK(seam >= 0);
+	for (int k = 0; k < 3; ++k)
+	{
+		CHECK(mesh.triangles[0].vertexIndices[k] != seam);
+	}
+
+	// the duplicate of 1 is shared by both triangles
+	int shared = 0;
+	for (int k = 0; k < 3; ++k)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			shared += mesh.triangles[0].vertexIndices[k] == second.vertexIndices[j];
+		}
+	}
+	CHECK(shared == 1);
+}
+
+TEST(computeNormalsAngleWeightingOnCubeCorner)
+{
+	// the three faces of a unit cube around the origin, with split vertices. The corner is in two triangles of the z and x faces
+	// and in one of the y face, so only the angle weighting gives the diagonal.
+	Mesh mesh;
+	auto addFace = [&mesh](const math::Vec3f& u, const math::Vec3f& v)
+	{
+		mesh.vertices.push_back(createVertex(math::Vec3f::Zero()));
+		mesh.vertices.push_back(createVertex(u));
+		mesh.vertices.push_back(createVertex(u + v));
+		mesh.vertices.push_back(createVertex(v));
+	};
+	addFace({ 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f });
+	addFace({ 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f });
+	addFace({ 0.0f, 0.0f, 1.0f }, { 1.0f, 0.0f, 0.0f });
+
+	const math::Vec3f outwards[3] = { { 0.0f, 0.0f, -1.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+	for (int face = 0; face < 3; ++face)
+	{
+		const int first = face * 4;
+		if (face < 2)
+		{
+			addTriangle(mesh, first, first + 1, first + 2, outwards[face]);
+			addTriangle(mesh, first, first + 2, first + 3, outwards[face]);
+		}
+		else
+		{
+			addTriangle(mesh, first, first + 1, first + 3, outwards[face]);
+			addTriangle(mesh, first + 1, first + 2, first + 3, outwards[face]);
+		}
+	}
+
+	const math::Vec3f diagonal = math::Vec3f(-1.0f, -1.0f, -1.0f).normalized();
+
+	MeshProcessing::computeNormals(mesh, MeshProcessing::NormalWeighting::ANGLE, EPSILON);
+	for (int face = 0; face < 3; ++face)
+	{
+		CHECK((mesh.vertices[face * 4].normal - diagonal).norm() < 1e-5f);
+	}
+
+	MeshProcessing::computeNormals(mesh, MeshProcessing::NormalWeighting::AREA, EPSILON);
+	CHECK((mesh.vertices[0].normal - diagonal).norm() > 0.1f);
+	CHECK(std::abs(mesh.vertices[0].normal.norm() - 1.0f) < 1e-5f);
+}
@@ -0,0 +1,280 @@
+#include "test.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "render/meshSystem/mesh/meshletBuilder.h"
+#include "render/meshSystem/mesh/meshletCulling.h"
+#include "render/meshSystem/mesh/boundingVolumes.h"
+#include <algorithm>
+#include <array>
+#include <set>
+
+using namespace Engine;
+
+namespace
+{
+	// Cube of 6 faces of size x size quads projected on the unit sphere, faces don't share vertices.
+	// Front faces are clockwise seen from outside, (p1 - p0) x (p2 - p0) points away from the center.
+	void createSphere(Mesh& mesh, uint32_t size)
+	{
+		const math::Vec3f normals[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+
+		mesh.vertices.clear();
+		std::vector<std::array<uint32_t, 3>> indices;
+		for (const math::Vec3f& normal : normals)
+		{
+			const math::Vec3f u = normal.x() != 0.0f ? math::Vec3f(0, 1, 0) : math::Vec3f(1, 0, 0);
+			const math::Vec3f v = normal.cross(u);
+
+			const uint32_t first = uint32_t(mesh.vertices.size());
+			for (uint32_t y = 0; y <= size; ++y)
+			{
+				for (uint32_t x = 0; x <= size; ++x)
+				{
+					math::Vertex vertex = {};
+					vertex.position = (normal + u * (2.0f * x / size - 1.0f) + v * (2.0f * y / size - 1.0f)).normalized();
+					mesh.vertices.push_back(vertex);
+				}
+			}
+
+			for (uint32_t y = 0; y < size; ++y)
+			{
+				for (uint32_t x = 0; x < size; ++x)
+				{
+					const uint32_t corner = first + y * (size + 1) + x;
+					indices.push_back({ corner, corner + 1, corner + size + 1 });
+					indices.push_back({ corner + 1, corner + size + 2, corner + size + 1 });
+				}
+			}
+		}
+
+		mesh.triangles.clear();
+		for (std::array<uint32_t, 3>& triangle : indices)
+		{
+			const math::Vec3f& p0 = mesh.vertices[triangle[0]].position;
+			const math::Vec3f normal = (mesh.vertices[triangle[1]].position - p0).cross(mesh.vertices[triangle[2]].position - p0);
+			if (normal.dot(p0) < 0.0f)
+			{
+				std::swap(triangle[1], triangle[2]);
+			}
+			mesh.triangles.emplace_back(triangle[0], triangle[1], triangle[2], mesh.vertices.data());
+		}
+
+		mesh.createBoundingBox();
+	}
+
+	void createMeshletSphere(Mesh& mesh)
+	{
+		createSphere(mesh, 24);
+		MeshletBuilder::build(mesh);
+		BoundingVolumes::build(mesh);
+	}
+
+	std::array<int, 3> getSortedIndices(const math::Triangle& triangle)
+	{
+		std::array<int, 3> indices = { triangle.vertexIndices[0], triangle.vertexIndices[1], triangle.vertexIndices[2] };
+		std::sort(indices.begin(), indices.end());
+		return indices;
+	}
+
+	math::Mat4f getWorldToClip(const math::Vec3f& position, const math::Vec3f& target)
+	{
+		return math::lookAt(position, target) * math::createPerspectiveProjectionMatrix(60.0f, 1.0f, 0.01f, 1000.0f);
+	}
+
+	bool isFrontFacing(const Mesh& mesh, const math::Triangle& triangle, const math::Mat4f& meshToWorld, const math::Vec3f& cameraPosition)
+	{
+		math::Vec3f p[3];
+		for (int k = 0; k < 3; ++k)
+		{
+			const math::Vec3f& position = mesh.vertices[triangle.vertexIndices[k]].position;
+			p[k] = (math::Vec4f(position.x(), position.y(), position.z(), 1.0f) * meshToWorld).head<3>();
+		}
+		return (p[1] - p[0]).cross(p[2] - p[0]).dot(cameraPosition - p[0]) > 0.0f;
+	}
+
+	// ranges are sorted, don't overlap and neighbouring ones are merged
+	void checkRanges(const Mesh& mesh, const std::vector<MeshletCulling::IndexRange>& ranges)
+	{
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			CHECK(ranges[i].indexNum > 0);
+			CHECK(ranges[i].indexOffset % 3 == 0 && ranges[i].indexNum % 3 == 0);
+			CHECK(ranges[i].indexOffset + ranges[i].indexNum <= mesh.triangles.size() * 3);
+			if (i > 0)
+			{
+				CHECK(ranges[i - 1].indexOffset + ranges[i - 1].indexNum < ranges[i].indexOffset);
+			}
+		}
+	}
+}
+
+TEST(meshletsRespectLimitsAndCoverTriangles)
+{
+	Mesh mesh;
+	createSphere(mesh, 24);
+
+	std::multiset<std::array<int, 3>> before;
+	for (const math::Triangle& triangle : mesh.triangles)
+	{
+		before.insert(getSortedIndices(triangle));
+	}
+
+	MeshletBuilder::build(mesh);
+	CHECK(mesh.meshlets.size() > 1);
+
+	// meshlets tile the reordered triangles in order
+	uint32_t nextTriangle = 0;
+	for (const Mesh::Meshlet& meshlet : mesh.meshlets)
+	{
+		CHECK(meshlet.triangleOffset == nextTriangle);
+		CHECK(meshlet.triangleCount > 0);
+		CHECK(meshlet.triangleCount <= MeshletBuilder::MAX_TRIANGLES);
+		CHECK(meshlet.vertexCount <= MeshletBuilder::MAX_VERTICES);
+		nextTriangle += meshlet.triangleCount;
+
+		std::set<int> vertices;
+		for (uint32_t t = meshlet.triangleOffset; t < meshlet.triangleOffset + meshlet.triangleCount; ++t)
+		{
+			vertices.insert(mesh.triangles[t].vertexIndices, mesh.triangles[t].vertexIndices + 3);
+
+			// the bounding sphere contains the triangles
+			for (int k = 0; k < 3; ++k)
+			{
+				CHECK((mesh.vertices[mesh.triangles[t].vertexIndices[k]].position - meshlet.center).norm() <= meshlet.radius * 1.0001f);
+			}
+		}
+		CHECK(vertices.size() == meshlet.vertexCount);
+	}
+	CHECK(nextTriangle == mesh.triangles.size());
+
+	// every triangle exactly once
+	std::multiset<std::array<int, 3>> after;
+	for (const math::Triangle& triangle : mesh.triangles)
+	{
+		after.insert(getSortedIndices(triangle));
+	}
+	CHECK(after == before);
+}
+
+TEST(meshletCullingKeepsFrontFaces)
+{
+	Mesh mesh;
+	createMeshletSphere(mesh);
+
+	math::Mat4f rotated = math::Mat4f::Identity();
+	rotated.topLeftCorner<3, 3>() = Eigen::AngleAxisf(0.7f, math::Vec3f(1.0f, 2.0f, 3.0f).normalized()).toRotationMatrix().transpose();
+	math::setTranslation(rotated, math::Vec3f(3.0f, -1.0f, 2.0f));
+
+	uint32_t backfaceCulled = 0;
+	for (const math::Mat4f& meshToWorld : { math::Mat4f(math::Mat4f::Identity()), rotated })
+	{
+		const math::Vec3f center = meshToWorld.row(3).head<3>();
+		for (const math::Vec3f& offset : { math::Vec3f(0, 0, -6), math::Vec3f(4, 3, 2), math::Vec3f(-1.5f, 0.5f, 1.2f), math::Vec3f(0.2f, -9, 0.3f) })
+		{
+			const math::Vec3f cameraPosition = center + offset;
+			std::vector<MeshletCulling::IndexRange> ranges;
+			const MeshletCulling::Stats stats = MeshletCulling::cull(mesh, meshToWorld, getWorldToClip(cameraPosition, center), cameraPosition, ranges);
+			checkRanges(mesh, ranges);
+
+			// the whole sphere is in view, only back faces may be dropped
+			CHECK(stats.frustumCulled == 0);
+			CHECK(stats.visible + stats.backfaceCulled == mesh.meshlets.size());
+			backfaceCulled += stats.backfaceCulled;
+
+			std::vector<bool> isDrawn(mesh.triangles.size(), false);
+			for (const MeshletCulling::IndexRange& range : ranges)
+			{
+				std::fill_n(isDrawn.begin() + range.indexOffset / 3, range.indexNum / 3, true);
+			}
+			for (size_t t = 0; t < mesh.triangles.size(); ++t)
+			{
+				CHECK(isDrawn[t] || !isFrontFacing(mesh, mesh.triangles[t], meshToWorld, cameraPosition));
+			}
+		}
+	}
+	CHECK(backfaceCulled > 0);
+}
+
+TEST(meshletCullingMergesRanges)
+{
+	Mesh mesh;
+	createMeshletSphere(mesh);
+
+	const math::Vec3f cameraPosition(0.0f, 0.0f, -6.0f);
+	const math::Mat4f worldToClip = getWorldToClip(cameraPosition, math::Vec3f::Zero());
+
+	// the ranges hold exactly the triangles of the visible meshlets, in fewer ranges than meshlets
+	std::vector<MeshletCulling::IndexRange> ranges;
+	const MeshletCulling::Stats stats = MeshletCulling::cull(mesh, math::Mat4f::Identity(), worldToClip, cameraPosition, ranges);
+	checkRanges(mesh, ranges);
+	uint32_t indexNum = 0;
+	for (const MeshletCulling::IndexRange& range : ranges)
+	{
+		indexNum += range.indexNum;
+	}
+	uint32_t visibleIndexNum = 0;
+	for (const Mesh::Meshlet& meshlet : mesh.meshlets)
+	{
+		const math::Vec3f toApex = meshlet.coneApex - cameraPosition;
+		if (meshlet.coneCutoff > 1.0f || toApex.dot(meshlet.coneAxis) < meshlet.coneCutoff * toApex.norm())
+		{
+			visibleIndexNum += meshlet.triangleCount * 3;
+		}
+	}
+	CHECK(indexNum == visibleIndexNum);
+	CHECK(stats.visible > 1);
+	CHECK(ranges.size() < stats.visible);
+
+	// mirrored meshes skip the cone test, so all meshlets are visible and merge into a single range
+	math::Mat4f mirrored = math::Mat4f::Identity();
+	mirrored(2, 2) = -1.0f;
+	ranges.clear();
+	MeshletCulling::cull(mesh, mirrored, worldToClip, cameraPosition, ranges);
+	CHECK(ranges.size() == 1);
+	CHECK(ranges[0].indexOffset == 0);
+	CHECK(ranges[0].indexNum == mesh.triangles.size() * 3);
+
+	// ranges are appended after the ones already in the vector
+	MeshletCulling::cull(mesh, mirrored, worldToClip, cameraPosition, ranges);
+	CHECK(ranges.size() == 2);
+	CHECK(ranges[1].indexOffset == 0);
+}
+
+TEST(meshletCullingSkipsConesOfMirroredMeshes)
+{
+	Mesh mesh;
+	createMeshletSphere(mesh);
+
+	const math::Vec3f cameraPosition(0.0f, 0.0f, -6.0f);
+	const math::Mat4f worldToClip = getWorldToClip(cameraPosition, math::Vec3f::Zero());
+
+	std::vector<MeshletCulling::IndexRange> ranges;
+	const MeshletCulling::Stats stats = MeshletCulling::cull(mesh, math::Mat4f::Identity(), worldToClip, cameraPosition, ranges);
+	CHECK(stats.backfaceCulled > 0);
+
+	math::Mat4f mirrored = math::Mat4f::Identity();
+	mirrored(0, 0) = -1.0f;
+	ranges.clear();
+	const MeshletCulling::Stats mirroredStats = MeshletCulling::cull(mesh, mirrored, worldToClip, cameraPosition, ranges);
+	CHECK(mirroredStats.backfaceCulled == 0);
+	CHECK(mirroredStats.frustumCulled == 0);
+	CHECK(mirroredStats.visible == mesh.meshlets.size());
+	CHECK(ranges.size() == 1);
+}
+
+TEST(meshletCullingOutsideFrustum)
+{
+	Mesh mesh;
+	createMeshletSphere(mesh);
+
+	// looking away from the sphere, and at it from beyond the far plane
+	const math::Vec3f cameraPosition(0.0f, 0.0f, -6.0f);
+	const math::Vec3f farPosition(0.0f, 0.0f, -2000.0f);
+	for (const math::Mat4f& worldToClip : { getWorldToClip(cameraPosition, math::Vec3f(0.0f, 0.0f, -10.0f)), getWorldToClip(farPosition, math::Vec3f::Zero()) })
+	{
+		std::vector<MeshletCulling::IndexRange> ranges;
+		const MeshletCulling::Stats stats = MeshletCulling::cull(mesh, math::Mat4f::Identity(), worldToClip, cameraPosition, ranges);
+		CHECK(ranges.empty());
+		CHECK(stats.visible == 0);
+		CHECK(stats.frustumCulled == mesh.meshlets.size());
+	}
+}
@@ -0,0 +1,174 @@
+#include "test.h"
+#include "math/packedVertex.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <vector>
+
+using namespace Engine;
+
+namespace
+{
+	float getAngleDegrees(const math::Vec3f& a, const math::Vec3f& b)
+	{
+		return std::acos(std::clamp(a.normalized().dot(b.normalized()), -1.0f, 1.0f)) * 180.0f / float(M_PI);
+	}
+
+	math::Vec3f getOrthogonal(const math::Vec3f& normal, float angle)
+	{
+		const math::Vec3f axis = std::abs(normal.x()) < 0.9f ? math::Vec3f(1.0f, 0.0f, 0.0f) : math::Vec3f(0.0f, 1.0f, 0.0f);
+		const math::Vec3f basisX = normal.cross(axis).normalized();
+		const math::Vec3f basisY = normal.cross(basisX);
+		return basisX * std::cos(angle) + basisY * std::sin(angle);
+	}
+
+	// packs the frame with both handednesses and checks the unpacked one against the error bounds
+	void checkRoundTrip(const math::Vec3f& normal, const math::Vec3f& tangent, const math::Vec2f& textureCoordinates)
+	{
+		for (float handedness : { 1.0f, -1.0f })
+		{
+			math::Vertex vertex = {};
+			vertex.position = math::Vec3f(1.0f, -2.0f, 3.0f);
+			vertex.textureCoordinates = textureCoordinates;
+			vertex.normal = normal;
+			vertex.tangent = tangent;
+			vertex.bitangent = normal.cross(tangent) * handedness;
+
+			const math::Vertex unpacked = math::PackedVertex::pack(vertex).unpack();
+			CHECK(unpacked.position == vertex.position);
+			CHECK(unpacked.color == math::PackedVertex::COLOR);
+			CHECK(getAngleDegrees(unpacked.normal, normal) <= math::PackedVertex::NORMAL_MAX_ERROR_DEGREES);
+			CHECK(getAngleDegrees(unpacked.tangent, tangent) <= math::PackedVertex::TANGENT_MAX_ERROR_DEGREES);
+			CHECK(unpacked.bitangent.dot(vertex.bitangent) > 0.9f);
+			for (int i = 0; i < 2; ++i)
+			{
+				const float maxError = (std::max)(std::abs(textureCoordinates[i]) * math::PackedVertex::TEXTURE_COORDINATES_RELATIVE_ERROR, 1.0f / 33554432.0f);
+				CHECK(std::abs(unpacked.textureCoordinates[i] - textureCoordinates[i]) <= maxError);
+			}
+		}
+	}
+}
+
+TEST(packedVertexRandomFrames)
+{
+	std::mt19937 random(42);
+	std::normal_distribution<float> normalDistribution;
+	std::uniform_real_distribution<float> angleDistribution(0.0f, 2.0f * float(M_PI));
+	std::uniform_real_distribution<float> exponentDistribution(-30.0f, 15.0f);
+
+	for (int i = 0; i < 100000; ++i)
+	{
+		math::Vec3f normal(normalDistribution(random), normalDistribution(random), normalDistribution(random));
+		if (normal.squaredNorm() < 1e-6f)
+		{
+			continue;
+		}
+		normal.normalize();
+
+		// texture coordinates over the whole half range, both signs
+		const float u = std::exp2(exponentDistribution(random)) * (i & 1 ? -1.0f : 1.0f);
+		const float v = std::exp2(exponentDistribution(random)) * (i & 2 ? -1.0f : 1.0f);
+		checkRoundTrip(normal, getOrthogonal(normal, angleDistribution(random)), math::Vec2f(u, v));
+	}
+}
+
+TEST(packedVertexOctahedralSeamAndPoles)
+{
+	std::vector<math::Vec3f> normals = { { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }, { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+
+	// the lower hemisphere folds over the diamond edges, x or y = 0 lies on the seam
+	for (float z : { -1e-6f, -0.01f, -0.3f, -0.7f, -0.9999f })
+	{
+		const float r = std::sqrt(1.0f - z * z);
+		normals.insert(normals.end(), { { r, 0.0f, z }, { -r, 0.0f, z }, { 0.0f, r, z }, { 0.0f, -r, z }, { r * 0.70710678f, r * 0.70710678f, z } });
+	}
+
+	// close to the poles
+	for (float z : { 1.0f - 1e-7f, -1.0f + 1e-7f })
+	{
+		const float r = std::sqrt(1.0f - z * z);
+		normals.insert(normals.end(), { { r, 0.0f, z }, { 0.0f, -r, z } });
+	}
+
+	for (const math::Vec3f& normal : normals)
+	{
+		for (int step = 0; step < 16; ++step)
+		{
+			checkRoundTrip(normal.normalized(), getOrthogonal(normal.normalized(), step * float(M_PI) / 8.0f), math::Vec2f(0.5f, -0.25f));
+		}
+	}
+}
+
+TEST(packedVertexDegenerateFrame)
+{
+	// a zero normal falls back to +z
+	math::Vertex vertex = {};
+	vertex.normal = math::Vec3f::Zero();
+	vertex.tangent = math::Vec3f(1.0f, 0.0f, 0.0f);
+	vertex.bitangent = math::Vec3f(0.0f, 1.0f, 0.0f);
+	const math::Vertex unpacked = math::PackedVertex::pack(vertex).unpack();
+	CHECK(unpacked.normal == math::Vec3f(0.0f, 0.0f, 1.0f));
+	CHECK(std::abs(unpacked.tangent.norm() - 1.0f) < 1e-5f);
+}
+
+TEST(packedVertexFloatToHalf)
+{
+	using math::PackedVertex;
+
+	CHECK(PackedVertex::floatToHalf(0.0f) == 0x0000);
+	CHECK(PackedVertex::floatToHalf(-0.0f) == 0x8000);
+	CHECK(PackedVertex::floatToHalf(1.0f) == 0x3C00);
+	CHECK(PackedVertex::floatToHalf(-2.0f) == 0xC000);
+
+	// round to nearest even
+	CHECK(PackedVertex::floatToHalf(1.0f + 1.0f / 2048.0f) == 0x3C00);
+	CHECK(PackedVertex::floatToHalf(1.0f + 3.0f / 2048.0f) == 0x3C02);
+	CHECK(PackedVertex::floatToHalf(std::nextafter(1.0f + 1.0f / 2048.0f, 2.0f)) == 0x3C01);
+
+	// subnormals, the smallest one is 2^-24
+	CHECK(PackedVertex::floatToHalf(std::ldexp(1.0f, -14)) == 0x0400);
+	CHECK(PackedVertex::floatToHalf(std::ldexp(1023.0f, -24)) == 0x03FF);
+	CHECK(PackedVertex::floatToHalf(std::ldexp(1.0f, -24)) == 0x0001);
+	CHECK(PackedVertex::floatToHalf(-std::ldexp(1.0f, -24)) == 0x8001);
+	CHECK(PackedVertex::floatToHalf(std::ldexp(1.0f, -25)) == 0x0000);
+	CHECK(PackedVertex::floatToHalf(std::ldexp(3.0f, -25)) == 0x0002);
+	CHECK(PackedVertex::floatToHalf(std::ldexp(1023.5f, -24)) == 0x0400);
+	CHECK(PackedVertex::floatToHalf(std::numeric_limits<float>::denorm_min()) == 0x0000);
+
+	// the largest half and overflow
+	CHECK(PackedVertex::floatToHalf(65504.0f) == 0x7BFF);
+	CHECK(PackedVertex::floatToHalf(65519.0f) == 0x7BFF);
+	CHECK(PackedVertex::floatToHalf(65520.0f) == 0x7C00);
+	CHECK(PackedVertex::floatToHalf(-1e10f) == 0xFC00);
+	CHECK(PackedVertex::floatToHalf(std::numeric_limits<float>::max()) == 0x7C00);
+	CHECK(PackedVertex::floatToHalf(std::numeric_limits<float>::infinity()) == 0x7C00);
+	CHECK(PackedVertex::floatToHalf(-std::numeric_limits<float>::infinity()) == 0xFC00);
+
+	// NaN stays NaN
+	const uint16_t nan = PackedVertex::floatToHalf(std::numeric_limits<float>::quiet_NaN());
+	CHECK((nan & 0x7C00) == 0x7C00 && (nan & 0x03FF) != 0);
+	CHECK(std::isnan(PackedVertex::halfToFloat(nan)));
+}
+
+TEST(packedVertexHalfRoundTrip)
+{
+	using math::PackedVertex;
+
+	CHECK(PackedVertex::halfToFloat(0x0001) == std::ldexp(1.0f, -24));
+	CHECK(PackedVertex::halfToFloat(0x7BFF) == 65504.0f);
+	CHECK(PackedVertex::halfToFloat(0xFC00) == -std::numeric_limits<float>::infinity());
+
+	// every half that isn't NaN converts back to the same bits
+	for (uint32_t bits = 0; bits <= 0xFFFF; ++bits)
+	{
+		const uint16_t half = uint16_t(bits);
+		const float value = PackedVertex::halfToFloat(half);
+		if ((half & 0x7C00) == 0x7C00 && (half & 0x03FF) != 0)
+		{
+			CHECK(std::isnan(value));
+			continue;
+		}
+		CHECK(PackedVertex::floatToHalf(value) == half);
+	}
+}
@@ -0,0 +1,263 @@
+#include "test.h"
+#include "utils/allocators/rangeAllocator.h"
+#include <algorithm>
+#include <random>
+
+using namespace Engine;
+
+namespace
+{
+	// Fills an allocator of exactly the summed size with the ranges in order, then frees the ones marked free.
+	// Neighbouring free ranges would merge, so layouts keep an allocated range between them.
+	struct Range
+	{
+		uint32_t size;
+		bool isFree;
+	};
+
+	std::vector<RangeAllocator::Handle> createLayout(RangeAllocator& allocator, const std::vector<Range>& ranges)
+	{
+		uint32_t capacity = 0;
+		for (const Range& range : ranges)
+		{
+			capacity += range.size;
+		}
+		allocator.grow(capacity);
+
+		std::vector<RangeAllocator::Handle> handles;
+		for (const Range& range : ranges)
+		{
+			handles.push_back(allocator.allocate(range.size));
+		}
+		for (size_t i = 0; i < ranges.size(); ++i)
+		{
+			if (ranges[i].isFree)
+			{
+				allocator.free(handles[i]);
+				handles[i] = RangeAllocator::INVALID_HANDLE;
+			}
+		}
+		return handles;
+	}
+
+	uint32_t getLayoutOffset(const std::vector<Range>& ranges, size_t index)
+	{
+		uint32_t offset = 0;
+		for (size_t i = 0; i < index; ++i)
+		{
+			offset += ranges[i].size;
+		}
+		return offset;
+	}
+}
+
+// sizes below 16 have a class each, so a range of the exact size is found even when a larger one comes first
+TEST(rangeAllocatorSmallSizeClasses)
+{
+	RangeAllocator allocator;
+	const std::vector<Range> ranges = { { 5, true }, { 1, false }, { 4, true }, { 1, false }, { 3, true }, { 1, false } };
+	createLayout(allocator, ranges);
+
+	const RangeAllocator::Handle three = allocator.allocate(3);
+	const RangeAllocator::Handle four = allocator.allocate(4);
+	const RangeAllocator::Handle five = allocator.allocate(5);
+	CHECK(allocator.getOffset(three) == getLayoutOffset(ranges, 4));
+	CHECK(allocator.getOffset(four) == getLayoutOffset(ranges, 2));
+	CHECK(allocator.getOffset(five) == getLayoutOffset(ranges, 0));
+	CHECK(allocator.getFreeSize() == 0);
+	CHECK(allocator.allocate(1) == RangeAllocator::INVALID_HANDLE);
+}
+
+// above 16 every power of two is split into 16 classes: 40 and 41 share the class [40, 42), 42 starts the next one
+TEST(rangeAllocatorLargeSizeClasses)
+{
+	RangeAllocator allocator;
+	const std::vector<Range> ranges = { { 42, true }, { 1, false }, { 41, true }, { 1, false }, { 40, true }, { 1, false } };
+	createLayout(allocator, ranges);
+
+	CHECK(allocator.getLargestFreeSize() == 42);
+
+	// 40 is the lower bound of its class, so any range in it fits and the first one in the list is taken
+	const RangeAllocator::Handle forty = allocator.allocate(40);
+	CHECK(allocator.getSize(forty) == 40);
+	CHECK(allocator.getOffset(forty) == getLayoutOffset(ranges, 4) || allocator.getOffset(forty) == getLayoutOffset(ranges, 2));
+	CHECK(allocator.getOffset(forty) != getLayoutOffset(ranges, 0));
+
+	// classes far apart, up to the largest one
+	RangeAllocator large(0xFFFFFFFFu);
+	const RangeAllocator::Handle half = large.allocate(0x80000000u);
+	CHECK(half != RangeAllocator::INVALID_HANDLE);
+	CHECK(large.getLargestFreeSize() == 0x7FFFFFFFu);
+	CHECK(large.allocate(0x80000000u) == RangeAllocator::INVALID_HANDLE);
+	CHECK(large.allocate(0x7FFFFFFFu) != RangeAllocator::INVALID_HANDLE);
+}
+
+// a size that is the lower bound of its class takes a range of exactly that size before a larger one
+TEST(rangeAllocatorFindsExactFit)
+{
+	RangeAllocator allocator;
+	const std::vector<Range> ranges = { { 1000, true }, { 1, false }, { 64, true }, { 1, false }, { 48, true }, { 1, false } };
+	createLayout(allocator, ranges);
+
+	const RangeAllocator::Handle handle = allocator.allocate(48);
+	CHECK(allocator.getOffset(handle) == getLayoutOffset(ranges, 4));
+
+	const RangeAllocator::Handle next = allocator.allocate(64);
+	CHECK(allocator.getOffset(next) == getLayoutOffset(ranges, 2));
+	CHECK(allocator.getLargestFreeSize() == 1000);
+}
+
+// Other sizes first look in the classes above theirs, where every range fits.
+// Their own class also holds smaller ranges, so it is only searched when nothing larger is free.
+TEST(rangeAllocatorFallsBackToOwnClass)
+{
+	RangeAllocator allocator;
+	const std::vector<Range> ranges = { { 40, true }, { 1, false }, { 41, true }, { 1, false }, { 200, true }, { 1, false } };
+	std::vector<RangeAllocator::Handle> handles = createLayout(allocator, ranges);
+
+	const RangeAllocator::Handle fromLarger = allocator.allocate(41);
+	CHECK(allocator.getOffset(fromLarger) == getLayoutOffset(ranges, 4));
+	CHECK(allocator.getLargestFreeSize() == 200 - 41);
+
+	// nothing above the class is left, the 40 range in the class doesn't fit and the 41 one does
+	allocator.allocate(200 - 41);
+	const RangeAllocator::Handle fromOwnClass = allocator.allocate(41);
+	CHECK(allocator.getOffset(fromOwnClass) == getLayoutOffset(ranges, 2));
+
+	// the 40 range and a single unit are left: 41 fails although 41 units are free in total
+	allocator.free(handles[5]);
+	CHECK(allocator.getFreeSize() == 41);
+	CHECK(allocator.getLargestFreeSize() == 40);
+	CHECK(allocator.allocate(41) == RangeAllocator::INVALID_HANDLE);
+	CHECK(allocator.allocate(40) != RangeAllocator::INVALID_HANDLE);
+}
+
+TEST(rangeAllocatorCoalescesOnFree)
+{
+	RangeAllocator allocator(100);
+	RangeAllocator::Handle handles[5];
+	for (RangeAllocator::Handle& handle : handles)
+	{
+		handle = allocator.allocate(20);
+	}
+	CHECK(allocator.getFreeSize() == 0);
+
+	// with the next range
+	allocator.free(handles[4]);
+	allocator.free(handles[3]);
+	CHECK(allocator.getLargestFreeSize() == 40);
+
+	// with the previous range
+	allocator.free(handles[0]);
+	allocator.free(handles[1]);
+	CHECK(allocator.getLargestFreeSize() == 40);
+	CHECK(allocator.getAllocationCount() == 1);
+
+	// with both, leaving one range of the whole capacity
+	allocator.free(handles[2]);
+	CHECK(allocator.getUsedSize() == 0);
+	CHECK(allocator.getLargestFreeSize() == 100);
+
+	const RangeAllocator::Handle whole = allocator.allocate(100);
+	CHECK(whole != RangeAllocator::INVALID_HANDLE);
+	CHECK(allocator.getOffset(whole) == 0);
+}
+
+TEST(rangeAllocatorGrows)
+{
+	RangeAllocator allocator;
+	CHECK(allocator.allocate(1) == RangeAllocator::INVALID_HANDLE);
+
+	// a free range at the end is extended
+	allocator.grow(50);
+	const RangeAllocator::Handle first = allocator.allocate(30);
+	allocator.grow(80);
+	CHECK(allocator.getCapacity() == 80);
+	CHECK(allocator.getLargestFreeSize() == 50);
+	CHECK(allocator.getOffset(first) == 0);
+
+	// with an allocation at the end a new range is added after it
+	const RangeAllocator::Handle second = allocator.allocate(50);
+	CHECK(allocator.getOffset(second) == 30);
+	allocator.grow(100);
+	CHECK(allocator.getLargestFreeSize() == 20);
+	CHECK(allocator.getOffset(first) == 0);
+	CHECK(allocator.getOffset(second) == 30);
+
+	// the added range merges with a freed last allocation
+	allocator.free(second);
+	CHECK(allocator.getLargestFreeSize() == 70);
+	allocator.grow(100);
+	CHECK(allocator.getLargestFreeSize() == 70);
+}
+
+// The moves must come in offset order and each copy may only overwrite ranges that were already copied,
+// so copying one unit after another in a buffer ends with every allocation intact at its new offset.
+TEST(rangeAllocatorDefragmentsInOffsetOrder)
+{
+	std::mt19937 random(4);
+	RangeAllocator allocator(4096);
+	std::vector<uint32_t> buffer(allocator.getCapacity(), RangeAllocator::INVALID_HANDLE);
+
+	std::vector<RangeAllocator::Handle> handles;
+	for (uint32_t i = 0; i < 2000; ++i)
+	{
+		if (!handles.empty() && random() % 3 == 0)
+		{
+			const size_t index = random() % handles.size();
+			allocator.free(handles[index]);
+			handles[index] = handles.back();
+			handles.pop_back();
+			continue;
+		}
+
+		const RangeAllocator::Handle handle = allocator.allocate(1 + random() % 40);
+		if (handle != RangeAllocator::INVALID_HANDLE)
+		{
+			std::fill_n(buffer.begin() + allocator.getOffset(handle), allocator.getSize(handle), handle);
+			handles.push_back(handle);
+		}
+	}
+	CHECK(!handles.empty());
+
+	const uint32_t usedSize = allocator.getUsedSize();
+	const std::vector<RangeAllocator::Move> moves = allocator.defragment();
+	CHECK(!moves.empty());
+
+	uint32_t previousOldOffset = 0;
+	for (const RangeAllocator::Move& move : moves)
+	{
+		CHECK(move.newOffset < move.oldOffset);
+		CHECK(move.oldOffset >= previousOldOffset);
+		CHECK(move.size == allocator.getSize(move.handle));
+		CHECK(move.newOffset == allocator.getOffset(move.handle));
+		previousOldOffset = move.oldOffset;
+
+		for (uint32_t unit = 0; unit < move.size; ++unit)
+		{
+			buffer[move.newOffset + unit] = buffer[move.oldOffset + unit];
+		}
+	}
+
+	// allocations are packed in their old order and hold what they held before
+	std::sort(handles.begin(), handles.end(), [&](RangeAllocator::Handle a, RangeAllocator::Handle b)
+	{
+		return allocator.getOffset(a) < allocator.getOffset(b);
+	});
+
+	uint32_t offset = 0;
+	for (RangeAllocator::Handle handle : handles)
+	{
+		CHECK(allocator.getOffset(handle) == offset);
+		for (uint32_t unit = 0; unit < allocator.getSize(handle); ++unit)
+		{
+			CHECK(buffer[offset + unit] == handle);
+		}
+		offset += allocator.getSize(handle);
+	}
+
+	CHECK(offset == usedSize);
+	CHECK(allocator.getUsedSize() == usedSize);
+	CHECK(allocator.getLargestFreeSize() == allocator.getCapacity() - usedSize);
+	CHECK(allocator.defragment().empty());
+}
@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+// Minimal test registry, TEST defines a function run by main and CHECK records a failure without stopping the test.
+namespace Tests
+{
+	struct TestCase
+	{
+		const char* name;
+		void (*function)();
+	};
+
+	std::vector<TestCase>& getTestCases();
+	void reportFailure(const char* file, int line, const char* expression);
+	uint32_t getFailureCount();
+
+	struct TestRegistrar
+	{
+		TestRegistrar(const char* name, void (*function)())
+		{
+			getTestCases().push_back({ name, function });
+		}
+	};
+}
+
+#define TEST(name) \
+	static void name(); \
+	static Tests::TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(expression) ((expression) ? (void)0 : Tests::reportFailure(__FILE__, __LINE__, #expression))
@@ -0,0 +1,222 @@
+#include "test.h"
+#include "render/meshSystem/mesh/mesh.h"
+#include "math/intersection.h"
+#include "math/ray.h"
+#include "math/rayPacket.h"
+#include <cmath>
+#include <random>
+
+using namespace Engine;
+
+namespace
+{
+	const TriangleBVH::Layout LAYOUTS[] = { TriangleBVH::Layout::BINARY, TriangleBVH::Layout::QUANTIZED_WIDE };
+
+	// size x size quads of two triangles, vertices are moved by up to jitter in every axis, a jitter of 0 keeps the grid flat at z = 0
+	void createGrid(Mesh& mesh, uint32_t size, float jitter, std::mt19937& random)
+	{
+		std::uniform_real_distribution<float> offset(-jitter, jitter);
+
+		mesh.vertices.resize((size + 1) * (size + 1));
+		for (uint32_t y = 0; y <= size; ++y)
+		{
+			for (uint32_t x = 0; x <= size; ++x)
+			{
+				mesh.vertices[y * (size + 1) + x].position = math::Vec3f(float(x) + offset(random), float(y) + offset(random), offset(random));
+			}
+		}
+
+		mesh.triangles.clear();
+		for (uint32_t y = 0; y < size; ++y)
+		{
+			for (uint32_t x = 0; x < size; ++x)
+			{
+				uint32_t corner = y * (size + 1) + x;
+				mesh.triangles.emplace_back(corner, corner + size + 1, corner + 1, mesh.vertices.data());
+				mesh.triangles.emplace_back(corner + 1, corner + size + 1, corner + size + 2, mesh.vertices.data());
+			}
+		}
+
+		mesh.createBoundingBox();
+	}
+
+	// Traces the rays one by one and as packets of up to RayPacket::SIZE lanes, lanes beyond the ray count stay inactive.
+	// Both must find the same nearest distance up to rounding: triangles sharing the edge a ray passes get distances an ulp apart,
+	// and which of them is found first depends on the traversal order.
+	void checkPacketsMatchSingleRays(const Mesh& mesh, const std::vector<math::Ray>& rays)
+	{
+		for (size_t first = 0; first < rays.size(); first += math::RayPacket::SIZE)
+		{
+			const uint32_t laneCount = uint32_t(std::min<size_t>(math::RayPacket::SIZE, rays.size() - first));
+
+			math::RayPacket packet;
+			math::MeshIntersection packetHits[math::RayPacket::SIZE];
+			for (uint32_t lane = 0; lane < math::RayPacket::SIZE; ++lane)
+			{
+				packet.set(lane, rays[first + std::min(lane, laneCount - 1)]);
+				packetHits[lane].reset(0.0f);
+			}
+
+			const uint32_t activeMask = (1u << laneCount) - 1;
+			const uint32_t hitMask = mesh.bvh.intersect(packet, activeMask, packetHits);
+			CHECK((hitMask & ~activeMask) == 0);
+
+			for (uint32_t lane = 0; lane < laneCount; ++lane)
+			{
+				math::MeshIntersection single;
+				single.reset(0.0f);
+				const bool isHit = mesh.bvh.intersect(rays[first + lane], single);
+
+				CHECK(isHit == ((hitMask >> lane) & 1));
+				CHECK(isHit == packetHits[lane].valid());
+				if (isHit && packetHits[lane].valid())
+				{
+					CHECK(std::abs(single.t - packetHits[lane].t) <= single.t * 1e-6f);
+				}
+			}
+
+			for (uint32_t lane = laneCount; lane < math::RayPacket::SIZE; ++lane)
+			{
+				CHECK(!packetHits[lane].valid());
+			}
+		}
+	}
+}
+
+// rays through vertices and along shared edges of a non-planar grid are where a non-watertight test would leak
+TEST(packetMatchesSingleRaysOnEdgesAndVertices)
+{
+	std::mt19937 random(1);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	for (TriangleBVH::Layout layout : LAYOUTS)
+	{
+		Mesh mesh;
+		createGrid(mesh, 64, 0.2f, random);
+		mesh.initializeBVH(layout);
+
+		std::vector<math::Ray> rays;
+		for (uint32_t packet = 0; packet < 4096; ++packet)
+		{
+			// lanes of a packet share the origin, like camera rays
+			const math::Vec3f origin(unit(random) * 64.0f, unit(random) * 64.0f, -20.0f - unit(random) * 10.0f);
+			for (uint32_t lane = 0; lane < math::RayPacket::SIZE; ++lane)
+			{
+				const math::Triangle& triangle = mesh.triangles[random() % mesh.triangles.size()];
+				const math::Vec3f& a = mesh.vertices[triangle.vertexIndices[random() % 3]].position;
+				const math::Vec3f& b = mesh.vertices[triangle.vertexIndices[(random() % 2) + 1]].position;
+
+				const math::Vec3f target = packet % 2 ? a : a + (b - a) * unit(random);
+				rays.push_back({ origin, target - origin });
+			}
+		}
+
+		checkPacketsMatchSingleRays(mesh, rays);
+	}
+}
+
+// Rays along +z through the vertex columns of a flat grid run exactly in the face planes of the nodes.
+// All of them hit, packets of any lane count match single rays.
+TEST(packetMatchesSingleRaysInNodeFacePlanes)
+{
+	std::mt19937 random(2);
+
+	for (TriangleBVH::Layout layout : LAYOUTS)
+	{
+		Mesh mesh;
+		createGrid(mesh, 64, 0.0f, random);
+		mesh.initializeBVH(layout);
+
+		std::vector<math::Ray> rays;
+		for (uint32_t y = 0; y <= 64; ++y)
+		{
+			for (uint32_t x = 0; x <= 64; ++x)
+			{
+				rays.push_back({ math::Vec3f(float(x), float(y), -1.0f), math::Vec3f(0.0f, 0.0f, 1.0f) });
+			}
+		}
+
+		for (const math::Ray& ray : rays)
+		{
+			math::MeshIntersection nearest;
+			nearest.reset(0.0f);
+			CHECK(mesh.bvh.intersect(ray, nearest));
+			CHECK(mesh.bvh.occluded(ray, 2.0f));
+		}
+
+		checkPacketsMatchSingleRays(mesh, rays);
+	}
+}
+
+// lanes missing the mesh, pointing away from it or disabled by the mask keep their nearest intersection
+TEST(packetKeepsMissedAndInactiveLanes)
+{
+	std::mt19937 random(3);
+
+	for (TriangleBVH::Layout layout : LAYOUTS)
+	{
+		Mesh mesh;
+		createGrid(mesh, 16, 0.1f, random);
+		mesh.initializeBVH(layout);
+
+		math::RayPacket packet;
+		math::MeshIntersection hits[math::RayPacket::SIZE];
+		for (uint32_t lane = 0; lane < math::RayPacket::SIZE; ++lane)
+		{
+			packet.set(lane, { math::Vec3f(8.0f + float(lane) * 0.25f, 8.0f, -5.0f), math::Vec3f(0.0f, 0.0f, 1.0f) });
+			hits[lane].reset(0.0f);
+			hits[lane].triangle = UINT32_MAX;
+		}
+		packet.set(0, { math::Vec3f(100.0f, 100.0f, -5.0f), math::Vec3f(0.0f, 0.0f, 1.0f) }); // beside the grid
+		packet.set(1, { math::Vec3f(8.0f, 8.0f, -5.0f), math::Vec3f(0.0f, 0.0f, -1.0f) }); // away from the grid
+
+		const uint32_t activeMask = math::RayPacket::FULL_MASK & ~(1u << 2);
+		const uint32_t hitMask = mesh.bvh.intersect(packet, activeMask, hits);
+
+		for (uint32_t lane = 0; lane < math::RayPacket::SIZE; ++lane)
+		{
+			const bool shouldHit = lane > 2;
+			CHECK(((hitMask >> lane) & 1) == uint32_t(shouldHit));
+			CHECK(hits[lane].valid() == shouldHit);
+			CHECK((hits[lane].triangle == UINT32_MAX) == !shouldHit);
+		}
+	}
+}
+
+// trees are only shared between meshes whose content compares equal, not just their hash
+TEST(sharedTreesRequireEqualContent)
+{
+	std::mt19937 random(5);
+
+	for (TriangleBVH::Layout layout : LAYOUTS)
+	{
+		Mesh mesh;
+		createGrid(mesh, 16, 0.1f, random);
+		mesh.initializeBVH(layout);
+
+		Mesh copy;
+		copy.vertices = mesh.vertices;
+		copy.triangles = mesh.triangles;
+		for (math::Triangle& triangle : copy.triangles)
+		{
+			triangle.verticesArray = copy.vertices.data();
+		}
+
+		const TriangleBVH& bvh = mesh.bvh;
+		CHECK(TriangleBVH::hasEqualContent(mesh, copy));
+		CHECK(TriangleBVH::isBuiltFrom(copy, bvh.getTriangles(), bvh.getTriangleData(), bvh.getTriangleStride()));
+
+		copy.vertices[100].position.z() += 1e-3f;
+		CHECK(!TriangleBVH::hasEqualContent(mesh, copy));
+		CHECK(!TriangleBVH::isBuiltFrom(copy, bvh.getTriangles(), bvh.getTriangleData(), bvh.getTriangleStride()));
+
+		copy.vertices[100].position = mesh.vertices[100].position;
+		std::swap(copy.triangles[0].vertexIndices[0], copy.triangles[0].vertexIndices[1]);
+		CHECK(!TriangleBVH::hasEqualContent(mesh, copy));
+		CHECK(!TriangleBVH::isBuiltFrom(copy, bvh.getTriangles(), bvh.getTriangleData(), bvh.getTriangleStride()));
+
+		copy.triangles.pop_back();
+		CHECK(!TriangleBVH::hasEqualContent(mesh, copy));
+		CHECK(!TriangleBVH::isBuiltFrom(copy, bvh.getTriangles(), bvh.getTriangleData(), bvh.getTriangleStride()));
+	}
+}